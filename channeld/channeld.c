@@ -218,6 +218,9 @@ struct peer {
 
 	/* --experimental-upgrade-protocol */
 	bool experimental_upgrade;
+
+	/* Can hsmd sign all our HTLC txs for a commitment in one go? */
+	bool hsm_sign_remote_htlc_txs;
 };
 
 static u8 *create_channel_announcement(const tal_t *ctx, struct peer *peer);
@@ -1292,6 +1295,7 @@ static struct bitcoin_signature *calc_commitsigs(const tal_t *ctx,
 	struct pubkey local_htlckey;
 	const u8 *msg;
 	struct bitcoin_signature *htlc_sigs;
+	struct remote_htlc_tx **htlc_txs;
 
 	htlcs = collect_htlcs(tmpctx, htlc_map);
 	msg = towire_hsmd_sign_remote_commitment_tx(NULL, txs[0],
@@ -1332,22 +1336,49 @@ static struct bitcoin_signature *calc_commitsigs(const tal_t *ctx,
 	 *  - MUST include one `htlc_signature` for every HTLC transaction
 	 *    corresponding to the ordering of the commitment transaction
 	 */
-	htlc_sigs = tal_arr(ctx, struct bitcoin_signature, tal_count(txs) - 1);
-
-	for (i = 0; i < tal_count(htlc_sigs); i++) {
-		u8 *wscript;
-
-		wscript = bitcoin_tx_output_get_witscript(tmpctx, txs[0],
+	htlc_txs = tal_arr(tmpctx, struct remote_htlc_tx *, tal_count(txs) - 1);
+	for (i = 0; i < tal_count(htlc_txs); i++) {
+		htlc_txs[i] = tal(htlc_txs, struct remote_htlc_tx);
+		htlc_txs[i]->tx = txs[i+1];
+		htlc_txs[i]->wscript
+			= bitcoin_tx_output_get_witscript(htlc_txs[i], txs[0],
 							  txs[i+1]->wtx->inputs[0].index);
-		msg = towire_hsmd_sign_remote_htlc_tx(NULL, txs[i + 1], wscript,
-						      &peer->remote_per_commit,
-						      channel_has_anchors(peer->channel));
+	}
 
+	/* No HTLCs (the common case)?  Then there's nothing to ask for. */
+	if (peer->hsm_sign_remote_htlc_txs && tal_count(htlc_txs) != 0) {
+		msg = towire_hsmd_sign_remote_htlc_txs(NULL,
+						       cast_const2(const struct remote_htlc_tx **,
+								   htlc_txs),
+						       &peer->remote_per_commit,
+						       channel_has_anchors(peer->channel));
 		msg = hsm_req(tmpctx, take(msg));
-		if (!fromwire_hsmd_sign_tx_reply(msg, &htlc_sigs[i]))
+		if (!fromwire_hsmd_sign_remote_htlc_txs_reply(ctx, msg,
+							      &htlc_sigs)
+		    || tal_count(htlc_sigs) != tal_count(htlc_txs))
 			status_failed(STATUS_FAIL_HSM_IO,
-				      "Bad sign_remote_htlc_tx reply: %s",
+				      "Bad sign_remote_htlc_txs reply: %s",
 				      tal_hex(tmpctx, msg));
+	} else {
+		htlc_sigs = tal_arr(ctx, struct bitcoin_signature,
+				    tal_count(htlc_txs));
+		for (i = 0; i < tal_count(htlc_txs); i++) {
+			msg = towire_hsmd_sign_remote_htlc_tx(NULL,
+							      htlc_txs[i]->tx,
+							      htlc_txs[i]->wscript,
+							      &peer->remote_per_commit,
+							      channel_has_anchors(peer->channel));
+
+			msg = hsm_req(tmpctx, take(msg));
+			if (!fromwire_hsmd_sign_tx_reply(msg, &htlc_sigs[i]))
+				status_failed(STATUS_FAIL_HSM_IO,
+					      "Bad sign_remote_htlc_tx reply: %s",
+					      tal_hex(tmpctx, msg));
+		}
+	}
+
+	for (i = 0; i < tal_count(htlc_sigs); i++) {
+		const u8 *wscript = htlc_txs[i]->wscript;
 
 		status_debug("Creating HTLC signature %s for tx %s wscript %s key %s",
 			     type_to_string(tmpctx, struct bitcoin_signature,
@@ -5774,7 +5805,8 @@ static void init_channel(struct peer *peer)
 				    &reestablish_only,
 				    &peer->channel_update,
 				    &peer->experimental_upgrade,
-				    &peer->splice_state->inflights)) {
+				    &peer->splice_state->inflights,
+				    &peer->hsm_sign_remote_htlc_txs)) {
 		master_badmsg(WIRE_CHANNELD_INIT, msg);
 	}
 
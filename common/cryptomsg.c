@@ -149,17 +149,14 @@ bool cryptomsg_decrypt_header(struct crypto_state *cs, const u8 hdr[18],
 	return true;
 }
 
-u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
-			  struct crypto_state *cs,
-			  const u8 *msg TAKES)
+size_t cryptomsg_encrypt_msg_into(struct crypto_state *cs,
+				  const u8 *msg, size_t mlen,
+				  u8 *out)
 {
 	unsigned char npub[crypto_aead_chacha20poly1305_ietf_NPUBBYTES];
-	unsigned long long clen, mlen = tal_count(msg);
+	unsigned long long clen;
 	be16 l;
 	int ret;
-	u8 *out;
-
-	out = tal_arr(ctx, u8, sizeof(l) + 16 + mlen + 16);
 
 	/* BOLT #8:
 	 *
@@ -231,6 +228,20 @@ u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
 
 	maybe_rotate_key(&cs->sn, &cs->sk, &cs->s_ck);
 
+	return CRYPTOMSG_HDR_SIZE + mlen + CRYPTOMSG_BODY_OVERHEAD;
+}
+
+u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
+			  struct crypto_state *cs,
+			  const u8 *msg TAKES)
+{
+	size_t mlen = tal_count(msg);
+	u8 *out;
+
+	out = tal_arr(ctx, u8,
+		      CRYPTOMSG_HDR_SIZE + mlen + CRYPTOMSG_BODY_OVERHEAD);
+	cryptomsg_encrypt_msg_into(cs, msg, mlen, out);
+
 	if (taken(msg))
 		tal_free(msg);
 	return out;
@@ -25,6 +25,12 @@
 u8 *cryptomsg_encrypt_msg(const tal_t *ctx,
 			  struct crypto_state *cs,
 			  const u8 *msg);
+/* Encrypts msg (of length mlen) into out, which must have room for
+ * CRYPTOMSG_HDR_SIZE + mlen + CRYPTOMSG_BODY_OVERHEAD bytes.  Returns
+ * that length.  Lets callers pack several messages into one buffer. */
+size_t cryptomsg_encrypt_msg_into(struct crypto_state *cs,
+				  const u8 *msg, size_t mlen,
+				  u8 *out);
 bool cryptomsg_decrypt_header(struct crypto_state *cs, const u8 hdr[18],
 			      u16 *lenp);
 u8 *cryptomsg_decrypt_body(const tal_t *ctx,
@@ -1,22 +1,19 @@
-/* Without this, gheap is *really* slow!  Comment out for debugging. */
-#define NDEBUG
 #include "config.h"
-#include <ccan/cast/cast.h>
+#include <assert.h>
 #include <common/dijkstra.h>
 #include <common/gossmap.h>
-#include <gheap.h>
 
 /* Each node has this side-info. */
-struct dijkstra {
+struct dijkstra_node {
+	/* Only valid if this matches dijkstra_space.gen */
+	u32 gen;
 	u32 distance;
 	/* Total CLTV delay */
 	u32 total_delay;
 	/* Total cost from here to destination */
 	struct amount_msat cost;
-	/* I want to use an index here, except that gheap moves things onto
-	 * a temporary on the stack and that makes things complex. */
-	/* NULL means it's been visited already. */
-	const struct gossmap_node **heapptr;
+	/* Where we are in the heap, or HEAP_UNSEEN / HEAP_VISITED */
+	u32 heappos;
 
 	/* How we decide "best", lower is better */
 	u64 score;
@@ -25,82 +22,318 @@ struct dijkstra {
 	struct gossmap_chan *best_chan;
 };
 
-/* Because item_mover doesn't provide a ctx ptr, we need a global anyway. */
-static struct dijkstra *global_dijkstra;
-static const struct gossmap *global_map;
+/* Not reached yet, so not in the heap. */
+#define HEAP_UNSEEN UINT32_MAX
+/* Popped off the heap: we have its best path. */
+#define HEAP_VISITED (UINT32_MAX - 1)
+
+/* These are in the inner loop: only check them in developer builds. */
+#if DEVELOPER
+#define heap_assert(e) assert(e)
+#else
+#define heap_assert(e) ((void)0)
+#endif
+
+/* A 4-ary min-heap indexed by node: each node knows its position (heappos),
+ * so we can decrease its score in place.  Nodes are only added when we first
+ * reach them.  We keep the score alongside the index so comparisons don't
+ * have to chase into the node array. */
+#define HEAP_FANOUT 4
+
+struct heap_entry {
+	u64 score;
+	u32 node_idx;
+};
+
+/* Per-node arrays are as big as the gossmap, so we keep them between
+ * searches: bumping gen invalidates every node at once, and a search only
+ * pays for the nodes it reaches.  The heap grows as needed, too. */
+struct dijkstra_space {
+	u32 gen;
+	struct dijkstra_node *nodes;
+	struct heap_entry *heap;
+	size_t heap_size;
+};
+
+/* What we hand back: the space is ours until this is freed. */
+struct dijkstra {
+	struct dijkstra_space *space;
+};
+
+/* A space nobody is using, for the next search.  Each search has its own
+ * space while its result is alive, so several can run at once. */
+static __thread struct dijkstra_space *spare_space;
+
+static void destroy_dijkstra(struct dijkstra *dij)
+{
+	if (spare_space)
+		tal_free(dij->space);
+	else
+		spare_space = dij->space;
+}
+
+static struct dijkstra *new_dijkstra(const tal_t *ctx, size_t max_node_idx)
+{
+	struct dijkstra *dij = tal(ctx, struct dijkstra);
+	struct dijkstra_space *space = spare_space;
+
+	if (space)
+		spare_space = NULL;
+	else {
+		/* Only spare_space points to it between searches. */
+		space = tal_label(NULL, struct dijkstra_space,
+				  "struct dijkstra_space_notleak");
+		space->gen = 0;
+		space->nodes = tal_arrz(space, struct dijkstra_node, 0);
+		space->heap = tal_arr(space, struct heap_entry, 16);
+	}
+
+	/* gen 0 is never valid, so new (zeroed) nodes start out unseen. */
+	if (++space->gen == 0) {
+		memset(space->nodes, 0, tal_bytelen(space->nodes));
+		space->gen = 1;
+	}
+	if (tal_count(space->nodes) < max_node_idx)
+		tal_resizez(&space->nodes, max_node_idx);
+	space->heap_size = 0;
+
+	dij->space = space;
+	tal_add_destructor(dij, destroy_dijkstra);
+	return dij;
+}
+
+/* The node's info, resetting it if we haven't touched it this search. */
+static struct dijkstra_node *dij_node(struct dijkstra_space *space,
+				      u32 node_idx)
+{
+	struct dijkstra_node *n = &space->nodes[node_idx];
+
+	if (n->gen != space->gen) {
+		n->gen = space->gen;
+		n->heappos = HEAP_UNSEEN;
+		n->distance = UINT_MAX;
+		n->cost = AMOUNT_MSAT(-1ULL);
+		n->total_delay = 0;
+		n->score = -1ULL;
+		n->best_chan = NULL;
+	}
+	return n;
+}
+
+static void heap_place(struct dijkstra_space *space,
+		       size_t pos, struct heap_entry e)
+{
+	space->heap[pos] = e;
+	space->nodes[e.node_idx].heappos = pos;
+}
+
+static void heap_sift_up(struct dijkstra_space *space, size_t pos)
+{
+	struct heap_entry e = space->heap[pos];
+
+	while (pos > 0) {
+		size_t parent = (pos - 1) / HEAP_FANOUT;
+		if (space->heap[parent].score <= e.score)
+			break;
+		heap_place(space, pos, space->heap[parent]);
+		pos = parent;
+	}
+	heap_place(space, pos, e);
+}
+
+static void heap_sift_down(struct dijkstra_space *space, size_t pos)
+{
+	struct heap_entry e = space->heap[pos];
+
+	for (;;) {
+		size_t first = pos * HEAP_FANOUT + 1, best = first;
+
+		if (first >= space->heap_size)
+			break;
+		for (size_t c = first + 1;
+		     c < first + HEAP_FANOUT && c < space->heap_size;
+		     c++) {
+			if (space->heap[c].score < space->heap[best].score)
+				best = c;
+		}
+		if (space->heap[best].score >= e.score)
+			break;
+		heap_place(space, pos, space->heap[best]);
+		pos = best;
+	}
+	heap_place(space, pos, e);
+}
+
+/* Add node, or lower its key if it's already there.  The key is the score,
+ * plus any A* bound for getting from there to the target. */
+static void heap_update(struct dijkstra_space *space, u32 node_idx, u64 key)
+{
+	struct heap_entry e;
+	size_t pos = space->nodes[node_idx].heappos;
+
+	heap_assert(space->nodes[node_idx].gen == space->gen);
+	heap_assert(pos != HEAP_VISITED);
+	e.score = key;
+	e.node_idx = node_idx;
+	if (pos == HEAP_UNSEEN) {
+		if (space->heap_size == tal_count(space->heap))
+			tal_resize(&space->heap, space->heap_size * 2);
+		pos = space->heap_size++;
+	}
+	space->heap[pos] = e;
+	heap_sift_up(space, pos);
+}
+
+static u32 heap_pop(struct dijkstra_space *space)
+{
+	u32 top = space->heap[0].node_idx;
+
+	space->nodes[top].heappos = HEAP_VISITED;
+	if (--space->heap_size) {
+		space->heap[0] = space->heap[space->heap_size];
+		heap_sift_down(space, 0);
+	}
+	return top;
+}
 
 /* Returns UINT_MAX if unreachable. */
 u32 dijkstra_distance(const struct dijkstra *dij, u32 node_idx)
 {
-	return dij[node_idx].distance;
+	const struct dijkstra_node *n = &dij->space->nodes[node_idx];
+
+	if (n->gen != dij->space->gen)
+		return UINT_MAX;
+	return n->distance;
 }
 
 struct gossmap_chan *dijkstra_best_chan(const struct dijkstra *dij,
 					u32 node_idx)
 {
-	return dij[node_idx].best_chan;
+	const struct dijkstra_node *n = &dij->space->nodes[node_idx];
+
+	if (n->gen != dij->space->gen)
+		return NULL;
+	return n->best_chan;
 }
 
-static struct dijkstra *get_dijkstra(const struct dijkstra *dij,
-				     const struct gossmap *map,
-				     const struct gossmap_node *n)
+/* Hop counts from each landmark to every node, interleaved by node so one
+ * lookup touches one cacheline.  Hop counts above LANDMARK_MAX_HOPS are
+ * clamped, which only ever weakens the bound. */
+#define LANDMARK_UNREACHABLE UINT16_MAX
+#define LANDMARK_MAX_HOPS (UINT16_MAX - 1)
+
+struct dijkstra_landmarks {
+	u64 generation;
+	size_t num_landmarks;
+	/* hops[node_idx * num_landmarks + l] */
+	u16 *hops;
+};
+
+/* Breadth-first from landmark, filling in column l.  Returns the (first)
+ * furthest node we reached, which is a good pick for the next landmark. */
+static u32 landmark_bfs(const struct gossmap *map,
+			struct dijkstra_landmarks *lm,
+			size_t l, u32 landmark_idx, u32 *queue)
 {
-	return cast_const(struct dijkstra *, dij) + gossmap_node_idx(map, n);
+	size_t qhead = 0, qtail = 0;
+	u16 *hops = lm->hops + l;
+	const size_t stride = lm->num_landmarks;
+	u32 furthest = landmark_idx;
+
+	hops[landmark_idx * stride] = 0;
+	queue[qtail++] = landmark_idx;
+	while (qhead != qtail) {
+		u32 cur_idx = queue[qhead++];
+		const struct gossmap_node *cur = gossmap_node_byidx(map, cur_idx);
+		u16 next_hops = hops[cur_idx * stride];
+
+		furthest = cur_idx;
+		if (next_hops < LANDMARK_MAX_HOPS)
+			next_hops++;
+		for (size_t i = 0; i < cur->num_chans; i++) {
+			int which_half;
+			struct gossmap_chan *c;
+			u32 neighbor_idx;
+
+			c = gossmap_nth_chan(map, cur, i, &which_half);
+			neighbor_idx = gossmap_node_idx(map,
+							gossmap_nth_node(map, c,
+									 !which_half));
+			if (hops[neighbor_idx * stride] != LANDMARK_UNREACHABLE)
+				continue;
+			hops[neighbor_idx * stride] = next_hops;
+			queue[qtail++] = neighbor_idx;
+		}
+	}
+	return furthest;
 }
 
-/* We want a minheap, not a maxheap, so this is backwards! */
-static int less_comparer(const void *const ctx,
-			 const void *const a,
-			 const void *const b)
+/* Landmarks are picked "farthest first": start at the best-connected node,
+ * then keep choosing whatever the last BFS found furthest away.  We ignore
+ * direction, disabled flags and capacity, so the hop counts are a lower
+ * bound for whatever channels a search later decides it can use. */
+struct dijkstra_landmarks *dijkstra_landmarks_new(const tal_t *ctx,
+						  const struct gossmap *map,
+						  size_t num_landmarks)
 {
-	return get_dijkstra(global_dijkstra, global_map,
-			    *(struct gossmap_node **)a)->score
-		> get_dijkstra(global_dijkstra, global_map,
-			       *(struct gossmap_node **)b)->score;
+	struct dijkstra_landmarks *lm = tal(ctx, struct dijkstra_landmarks);
+	const size_t max_node_idx = gossmap_max_node_idx(map);
+	u32 *queue;
+	u32 next = UINT32_MAX;
+
+	lm->generation = gossmap_generation(map);
+	lm->num_landmarks = num_landmarks;
+	lm->hops = tal_arr(lm, u16, max_node_idx * num_landmarks);
+	for (size_t i = 0; i < tal_count(lm->hops); i++)
+		lm->hops[i] = LANDMARK_UNREACHABLE;
+
+	for (const struct gossmap_node *n = gossmap_first_node(map);
+	     n;
+	     n = gossmap_next_node(map, n)) {
+		if (next == UINT32_MAX
+		    || n->num_chans > gossmap_node_byidx(map, next)->num_chans)
+			next = gossmap_node_idx(map, n);
+	}
+
+	/* Empty map?  Then every bound is 0, which is fine. */
+	if (next == UINT32_MAX) {
+		lm->num_landmarks = 0;
+		return lm;
+	}
+
+	queue = tal_arr(NULL, u32, max_node_idx);
+	for (size_t l = 0; l < num_landmarks; l++)
+		next = landmark_bfs(map, lm, l, next, queue);
+	tal_free(queue);
+	return lm;
 }
 
-static void item_mover(void *const dst, const void *const src)
+bool dijkstra_landmarks_valid(const struct dijkstra_landmarks *lm,
+			      const struct gossmap *map)
 {
-	struct gossmap_node *n = *((struct gossmap_node **)src);
-	get_dijkstra(global_dijkstra, global_map, n)->heapptr = dst;
-	*((struct gossmap_node **)dst) = n;
+	return lm->generation == gossmap_generation(map);
 }
 
-static const struct gossmap_node **mkheap(const tal_t *ctx,
-					  struct dijkstra *dij,
-					  const struct gossmap *map,
-					  const struct gossmap_node *start,
-					  struct amount_msat sent)
+/* By the triangle inequality, a and b are at least |hops(L,a) - hops(L,b)|
+ * apart for every landmark L they can both reach.  This is consistent, too:
+ * moving one hop changes it by at most one. */
+static u32 landmarks_hops_bound(const struct dijkstra_landmarks *lm,
+				u32 a_idx, u32 b_idx)
 {
-	const struct gossmap_node *n, **heap;
-	size_t i;
+	const u16 *a = lm->hops + a_idx * lm->num_landmarks;
+	const u16 *b = lm->hops + b_idx * lm->num_landmarks;
+	u32 bound = 0;
 
-	heap = tal_arr(tmpctx, const struct gossmap_node *,
-		       gossmap_num_nodes(map));
-	for (i = 1, n = gossmap_first_node(map);
-	     n;
-	     n = gossmap_next_node(map, n), i++) {
-		struct dijkstra *d = get_dijkstra(dij, map, n);
-		if (n == start) {
-			/* First entry in heap is start, distance 0 */
-			heap[0] = start;
-			d->heapptr = &heap[0];
-			d->distance = 0;
-			d->total_delay = 0;
-			d->cost = sent;
-			d->score = 0;
-			i--;
-		} else {
-			heap[i] = n;
-			d->heapptr = &heap[i];
-			d->distance = UINT_MAX;
-			d->cost = AMOUNT_MSAT(-1ULL);
-			d->total_delay = 0;
-			d->score = -1ULL;
-		}
+	for (size_t l = 0; l < lm->num_landmarks; l++) {
+		u32 diff;
+
+		if (a[l] == LANDMARK_UNREACHABLE || b[l] == LANDMARK_UNREACHABLE)
+			continue;
+		diff = a[l] > b[l] ? a[l] - b[l] : b[l] - a[l];
+		if (diff > bound)
+			bound = diff;
 	}
-	assert(i == tal_count(heap));
-	return heap;
+	return bound;
 }
 
 /* 365.25 * 24 * 60 / 10 */
@@ -119,44 +352,52 @@ static struct amount_msat risk_price(struct amount_msat amount,
 	return riskfee;
 }
 
-/* Do Dijkstra: start in this case is the dst node. */
-const struct dijkstra *
-dijkstra_(const tal_t *ctx,
-	  const struct gossmap *map,
-	  const struct gossmap_node *start,
-	  struct amount_msat amount,
-	  double riskfactor,
-	  bool (*channel_ok)(const struct gossmap *map,
-			     const struct gossmap_chan *c,
-			     int dir,
-			     struct amount_msat amount,
-			     void *arg),
-	  u64 (*path_score)(u32 distance,
-			    struct amount_msat cost,
-			    struct amount_msat risk,
-			    int dir,
-			    const struct gossmap_chan *c),
-	  void *arg)
+/* Score plus the least path_score can still grow getting to target. */
+static u64 heap_key(const struct dijkstra_space *space,
+		    u32 node_idx, u32 target_idx,
+		    const struct dijkstra_landmarks *landmarks,
+		    u64 (*score_bound)(u32 hops))
 {
-	struct dijkstra *dij;
-	const struct gossmap_node **heap;
-	size_t heapsize;
-	struct gheap_ctx gheap_ctx;
+	u64 key = space->nodes[node_idx].score, bound;
 
-	/* There doesn't seem to be much difference with fanout 2-4. */
-	gheap_ctx.fanout = 2;
-	/* There seems to be a slight decrease if we alter this value. */
-	gheap_ctx.page_chunks = 1;
-	gheap_ctx.item_size = sizeof(*heap);
-	gheap_ctx.less_comparer = less_comparer;
-	gheap_ctx.less_comparer_ctx = NULL;
-	gheap_ctx.item_mover = item_mover;
+	if (!landmarks)
+		return key;
+	bound = score_bound(landmarks_hops_bound(landmarks,
+						 node_idx, target_idx));
+	if (key + bound < key)
+		return -1ULL;
+	return key + bound;
+}
 
-	dij = tal_arr(ctx, struct dijkstra, gossmap_max_node_idx(map));
+/* target_idx is UINT32_MAX to do the whole map. */
+static const struct dijkstra *
+dijkstra_search(const tal_t *ctx,
+		const struct gossmap *map,
+		const struct gossmap_node *start,
+		u32 target_idx,
+		struct amount_msat amount,
+		double riskfactor,
+		bool (*channel_ok)(const struct gossmap *map,
+				   const struct gossmap_chan *c,
+				   int dir,
+				   struct amount_msat amount,
+				   void *arg),
+		u64 (*path_score)(u32 distance,
+				  struct amount_msat cost,
+				  struct amount_msat risk,
+				  int dir,
+				  const struct gossmap_chan *c),
+		const struct dijkstra_landmarks *landmarks,
+		u64 (*score_bound)(u32 hops),
+		void *arg)
+{
+	struct dijkstra *dij;
+	struct dijkstra_space *space;
+	struct dijkstra_node *start_d;
+	u32 start_idx = gossmap_node_idx(map, start);
 
-	/* Pay no attention to the man behind the curtain! */
-	global_map = map;
-	global_dijkstra = dij;
+	dij = new_dijkstra(ctx, gossmap_max_node_idx(map));
+	space = dij->space;
 
 	/* Wikipedia's article on Dijkstra is excellent:
 	 *    https://en.wikipedia.org/wiki/Dijkstra's_algorithm
@@ -170,9 +411,18 @@ dijkstra_(const tal_t *ctx,
 	 * 2. Assign to every node a tentative distance value: set it to zero
 	 * for our initial node and to infinity for all other nodes. Set the
 	 * initial node as current.[14]
+	 *
+	 * new_dijkstra() marked every node unvisited, and dij_node() sets
+	 * them to infinity when we first reach them.
 	 */
-	heap = mkheap(NULL, dij, map, start, amount);
-	heapsize = tal_count(heap);
+	/* Only reached nodes go into the heap, starting with start. */
+	start_d = dij_node(space, start_idx);
+	start_d->distance = 0;
+	start_d->cost = amount;
+	start_d->score = 0;
+	heap_update(space, start_idx,
+		    heap_key(space, start_idx, target_idx,
+			     landmarks, score_bound));
 
 	/*
 	 * 3. For the current node, consider all of its unvisited neighbouds
@@ -199,32 +449,38 @@ dijkstra_(const tal_t *ctx,
 	 * 6.  Otherwise, select the unvisited node that is marked with the
 	 * smallest tentative distance, set it as the new "current node", and
 	 * go back to step 3.
+	 *
+	 * With landmarks, this is A*: we select by tentative distance plus a
+	 * lower bound of what's left to the target.  Because that bound is
+	 * consistent, nodes still come off the heap with their best paths.
 	 */
-	while (heapsize != 0) {
-		struct dijkstra *cur_d;
-		const struct gossmap_node *cur = heap[0];
-
-		cur_d = get_dijkstra(dij, map, cur);
-		assert(cur_d->heapptr == heap);
+	while (space->heap_size != 0) {
+		u32 cur_idx = heap_pop(space);
+		const struct dijkstra_node *cur_d = &space->nodes[cur_idx];
+		const struct gossmap_node *cur;
 
-		/* Finished all reachable nodes */
-		if (cur_d->distance == UINT_MAX)
+		/* Nothing after this can change the path to target. */
+		if (cur_idx == target_idx)
 			break;
 
+		cur = gossmap_node_byidx(map, cur_idx);
+
 		for (size_t i = 0; i < cur->num_chans; i++) {
 			struct gossmap_node *neighbor;
 			int which_half;
 			struct gossmap_chan *c;
-			struct dijkstra *d;
+			struct dijkstra_node *d;
 			struct amount_msat cost, risk;
 			u64 score;
+			u32 neighbor_idx;
 
 			c = gossmap_nth_chan(map, cur, i, &which_half);
 			neighbor = gossmap_nth_node(map, c, !which_half);
 
-			d = get_dijkstra(dij, map, neighbor);
+			neighbor_idx = gossmap_node_idx(map, neighbor);
+			d = dij_node(space, neighbor_idx);
 			/* Ignore if already visited. */
-			if (!d->heapptr)
+			if (d->heappos == HEAP_VISITED)
 				continue;
 
 			/* We're going from neighbor to c, hence !which_half */
@@ -252,13 +508,62 @@ dijkstra_(const tal_t *ctx,
 			d->cost = cost;
 			d->best_chan = c;
 			d->score = score;
-			gheap_restore_heap_after_item_increase(&gheap_ctx,
-							       heap, heapsize,
-							       d->heapptr - heap);
+			heap_update(space, neighbor_idx,
+				    heap_key(space, neighbor_idx, target_idx,
+					     landmarks, score_bound));
 		}
-		gheap_pop_heap(&gheap_ctx, heap, heapsize--);
-		cur_d->heapptr = NULL;
 	}
-	tal_free(heap);
 	return dij;
 }
+
+/* Do Dijkstra: start in this case is the dst node. */
+const struct dijkstra *
+dijkstra_(const tal_t *ctx,
+	  const struct gossmap *map,
+	  const struct gossmap_node *start,
+	  struct amount_msat amount,
+	  double riskfactor,
+	  bool (*channel_ok)(const struct gossmap *map,
+			     const struct gossmap_chan *c,
+			     int dir,
+			     struct amount_msat amount,
+			     void *arg),
+	  u64 (*path_score)(u32 distance,
+			    struct amount_msat cost,
+			    struct amount_msat risk,
+			    int dir,
+			    const struct gossmap_chan *c),
+	  void *arg)
+{
+	return dijkstra_search(ctx, map, start, UINT32_MAX,
+			       amount, riskfactor, channel_ok, path_score,
+			       NULL, NULL, arg);
+}
+
+const struct dijkstra *
+dijkstra_to_(const tal_t *ctx,
+	     const struct gossmap *map,
+	     const struct gossmap_node *start,
+	     const struct gossmap_node *target,
+	     struct amount_msat amount,
+	     double riskfactor,
+	     bool (*channel_ok)(const struct gossmap *map,
+				const struct gossmap_chan *c,
+				int dir,
+				struct amount_msat amount,
+				void *arg),
+	     u64 (*path_score)(u32 distance,
+			       struct amount_msat cost,
+			       struct amount_msat risk,
+			       int dir,
+			       const struct gossmap_chan *c),
+	     const struct dijkstra_landmarks *landmarks,
+	     u64 (*score_bound)(u32 hops),
+	     void *arg)
+{
+	assert(!landmarks || dijkstra_landmarks_valid(landmarks, map));
+	assert(!landmarks || score_bound);
+	return dijkstra_search(ctx, map, start, gossmap_node_idx(map, target),
+			       amount, riskfactor, channel_ok, path_score,
+			       landmarks, score_bound, arg);
+}
@@ -3,11 +3,13 @@
 #include "config.h"
 #include <common/amount.h>
 
+struct dijkstra_landmarks;
 struct gossmap;
 struct gossmap_chan;
 struct gossmap_node;
 
-/* Do Dijkstra: start in this case is the dst node. */
+/* Do Dijkstra: start in this case is the dst node.  The result holds
+ * per-node space the next search can reuse once it's freed. */
 const struct dijkstra *
 dijkstra_(const tal_t *ctx,
 	  const struct gossmap *gossmap,
@@ -36,6 +38,53 @@ dijkstra_(const tal_t *ctx,
 		  (path_score),						\
 		  (arg))
 
+/* Precomputed hop counts from a few well-spread nodes, which give a lower
+ * bound on how many hops apart any two nodes are.  Only valid for this
+ * gossmap until it changes (see dijkstra_landmarks_valid). */
+struct dijkstra_landmarks *dijkstra_landmarks_new(const tal_t *ctx,
+						  const struct gossmap *map,
+						  size_t num_landmarks);
+
+/* False once the gossmap has changed since dijkstra_landmarks_new(). */
+bool dijkstra_landmarks_valid(const struct dijkstra_landmarks *lm,
+			      const struct gossmap *map);
+
+/* Like dijkstra, but we only care about the path from target: we stop as
+ * soon as we have it, so only target and the nodes on its path are valid.
+ * If landmarks is non-NULL, we use them to head towards target (A*):
+ * score_bound(hops) must never exceed what path_score() could add over
+ * that many more hops (see route_bound_shorter). */
+const struct dijkstra *
+dijkstra_to_(const tal_t *ctx,
+	     const struct gossmap *gossmap,
+	     const struct gossmap_node *start,
+	     const struct gossmap_node *target,
+	     struct amount_msat amount,
+	     double riskfactor,
+	     bool (*channel_ok)(const struct gossmap *map,
+				const struct gossmap_chan *c,
+				int dir,
+				struct amount_msat amount,
+				void *arg),
+	     u64 (*path_score)(u32 distance,
+			       struct amount_msat cost,
+			       struct amount_msat risk,
+			       int dir,
+			       const struct gossmap_chan *c),
+	     const struct dijkstra_landmarks *landmarks,
+	     u64 (*score_bound)(u32 hops),
+	     void *arg);
+
+#define dijkstra_to(ctx, map, start, target, amount, riskfactor,	\
+		    channel_ok, path_score, landmarks, score_bound, arg) \
+	dijkstra_to_((ctx), (map), (start), (target), (amount), (riskfactor), \
+		     typesafe_cb_preargs(bool, void *, (channel_ok), (arg), \
+					 const struct gossmap *,	\
+					 const struct gossmap_chan *,	\
+					 int, struct amount_msat),	\
+		     (path_score), (landmarks), (score_bound),		\
+		     (arg))
+
 /* Returns UINT_MAX if unreachable. */
 u32 dijkstra_distance(const struct dijkstra *dij, u32 node_idx);
 
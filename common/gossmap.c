@@ -1,19 +1,26 @@
 #include "config.h"
 #include <assert.h>
+#include <ccan/build_assert/build_assert.h>
+#include <ccan/crc32c/crc32c.h>
 #include <ccan/crypto/siphash24/siphash24.h>
 #include <ccan/err/err.h>
 #include <ccan/htable/htable_type.h>
+#include <ccan/mem/mem.h>
 #include <ccan/ptrint/ptrint.h>
+#include <ccan/read_write_all/read_write_all.h>
 #include <ccan/tal/str/str.h>
 #include <common/features.h>
 #include <common/gossip_store.h>
 #include <common/gossmap.h>
 #include <common/pseudorand.h>
 #include <common/type_to_string.h>
+#include <common/utils.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <gossipd/gossip_store_wiregen.h>
+#include <stdio.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wire/peer_wire.h>
 
@@ -57,6 +64,8 @@ struct gossmap {
 	u8 *mmap;
 	/* map_end is where we read to so far, map_size is total size */
 	size_t map_end, map_size;
+	/* Offset of the last complete record before map_end (or 0) */
+	size_t last_rec_off;
 
 	/* Map of node id -> node */
 	struct nodeidx_htable *nodes;
@@ -71,7 +80,8 @@ struct gossmap {
 
 	/* Array of chans, so we can use simple index */
 	struct gossmap_chan *chan_arr;
-	/* This is tal_count(chan_arr), which we call very often in assert() */
+	/* This is tal_count(chan_arr) (unless it's in idx_map), which we call
+	 * very often in assert() */
 	size_t num_chan_arr;
 
 	/* Linked list of freed ones, if any. */
@@ -79,8 +89,56 @@ struct gossmap {
 
 	/* local messages, if any. */
 	const u8 *local;
+
+	/* Bumped whenever the topology or channel updates change. */
+	u64 generation;
+
+	/* Removing localmods puts the map back how it was, so we put the
+	 * generation back too.  And if the same localmods are applied
+	 * again (say, our own channels, for every payment), the map is the
+	 * same as last time, so it gets the same generation. */
+	u64 pre_local_generation;
+	struct applied_localmod *last_applied;
+	u8 *last_local;
+	u64 last_applied_base, last_applied_generation;
+
+	/* How many channel_updates we couldn't represent (for the index). */
+	size_t num_rejected;
+
+	/* If we loaded from an index, it's mapped copy-on-write here, and
+	 * chan_arr and the nodes' chan_idxs point into it until we need to
+	 * grow them.  So every process using the same index shares the
+	 * pages we don't change.
+	 *
+	 * But every channel_update we read changes a channel in place, and a
+	 * page holds ~85 channels, so a few thousand updates make almost all
+	 * of chan_arr private again.  So gossipd rewrites the index as the
+	 * store grows, and gossmap_refresh() switches to the new one (see
+	 * maybe_reload_index), which puts us back to sharing all but the
+	 * node array and hash tables. */
+	u8 *idx_map;
+	size_t idx_map_len;
+	/* Which file idx_map is, so we can tell when there's a new one. */
+	dev_t idx_dev;
+	ino_t idx_ino;
 };
 
+static bool in_idx_map(const struct gossmap *map, const void *p)
+{
+	return map->idx_map
+		&& (const u8 *)p >= map->idx_map
+		&& (const u8 *)p < map->idx_map + map->idx_map_len;
+}
+
+/* Generations are unique across all maps, so a freed map and a new one
+ * allocated at the same address can never be confused. */
+static u64 gossmap_generation_counter;
+
+static void gossmap_changed(struct gossmap *map)
+{
+	map->generation = ++gossmap_generation_counter;
+}
+
 /* Accessors for the gossmap */
 static void map_copy(const struct gossmap *map, size_t offset,
 		     void *dst, size_t len)
@@ -163,9 +221,15 @@ u32 gossmap_max_node_idx(const struct gossmap *map)
 	return map->num_node_arr;
 }
 
+u64 gossmap_generation(const struct gossmap *map)
+{
+	return map->generation;
+}
+
 u32 gossmap_max_chan_idx(const struct gossmap *map)
 {
-	assert(tal_count(map->chan_arr) == map->num_chan_arr);
+	assert(in_idx_map(map, map->chan_arr)
+	       || tal_count(map->chan_arr) == map->num_chan_arr);
 	return map->num_chan_arr;
 }
 
@@ -281,6 +345,13 @@ static struct gossmap_node *next_free_node(struct gossmap *map)
 	return &map->node_arr[f];
 }
 
+static void free_chan_idxs(const struct gossmap *map, struct gossmap_node *node)
+{
+	if (!in_idx_map(map, node->chan_idxs))
+		free(node->chan_idxs);
+	node->chan_idxs = NULL;
+}
+
 static u32 new_node(struct gossmap *map)
 {
 	struct gossmap_node *node = next_free_node(map);
@@ -298,18 +369,26 @@ static void remove_node(struct gossmap *map, struct gossmap_node *node)
 	if (!nodeidx_htable_del(map->nodes, node2ptrint(node)))
 		abort();
 	node->nann_off = map->freed_nodes;
-	free(node->chan_idxs);
-	node->chan_idxs = NULL;
+	free_chan_idxs(map, node);
 	node->num_chans = 0;
 	map->freed_nodes = nodeidx;
 }
 
-static void node_add_channel(struct gossmap_node *node, u32 chanidx)
+static void node_add_channel(const struct gossmap *map,
+			     struct gossmap_node *node, u32 chanidx)
 {
-	node->num_chans++;
-	node->chan_idxs = realloc(node->chan_idxs,
-				  node->num_chans * sizeof(*node->chan_idxs));
-	node->chan_idxs[node->num_chans-1] = chanidx;
+	/* We can't realloc inside the index: copy it out. */
+	if (in_idx_map(map, node->chan_idxs)) {
+		u32 *chan_idxs = malloc((node->num_chans + 1)
+					* sizeof(*node->chan_idxs));
+		memcpy(chan_idxs, node->chan_idxs,
+		       node->num_chans * sizeof(*node->chan_idxs));
+		node->chan_idxs = chan_idxs;
+	} else
+		node->chan_idxs = realloc(node->chan_idxs,
+					  (node->num_chans + 1)
+					  * sizeof(*node->chan_idxs));
+	node->chan_idxs[node->num_chans++] = chanidx;
 }
 
 static u32 init_chan_arr(struct gossmap_chan *chan_arr, size_t start)
@@ -331,7 +410,11 @@ static struct gossmap_chan *next_free_chan(struct gossmap *map)
 
 	if (map->freed_chans == UINT_MAX) {
 		/* Double in size, add second half to free list */
-		size_t n = tal_count(map->chan_arr);
+		size_t n = map->num_chan_arr;
+		/* We can't resize inside the index: copy it out. */
+		if (in_idx_map(map, map->chan_arr))
+			map->chan_arr = tal_dup_arr(map, struct gossmap_chan,
+						    map->chan_arr, n, 0);
 		map->num_chan_arr *= 2;
 		tal_resize(&map->chan_arr, n * 2);
 		map->freed_chans = init_chan_arr(map->chan_arr, n);
@@ -357,8 +440,8 @@ static struct gossmap_chan *new_channel(struct gossmap *map,
 	memset(chan->half, 0, sizeof(chan->half));
 	chan->half[0].nodeidx = n1idx;
 	chan->half[1].nodeidx = n2idx;
-	node_add_channel(map->node_arr + n1idx, gossmap_chan_idx(map, chan));
-	node_add_channel(map->node_arr + n2idx, gossmap_chan_idx(map, chan));
+	node_add_channel(map, map->node_arr + n1idx, gossmap_chan_idx(map, chan));
+	node_add_channel(map, map->node_arr + n2idx, gossmap_chan_idx(map, chan));
 	chanidx_htable_add(map->channels, chan2ptrint(chan));
 
 	return chan;
@@ -393,6 +476,7 @@ void gossmap_remove_chan(struct gossmap *map, struct gossmap_chan *chan)
 	chan->cann_off = map->freed_chans;
 	chan->plus_scid_off = 0;
 	map->freed_chans = chanidx;
+	gossmap_changed(map);
 }
 
 void gossmap_remove_node(struct gossmap *map, struct gossmap_node *node)
@@ -616,6 +700,11 @@ static bool map_catchup(struct gossmap *map, size_t *num_rejected)
 		map_copy(map, map->map_end, &ghdr, sizeof(ghdr));
 		reclen = be16_to_cpu(ghdr.len) + sizeof(ghdr);
 
+		/* Partial write, this can happen. */
+		if (map->map_end + reclen > map->map_size)
+			break;
+		map->last_rec_off = map->map_end;
+
 		flags = be16_to_cpu(ghdr.flags);
 		if (flags & GOSSIP_STORE_DELETED_BIT)
 			continue;
@@ -623,10 +712,6 @@ static bool map_catchup(struct gossmap *map, size_t *num_rejected)
 		if (flags & GOSSIP_STORE_ZOMBIE_BIT)
 			continue;
 
-		/* Partial write, this can happen. */
-		if (map->map_end + reclen > map->map_size)
-			break;
-
 		off = map->map_end + sizeof(ghdr);
 		type = map_be16(map, off);
 		if (type == WIRE_CHANNEL_ANNOUNCEMENT)
@@ -649,13 +734,287 @@ static bool map_catchup(struct gossmap *map, size_t *num_rejected)
 		changed = true;
 	}
 
+	map->num_rejected += num_bad;
 	if (num_rejected)
 		*num_rejected = num_bad;
 	return changed;
 }
 
-static bool load_gossip_store(struct gossmap *map, size_t *num_rejected)
+/* The index is a snapshot of our arrays, so gossmap_load() can skip
+ * reading the store up to index_hdr.map_end.  It's only a cache for this
+ * machine, so it's in native endian, and we check the struct sizes. */
+#define GOSSMAP_INDEX_MAGIC 0x474d4958 /* "GMIX" */
+#define GOSSMAP_INDEX_VERSION 2
+
+struct gossmap_index_hdr {
+	u32 magic;
+	u16 version;
+	u16 node_size, chan_size;
+	/* First byte of the gossip_store */
+	u8 store_version;
+	u8 pad;
+	/* How far into the gossip_store this covers. */
+	u64 map_end;
+	/* To detect a rewritten store, the header of the last record. */
+	u64 last_rec_off;
+	struct gossip_hdr last_rec_hdr;
+	u32 num_rejected;
+	u32 num_node_arr, num_chan_arr;
+	u32 freed_nodes, freed_chans;
+	/* Total of all nodes' num_chans */
+	u32 num_chan_idxs;
+	/* crc32c of everything after this header */
+	u32 crc;
+};
+
+/* Followed by the nodes (num_chans 0 if free)... */
+struct gossmap_index_node {
+	u32 nann_off;
+	u32 num_chans;
+};
+/* ...then num_chan_idxs u32 chan_idxs (padded to 8 bytes), then chan_arr.
+ * We use chan_idxs and chan_arr in place, so they need to be aligned. */
+static size_t padded_chan_idxs(const struct gossmap_index_hdr *hdr)
+{
+	return (hdr->num_chan_idxs + 1) / 2 * 2;
+}
+
+static const char *index_filename(const tal_t *ctx, const struct gossmap *map)
+{
+	return tal_fmt(ctx, "%s.idx", map->fname);
+}
+
+static bool index_hdr_matches(const struct gossmap *map,
+			      const struct gossmap_index_hdr *hdr,
+			      size_t len)
+{
+	struct gossip_hdr ghdr;
+
+	if (hdr->magic != GOSSMAP_INDEX_MAGIC
+	    || hdr->version != GOSSMAP_INDEX_VERSION
+	    || hdr->node_size != sizeof(struct gossmap_index_node)
+	    || hdr->chan_size != sizeof(struct gossmap_chan)
+	    || hdr->store_version != map_u8(map, 0)
+	    || hdr->map_end > map->map_size
+	    || hdr->num_node_arr == 0
+	    || hdr->num_chan_arr == 0)
+		return false;
+
+	if (len != sizeof(*hdr)
+	    + hdr->num_node_arr * sizeof(struct gossmap_index_node)
+	    + padded_chan_idxs(hdr) * sizeof(u32)
+	    + hdr->num_chan_arr * sizeof(struct gossmap_chan))
+		return false;
+
+	/* Nothing in store?  Nothing to check. */
+	if (hdr->map_end == 1)
+		return true;
+
+	/* If the store has been rewritten since, the record there will
+	 * differ (the flags can change under us, the rest can't). */
+	if (hdr->last_rec_off + sizeof(ghdr) > hdr->map_end)
+		return false;
+	map_copy(map, hdr->last_rec_off, &ghdr, sizeof(ghdr));
+	return ghdr.len == hdr->last_rec_hdr.len
+		&& ghdr.crc == hdr->last_rec_hdr.crc
+		&& ghdr.timestamp == hdr->last_rec_hdr.timestamp
+		&& hdr->last_rec_off + sizeof(ghdr) + be16_to_cpu(ghdr.len)
+		== hdr->map_end;
+}
+
+/* Maps the index, if there's a usable one. */
+static u8 *map_index(const struct gossmap *map, struct stat *st)
+{
+	const char *fname = index_filename(tmpctx, map);
+	const struct gossmap_index_hdr *hdr;
+	u8 *idx;
+	int fd;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, st) != 0 || st->st_size < sizeof(*hdr)) {
+		close(fd);
+		return NULL;
+	}
+
+	/* Private, so our changes are copy-on-write: gossipd replaces the
+	 * file rather than changing it, so it can't change under us. */
+	idx = mmap(NULL, st->st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (idx == MAP_FAILED)
+		return NULL;
+
+	hdr = (const struct gossmap_index_hdr *)idx;
+	if (!index_hdr_matches(map, hdr, st->st_size)
+	    || crc32c(0, idx + sizeof(*hdr), st->st_size - sizeof(*hdr))
+	    != hdr->crc) {
+		munmap(idx, st->st_size);
+		return NULL;
+	}
+	return idx;
+}
+
+/* Set up our arrays from a mapped index. */
+static void use_index(struct gossmap *map, u8 *idx, const struct stat *st,
+		      size_t *num_rejected)
+{
+	const struct gossmap_index_hdr *hdr;
+	const struct gossmap_index_node *inodes;
+	u32 *chan_idxs;
+
+	hdr = (const struct gossmap_index_hdr *)idx;
+	BUILD_ASSERT(sizeof(*hdr) % 8 == 0);
+	BUILD_ASSERT(sizeof(*inodes) % 8 == 0);
+	inodes = (const struct gossmap_index_node *)(hdr + 1);
+	chan_idxs = (u32 *)(inodes + hdr->num_node_arr);
+
+	map->idx_map = idx;
+	map->idx_map_len = st->st_size;
+	map->idx_dev = st->st_dev;
+	map->idx_ino = st->st_ino;
+	map->num_chan_arr = hdr->num_chan_arr;
+	map->chan_arr = (struct gossmap_chan *)(chan_idxs
+						+ padded_chan_idxs(hdr));
+	map->freed_chans = hdr->freed_chans;
+	/* We need our own nodes, since chan_idxs are pointers */
+	map->num_node_arr = hdr->num_node_arr;
+	map->node_arr = tal_arr(map, struct gossmap_node, map->num_node_arr);
+	map->freed_nodes = hdr->freed_nodes;
+
+	/* Hash tables use a per-process seed, so we rebuild those. */
+	map->channels = tal(map, struct chanidx_htable);
+	chanidx_htable_init_sized(map->channels, map->num_chan_arr);
+	map->nodes = tal(map, struct nodeidx_htable);
+	nodeidx_htable_init_sized(map->nodes, map->num_node_arr);
+
+	for (size_t i = 0; i < map->num_node_arr; i++) {
+		struct gossmap_node *node = &map->node_arr[i];
+
+		node->nann_off = inodes[i].nann_off;
+		node->num_chans = inodes[i].num_chans;
+		if (!node->num_chans) {
+			node->chan_idxs = NULL;
+			continue;
+		}
+		node->chan_idxs = chan_idxs;
+		chan_idxs += node->num_chans;
+	}
+
+	for (size_t i = 0; i < map->num_chan_arr; i++) {
+		if (map->chan_arr[i].plus_scid_off == 0)
+			continue;
+		chanidx_htable_add(map->channels, chan2ptrint(&map->chan_arr[i]));
+	}
+	/* Nodes get their id from their first channel, so do these last */
+	for (size_t i = 0; i < map->num_node_arr; i++) {
+		if (!map->node_arr[i].chan_idxs)
+			continue;
+		nodeidx_htable_add(map->nodes, node2ptrint(&map->node_arr[i]));
+	}
+
+	map->map_end = hdr->map_end;
+	map->last_rec_off = hdr->last_rec_off;
+	*num_rejected = hdr->num_rejected;
+}
+
+/* Returns false if there's no (usable) index: caller must start from
+ * scratch. */
+static bool load_index(struct gossmap *map, size_t *num_rejected)
 {
+	struct stat st;
+	u8 *idx;
+
+	idx = map_index(map, &st);
+	if (!idx)
+		return false;
+
+	use_index(map, idx, &st, num_rejected);
+	return true;
+}
+
+bool gossmap_write_index(const struct gossmap *map)
+{
+	struct gossmap_index_hdr hdr;
+	struct gossmap_index_node *inodes;
+	u32 *chan_idxs;
+	const char *fname, *tmpname;
+	bool ok;
+	int fd;
+
+	/* Local mods aren't in the store! */
+	assert(!map->local);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = GOSSMAP_INDEX_MAGIC;
+	hdr.version = GOSSMAP_INDEX_VERSION;
+	hdr.node_size = sizeof(struct gossmap_index_node);
+	hdr.chan_size = sizeof(struct gossmap_chan);
+	hdr.store_version = map_u8(map, 0);
+	hdr.map_end = map->map_end;
+	hdr.last_rec_off = map->last_rec_off;
+	if (hdr.map_end != 1)
+		map_copy(map, hdr.last_rec_off,
+			 &hdr.last_rec_hdr, sizeof(hdr.last_rec_hdr));
+	hdr.num_rejected = map->num_rejected;
+	hdr.num_node_arr = map->num_node_arr;
+	hdr.num_chan_arr = map->num_chan_arr;
+	hdr.freed_nodes = map->freed_nodes;
+	hdr.freed_chans = map->freed_chans;
+
+	inodes = tal_arr(tmpctx, struct gossmap_index_node, map->num_node_arr);
+	chan_idxs = tal_arr(tmpctx, u32, 0);
+	for (size_t i = 0; i < map->num_node_arr; i++) {
+		const struct gossmap_node *node = &map->node_arr[i];
+
+		inodes[i].nann_off = node->nann_off;
+		/* num_chans is uninitialized in never-used entries. */
+		if (!node->chan_idxs) {
+			inodes[i].num_chans = 0;
+			continue;
+		}
+		inodes[i].num_chans = node->num_chans;
+		for (size_t j = 0; j < node->num_chans; j++)
+			tal_arr_expand(&chan_idxs, node->chan_idxs[j]);
+	}
+	hdr.num_chan_idxs = tal_count(chan_idxs);
+	if (tal_count(chan_idxs) != padded_chan_idxs(&hdr))
+		tal_arr_expand(&chan_idxs, 0);
+
+	hdr.crc = crc32c(0, inodes, tal_bytelen(inodes));
+	hdr.crc = crc32c(hdr.crc, chan_idxs, tal_bytelen(chan_idxs));
+	hdr.crc = crc32c(hdr.crc, map->chan_arr,
+			 map->num_chan_arr * sizeof(*map->chan_arr));
+
+	/* Readers may be loading the old one: replace it atomically */
+	fname = index_filename(tmpctx, map);
+	tmpname = tal_fmt(tmpctx, "%s.tmp", fname);
+	fd = open(tmpname, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	if (fd < 0)
+		return false;
+
+	ok = write_all(fd, &hdr, sizeof(hdr))
+		&& write_all(fd, inodes, tal_bytelen(inodes))
+		&& write_all(fd, chan_idxs, tal_bytelen(chan_idxs))
+		&& write_all(fd, map->chan_arr,
+			     map->num_chan_arr * sizeof(*map->chan_arr));
+	if (close(fd) != 0)
+		ok = false;
+	if (!ok || rename(tmpname, fname) != 0) {
+		int e = errno;
+		unlink(tmpname);
+		errno = e;
+		return false;
+	}
+	return true;
+}
+
+static bool load_gossip_store(struct gossmap *map, bool use_index,
+			      size_t *num_rejected)
+{
+	size_t num_index_bad;
+
 	map->fd = open(map->fname, O_RDONLY);
 	if (map->fd < 0)
 		return false;
@@ -676,25 +1035,41 @@ static bool load_gossip_store(struct gossmap *map, size_t *num_rejected)
 		return false;
 	}
 
-	/* Since channel_announcement is ~430 bytes, and channel_update is 136,
-	 * node_announcement is 144, and current topology has 35000 channels
-	 * and 10000 nodes, let's assume each channel gets about 750 bytes.
-	 *
-	 * We halve this, since often some records are deleted. */
-	map->channels = tal(map, struct chanidx_htable);
-	chanidx_htable_init_sized(map->channels, map->map_size / 750 / 2);
-	map->nodes = tal(map, struct nodeidx_htable);
-	nodeidx_htable_init_sized(map->nodes, map->map_size / 2500 / 2);
-
-	map->num_chan_arr = map->map_size / 750 / 2 + 1;
-	map->chan_arr = tal_arr(map, struct gossmap_chan, map->num_chan_arr);
-	map->freed_chans = init_chan_arr(map->chan_arr, 0);
-	map->num_node_arr = map->map_size / 2500 / 2 + 1;
-	map->node_arr = tal_arr(map, struct gossmap_node, map->num_node_arr);
-	map->freed_nodes = init_node_arr(map->node_arr, 0);
+	gossmap_changed(map);
+	map->idx_map = NULL;
+	map->last_applied = NULL;
+	map->last_local = NULL;
+
+	/* gossipd leaves us an index, so we only have to read the
+	 * store after that. */
+	if (!use_index || !load_index(map, &num_index_bad)) {
+		/* Since channel_announcement is ~430 bytes, and
+		 * channel_update is 136, node_announcement is 144, and
+		 * current topology has 35000 channels and 10000 nodes, let's
+		 * assume each channel gets about 750 bytes.
+		 *
+		 * We halve this, since often some records are deleted. */
+		map->channels = tal(map, struct chanidx_htable);
+		chanidx_htable_init_sized(map->channels, map->map_size / 750 / 2);
+		map->nodes = tal(map, struct nodeidx_htable);
+		nodeidx_htable_init_sized(map->nodes, map->map_size / 2500 / 2);
+
+		map->num_chan_arr = map->map_size / 750 / 2 + 1;
+		map->chan_arr = tal_arr(map, struct gossmap_chan, map->num_chan_arr);
+		map->freed_chans = init_chan_arr(map->chan_arr, 0);
+		map->num_node_arr = map->map_size / 2500 / 2 + 1;
+		map->node_arr = tal_arr(map, struct gossmap_node, map->num_node_arr);
+		map->freed_nodes = init_node_arr(map->node_arr, 0);
+
+		map->map_end = 1;
+		map->last_rec_off = 0;
+		num_index_bad = 0;
+	}
 
-	map->map_end = 1;
-	map_catchup(map, num_rejected);
+	map->num_rejected = num_index_bad;
+	map_catchup(map, NULL);
+	if (num_rejected)
+		*num_rejected = map->num_rejected;
 	return true;
 }
 
@@ -704,7 +1079,9 @@ static void destroy_map(struct gossmap *map)
 		munmap(map->mmap, map->map_size);
 
 	for (size_t i = 0; i < tal_count(map->node_arr); i++)
-		free(map->node_arr[i].chan_idxs);
+		free_chan_idxs(map, &map->node_arr[i]);
+	if (map->idx_map)
+		munmap(map->idx_map, map->idx_map_len);
 }
 
 /* Local modifications.  We only expect a few, so we use a simple
@@ -880,14 +1257,57 @@ bool gossmap_local_updatechan(struct gossmap_localmods *localmods,
 	return true;
 }
 
+/* What a localmod did to the map (hc[].nodeidx is unused). */
+struct applied_localmod {
+	u32 chan_idx;
+	u32 node_idx[2];
+	bool updates_set[2];
+	struct half_chan hc[2];
+};
+
+static bool half_chan_eq(const struct half_chan *a, const struct half_chan *b)
+{
+	return a->enabled == b->enabled
+		&& a->htlc_min == b->htlc_min
+		&& a->htlc_max == b->htlc_max
+		&& a->base_fee == b->base_fee
+		&& a->proportional_fee == b->proportional_fee
+		&& a->delay == b->delay;
+}
+
+static bool applied_localmods_eq(const struct applied_localmod *a,
+				 const struct applied_localmod *b)
+{
+	if (tal_count(a) != tal_count(b))
+		return false;
+
+	for (size_t i = 0; i < tal_count(a); i++) {
+		if (a[i].chan_idx != b[i].chan_idx
+		    || a[i].node_idx[0] != b[i].node_idx[0]
+		    || a[i].node_idx[1] != b[i].node_idx[1])
+			return false;
+		for (size_t h = 0; h < 2; h++) {
+			if (a[i].updates_set[h] != b[i].updates_set[h])
+				return false;
+			if (a[i].updates_set[h]
+			    && !half_chan_eq(&a[i].hc[h], &b[i].hc[h]))
+				return false;
+		}
+	}
+	return true;
+}
+
 /* Apply localmods to this map */
 void gossmap_apply_localmods(struct gossmap *map,
 			     struct gossmap_localmods *localmods)
 {
 	size_t n = tal_count(localmods->mods);
+	struct applied_localmod *applied;
 
 	assert(!map->local);
 	map->local = localmods->local;
+	map->pre_local_generation = map->generation;
+	applied = tal_arr(map, struct applied_localmod, 0);
 
 	for (size_t i = 0; i < n; i++) {
 		struct localmod *mod = &localmods->mods[i];
@@ -915,7 +1335,36 @@ void gossmap_apply_localmods(struct gossmap *map,
 			chan->half[h].nodeidx = mod->orig[h].nodeidx;
 			chan->cupdate_off[h] = 0xFFFFFFFF;
 		}
+
+		tal_resize(&applied, tal_count(applied) + 1);
+		applied[tal_count(applied) - 1].chan_idx
+			= gossmap_chan_idx(map, chan);
+		for (size_t h = 0; h < 2; h++) {
+			struct applied_localmod *a = &applied[tal_count(applied) - 1];
+			a->node_idx[h] = chan->half[h].nodeidx;
+			a->updates_set[h] = mod->updates_set[h];
+			a->hc[h] = mod->hc[h];
+		}
 	}
+
+	if (map->last_applied
+	    && map->last_applied_base == map->pre_local_generation
+	    && tal_bytelen(map->last_local) == tal_bytelen(map->local)
+	    && memeq(map->last_local, tal_bytelen(map->last_local),
+		     map->local, tal_bytelen(map->local))
+	    && applied_localmods_eq(map->last_applied, applied)) {
+		map->generation = map->last_applied_generation;
+		tal_free(applied);
+		return;
+	}
+
+	gossmap_changed(map);
+	tal_free(map->last_applied);
+	tal_free(map->last_local);
+	map->last_applied = applied;
+	map->last_local = tal_dup_talarr(map, u8, map->local);
+	map->last_applied_base = map->pre_local_generation;
+	map->last_applied_generation = map->generation;
 }
 
 void gossmap_remove_localmods(struct gossmap *map,
@@ -925,7 +1374,8 @@ void gossmap_remove_localmods(struct gossmap *map,
 
 	assert(map->local == localmods->local);
 
-	for (size_t i = 0; i < n; i++) {
+	/* In reverse, so re-applying them reuses the same chan idxs. */
+	for (size_t i = n; i-- > 0;) {
 		const struct localmod *mod = &localmods->mods[i];
 		struct gossmap_chan *chan = gossmap_find_chan(map, &mod->scid);
 
@@ -947,11 +1397,51 @@ void gossmap_remove_localmods(struct gossmap *map,
 		}
 	}
 	map->local = NULL;
+	map->generation = map->pre_local_generation;
+}
+
+/* Drop everything we've read, and start again from the new index, if
+ * gossipd has written one.  This is cheap (we only read the store after
+ * it), and gives back all the pages of the old one we had made private. */
+static bool maybe_reload_index(struct gossmap *map)
+{
+	struct stat st;
+	size_t num_index_bad;
+	u8 *idx;
+
+	/* We only switch if we started from one. */
+	if (!map->idx_map)
+		return false;
+
+	/* The old one stays open while we have it mapped, so a new one
+	 * can't have the same inode. */
+	if (stat(index_filename(tmpctx, map), &st) != 0
+	    || (st.st_dev == map->idx_dev && st.st_ino == map->idx_ino))
+		return false;
+
+	/* Make sure it's usable before we throw anything away. */
+	idx = map_index(map, &st);
+	if (!idx)
+		return false;
+
+	for (size_t i = 0; i < map->num_node_arr; i++)
+		free_chan_idxs(map, &map->node_arr[i]);
+	tal_free(map->node_arr);
+	if (!in_idx_map(map, map->chan_arr))
+		tal_free(map->chan_arr);
+	tal_free(map->channels);
+	tal_free(map->nodes);
+	munmap(map->idx_map, map->idx_map_len);
+
+	use_index(map, idx, &st, &num_index_bad);
+	map->num_rejected = num_index_bad;
+	return true;
 }
 
 bool gossmap_refresh(struct gossmap *map, size_t *num_rejected)
 {
 	off_t len;
+	bool reloaded;
 
 	/* You must remove local updates before this. */
 	assert(!map->local);
@@ -967,21 +1457,39 @@ bool gossmap_refresh(struct gossmap *map, size_t *num_rejected)
 	map->mmap = mmap(NULL, map->map_size, PROT_READ, MAP_SHARED, map->fd, 0);
 	if (map->mmap == MAP_FAILED)
 		map->mmap = NULL;
-	return map_catchup(map, num_rejected);
+	/* Indexes and pointers all change if we reload. */
+	reloaded = maybe_reload_index(map);
+	if (!map_catchup(map, num_rejected) && !reloaded)
+		return false;
+	gossmap_changed(map);
+	return true;
 }
 
-struct gossmap *gossmap_load(const tal_t *ctx, const char *filename,
-			     size_t *num_channel_updates_rejected)
+static struct gossmap *new_gossmap(const tal_t *ctx, const char *filename,
+				   bool use_index,
+				   size_t *num_channel_updates_rejected)
 {
 	map = tal(ctx, struct gossmap);
 	map->fname = tal_strdup(map, filename);
-	if (load_gossip_store(map, num_channel_updates_rejected))
+	if (load_gossip_store(map, use_index, num_channel_updates_rejected))
 		tal_add_destructor(map, destroy_map);
 	else
 		map = tal_free(map);
 	return map;
 }
 
+struct gossmap *gossmap_load(const tal_t *ctx, const char *filename,
+			     size_t *num_channel_updates_rejected)
+{
+	return new_gossmap(ctx, filename, true, num_channel_updates_rejected);
+}
+
+struct gossmap *gossmap_load_noindex(const tal_t *ctx, const char *filename,
+				     size_t *num_channel_updates_rejected)
+{
+	return new_gossmap(ctx, filename, false, num_channel_updates_rejected);
+}
+
 void gossmap_node_get_id(const struct gossmap *map,
 			 const struct gossmap_node *node,
 			 struct node_id *id)
@@ -45,6 +45,18 @@ struct gossmap_chan {
 struct gossmap *gossmap_load(const tal_t *ctx, const char *filename,
 			     size_t *num_channel_updates_rejected);
 
+/* Like gossmap_load, but reads the whole store even if there's an index.
+ * The index can't see flags changed in place (e.g. zombies), so gossipd
+ * uses this to write a fresh one. */
+struct gossmap *gossmap_load_noindex(const tal_t *ctx, const char *filename,
+				     size_t *num_channel_updates_rejected);
+
+/* gossipd calls this to write an index of the map (as far as it's read the
+ * store) beside the store, so later gossmap_load() calls only have to read
+ * the store from there.  Map must not have localmods applied.  Returns false
+ * and sets errno on failure. */
+bool gossmap_write_index(const struct gossmap *map);
+
 /* Call this before using to ensure it's up-to-date.  Returns true if something
  * was updated. Note: this can scramble node and chan indexes! */
 bool gossmap_refresh(struct gossmap *map, size_t *num_channel_updates_rejected);
@@ -97,6 +109,12 @@ struct gossmap_chan *gossmap_chan_byidx(const struct gossmap *map, u32 idx);
 u32 gossmap_max_node_idx(const struct gossmap *map);
 u32 gossmap_max_chan_idx(const struct gossmap *map);
 
+/* This changes whenever the map does (refresh, localmods, removals), so
+ * callers can cache things derived from it.  Removing localmods restores
+ * the generation from before they were applied, and applying the same
+ * localmods again gives the same generation as last time. */
+u64 gossmap_generation(const struct gossmap *map);
+
 /* Find node with this node_id */
 struct gossmap_node *gossmap_find_node(const struct gossmap *map,
 				       const struct node_id *id);
@@ -16,6 +16,8 @@
  * v4 with sign_anchorspend: 8a30722e38b56e82af566b9629ff18da01fcebd1e80ec67f04d8b3a2fa66d81c
  * v4 with sign_htlc_tx_mingle: b9247e75d41ee1b3fc2f7db0bac8f4e92d544ab2f017d430ae3a000589c384e5
  * v4 with splicing: 06f21012936f825913af289fa81af1512c9ada1cb97c611698975a8fd287edbb
+ * v4 with sign_remote_htlc_txs: b50b8415b5bef70923e26153e18592ef73564af39c9fab231e19dc67ba51e99d
+ * v4 with ecdh_batch: d4eb64714acc6eb3335f6a653e73dfab7630b957d3b58cd8538929ac74c53c5b
  */
 #define HSM_MIN_VERSION 3
 #define HSM_MAX_VERSION 4
@@ -223,6 +223,98 @@ const jsmntok_t *json_get_member(const char *buffer, const jsmntok_t tok[],
 	return json_get_membern(buffer, tok, label, strlen(label));
 }
 
+/* Below this, a linear walk is as quick as building a table. */
+#define JSON_MEMBER_INDEX_MIN 16
+
+struct json_member_index {
+	const char *buffer;
+	const jsmntok_t *obj;
+	/* Open-addressed table of member names (NULL if empty slot),
+	 * allocated on first lookup; stays NULL if obj is small. */
+	const jsmntok_t **names;
+	size_t mask;
+	/* We only add members as far as a lookup has needed to walk:
+	 * this is the next one to add (num_added of obj->size). */
+	const jsmntok_t *next;
+	size_t num_added;
+};
+
+/* Member names are short and mostly differ in length or at the ends, so
+ * this is enough to spread them: a collision just costs a compare, and
+ * even a bad case is no worse than json_get_member(). */
+static size_t member_hash(const char *str, size_t len)
+{
+	if (len == 0)
+		return 0;
+	return len * 1000003 + str[0] * 31 + str[len / 2] * 7 + str[len - 1];
+}
+
+struct json_member_index *json_member_index(const tal_t *ctx,
+					    const char *buffer,
+					    const jsmntok_t *obj)
+{
+	struct json_member_index *idx = tal(ctx, struct json_member_index);
+
+	idx->buffer = buffer;
+	idx->obj = obj;
+	idx->names = NULL;
+	idx->next = obj + 1;
+	idx->num_added = 0;
+	return idx;
+}
+
+/* Returns the slot where this name is, or should go. */
+static const jsmntok_t **member_slot(const struct json_member_index *idx,
+				     const char *label, size_t len)
+{
+	for (size_t h = member_hash(label, len);; h++) {
+		const jsmntok_t **slot = &idx->names[h & idx->mask];
+		if (!*slot || json_tok_strneq(idx->buffer, *slot, label, len))
+			return slot;
+	}
+}
+
+const jsmntok_t *json_member_index_get(struct json_member_index *idx,
+				       const char *label)
+{
+	size_t size, len = strlen(label);
+	const jsmntok_t **slot;
+
+	if (idx->obj->type != JSMN_OBJECT
+	    || idx->obj->size < JSON_MEMBER_INDEX_MIN)
+		return json_get_membern(idx->buffer, idx->obj, label, len);
+
+	if (!idx->names) {
+		/* At most half full */
+		size = 1;
+		while (size < idx->obj->size * 2)
+			size *= 2;
+		idx->names = tal_arrz(idx, const jsmntok_t *, size);
+		idx->mask = size - 1;
+	}
+
+	slot = member_slot(idx, label, len);
+	if (*slot)
+		return *slot + 1;
+
+	/* Not seen yet: add members until we find it. */
+	while (idx->num_added < idx->obj->size) {
+		const jsmntok_t *t = idx->next, **s;
+
+		idx->next = json_next(t + 1);
+		idx->num_added++;
+
+		/* Like json_get_member(), first one wins. */
+		s = member_slot(idx, idx->buffer + t->start, t->end - t->start);
+		if (*s)
+			continue;
+		*s = t;
+		if (json_tok_strneq(idx->buffer, t, label, len))
+			return t + 1;
+	}
+	return NULL;
+}
+
 const jsmntok_t *json_get_arr(const jsmntok_t tok[], size_t index)
 {
 	const jsmntok_t *t;
@@ -560,6 +652,181 @@ jsmntok_t *json_parse_simple(const tal_t *ctx, const char *input, int len)
 	return toks;
 }
 
+void json_input_init(struct json_input *in)
+{
+	in->pos = 0;
+	in->in_element = false;
+	in->framed = in->in_frame = false;
+}
+
+void json_input_set_framed(struct json_input *in)
+{
+	assert(!in->in_element);
+	in->framed = true;
+}
+
+/* The length tells us where it ends, so there's nothing to scan. */
+static bool json_input_find_frame_end(struct json_input *in,
+				      const char *input, size_t len)
+{
+	if (!in->in_element) {
+		const u8 *hdr;
+		u32 framelen;
+
+		if (len - in->pos < JSON_FRAME_HDR_LEN)
+			return false;
+
+		hdr = (const u8 *)input + in->pos;
+		framelen = (((u32)hdr[0] << 24) | ((u32)hdr[1] << 16)
+			    | ((u32)hdr[2] << 8) | hdr[3]) & ~JSON_FRAME_HDR_BIT;
+		in->in_element = true;
+		/* Too big?  Hand jsmn an empty element to reject. */
+		if (framelen > JSON_FRAME_MAX_LEN) {
+			in->start = in->end = in->pos;
+			return true;
+		}
+		in->start = in->pos + JSON_FRAME_HDR_LEN;
+		in->end = in->start + framelen;
+		in->pos = in->start;
+	}
+
+	if (len < in->end)
+		return false;
+	in->pos = in->end;
+	return true;
+}
+
+/* Scan forward to the end of the current element: returns false if we
+ * need more input.  We only need to find the end: jsmn does the checking. */
+static bool json_input_find_end(struct json_input *in,
+				const char *input, size_t len)
+{
+	/* Streamed (or huge) elements still come unframed: they start with
+	 * JSON, which never has the header's top bit set. */
+	if (in->framed && !in->in_element) {
+		while (in->pos < len && cisspace(input[in->pos]))
+			in->pos++;
+		if (in->pos == len)
+			return false;
+		in->in_frame = ((u8)input[in->pos] & 0x80);
+	}
+	if (in->in_frame)
+		return json_input_find_frame_end(in, input, len);
+
+	for (; in->pos < len; in->pos++) {
+		char c = input[in->pos];
+
+		if (!in->in_element) {
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				continue;
+			in->in_element = true;
+			in->start = in->pos;
+			in->depth = 0;
+			in->in_string = in->escaped = false;
+			/* Anything else can't be a message, so hand over a
+			 * single char for jsmn to reject. */
+			if (c != '{' && c != '[' && c != '"') {
+				in->pos++;
+				return true;
+			}
+		}
+
+		if (in->in_string) {
+			if (in->escaped)
+				in->escaped = false;
+			else if (c == '\\')
+				in->escaped = true;
+			else if (c == '"') {
+				in->in_string = false;
+				if (in->depth == 0) {
+					in->pos++;
+					return true;
+				}
+			}
+			continue;
+		}
+
+		switch (c) {
+		case '"':
+			in->in_string = true;
+			break;
+		case '{':
+		case '[':
+			in->depth++;
+			break;
+		case '}':
+		case ']':
+			if (--in->depth == 0) {
+				in->pos++;
+				return true;
+			}
+			break;
+		}
+	}
+	return false;
+}
+
+bool json_input_parse(struct json_input *in,
+		      jsmn_parser *parser,
+		      jsmntok_t **toks,
+		      const char *input, size_t len,
+		      bool *complete)
+{
+	if (!json_input_find_end(in, input, len)) {
+		*complete = false;
+		return true;
+	}
+
+	jsmn_init(parser);
+	toks_reset(*toks);
+	if (!json_parse_input(parser, toks,
+			      input + in->start, in->pos - in->start,
+			      complete))
+		return false;
+	/* We gave it the whole element, so it can't want more. */
+	if (!*complete)
+		return false;
+
+	/* Make offsets relative to input (leave the terminator alone). */
+	for (size_t i = 0; i < tal_count(*toks) - 1; i++) {
+		(*toks)[i].start += in->start;
+		(*toks)[i].end += in->start;
+	}
+	in->in_element = false;
+	return true;
+}
+
+size_t json_input_consumed(const struct json_input *in)
+{
+	if (in->in_element)
+		return in->start;
+	return in->pos;
+}
+
+void json_input_make_room(struct json_input *in, char **buffer, size_t *used)
+{
+	size_t consumed = json_input_consumed(in);
+
+	/* Once we've consumed half, moving the rest down costs less than
+	 * what we've consumed, so each byte is moved O(1) times. */
+	if (consumed == *used || consumed >= tal_count(*buffer) / 2) {
+		memmove(*buffer, *buffer + consumed, *used - consumed);
+		*used -= consumed;
+		in->pos -= consumed;
+		if (in->in_element) {
+			in->start -= consumed;
+			if (in->in_frame)
+				in->end -= consumed;
+		}
+	}
+
+	/* Read the rest of a framed element all at once. */
+	if (in->in_frame && in->in_element && in->end > tal_count(*buffer))
+		tal_resize(buffer, in->end);
+	else if (*used == tal_count(*buffer))
+		tal_resize(buffer, *used * 2);
+}
+
 const char *jsmntype_to_string(jsmntype_t t)
 {
 	switch (t) {
@@ -69,6 +69,21 @@ const jsmntok_t *json_get_membern(const char *buffer,
 const jsmntok_t *json_get_member(const char *buffer, const jsmntok_t tok[],
 				 const char *label);
 
+/* For looking up many members of one big object: json_get_member()
+ * walks every token of the members before the one it finds (all of them,
+ * if it's missing). */
+struct json_member_index;
+
+/* Index @obj's members.  The index is built lazily on the first lookup,
+ * and only if @obj has enough members to make it worthwhile. */
+struct json_member_index *json_member_index(const tal_t *ctx,
+					    const char *buffer,
+					    const jsmntok_t *obj);
+
+/* Same as json_get_member(), but using the index. */
+const jsmntok_t *json_member_index_get(struct json_member_index *idx,
+				       const char *label);
+
 /* Get index'th array member. */
 const jsmntok_t *json_get_arr(const jsmntok_t tok[], size_t index);
 
@@ -110,6 +125,76 @@ bool json_parse_input(jsmn_parser *parser,
  * JSON string */
 jsmntok_t *json_parse_simple(const tal_t *ctx, const char *input, int len);
 
+/* State for splitting a stream of JSON elements (e.g. JSON-RPC messages)
+ * as it is read into a buffer.  We remember how far we've looked, so each
+ * byte is only scanned once however the stream is split across reads. */
+struct json_input {
+	/* Offset of the next byte to scan. */
+	size_t pos;
+	/* Are we part-way through an element which starts at @start? */
+	bool in_element;
+	size_t start;
+	/* How deeply we're nested in {} and [] */
+	size_t depth;
+	/* Are we inside a string (and just after a backslash)? */
+	bool in_string, escaped;
+	/* Can elements be preceded by a JSON_FRAME_HDR_LEN header? */
+	bool framed;
+	/* Was this one?  Then we don't scan it at all: it ends at @end. */
+	bool in_frame;
+	size_t end;
+};
+
+/* A length-prefixed element starts with its length as a big-endian u32,
+ * with the top bit set so it can't be mistaken for whitespace (or JSON).
+ * Bigger elements aren't framed (nor are ones still being written when we
+ * start sending them), and we reject frames which claim to be. */
+#define JSON_FRAME_HDR_LEN 4
+#define JSON_FRAME_HDR_BIT 0x80000000
+#define JSON_FRAME_MAX_LEN (64 * 1024 * 1024)
+
+/* Start on an empty buffer. */
+void json_input_init(struct json_input *in);
+
+/* From now on, elements may be length-prefixed (whitespace before them,
+ * such as after the last unframed one, is still skipped). */
+void json_input_set_framed(struct json_input *in);
+
+/**
+ * json_input_parse: parse and validate the next element in a stream.
+ * @in: the stream state.
+ * @parser, @toks: as per json_parse_input.
+ * @input, @len: everything read so far.
+ * @complete: set to true if we parsed an element.
+ *
+ * Like json_parse_input, but only tokenizes once a whole element has
+ * arrived, and only that element.  The tokens' offsets are relative to
+ * @input (not where the element starts), and the element is consumed.
+ * Leading whitespace is consumed too.
+ */
+bool json_input_parse(struct json_input *in,
+		      jsmn_parser *parser,
+		      jsmntok_t **toks,
+		      const char *input, size_t len,
+		      bool *complete);
+
+/* Offset of the first byte we still need (earlier ones can be discarded). */
+size_t json_input_consumed(const struct json_input *in);
+
+/**
+ * json_input_make_room: make space to read more into @buffer.
+ * @in: the stream state.
+ * @buffer: the tal array being read into.
+ * @used: how much of @buffer is filled.
+ *
+ * This discards consumed input, but only once that frees at least half of
+ * @buffer, so pipelined elements aren't shuffled down one at a time.  If
+ * there's still no space, @buffer is doubled.  This invalidates tokens
+ * from json_input_parse().  If we know how long a framed element is, we
+ * make room for all of it.
+ */
+void json_input_make_room(struct json_input *in, char **buffer, size_t *used);
+
 /* Convert a jsmntype_t enum to a human readable string. */
 const char *jsmntype_to_string(jsmntype_t t);
 
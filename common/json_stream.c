@@ -6,6 +6,7 @@
 #include <bitcoin/short_channel_id.h>
 #include <bitcoin/signature.h>
 #include <bitcoin/tx.h>
+#include <ccan/endian/endian.h>
 #include <ccan/io/io.h>
   /* To reach into io_plan: not a public header! */
   #include <ccan/io/backend.h>
@@ -49,6 +50,7 @@ struct json_stream *new_json_stream(const tal_t *ctx,
 	js->reader = NULL;
 	js->log = log;
 	js->filter = NULL;
+	js->drained_cb = NULL;
 	return js;
 }
 
@@ -79,6 +81,7 @@ struct json_stream *json_stream_dup(const tal_t *ctx,
 
 	js->jout = json_out_dup(js, original->jout);
 	js->log = log;
+	js->drained_cb = NULL;
 	/* You can't dup things with filters! */
 	assert(!js->filter);
 	return js;
@@ -147,6 +150,13 @@ void json_stream_flush(struct json_stream *js)
 	io_wake(js);
 }
 
+void json_stream_when_drained_(struct json_stream *js,
+			       void (*cb)(void *arg), void *arg)
+{
+	js->drained_cb = cb;
+	js->drained_arg = arg;
+}
+
 void json_array_start(struct json_stream *js, const char *fieldname)
 {
 	if (json_filter_down(&js->filter, fieldname))
@@ -258,6 +268,11 @@ static struct io_plan *json_stream_output_write(struct io_conn *conn,
 		js->reader = NULL;
 		if (!json_stream_still_writing(js))
 			return js->reader_cb(conn, js, js->reader_arg);
+		if (js->drained_cb) {
+			void (*cb)(void *arg) = js->drained_cb;
+			js->drained_cb = NULL;
+			cb(js->drained_arg);
+		}
 		return io_out_wait(conn, js, json_stream_output_write, js);
 	}
 
@@ -283,6 +298,57 @@ struct io_plan *json_stream_output_(struct json_stream *js,
 	return json_stream_output_write(conn, js);
 }
 
+static struct io_plan *json_stream_output_framed_done(struct io_conn *conn,
+						      struct json_stream *js)
+{
+	return js->reader_cb(conn, js, js->reader_arg);
+}
+
+/* We can't write the header until we know the length, so we only frame
+ * streams which are already complete, and send those in one go. */
+static struct io_plan *json_stream_output_frame(struct io_conn *conn,
+						struct json_stream *js)
+{
+	const char *p;
+	size_t len;
+	char *frame;
+	be32 hdr;
+
+	p = json_out_contents(js->jout, &len);
+
+	/* Someone is streaming into it, so send it unframed as it comes,
+	 * rather than holding up everything behind it.  Same if it's too
+	 * big for a frame. */
+	if (json_stream_still_writing(js) || len > JSON_FRAME_MAX_LEN) {
+		js->len_read = 0;
+		return json_stream_output_write(conn, js);
+	}
+
+	hdr = cpu_to_be32(JSON_FRAME_HDR_BIT | len);
+	frame = tal_arr(js, char, sizeof(hdr) + len);
+	memcpy(frame, &hdr, sizeof(hdr));
+	memcpy(frame + sizeof(hdr), p, len);
+	json_out_consume(js->jout, len);
+
+	return io_write(conn, frame, tal_bytelen(frame),
+			json_stream_output_framed_done, js);
+}
+
+struct io_plan *json_stream_output_framed_(struct json_stream *js,
+					   struct io_conn *conn,
+					   struct io_plan *(*cb)(struct io_conn *conn,
+								 struct json_stream *js,
+								 void *arg),
+					   void *arg)
+{
+	assert(!js->reader);
+
+	js->reader_cb = cb;
+	js->reader_arg = arg;
+
+	return json_stream_output_frame(conn, js);
+}
+
 void json_add_num(struct json_stream *result, const char *fieldname, unsigned int value)
 {
 	json_add_primitive_fmt(result, fieldname, "%u", value);
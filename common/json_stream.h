@@ -49,6 +49,10 @@ struct json_stream {
 	void *reader_arg;
 	size_t len_read;
 
+	/* If non-NULL, call this once the reader has caught up. */
+	void (*drained_cb)(void *arg);
+	void *drained_arg;
+
 	/* If non-NULL, reflects the current filter position */
 	struct json_filter *filter;
 
@@ -196,10 +200,55 @@ struct io_plan *json_stream_output_(struct json_stream *js,
 							  void *arg),
 				    void *arg);
 
+/**
+ * json_stream_output_framed - write out a json_stream, length-prefixed.
+ * @js: the json_stream
+ * @conn: the io_conn to write out to.
+ * @cb: the callback to call once it's all written.
+ * @arg: the argument to @cb
+ *
+ * Like json_stream_output, but if @js is already closed (and not too big),
+ * writes it with a JSON_FRAME_HDR_LEN header (see json_input_set_framed).
+ * Otherwise it's written unframed, as json_stream_output does.
+ */
+#define json_stream_output_framed(js, conn, cb, arg)			\
+	json_stream_output_framed_((js), (conn),			\
+				   typesafe_cb_preargs(struct io_plan *, \
+						       void *,		\
+						       (cb), (arg),	\
+						       struct io_conn *, \
+						       struct json_stream *), \
+				   (arg))
+
+struct io_plan *json_stream_output_framed_(struct json_stream *js,
+					   struct io_conn *conn,
+					   struct io_plan *(*cb)(struct io_conn *conn,
+								 struct json_stream *js,
+								 void *arg),
+					   void *arg);
+
 /* Ensure there's a double \n after a JSON response. */
 void json_stream_double_cr(struct json_stream *js);
 void json_stream_flush(struct json_stream *js);
 
+/**
+ * json_stream_when_drained - call back once everything so far is written.
+ * @js: the json_stream (still open).
+ * @cb: the callback (called once), or NULL to cancel.
+ * @arg: the argument to @cb
+ *
+ * For writers producing a large stream a piece at a time, who don't want
+ * to get too far ahead of the reader.  @cb is called from inside the io
+ * loop, so it shouldn't write to @js itself: schedule that instead.
+ */
+#define json_stream_when_drained(js, cb, arg)				\
+	json_stream_when_drained_((js),					\
+				  typesafe_cb(void, void *, (cb), (arg)), \
+				  (arg))
+
+void json_stream_when_drained_(struct json_stream *js,
+			       void (*cb)(void *arg), void *arg);
+
 /* '"fieldname" : "value"' or '"value"' if fieldname is NULL.  Turns
  * any non-printable chars into JSON escapes, but leaves existing escapes alone.
  */
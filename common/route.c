@@ -60,6 +60,12 @@ u64 route_score_cheaper(u32 distance,
 	return ((u64)costs_to_score(cost, risk) << 32) + distance;
 }
 
+/* Each hop adds at least one to distance, and costs never go down. */
+u64 route_bound_shorter(u32 hops)
+{
+	return (u64)hops << 32;
+}
+
 /* Recursive version: return false if we can't get there.
  *
  * amount and cltv are updated, and reflect the amount we
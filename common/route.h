@@ -56,6 +56,10 @@ u64 route_score_cheaper(u32 distance,
 			int dir UNUSED,
 			const struct gossmap_chan *c UNUSED);
 
+/* Lower bound on how much route_score_shorter grows over hops more hops,
+ * for dijkstra_to() */
+u64 route_bound_shorter(u32 hops);
+
 /* Extract route tal_arr from completed dijkstra: NULL if none. */
 struct route_hop *route_from_dijkstra(const tal_t *ctx,
 				      const struct gossmap *map,
@@ -593,49 +593,53 @@ struct onionpacket *create_onionpacket(
 bool dev_fail_process_onionpacket;
 #endif
 
-/*
- * Given an onionpacket msg extract the information for the current
- * node and unwrap the remainder so that the node can forward it.
- */
-struct route_step *process_onionpacket(
-	const tal_t *ctx,
-	const struct onionpacket *msg,
-	const struct secret *shared_secret,
-	const u8 *assocdata,
-	const size_t assocdatalen,
-	bool has_realm
-	)
+bool sphinx_peel(const struct onionpacket *msg,
+		 size_t routinginfo_len,
+		 const struct secret *shared_secret,
+		 const u8 *assocdata,
+		 const size_t assocdatalen,
+		 u8 *paddedheader,
+		 struct pubkey *next_ephemeralkey)
 {
-	struct route_step *step = talz(ctx, struct route_step);
 	struct hmac hmac;
 	struct keyset keys;
 	u8 blind[BLINDING_FACTOR_SIZE];
-	u8 *paddedheader;
-	size_t payload_size;
-	bigsize_t shift_size;
-	const u8 *cursor;
-	size_t max;
 
-	step->next = talz(step, struct onionpacket);
-	step->next->version = msg->version;
 	generate_key_set(shared_secret, &keys);
 
-	compute_packet_hmac(msg, assocdata, assocdatalen, &keys.mu, &hmac);
+	/* Same as compute_packet_hmac, but without tal_bytelen. */
+	compute_hmac(&keys.mu, msg->routinginfo, routinginfo_len,
+		     assocdata, assocdatalen, &hmac);
 
 	if (!hmac_eq(&msg->hmac, &hmac)
 	    || IFDEV(dev_fail_process_onionpacket, false)) {
 		/* Computed MAC does not match expected MAC, the message was modified. */
-		return tal_free(step);
+		return false;
 	}
 
 	//FIXME:store seen secrets to avoid replay attacks
-	paddedheader = tal_arrz(step, u8, tal_bytelen(msg->routinginfo)*2);
-	memcpy(paddedheader, msg->routinginfo, tal_bytelen(msg->routinginfo));
-	xor_cipher_stream(paddedheader, &keys.rho, tal_bytelen(paddedheader));
+	memcpy(paddedheader, msg->routinginfo, routinginfo_len);
+	memset(paddedheader + routinginfo_len, 0, routinginfo_len);
+	xor_cipher_stream(paddedheader, &keys.rho, routinginfo_len * 2);
 
 	compute_blinding_factor(&msg->ephemeralkey, shared_secret, blind);
-	if (!blind_group_element(&step->next->ephemeralkey, &msg->ephemeralkey, blind))
-		return tal_free(step);
+	return blind_group_element(next_ephemeralkey, &msg->ephemeralkey, blind);
+}
+
+struct route_step *sphinx_peeled_step(const tal_t *ctx,
+				      const struct onionpacket *msg,
+				      const u8 *paddedheader,
+				      const struct pubkey *next_ephemeralkey)
+{
+	struct route_step *step = talz(ctx, struct route_step);
+	size_t payload_size;
+	bigsize_t shift_size;
+	const u8 *cursor;
+	size_t max;
+
+	step->next = talz(step, struct onionpacket);
+	step->next->version = msg->version;
+	step->next->ephemeralkey = *next_ephemeralkey;
 
 	/* Now, try to pull data out. */
 	cursor = paddedheader;
@@ -673,6 +677,34 @@ struct route_step *process_onionpacket(
 		step->nextcase = ONION_FORWARD;
 	}
 
+	return step;
+}
+
+/*
+ * Given an onionpacket msg extract the information for the current
+ * node and unwrap the remainder so that the node can forward it.
+ */
+struct route_step *process_onionpacket(
+	const tal_t *ctx,
+	const struct onionpacket *msg,
+	const struct secret *shared_secret,
+	const u8 *assocdata,
+	const size_t assocdatalen,
+	bool has_realm
+	)
+{
+	struct route_step *step;
+	struct pubkey next_ephemeralkey;
+	u8 *paddedheader;
+
+	paddedheader = tal_arr(NULL, u8, tal_bytelen(msg->routinginfo)*2);
+	if (!sphinx_peel(msg, tal_bytelen(msg->routinginfo), shared_secret,
+			 assocdata, assocdatalen,
+			 paddedheader, &next_ephemeralkey))
+		step = NULL;
+	else
+		step = sphinx_peeled_step(ctx, msg, paddedheader,
+					  &next_ephemeralkey);
 	tal_free(paddedheader);
 	return step;
 }
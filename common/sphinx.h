@@ -118,6 +118,40 @@ struct route_step *process_onionpacket(
 	bool has_realm
 	);
 
+/**
+ * sphinx_peel - the cryptographic half of process_onionpacket.
+ *
+ * This doesn't allocate (or otherwise touch tal), so it can run in another
+ * thread.
+ *
+ * @packet: incoming packet being processed
+ * @routinginfo_len: tal_bytelen(@packet->routinginfo)
+ * @shared_secret: the result of onion_shared_secret.
+ * @assocdata: associated data to commit to in HMACs
+ * @assocdatalen: length of the assocdata
+ * @paddedheader: (out) 2 * @routinginfo_len bytes for the decrypted routinginfo
+ * @next_ephemeralkey: (out) the ephemeral key for the next hop.
+ *
+ * Returns false if the HMAC is wrong (or the key can't be blinded).
+ */
+bool sphinx_peel(const struct onionpacket *packet,
+		 size_t routinginfo_len,
+		 const struct secret *shared_secret,
+		 const u8 *assocdata,
+		 const size_t assocdatalen,
+		 u8 *paddedheader,
+		 struct pubkey *next_ephemeralkey);
+
+/**
+ * sphinx_peeled_step - the rest of process_onionpacket, after sphinx_peel.
+ *
+ * Returns NULL if the payload is malformed.
+ */
+struct route_step *sphinx_peeled_step(const tal_t *ctx,
+				      const struct onionpacket *packet,
+				      const u8 *paddedheader,
+				      const struct pubkey *next_ephemeralkey);
+
 /**
  * serialize_onionpacket - Serialize an onionpacket to a buffer.
  *
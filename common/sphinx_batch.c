@@ -0,0 +1,172 @@
+#include "config.h"
+#include <common/sphinx.h>
+#include <common/sphinx_batch.h>
+#include <common/utils.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+/* Below this many, it's not worth waking the threads. */
+#define SPHINX_BATCH_MIN_PARALLEL 4
+
+/* One onion's worth of work: everything here is allocated beforehand, since
+ * the threads can't touch tal. */
+struct peel {
+	const struct sphinx_batch_onion *onion;
+	size_t routinginfo_len;
+	u8 *paddedheader;
+	struct pubkey next_ephemeralkey;
+	bool ok;
+};
+
+struct sphinx_batch {
+	size_t num_threads;
+	/* NULL until we start them. */
+	pthread_t *threads;
+	/* Who started them (we don't have them after fork()). */
+	pid_t pid;
+
+	/* Everything below is protected by lock. */
+	pthread_mutex_t lock;
+	pthread_cond_t work, done;
+	struct peel *peels;
+	size_t num_peels, next, num_done;
+	bool exiting;
+};
+
+static void do_peel(struct peel *peel)
+{
+	const struct sphinx_batch_onion *onion = peel->onion;
+
+	peel->ok = sphinx_peel(onion->packet, peel->routinginfo_len,
+			       onion->shared_secret,
+			       onion->assocdata, onion->assocdatalen,
+			       peel->paddedheader, &peel->next_ephemeralkey);
+}
+
+/* Called with lock held: take onions until there are none left. */
+static void peel_some(struct sphinx_batch *b)
+{
+	while (b->next < b->num_peels) {
+		struct peel *peel = &b->peels[b->next++];
+
+		pthread_mutex_unlock(&b->lock);
+		do_peel(peel);
+		pthread_mutex_lock(&b->lock);
+
+		if (++b->num_done == b->num_peels)
+			pthread_cond_signal(&b->done);
+	}
+}
+
+static void *peel_thread(struct sphinx_batch *b)
+{
+	pthread_mutex_lock(&b->lock);
+	while (!b->exiting) {
+		peel_some(b);
+		pthread_cond_wait(&b->work, &b->lock);
+	}
+	pthread_mutex_unlock(&b->lock);
+	return NULL;
+}
+
+static void destroy_sphinx_batch(struct sphinx_batch *b)
+{
+	if (b->threads && b->pid == getpid()) {
+		pthread_mutex_lock(&b->lock);
+		b->exiting = true;
+		pthread_cond_broadcast(&b->work);
+		pthread_mutex_unlock(&b->lock);
+		for (size_t i = 0; i < b->num_threads; i++)
+			pthread_join(b->threads[i], NULL);
+	}
+	pthread_cond_destroy(&b->done);
+	pthread_cond_destroy(&b->work);
+	pthread_mutex_destroy(&b->lock);
+}
+
+static void start_threads(struct sphinx_batch *b)
+{
+	sigset_t all, old;
+
+	b->threads = tal_arr(b, pthread_t, b->num_threads);
+	b->pid = getpid();
+
+	/* Signals are for the main thread. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (size_t i = 0; i < b->num_threads; i++) {
+		if (pthread_create(&b->threads[i], NULL,
+				   (void *(*)(void *))peel_thread, b) != 0) {
+			/* We can manage with fewer (even none). */
+			b->num_threads = i;
+			break;
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+struct sphinx_batch *sphinx_batch_new(const tal_t *ctx, size_t num_threads)
+{
+	struct sphinx_batch *b = tal(ctx, struct sphinx_batch);
+
+	b->num_threads = num_threads;
+	b->threads = NULL;
+	pthread_mutex_init(&b->lock, NULL);
+	pthread_cond_init(&b->work, NULL);
+	pthread_cond_init(&b->done, NULL);
+	b->peels = NULL;
+	b->num_peels = b->next = b->num_done = 0;
+	b->exiting = false;
+	tal_add_destructor(b, destroy_sphinx_batch);
+	return b;
+}
+
+void sphinx_batch_process(const tal_t *ctx,
+			  struct sphinx_batch *batch,
+			  struct sphinx_batch_onion *onions)
+{
+	size_t n = tal_count(onions);
+	struct peel *peels = tal_arr(tmpctx, struct peel, n);
+
+	for (size_t i = 0; i < n; i++) {
+		peels[i].onion = &onions[i];
+		peels[i].routinginfo_len = tal_bytelen(onions[i].packet->routinginfo);
+		peels[i].paddedheader = tal_arr(peels, u8,
+						peels[i].routinginfo_len * 2);
+	}
+
+	if (batch->num_threads == 0 || n < SPHINX_BATCH_MIN_PARALLEL) {
+		for (size_t i = 0; i < n; i++)
+			do_peel(&peels[i]);
+	} else {
+		if (!batch->threads)
+			start_threads(batch);
+
+		pthread_mutex_lock(&batch->lock);
+		batch->peels = peels;
+		batch->num_peels = n;
+		batch->next = batch->num_done = 0;
+		pthread_cond_broadcast(&batch->work);
+
+		/* We help, too. */
+		peel_some(batch);
+		while (batch->num_done != batch->num_peels)
+			pthread_cond_wait(&batch->done, &batch->lock);
+
+		batch->peels = NULL;
+		batch->num_peels = batch->next = batch->num_done = 0;
+		pthread_mutex_unlock(&batch->lock);
+	}
+
+	/* The rest allocates, so it's ours alone. */
+	for (size_t i = 0; i < n; i++) {
+		if (peels[i].ok)
+			onions[i].rs = sphinx_peeled_step(ctx, onions[i].packet,
+							  peels[i].paddedheader,
+							  &peels[i].next_ephemeralkey);
+		else
+			onions[i].rs = NULL;
+	}
+	tal_free(peels);
+}
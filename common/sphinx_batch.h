@@ -0,0 +1,49 @@
+#ifndef LIGHTNING_COMMON_SPHINX_BATCH_H
+#define LIGHTNING_COMMON_SPHINX_BATCH_H
+#include "config.h"
+#include <ccan/short_types/short_types.h>
+#include <ccan/tal/tal.h>
+
+struct onionpacket;
+struct route_step;
+struct secret;
+
+/* Peels many onions at once (eg. all the HTLCs a commitment added), with the
+ * crypto spread over some threads. */
+struct sphinx_batch;
+
+struct sphinx_batch_onion {
+	/* What process_onionpacket would be handed. */
+	const struct onionpacket *packet;
+	const struct secret *shared_secret;
+	const u8 *assocdata;
+	size_t assocdatalen;
+
+	/* What it would return: NULL if it's bad. */
+	struct route_step *rs;
+};
+
+/**
+ * sphinx_batch_new - create a batch peeler.
+ * @ctx: tal context to allocate from: freeing it stops the threads.
+ * @num_threads: how many threads to use, as well as the caller's.
+ *
+ * The threads aren't started until the first sphinx_batch_process (so it's
+ * safe to fork() until then).
+ */
+struct sphinx_batch *sphinx_batch_new(const tal_t *ctx, size_t num_threads);
+
+/**
+ * sphinx_batch_process - process_onionpacket for every onion.
+ * @ctx: tal context to allocate the route_steps from.
+ * @batch: the batch peeler.
+ * @onions: tal array of onions: sets ->rs for each.
+ *
+ * The route_steps are allocated (in order) by the caller's thread, so the
+ * results are exactly as if process_onionpacket were called for each in
+ * turn.
+ */
+void sphinx_batch_process(const tal_t *ctx,
+			  struct sphinx_batch *batch,
+			  struct sphinx_batch_onion *onions);
+#endif /* LIGHTNING_COMMON_SPHINX_BATCH_H */
@@ -0,0 +1,202 @@
+#include "config.h"
+/* htlc_accepted-style hook round trips to a child "plugin", as JSON against
+ * length-prefixed. */
+#include "../json_parse_simple.c"
+#include <ccan/err/err.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <ccan/time/time.h>
+#include <common/setup.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct conn {
+	int fd;
+	bool framed;
+	char *buffer;
+	size_t used;
+	struct json_input in;
+	jsmn_parser parser;
+	jsmntok_t *toks;
+};
+
+static void conn_init(const tal_t *ctx, struct conn *conn, int fd, bool framed)
+{
+	conn->fd = fd;
+	conn->framed = framed;
+	conn->buffer = tal_arr(ctx, char, 64);
+	conn->used = 0;
+	json_input_init(&conn->in);
+	if (framed)
+		json_input_set_framed(&conn->in);
+	conn->toks = toks_alloc(ctx);
+}
+
+/* Like json_stream_output{_framed}, one write per message. */
+static void send_msg(struct conn *conn, const char *json)
+{
+	size_t len = strlen(json);
+	char *msg;
+
+	/* Same size either way: unframed ones end in whitespace instead. */
+	msg = tal_arr(tmpctx, char, JSON_FRAME_HDR_LEN + len);
+	if (conn->framed) {
+		u32 hdr = JSON_FRAME_HDR_BIT | len;
+		msg[0] = hdr >> 24;
+		msg[1] = hdr >> 16;
+		msg[2] = hdr >> 8;
+		msg[3] = hdr;
+		memcpy(msg + JSON_FRAME_HDR_LEN, json, len);
+	} else {
+		memcpy(msg, json, len);
+		memcpy(msg + len, "\n\n\n\n", JSON_FRAME_HDR_LEN);
+	}
+
+	if (!write_all(conn->fd, msg, tal_count(msg)))
+		err(1, "Writing message");
+	tal_free(msg);
+}
+
+/* Returns false on EOF. */
+static bool recv_msg(struct conn *conn)
+{
+	for (;;) {
+		bool complete;
+		ssize_t r;
+
+		if (!json_input_parse(&conn->in, &conn->parser, &conn->toks,
+				      conn->buffer, conn->used, &complete))
+			errx(1, "Invalid JSON");
+		if (complete)
+			return true;
+
+		json_input_make_room(&conn->in, &conn->buffer, &conn->used);
+		r = read(conn->fd, conn->buffer + conn->used,
+			 tal_count(conn->buffer) - conn->used);
+		if (r < 0)
+			err(1, "Reading message");
+		if (r == 0)
+			return false;
+		conn->used += r;
+	}
+}
+
+/* The plugin: reply to every hook call. */
+static pid_t start_plugin(int fds[2], bool framed)
+{
+	struct conn conn;
+	pid_t pid;
+
+	/* Don't let the child flush our stdout too. */
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid != 0)
+		return pid;
+
+	/* Otherwise we'd never see EOF. */
+	close(fds[0]);
+	conn_init(NULL, &conn, fds[1], framed);
+	while (recv_msg(&conn)) {
+		const jsmntok_t *id, *params, *onion;
+
+		id = json_get_member(conn.buffer, conn.toks, "id");
+		params = json_get_member(conn.buffer, conn.toks, "params");
+		onion = json_get_member(conn.buffer, params, "onion");
+		if (!id || !onion)
+			errx(1, "Bad hook call");
+		send_msg(&conn,
+			 tal_fmt(tmpctx,
+				 "{\"jsonrpc\":\"2.0\",\"id\":%.*s,"
+				 "\"result\":{\"result\":\"continue\"}}",
+				 json_tok_full_len(id),
+				 json_tok_full(conn.buffer, id)));
+		clean_tmpctx();
+	}
+	exit(0);
+}
+
+static void run(const char *name, bool framed, size_t num_hooks,
+		const char *onion)
+{
+	struct conn conn;
+	int fds[2];
+	pid_t pid;
+	u64 total = 0, max = 0;
+	char *ctx = tal(NULL, char);
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		err(1, "socketpair");
+
+	pid = start_plugin(fds, framed);
+	close(fds[1]);
+
+	conn_init(ctx, &conn, fds[0], framed);
+	for (size_t i = 0; i < num_hooks; i++) {
+		struct timemono start;
+		const char *req;
+		u64 usec;
+
+		/* lightningd builds these with json_stream: don't time that. */
+		req = tal_fmt(tmpctx,
+			      "{\"jsonrpc\":\"2.0\",\"id\":\"cln:htlc_accepted#%zu\","
+			      "\"method\":\"htlc_accepted\",\"params\":{"
+			      "\"onion\":{\"payload\":\"1202%s\","
+			      "\"type\":\"tlv\",\"forward_msat\":1000000,"
+			      "\"outgoing_cltv_value\":800040,"
+			      "\"short_channel_id\":\"800000x1x0\","
+			      "\"shared_secret\":\"%064zx\","
+			      "\"next_onion\":\"%s\"},"
+			      "\"htlc\":{\"short_channel_id\":\"799000x2x1\","
+			      "\"id\":%zu,\"amount_msat\":1001000,"
+			      "\"cltv_expiry\":800080,\"cltv_expiry_relative\":80,"
+			      "\"payment_hash\":\"%064zx\"},"
+			      "\"forward_to\":\"%064zx\"}}",
+			      i, "0000000000000000", i, onion, i, i, i);
+
+		start = time_mono();
+		send_msg(&conn, req);
+		if (!recv_msg(&conn))
+			errx(1, "%s: plugin died", name);
+		usec = time_to_usec(timemono_since(start));
+		total += usec;
+		if (usec > max)
+			max = usec;
+		clean_tmpctx();
+	}
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+	tal_free(ctx);
+
+	printf("# %s: %zu hooks, %"PRIu64" usec average, %"PRIu64" usec max\n",
+	       name, num_hooks, num_hooks ? total / num_hooks : 0, max);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_hooks = 20000, onion_size = 1366;
+	char *onion;
+
+	common_setup(argv[0]);
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<num-hooks> [<onion-size>]]", argv[0]);
+	if (argc > 1)
+		num_hooks = atol(argv[1]);
+	if (argc > 2)
+		onion_size = atol(argv[2]);
+
+	onion = tal_arr(NULL, char, onion_size * 2 + 1);
+	for (size_t i = 0; i < onion_size * 2; i++)
+		onion[i] = "0123456789abcdef"[i % 16];
+	onion[onion_size * 2] = '\0';
+
+	run("JSON", false, num_hooks, onion);
+	run("length-prefixed", true, num_hooks, onion);
+
+	tal_free(onion);
+	common_shutdown();
+	return 0;
+}
@@ -0,0 +1,170 @@
+#include "config.h"
+/* Splitting pipelined requests off a socket: json_input against the old
+ * parse-then-memmove.  The buffer only grows to fit the largest request, so
+ * the first is large (think sendpsbt) and later reads pull in many at once. */
+#include "../json_parse_simple.c"
+#include <ccan/err/err.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <ccan/time/time.h>
+#include <common/setup.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Writes all the requests as fast as it can, like a busy client. */
+static pid_t start_writer(int fd, const char *requests)
+{
+	pid_t pid;
+
+	/* Don't let the child flush our stdout too. */
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid != 0)
+		return pid;
+
+	if (!write_all(fd, requests, strlen(requests)))
+		err(1, "Writing requests");
+	exit(0);
+}
+
+/* Returns the number of bytes read, or 0 when they're done. */
+static size_t read_more(int fd, char **buffer, size_t *used)
+{
+	ssize_t r = read(fd, *buffer + *used, tal_count(*buffer) - *used);
+
+	if (r < 0)
+		err(1, "Reading requests");
+	*used += r;
+	return r;
+}
+
+/* What lightningd's read_json used to do. */
+static size_t old_way(int fd)
+{
+	char *buffer = tal_arr(tmpctx, char, 64);
+	jsmntok_t *toks = toks_alloc(tmpctx);
+	jsmn_parser parser;
+	size_t used = 0, num = 0;
+	bool complete;
+
+	jsmn_init(&parser);
+	for (;;) {
+		if (used == tal_count(buffer))
+			tal_resize(&buffer, used * 2);
+		if (!read_more(fd, &buffer, &used))
+			break;
+
+		for (;;) {
+			if (!json_parse_input(&parser, &toks, buffer, used,
+					      &complete))
+				errx(1, "Invalid JSON");
+			if (!complete)
+				break;
+			if (tal_count(toks) == 1) {
+				used = 0;
+				jsmn_init(&parser);
+				toks_reset(toks);
+				break;
+			}
+			num++;
+			memmove(buffer, buffer + toks[0].end,
+				tal_count(buffer) - toks[0].end);
+			used -= toks[0].end;
+			jsmn_init(&parser);
+			toks_reset(toks);
+		}
+	}
+	return num;
+}
+
+static size_t new_way(int fd)
+{
+	char *buffer = tal_arr(tmpctx, char, 64);
+	jsmntok_t *toks = toks_alloc(tmpctx);
+	jsmn_parser parser;
+	struct json_input in;
+	size_t used = 0, num = 0;
+	bool complete;
+
+	json_input_init(&in);
+	for (;;) {
+		json_input_make_room(&in, &buffer, &used);
+		if (!read_more(fd, &buffer, &used))
+			break;
+
+		for (;;) {
+			if (!json_input_parse(&in, &parser, &toks,
+					      buffer, used, &complete))
+				errx(1, "Invalid JSON");
+			if (!complete)
+				break;
+			num++;
+		}
+	}
+	return num;
+}
+
+static void run(const char *name, size_t (*fn)(int), const char *requests)
+{
+	int fds[2];
+	pid_t pid;
+	struct timemono start;
+	size_t num;
+	u64 usec;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		err(1, "socketpair");
+
+	pid = start_writer(fds[1], requests);
+	close(fds[1]);
+
+	start = time_mono();
+	num = fn(fds[0]);
+	usec = time_to_usec(timemono_since(start));
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+
+	printf("# %s: %zu requests in %"PRIu64" usec, %"PRIu64" requests/sec\n",
+	       name, num, usec, usec ? (u64)num * 1000000 / usec : 0);
+	clean_tmpctx();
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_requests = 5000, first_size = 16384;
+	char *requests, *big;
+
+	common_setup(argv[0]);
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<num-requests> [<first-request-size>]]",
+		     argv[0]);
+	if (argc > 1)
+		num_requests = atol(argv[1]);
+	if (argc > 2)
+		first_size = atol(argv[2]);
+
+	big = tal_arr(tmpctx, char, first_size + 1);
+	memset(big, 'x', first_size);
+	big[first_size] = '\0';
+	requests = tal_fmt(NULL,
+			   "{\"jsonrpc\":\"2.0\",\"id\":\"first\","
+			   "\"method\":\"echo\",\"params\":[\"%s\"]}\n",
+			   big);
+	for (size_t i = 1; i < num_requests; i++)
+		tal_append_fmt(&requests,
+			       "{\"jsonrpc\":\"2.0\",\"id\":%zu,"
+			       "\"method\":\"getinfo\",\"params\":{}}\n",
+			       i);
+
+	run("json_input", new_way, requests);
+	run("parse+memmove", old_way, requests);
+
+	tal_free(requests);
+
+	common_shutdown();
+	return 0;
+}
@@ -0,0 +1,137 @@
+#include "config.h"
+/* What the sql plugin does to a big listpeerchannels response (look up
+ * every column of every channel): json_get_member() against
+ * json_member_index. */
+#include "../json_parse_simple.c"
+#include <ccan/err/err.h>
+#include <ccan/time/time.h>
+#include <common/setup.h>
+#include <stdio.h>
+
+/* Roughly what lightningd gives, in the same order. */
+static void add_channel(char **buf, size_t n, size_t num_htlcs)
+{
+	tal_append_fmt(buf,
+		       "{\"peer_id\":\"02%064zx\",\"peer_connected\":true,"
+		       "\"state\":\"CHANNELD_NORMAL\","
+		       "\"scratch_txid\":\"%064zx\","
+		       "\"channel_type\":{\"bits\":[12,22],"
+		       "\"names\":[\"static_remotekey/even\",\"anchors_zero_fee_htlc_tx/even\"]},"
+		       "\"feerate\":{\"perkw\":253,\"perkb\":1012},"
+		       "\"owner\":\"channeld\",\"short_channel_id\":\"%zux1x0\","
+		       "\"direction\":%zu,\"channel_id\":\"%064zx\","
+		       "\"funding_txid\":\"%064zx\",\"funding_outnum\":0,"
+		       "\"close_to_addr\":\"bcrt1q%038zx\",\"close_to\":\"0014%040zx\","
+		       "\"private\":false,\"opener\":\"local\","
+		       "\"features\":[\"option_static_remotekey\",\"option_anchors_zero_fee_htlc_tx\"],"
+		       "\"funding\":{\"local_funds_msat\":1000000000,\"remote_funds_msat\":0,\"pushed_msat\":0},"
+		       "\"to_us_msat\":999000000,\"min_to_us_msat\":990000000,\"max_to_us_msat\":1000000000,"
+		       "\"total_msat\":1000000000,\"fee_base_msat\":1,\"fee_proportional_millionths\":10,"
+		       "\"dust_limit_msat\":546000,\"max_total_htlc_in_msat\":18446744073709551615,"
+		       "\"their_reserve_msat\":10000000,\"our_reserve_msat\":10000000,"
+		       "\"spendable_msat\":970000000,\"receivable_msat\":0,"
+		       "\"minimum_htlc_in_msat\":0,\"minimum_htlc_out_msat\":0,"
+		       "\"maximum_htlc_out_msat\":990000000,"
+		       "\"their_to_self_delay\":5,\"our_to_self_delay\":5,"
+		       "\"max_accepted_htlcs\":483,"
+		       "\"alias\":{\"local\":\"%zux2x0\",\"remote\":\"%zux3x0\"},"
+		       "\"state_changes\":["
+		       "{\"timestamp\":\"2023-08-01T00:00:00.000Z\",\"old_state\":\"CHANNELD_AWAITING_LOCKIN\",\"new_state\":\"CHANNELD_NORMAL\",\"cause\":\"user\",\"message\":\"Lockin complete\"}],"
+		       "\"status\":[\"CHANNELD_NORMAL:Channel ready for use.\"],"
+		       "\"in_payments_offered\":%zu,\"in_offered_msat\":%zu,"
+		       "\"in_payments_fulfilled\":%zu,\"in_fulfilled_msat\":%zu,"
+		       "\"out_payments_offered\":%zu,\"out_offered_msat\":%zu,"
+		       "\"out_payments_fulfilled\":%zu,\"out_fulfilled_msat\":%zu,"
+		       "\"last_stable_connection\":1690000000,"
+		       "\"htlcs\":[",
+		       n, n, n + 100, n % 2, n, n, n, n, n + 100, n + 100,
+		       n, n, n, n, n, n, n, n);
+	for (size_t i = 0; i < num_htlcs; i++)
+		tal_append_fmt(buf,
+			       "%s{\"direction\":\"out\",\"id\":%zu,"
+			       "\"amount_msat\":1000,\"expiry\":%zu,"
+			       "\"payment_hash\":\"%064zx\",\"state\":\"SENT_ADD_ACK_REVOCATION\"}",
+			       i ? "," : "", i, 200 + i, i);
+	tal_append_fmt(buf, "]}");
+}
+
+static u64 lookup_all(const char *buf, const jsmntok_t *channels,
+		      const char **names, size_t num_names, bool use_index,
+		      size_t *found)
+{
+	struct timemono start = time_mono();
+	const jsmntok_t *chan;
+	size_t i;
+
+	*found = 0;
+
+	json_for_each_arr(i, chan, channels) {
+		struct json_member_index *idx = NULL;
+
+		if (use_index)
+			idx = json_member_index(tmpctx, buf, chan);
+		for (size_t f = 0; f < num_names; f++) {
+			const jsmntok_t *t;
+			if (use_index)
+				t = json_member_index_get(idx, names[f]);
+			else
+				t = json_get_member(buf, chan, names[f]);
+			if (t)
+				(*found)++;
+		}
+		tal_free(idx);
+	}
+	return time_to_usec(timemono_since(start));
+}
+
+int main(int argc, char *argv[])
+{
+	size_t i, found, num_channels = 5000, num_htlcs = 10;
+	const jsmntok_t *toks, *channels, *t;
+	const char **all_fields;
+	struct timemono start;
+	char *buf;
+	u64 usec;
+
+	common_setup(argv[0]);
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<num-channels> [<htlcs-per-channel>]]",
+		     argv[0]);
+	if (argc > 1)
+		num_channels = atol(argv[1]);
+	if (argc > 2)
+		num_htlcs = atol(argv[2]);
+
+	buf = tal_strdup(tmpctx, "{\"channels\":[");
+	for (i = 0; i < num_channels; i++) {
+		if (i)
+			tal_append_fmt(&buf, ",");
+		add_channel(&buf, i, num_htlcs);
+	}
+	tal_append_fmt(&buf, "]}");
+
+	start = time_mono();
+	toks = json_parse_simple(tmpctx, buf, strlen(buf));
+	if (!toks)
+		errx(1, "Bad JSON");
+	usec = time_to_usec(timemono_since(start));
+	printf("# Parsed %zu bytes (%zu tokens) in %"PRIu64" usec\n",
+	       strlen(buf), tal_count(toks), usec);
+
+	channels = json_get_member(buf, toks, "channels");
+	all_fields = tal_arr(tmpctx, const char *, 0);
+	json_for_each_obj(i, t, channels + 1)
+		tal_arr_expand(&all_fields, json_strdup(all_fields, buf, t));
+	usec = lookup_all(buf, channels, all_fields, tal_count(all_fields),
+			  false, &found);
+	printf("# json_get_member: %zu channels, %zu fields (%zu found) in %"PRIu64" usec\n",
+	       num_channels, tal_count(all_fields), found, usec);
+	usec = lookup_all(buf, channels, all_fields, tal_count(all_fields),
+			  true, &found);
+	printf("# json_member_index: %zu channels, %zu fields (%zu found) in %"PRIu64" usec\n",
+	       num_channels, tal_count(all_fields), found, usec);
+
+	common_shutdown();
+	return 0;
+}
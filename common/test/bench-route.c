@@ -0,0 +1,261 @@
+#include "config.h"
+#include <bitcoin/chainparams.h>
+#include <ccan/err/err.h>
+#include <ccan/time/time.h>
+#include <common/dijkstra.h>
+#include <common/gossip_store.h>
+#include <common/gossmap.h>
+#include <common/route.h>
+#include <common/setup.h>
+#include <common/utils.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <wire/peer_wiregen.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fromwire_bigsize */
+bigsize_t fromwire_bigsize(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
+{ fprintf(stderr, "fromwire_bigsize called!\n"); abort(); }
+/* Generated stub for fromwire_channel_id */
+bool fromwire_channel_id(const u8 **cursor UNNEEDED, size_t *max UNNEEDED,
+			 struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_channel_id called!\n"); abort(); }
+/* Generated stub for fromwire_tlv */
+bool fromwire_tlv(const u8 **cursor UNNEEDED, size_t *max UNNEEDED,
+		  const struct tlv_record_type *types UNNEEDED, size_t num_types UNNEEDED,
+		  void *record UNNEEDED, struct tlv_field **fields UNNEEDED,
+		  const u64 *extra_types UNNEEDED, size_t *err_off UNNEEDED, u64 *err_type UNNEEDED)
+{ fprintf(stderr, "fromwire_tlv called!\n"); abort(); }
+/* Generated stub for towire_bigsize */
+void towire_bigsize(u8 **pptr UNNEEDED, const bigsize_t val UNNEEDED)
+{ fprintf(stderr, "towire_bigsize called!\n"); abort(); }
+/* Generated stub for towire_channel_id */
+void towire_channel_id(u8 **pptr UNNEEDED, const struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "towire_channel_id called!\n"); abort(); }
+/* Generated stub for towire_tlv */
+void towire_tlv(u8 **pptr UNNEEDED,
+		const struct tlv_record_type *types UNNEEDED, size_t num_types UNNEEDED,
+		const void *record UNNEEDED)
+{ fprintf(stderr, "towire_tlv called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+#define SYNTH_NODES 15000
+#define SYNTH_CHANS_PER_NODE 5
+
+static void write_to_store(int store_fd, const u8 *msg)
+{
+	struct gossip_hdr hdr;
+
+	hdr.flags = cpu_to_be16(0);
+	hdr.len = cpu_to_be16(tal_count(msg));
+	/* We don't actually check these! */
+	hdr.crc = 0;
+	hdr.timestamp = 0;
+	if (write(store_fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+	    || write(store_fd, msg, tal_count(msg)) != tal_count(msg))
+		err(1, "Writing gossip_store");
+}
+
+/* gossmap doesn't check these are valid points, so don't waste time. */
+static void synth_node_id(u32 idx, struct node_id *id)
+{
+	memset(id->k, 0, sizeof(id->k));
+	id->k[0] = 0x02;
+	id->k[PUBKEY_CMPR_LEN-4] = idx >> 24;
+	id->k[PUBKEY_CMPR_LEN-3] = idx >> 16;
+	id->k[PUBKEY_CMPR_LEN-2] = idx >> 8;
+	id->k[PUBKEY_CMPR_LEN-1] = idx;
+}
+
+static void add_channel(int store_fd, u32 blocknum, u32 n1, u32 n2)
+{
+	struct short_channel_id scid;
+	secp256k1_ecdsa_signature dummy_sig;
+	struct pubkey dummy_key;
+	struct node_id ids[2];
+	u8 *msg;
+
+	memset(&dummy_sig, 0, sizeof(dummy_sig));
+	memset(&dummy_key, 0, sizeof(dummy_key));
+	if (!mk_short_channel_id(&scid, blocknum, 1, 0))
+		abort();
+
+	synth_node_id(n1, &ids[0]);
+	synth_node_id(n2, &ids[1]);
+	if (node_id_cmp(&ids[0], &ids[1]) > 0) {
+		struct node_id tmp = ids[0];
+		ids[0] = ids[1];
+		ids[1] = tmp;
+	}
+	msg = towire_channel_announcement(tmpctx, &dummy_sig, &dummy_sig,
+					  &dummy_sig, &dummy_sig,
+					  /* features */ NULL,
+					  &chainparams->genesis_blockhash,
+					  &scid,
+					  &ids[0], &ids[1],
+					  &dummy_key, &dummy_key);
+	write_to_store(store_fd, msg);
+
+	for (int dir = 0; dir < 2; dir++) {
+		msg = towire_channel_update(tmpctx,
+					    &dummy_sig,
+					    &chainparams->genesis_blockhash,
+					    &scid, 0,
+					    ROUTING_OPT_HTLC_MAX_MSAT,
+					    dir,
+					    6 + random() % 140,
+					    AMOUNT_MSAT(0),
+					    random() % 1000,
+					    1 + random() % 2000,
+					    AMOUNT_MSAT(1000000000));
+		write_to_store(store_fd, msg);
+	}
+}
+
+static struct gossmap *synth_gossmap(const tal_t *ctx)
+{
+	char gossip_version = 10;
+	char *gossipfilename;
+	struct gossmap *gossmap;
+	u32 blocknum = 1;
+	int store_fd;
+
+	store_fd = tmpdir_mkstemp(tmpctx, "bench-route-gossipstore.XXXXXX",
+				  &gossipfilename);
+	if (write(store_fd, &gossip_version, sizeof(gossip_version))
+	    != sizeof(gossip_version))
+		err(1, "Writing gossip_store");
+
+	for (u32 i = 0; i < SYNTH_NODES; i++) {
+		for (size_t j = 0; j < SYNTH_CHANS_PER_NODE; j++) {
+			u32 peer = random() % SYNTH_NODES;
+			if (peer != i)
+				add_channel(store_fd, blocknum++, i, peer);
+		}
+		clean_tmpctx();
+	}
+	close(store_fd);
+
+	gossmap = gossmap_load(ctx, gossipfilename, NULL);
+	if (!gossmap)
+		err(1, "Loading %s", gossipfilename);
+	unlink(gossipfilename);
+	return gossmap;
+}
+
+static struct gossmap_node *random_node(struct gossmap *gossmap)
+{
+	struct gossmap_node *n;
+
+	do {
+		n = gossmap_node_byidx(gossmap,
+				       random() % gossmap_max_node_idx(gossmap));
+	} while (!n || n->num_chans == 0);
+	return n;
+}
+
+/* What getroute used to do, what it does now, and its shortest-route
+ * fallback without and with guidance */
+enum bench_mode {
+	BENCH_FULL,
+	BENCH_TO,
+	BENCH_SHORTER,
+	BENCH_GUIDED,
+	NUM_MODES
+};
+
+static const char *bench_mode_name[NUM_MODES] = {
+	"dijkstra", "dijkstra_to", "dijkstra_to (shorter)",
+	"dijkstra_to (shorter, guided)"
+};
+
+int main(int argc, char *argv[])
+{
+	const tal_t *ctx;
+	struct gossmap *gossmap;
+	struct timemono tstart, tstop;
+	const struct dijkstra_landmarks *lm;
+	size_t num_routes = 100, num_found[NUM_MODES] = { 0 };
+	u64 total_usec[NUM_MODES] = { 0 }, max_usec[NUM_MODES] = { 0 };
+
+	common_setup(argv[0]);
+	chainparams = chainparams_for_network("regtest");
+	ctx = tal(NULL, char);
+	srandom(1);
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<gossip_store> [<num-routes>]]", argv[0]);
+	if (argc > 2)
+		num_routes = atol(argv[2]);
+
+	tstart = time_mono();
+	if (argc > 1 && !streq(argv[1], "-")) {
+		gossmap = gossmap_load(ctx, argv[1], NULL);
+		if (!gossmap)
+			err(1, "Loading gossip store %s", argv[1]);
+	} else
+		gossmap = synth_gossmap(ctx);
+	tstop = time_mono();
+
+	printf("# Loaded %zu nodes and %zu channels in %"PRIu64" msec\n",
+	       gossmap_num_nodes(gossmap), gossmap_num_chans(gossmap),
+	       time_to_msec(timemono_between(tstop, tstart)));
+
+	tstart = time_mono();
+	lm = dijkstra_landmarks_new(ctx, gossmap, 8);
+	tstop = time_mono();
+	printf("# Landmarks in %"PRIu64" msec\n",
+	       time_to_msec(timemono_between(tstop, tstart)));
+
+	for (size_t i = 0; i < num_routes; i++) {
+		struct gossmap_node *src = random_node(gossmap),
+			*dst = random_node(gossmap);
+
+		for (enum bench_mode m = 0; m < NUM_MODES; m++) {
+			const struct dijkstra *dij;
+			struct route_hop *route;
+			u64 usec;
+
+			tstart = time_mono();
+			if (m == BENCH_FULL)
+				dij = dijkstra(tmpctx, gossmap, dst,
+					       AMOUNT_MSAT(10000000), 1.0,
+					       route_can_carry,
+					       route_score_cheaper, NULL);
+			else if (m == BENCH_TO)
+				dij = dijkstra_to(tmpctx, gossmap, dst, src,
+						  AMOUNT_MSAT(10000000), 1.0,
+						  route_can_carry,
+						  route_score_cheaper,
+						  NULL, NULL, NULL);
+			else
+				dij = dijkstra_to(tmpctx, gossmap, dst, src,
+						  AMOUNT_MSAT(10000000), 1.0,
+						  route_can_carry,
+						  route_score_shorter,
+						  m == BENCH_GUIDED ? lm : NULL,
+						  route_bound_shorter, NULL);
+			route = route_from_dijkstra(tmpctx, gossmap, dij, src,
+						    AMOUNT_MSAT(10000000), 9);
+			tstop = time_mono();
+
+			usec = time_to_usec(timemono_between(tstop, tstart));
+			total_usec[m] += usec;
+			max_usec[m] = usec > max_usec[m] ? usec : max_usec[m];
+			if (route)
+				num_found[m]++;
+		}
+		clean_tmpctx();
+	}
+
+	for (enum bench_mode m = 0; m < NUM_MODES; m++)
+		printf("# %s: %zu routes (%zu found): %"PRIu64" usec average, %"PRIu64" usec max\n",
+		       bench_mode_name[m], num_routes, num_found[m],
+		       num_routes ? total_usec[m] / num_routes : 0,
+		       max_usec[m]);
+
+	tal_free(ctx);
+	common_shutdown();
+	return 0;
+}
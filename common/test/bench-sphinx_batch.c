@@ -0,0 +1,120 @@
+#include "config.h"
+/* A commitment's worth of onions: process_onionpacket one at a time against
+ * sphinx_batch with 0..max threads. */
+#include <ccan/err/err.h>
+#include <ccan/time/time.h>
+#include <common/setup.h>
+#include <common/sphinx.h>
+#include <common/sphinx_batch.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+struct bench {
+	struct onionpacket **packets;
+	struct secret *shared_secrets;
+	struct sha256 *payment_hashes;
+};
+
+/* Single-hop onions, to us. */
+static struct bench *new_bench(const tal_t *ctx, size_t num_onions,
+			       const struct privkey *privkey)
+{
+	struct bench *b = tal(ctx, struct bench);
+	struct pubkey id;
+	u8 payload[40];
+
+	if (!pubkey_from_privkey(privkey, &id))
+		errx(1, "Bad privkey");
+	memset(payload, 1, sizeof(payload));
+
+	b->packets = tal_arr(b, struct onionpacket *, num_onions);
+	b->shared_secrets = tal_arr(b, struct secret, num_onions);
+	b->payment_hashes = tal_arr(b, struct sha256, num_onions);
+	for (size_t i = 0; i < num_onions; i++) {
+		struct sphinx_path *sp;
+		struct secret *path_secrets;
+
+		memset(&b->payment_hashes[i], i, sizeof(b->payment_hashes[i]));
+		sp = sphinx_path_new(tmpctx, b->payment_hashes[i].u.u8);
+		sphinx_add_hop(sp, &id, tal_dup_arr(NULL, u8, payload,
+						    sizeof(payload), 0));
+		b->packets[i] = create_onionpacket(b->packets, sp,
+						   ROUTING_INFO_SIZE,
+						   &path_secrets);
+		if (!onion_shared_secret(&b->shared_secrets[i], b->packets[i],
+					 privkey))
+			errx(1, "Bad onion %zu", i);
+		clean_tmpctx();
+	}
+	return b;
+}
+
+/* What peer_accepted_htlc used to do. */
+static u64 run_serial(const struct bench *b)
+{
+	struct timemono start = time_mono();
+
+	for (size_t i = 0; i < tal_count(b->packets); i++)
+		process_onionpacket(tmpctx, b->packets[i],
+				    &b->shared_secrets[i],
+				    b->payment_hashes[i].u.u8,
+				    sizeof(b->payment_hashes[i]), true);
+	clean_tmpctx();
+	return time_to_usec(timemono_since(start));
+}
+
+static u64 run_batch(const struct bench *b, struct sphinx_batch *batch)
+{
+	struct sphinx_batch_onion *onions;
+	struct timemono start = time_mono();
+
+	onions = tal_arr(tmpctx, struct sphinx_batch_onion,
+			 tal_count(b->packets));
+	for (size_t i = 0; i < tal_count(onions); i++) {
+		onions[i].packet = b->packets[i];
+		onions[i].shared_secret = &b->shared_secrets[i];
+		onions[i].assocdata = b->payment_hashes[i].u.u8;
+		onions[i].assocdatalen = sizeof(b->payment_hashes[i]);
+	}
+	sphinx_batch_process(tmpctx, batch, onions);
+	clean_tmpctx();
+	return time_to_usec(timemono_since(start));
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_onions = 483, max_threads = 7;
+	struct privkey privkey;
+	struct bench *b;
+	u64 usec;
+
+	common_setup(argv[0]);
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<num-onions> [<max-threads>]]", argv[0]);
+	if (argc > 1)
+		num_onions = atol(argv[1]);
+	if (argc > 2)
+		max_threads = atol(argv[2]);
+
+	memset(&privkey, 7, sizeof(privkey));
+	b = new_bench(NULL, num_onions, &privkey);
+
+	usec = run_serial(b);
+	printf("# one at a time: %"PRIu64" onions/sec\n",
+	       usec ? num_onions * 1000000 / usec : 0);
+	for (size_t t = 0; t <= max_threads; t++) {
+		struct sphinx_batch *batch = sphinx_batch_new(NULL, t);
+
+		/* The first one starts the threads: don't count that. */
+		run_batch(b, batch);
+		usec = run_batch(b, batch);
+		printf("# batch, %zu extra threads: %"PRIu64" onions/sec\n",
+		       t, usec ? num_onions * 1000000 / usec : 0);
+		tal_free(batch);
+	}
+
+	tal_free(b);
+	common_shutdown();
+	return 0;
+}
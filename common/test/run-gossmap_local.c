@@ -298,6 +298,7 @@ int main(int argc, char *argv[])
 	struct amount_sat capacity;
 	u32 timestamp, fee_base_msat, fee_proportional_millionths;
 	u8 message_flags, channel_flags;
+	u64 gen_base, gen_mods;
 	struct amount_msat htlc_minimum_msat, htlc_maximum_msat;
 	u8 *cann, *nann;
 
@@ -429,7 +430,10 @@ int main(int argc, char *argv[])
 	assert(gossmap_local_addchan(mods, &l1, &l4, &scid_local, NULL));
 
 	/* Apply changes, check they work. */
+	gen_base = gossmap_generation(map);
 	gossmap_apply_localmods(map, mods);
+	gen_mods = gossmap_generation(map);
+	assert(gen_mods != gen_base);
 	assert(gossmap_find_node(map, &l4));
 	chan = gossmap_find_chan(map, &scid_local);
 
@@ -443,6 +447,13 @@ int main(int argc, char *argv[])
 	assert(!gossmap_find_chan(map, &scid_local));
 	assert(!gossmap_find_node(map, &l4));
 
+	/* Map is as it was, and the same mods make the same map again. */
+	assert(gossmap_generation(map) == gen_base);
+	gossmap_apply_localmods(map, mods);
+	assert(gossmap_generation(map) == gen_mods);
+	gossmap_remove_localmods(map, mods);
+	assert(gossmap_generation(map) == gen_base);
+
 	/* Now update it both local, and an existing one. */
 	gossmap_local_updatechan(mods, &scid_local,
 				 AMOUNT_MSAT(1),
@@ -458,6 +469,8 @@ int main(int argc, char *argv[])
 				 101, 102, 103, true, 0);
 
 	gossmap_apply_localmods(map, mods);
+	assert(gossmap_generation(map) != gen_base);
+	assert(gossmap_generation(map) != gen_mods);
 	chan = gossmap_find_chan(map, &scid_local);
 	assert(gossmap_chan_set(chan, 0));
 	assert(!gossmap_chan_set(chan, 1));
@@ -496,6 +509,8 @@ int main(int argc, char *argv[])
 	assert(chan->half[0].proportional_fee == 1000);
 	assert(chan->half[0].delay == 6);
 
+	assert(gossmap_generation(map) == gen_base);
+
 	/* Now we can refresh. */
 	assert(write(fd, "", 1) == 1);
 	gossmap_refresh(map, NULL);
@@ -2,6 +2,7 @@
 #include "../json_parse.c"
 #include "../json_parse_simple.c"
 #include <assert.h>
+#include <ccan/array_size/array_size.h>
 #include <ccan/tal/str/str.h>
 #include <common/channel_type.h>
 #include <common/json_filter.h>
@@ -216,6 +217,226 @@ static void test_json_bad_utf8(void)
 	assert(json_parse_simple(tmpctx, buf, strlen(buf)));
 }
 
+/* Feed a pipelined stream through in every chunk size, the way
+ * lightningd reads requests. */
+static void test_json_input(void)
+{
+	const char *stream =
+		"{\"id\":1,\"s\":\"}\\\"{\"}\n"
+		"  [1, {\"a\": [2, 3]}]\r\n"
+		"\"str\\\\\"{\"id\":\"x\"}\t";
+	const char *expect[] = {
+		"{\"id\":1,\"s\":\"}\\\"{\"}",
+		"[1, {\"a\": [2, 3]}]",
+		"\"str\\\\\"",
+		"{\"id\":\"x\"}",
+	};
+	size_t len = strlen(stream);
+
+	for (size_t chunk = 1; chunk <= len; chunk++) {
+		struct json_input in;
+		jsmn_parser parser;
+		jsmntok_t *toks = toks_alloc(tmpctx);
+		char *buffer = tal_arr(tmpctx, char, 4);
+		size_t used = 0, sent = 0, n = 0;
+
+		json_input_init(&in);
+		while (sent < len) {
+			bool complete;
+			size_t amt;
+
+			json_input_make_room(&in, &buffer, &used);
+			amt = tal_count(buffer) - used;
+			if (amt > chunk)
+				amt = chunk;
+			if (amt > len - sent)
+				amt = len - sent;
+			memcpy(buffer + used, stream + sent, amt);
+			used += amt;
+			sent += amt;
+
+			for (;;) {
+				assert(json_input_parse(&in, &parser, &toks,
+							buffer, used,
+							&complete));
+				if (!complete)
+					break;
+				assert(n < ARRAY_SIZE(expect));
+				assert(json_tok_full_len(toks)
+				       == strlen(expect[n]));
+				assert(memcmp(json_tok_full(buffer, toks),
+					      expect[n],
+					      strlen(expect[n])) == 0);
+				n++;
+			}
+		}
+		assert(n == ARRAY_SIZE(expect));
+		/* Trailing whitespace is consumed too. */
+		assert(json_input_consumed(&in) == used);
+		/* And the buffer never needed to hold more than one. */
+		assert(tal_count(buffer) <= 64);
+	}
+
+	/* Garbage between elements is rejected. */
+	{
+		struct json_input in;
+		jsmn_parser parser;
+		jsmntok_t *toks = toks_alloc(tmpctx);
+		const char *buf = "{\"a\":1} , {\"b\":2}";
+		bool complete;
+
+		json_input_init(&in);
+		assert(json_input_parse(&in, &parser, &toks,
+					buf, strlen(buf), &complete));
+		assert(complete);
+		assert(!json_input_parse(&in, &parser, &toks,
+					 buf, strlen(buf), &complete));
+		assert(json_input_consumed(&in) == strlen("{\"a\":1} "));
+	}
+}
+
+static void add_frame(char **stream, const char *json)
+{
+	size_t len = strlen(json), off = tal_count(*stream);
+	u32 hdr = JSON_FRAME_HDR_BIT | len;
+
+	tal_resize(stream, off + JSON_FRAME_HDR_LEN + len);
+	(*stream)[off] = hdr >> 24;
+	(*stream)[off+1] = hdr >> 16;
+	(*stream)[off+2] = hdr >> 8;
+	(*stream)[off+3] = hdr;
+	memcpy(*stream + off + JSON_FRAME_HDR_LEN, json, len);
+}
+
+static void add_unframed(char **stream, const char *json)
+{
+	size_t len = strlen(json), off = tal_count(*stream);
+
+	tal_resize(stream, off + len + 2);
+	memcpy(*stream + off, json, len);
+	memcpy(*stream + off + len, "\n\n", 2);
+}
+
+static void test_json_input_framed(void)
+{
+	const char *expect[] = {
+		"{\"id\":0}",
+		"{\"id\":1,\"s\":\"}\"}",
+		/* Looks incomplete, but the length says otherwise. */
+		"[1, {\"a\": [2, 3]}]",
+		/* Streamed, so not framed. */
+		"{\"id\":3,\"rows\":[[1],[2]]}",
+		"{\"id\":4}",
+	};
+	char *stream;
+	size_t len;
+
+	/* The first isn't framed, and the whitespace after it is skipped. */
+	stream = tal_fmt(tmpctx, "%s\n\n", expect[0]);
+	tal_resize(&stream, strlen(stream));
+	add_frame(&stream, "{\"id\":1,\"s\":\"}\"}\n\n");
+	add_frame(&stream, expect[2]);
+	add_unframed(&stream, expect[3]);
+	add_frame(&stream, expect[4]);
+	len = tal_count(stream);
+
+	for (size_t chunk = 1; chunk <= len; chunk++) {
+		struct json_input in;
+		jsmn_parser parser;
+		jsmntok_t *toks = toks_alloc(tmpctx);
+		char *buffer = tal_arr(tmpctx, char, 4);
+		size_t used = 0, sent = 0, n = 0;
+
+		json_input_init(&in);
+		while (sent < len) {
+			bool complete;
+			size_t amt;
+
+			json_input_make_room(&in, &buffer, &used);
+			amt = tal_count(buffer) - used;
+			if (amt > chunk)
+				amt = chunk;
+			if (amt > len - sent)
+				amt = len - sent;
+			memcpy(buffer + used, stream + sent, amt);
+			used += amt;
+			sent += amt;
+
+			for (;;) {
+				assert(json_input_parse(&in, &parser, &toks,
+							buffer, used,
+							&complete));
+				if (!complete)
+					break;
+				assert(n < ARRAY_SIZE(expect));
+				assert(json_tok_full_len(toks)
+				       == strlen(expect[n]));
+				assert(memcmp(json_tok_full(buffer, toks),
+					      expect[n],
+					      strlen(expect[n])) == 0);
+				if (n++ == 0)
+					json_input_set_framed(&in);
+			}
+		}
+		assert(n == ARRAY_SIZE(expect));
+		assert(json_input_consumed(&in) == used);
+	}
+
+	/* A frame which is too big is rejected. */
+	{
+		struct json_input in;
+		jsmn_parser parser;
+		jsmntok_t *toks = toks_alloc(tmpctx);
+		char *buf = tal_arr(tmpctx, char, 0);
+		bool complete;
+
+		add_frame(&buf, "{\"a\":1}");
+		buf[0] |= (JSON_FRAME_MAX_LEN + 1) >> 24;
+		json_input_init(&in);
+		json_input_set_framed(&in);
+		assert(!json_input_parse(&in, &parser, &toks,
+					 buf, tal_count(buf), &complete));
+	}
+}
+
+static void test_json_member_index(void)
+{
+	char *buf = tal_strdup(tmpctx, "{");
+	const jsmntok_t *toks;
+	struct json_member_index *idx;
+
+	/* Enough members to get a table, with nested values and a dup. */
+	for (size_t i = 0; i < 40; i++)
+		tal_append_fmt(&buf, "\"f%zu\":{\"f%zu\":[%zu,{\"x\":1}]},",
+			       i, i + 1, i);
+	tal_append_fmt(&buf, "\"f7\":\"dup\",\"\":1}");
+	toks = json_parse_simple(tmpctx, buf, strlen(buf));
+	assert(toks);
+
+	idx = json_member_index(tmpctx, buf, toks);
+	/* It only indexes as far as it's had to look: go part way first. */
+	assert(json_member_index_get(idx, "f39")
+	       == json_get_member(buf, toks, "f39"));
+	for (size_t i = 0; i < 45; i++) {
+		const char *label = tal_fmt(tmpctx, "f%zu", i);
+		assert(json_member_index_get(idx, label)
+		       == json_get_member(buf, toks, label));
+		assert(json_member_index_get(idx, label) == NULL
+		       || i < 40);
+	}
+	assert(json_member_index_get(idx, "")
+	       == json_get_member(buf, toks, ""));
+	assert(json_member_index_get(idx, "x") == NULL);
+
+	/* Small objects, and non-objects, just do the walk. */
+	idx = json_member_index(tmpctx, buf, toks + 2);
+	assert(json_member_index_get(idx, "f1")
+	       == json_get_member(buf, toks + 2, "f1"));
+	assert(json_member_index_get(idx, "f0") == NULL);
+	idx = json_member_index(tmpctx, buf, toks + 3);
+	assert(json_member_index_get(idx, "f1") == NULL);
+}
+
 int main(int argc, char *argv[])
 {
 	common_setup(argv[0]);
@@ -224,6 +445,9 @@ int main(int argc, char *argv[])
 	test_json_tok_bitcoin_amount();
 	test_json_tok_millionths();
 	test_json_bad_utf8();
+	test_json_input();
+	test_json_input_framed();
+	test_json_member_index();
 
 	common_shutdown();
 }
@@ -158,6 +158,51 @@ static bool route_can_carry_unless_disabled(const struct gossmap *map,
 	return route_can_carry_even_disabled(map, c, dir, amount, arg);
 }
 
+static void check_route_eq(const struct route_hop *r,
+			   const struct route_hop *route)
+{
+	assert(tal_count(r) == tal_count(route));
+	for (size_t i = 0; i < tal_count(r); i++) {
+		assert(short_channel_id_eq(&r[i].scid, &route[i].scid));
+		assert(r[i].direction == route[i].direction);
+		assert(amount_msat_eq(r[i].amount, route[i].amount));
+		assert(r[i].delay == route[i].delay);
+	}
+}
+
+/* dijkstra_to must find exactly the same route, and so must the guided
+ * shortest-path search as the unguided one. */
+static void check_dijkstra_to(const struct gossmap *gossmap,
+			      const struct gossmap_node *dst,
+			      const struct gossmap_node *src,
+			      struct amount_msat amount,
+			      double riskfactor,
+			      u32 cltv,
+			      const struct route_hop *route)
+{
+	const struct dijkstra_landmarks *lm;
+	const struct dijkstra *dij;
+	struct route_hop *shortest;
+
+	dij = dijkstra_to(tmpctx, gossmap, dst, src, amount, riskfactor,
+			  route_can_carry_unless_disabled,
+			  route_score_cheaper, NULL, NULL, NULL);
+	check_route_eq(route_from_dijkstra(tmpctx, gossmap, dij, src,
+					   amount, cltv), route);
+
+	lm = dijkstra_landmarks_new(tmpctx, gossmap, 2);
+	assert(dijkstra_landmarks_valid(lm, gossmap));
+	dij = dijkstra_to(tmpctx, gossmap, dst, src, amount, riskfactor,
+			  route_can_carry_unless_disabled,
+			  route_score_shorter, NULL, NULL, NULL);
+	shortest = route_from_dijkstra(tmpctx, gossmap, dij, src, amount, cltv);
+	dij = dijkstra_to(tmpctx, gossmap, dst, src, amount, riskfactor,
+			  route_can_carry_unless_disabled,
+			  route_score_shorter, lm, route_bound_shorter, NULL);
+	check_route_eq(route_from_dijkstra(tmpctx, gossmap, dij, src,
+					   amount, cltv), shortest);
+}
+
 static void node_id_from_privkey(const struct privkey *p, struct node_id *id)
 {
 	struct pubkey k;
@@ -165,6 +210,44 @@ static void node_id_from_privkey(const struct privkey *p, struct node_id *id)
 	node_id_from_pubkey(id, &k);
 }
 
+/* Each result keeps its own space until it's freed, and a search reusing
+ * a freed one must not see nodes from the last search. */
+static void check_dijkstra_reuse(const struct gossmap *gossmap,
+				 const struct gossmap_node *n1,
+				 const struct gossmap_node *n2,
+				 double riskfactor)
+{
+	const struct dijkstra *dij1, *dij2;
+	u32 idx1 = gossmap_node_idx(gossmap, n1);
+	u32 idx2 = gossmap_node_idx(gossmap, n2);
+	u32 dist;
+
+	dij1 = dijkstra(NULL, gossmap, n1, AMOUNT_MSAT(3000000), riskfactor,
+			route_can_carry_unless_disabled,
+			route_score_cheaper, NULL);
+	dist = dijkstra_distance(dij1, idx2);
+	assert(dist != 0 && dist != UINT_MAX);
+
+	dij2 = dijkstra(NULL, gossmap, n2, AMOUNT_MSAT(3000000), riskfactor,
+			route_can_carry_unless_disabled,
+			route_score_cheaper, NULL);
+	assert(dijkstra_distance(dij2, idx2) == 0);
+	assert(dijkstra_distance(dij1, idx1) == 0);
+	assert(dijkstra_distance(dij1, idx2) == dist);
+	tal_free(dij2);
+
+	/* Stops as soon as it starts: only n1 is touched. */
+	dij2 = dijkstra_to(NULL, gossmap, n1, n1, AMOUNT_MSAT(3000000), riskfactor,
+			   route_can_carry_unless_disabled,
+			   route_score_cheaper, NULL, NULL, NULL);
+	assert(dijkstra_distance(dij2, idx1) == 0);
+	assert(dijkstra_distance(dij2, idx2) == UINT_MAX);
+	assert(!dijkstra_best_chan(dij2, idx2));
+	assert(dijkstra_distance(dij1, idx2) == dist);
+	tal_free(dij2);
+	tal_free(dij1);
+}
+
 int main(int argc, char *argv[])
 {
 	common_setup(argv[0]);
@@ -206,6 +289,7 @@ int main(int argc, char *argv[])
 
 	route = route_from_dijkstra(tmpctx, gossmap, dij, a_node, AMOUNT_MSAT(1000), 10);
 	assert(route);
+	check_dijkstra_to(gossmap, b_node, a_node, AMOUNT_MSAT(1000), riskfactor, 10, route);
 	assert(tal_count(route) == 1);
 	assert(amount_msat_eq(route[0].amount, AMOUNT_MSAT(1000)));
 	assert(route[0].delay == 10);
@@ -226,6 +310,7 @@ int main(int argc, char *argv[])
 	route = route_from_dijkstra(tmpctx, gossmap, dij, a_node,
 				    AMOUNT_MSAT(1000), 11);
 	assert(route);
+	check_dijkstra_to(gossmap, c_node, a_node, AMOUNT_MSAT(1000), riskfactor, 11, route);
 	assert(tal_count(route) == 2);
 	assert(amount_msat_eq(route[1].amount, AMOUNT_MSAT(1000)));
 	assert(route[1].delay == 11);
@@ -254,6 +339,7 @@ int main(int argc, char *argv[])
 				    AMOUNT_MSAT(1000), 12);
 
 	assert(route);
+	check_dijkstra_to(gossmap, c_node, a_node, AMOUNT_MSAT(1000), riskfactor, 12, route);
 	assert(tal_count(route) == 2);
 	assert(channel_is_between(gossmap, &route[0], a_node, d_node));
 	assert(channel_is_between(gossmap, &route[1], d_node, c_node));
@@ -269,6 +355,7 @@ int main(int argc, char *argv[])
 	route = route_from_dijkstra(tmpctx, gossmap, dij, a_node,
 				    AMOUNT_MSAT(3000000), 13);
 	assert(route);
+	check_dijkstra_to(gossmap, c_node, a_node, AMOUNT_MSAT(3000000), riskfactor, 13, route);
 	assert(tal_count(route) == 2);
 	assert(channel_is_between(gossmap, &route[0], a_node, b_node));
 	assert(channel_is_between(gossmap, &route[1], b_node, c_node));
@@ -293,6 +380,7 @@ int main(int argc, char *argv[])
 	route = route_from_dijkstra(tmpctx, gossmap, dij, a_node,
 				    AMOUNT_MSAT(3000000), 14);
 	assert(route);
+	check_dijkstra_to(gossmap, c_node, a_node, AMOUNT_MSAT(3000000), riskfactor, 14, route);
 	assert(tal_count(route) == 2);
 	assert(channel_is_between(gossmap, &route[0], a_node, d_node));
 	assert(channel_is_between(gossmap, &route[1], d_node, c_node));
@@ -301,6 +389,8 @@ int main(int argc, char *argv[])
 	assert(amount_msat_eq(route[0].amount, AMOUNT_MSAT(3000000 + 6)));
 	assert(route[0].delay == 15);
 
+	check_dijkstra_reuse(gossmap, c_node, a_node, riskfactor);
+
 	common_shutdown();
 	return 0;
 }
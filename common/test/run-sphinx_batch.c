@@ -0,0 +1,133 @@
+#include "config.h"
+#include <assert.h>
+#include <ccan/mem/mem.h>
+#include <common/setup.h>
+#include <common/sphinx.h>
+#include <common/sphinx_batch.h>
+#include <common/utils.h>
+#include <stdio.h>
+
+struct test_onion {
+	struct onionpacket *packet;
+	struct secret shared_secret;
+	struct sha256 payment_hash;
+};
+
+/* Onions to us: odd ones go on to another hop, even ones end here.  Every
+ * third one has its HMAC broken. */
+static struct test_onion *make_onions(const tal_t *ctx, size_t num,
+				      const struct privkey *privkey)
+{
+	struct test_onion *onions = tal_arr(ctx, struct test_onion, num);
+	struct privkey next_privkey;
+	struct pubkey id, next_id;
+
+	memset(&next_privkey, 8, sizeof(next_privkey));
+	assert(pubkey_from_privkey(privkey, &id));
+	assert(pubkey_from_privkey(&next_privkey, &next_id));
+
+	for (size_t i = 0; i < num; i++) {
+		struct sphinx_path *sp;
+		struct secret *path_secrets;
+		u8 *payload = tal_arr(tmpctx, u8, 10 + i);
+
+		memset(payload, i, tal_bytelen(payload));
+		memset(&onions[i].payment_hash, i,
+		       sizeof(onions[i].payment_hash));
+		sp = sphinx_path_new(tmpctx, onions[i].payment_hash.u.u8);
+		sphinx_add_hop(sp, &id, payload);
+		if (i % 2)
+			sphinx_add_hop(sp, &next_id, payload);
+		onions[i].packet = create_onionpacket(onions, sp,
+						      ROUTING_INFO_SIZE,
+						      &path_secrets);
+		assert(onion_shared_secret(&onions[i].shared_secret,
+					   onions[i].packet, privkey));
+		if (i % 3 == 0)
+			onions[i].packet->hmac.bytes[0] ^= 1;
+	}
+	return onions;
+}
+
+static void check_same_step(const struct route_step *a,
+			    const struct route_step *b)
+{
+	if (!a) {
+		assert(!b);
+		return;
+	}
+	assert(b);
+	assert(a->nextcase == b->nextcase);
+	assert(memeq(a->raw_payload, tal_bytelen(a->raw_payload),
+		     b->raw_payload, tal_bytelen(b->raw_payload)));
+	assert(a->next->version == b->next->version);
+	assert(pubkey_eq(&a->next->ephemeralkey, &b->next->ephemeralkey));
+	assert(hmac_eq(&a->next->hmac, &b->next->hmac));
+	assert(memeq(a->next->routinginfo, tal_bytelen(a->next->routinginfo),
+		     b->next->routinginfo, tal_bytelen(b->next->routinginfo)));
+}
+
+/* The batch must give exactly what process_onionpacket does. */
+static void check_batch(struct sphinx_batch *batch,
+			const struct test_onion *onions)
+{
+	struct sphinx_batch_onion *bonions;
+	size_t num_ok = 0;
+
+	bonions = tal_arr(tmpctx, struct sphinx_batch_onion, tal_count(onions));
+	for (size_t i = 0; i < tal_count(onions); i++) {
+		bonions[i].packet = onions[i].packet;
+		bonions[i].shared_secret = &onions[i].shared_secret;
+		bonions[i].assocdata = onions[i].payment_hash.u.u8;
+		bonions[i].assocdatalen = sizeof(onions[i].payment_hash);
+	}
+	sphinx_batch_process(tmpctx, batch, bonions);
+
+	for (size_t i = 0; i < tal_count(onions); i++) {
+		struct route_step *rs;
+
+		rs = process_onionpacket(tmpctx, onions[i].packet,
+					 &onions[i].shared_secret,
+					 onions[i].payment_hash.u.u8,
+					 sizeof(onions[i].payment_hash), true);
+		check_same_step(rs, bonions[i].rs);
+		/* Make sure we're testing both good and bad ones. */
+		assert(!rs == (i % 3 == 0));
+		if (rs) {
+			assert(rs->nextcase == (i % 2 ? ONION_FORWARD : ONION_END));
+			num_ok++;
+		}
+	}
+	assert(num_ok == tal_count(onions) - (tal_count(onions) + 2) / 3);
+}
+
+int main(int argc, char *argv[])
+{
+	struct privkey privkey;
+	struct test_onion *few, *many;
+	struct sphinx_batch *batch;
+
+	common_setup(argv[0]);
+
+	memset(&privkey, 7, sizeof(privkey));
+	/* Few enough that we don't use the threads. */
+	few = make_onions(tmpctx, 3, &privkey);
+	many = make_onions(tmpctx, 20, &privkey);
+
+	/* No threads at all. */
+	batch = sphinx_batch_new(tmpctx, 0);
+	check_batch(batch, few);
+	check_batch(batch, many);
+	tal_free(batch);
+
+	batch = sphinx_batch_new(tmpctx, 3);
+	check_batch(batch, few);
+	check_batch(batch, many);
+	/* Once the threads are started, too. */
+	check_batch(batch, many);
+	check_batch(batch, few);
+	tal_free(batch);
+
+	common_shutdown();
+	return 0;
+}
@@ -245,7 +245,8 @@ static struct peer *new_peer(struct daemon *daemon,
 	peer->cs = *cs;
 	peer->subds = tal_arr(peer, struct subd *, 0);
 	peer->peer_in = NULL;
-	peer->sent_to_peer = NULL;
+	peer->peer_out = NULL;
+	peer->peer_out_len = 0;
 	peer->urgent = false;
 	peer->draining = false;
 	peer->peer_outq = msg_queue_new(peer, false);
@@ -255,6 +256,7 @@ static struct peer *new_peer(struct daemon *daemon,
 #if DEVELOPER
 	peer->dev_writes_enabled = NULL;
 	peer->dev_read_enabled = true;
+	peer->dev_msgs_written = peer->dev_writes = 0;
 #endif
 
 	peer->to_peer = conn;
@@ -1886,6 +1888,22 @@ static void dev_suppress_gossip(struct daemon *daemon, const u8 *msg)
 	daemon->dev_suppress_gossip = true;
 }
 
+static void dev_peer_writes(struct daemon *daemon, const u8 *msg)
+{
+	struct node_id id;
+	struct peer *peer;
+
+	if (!fromwire_connectd_dev_peer_writes(msg, &id))
+		master_badmsg(WIRE_CONNECTD_DEV_PEER_WRITES, msg);
+
+	peer = peer_htable_get(daemon->peers, &id);
+	daemon_conn_send(daemon->master,
+			 take(towire_connectd_dev_peer_writes_reply(NULL,
+								    peer != NULL,
+								    peer ? peer->dev_msgs_written : 0,
+								    peer ? peer->dev_writes : 0)));
+}
+
 static const char *addr2name(const tal_t *ctx,
 			     const struct sockaddr_storage *sa,
 			     socklen_t addrlen)
@@ -1993,7 +2011,7 @@ static void dev_report_fds(struct daemon *daemon, const u8 *msg)
 			continue;
 		}
 #endif
-		if (fd == daemon->gossip_store_fd) {
+		if (fd == daemon->gossip_store.fd) {
 			status_info("dev_report_fds: %i -> gossip_store", fd);
 			continue;
 		}
@@ -2095,6 +2113,11 @@ static struct io_plan *recv_req(struct io_conn *conn,
 #if DEVELOPER
 		dev_report_fds(daemon, msg);
 		goto out;
+#endif
+	case WIRE_CONNECTD_DEV_PEER_WRITES:
+#if DEVELOPER
+		dev_peer_writes(daemon, msg);
+		goto out;
 #endif
 	/* We send these, we don't receive them */
 	case WIRE_CONNECTD_INIT_REPLY:
@@ -2103,6 +2126,7 @@ static struct io_plan *recv_req(struct io_conn *conn,
 	case WIRE_CONNECTD_PEER_SPOKE:
 	case WIRE_CONNECTD_CONNECT_FAILED:
 	case WIRE_CONNECTD_DEV_MEMLEAK_REPLY:
+	case WIRE_CONNECTD_DEV_PEER_WRITES_REPLY:
 	case WIRE_CONNECTD_PING_REPLY:
 	case WIRE_CONNECTD_GOT_ONIONMSG_TO_US:
 	case WIRE_CONNECTD_CUSTOMMSG_IN:
@@ -2184,7 +2208,8 @@ int main(int argc, char *argv[])
 	memleak_add_helper(daemon, memleak_daemon_cb);
 	list_head_init(&daemon->connecting);
 	timers_init(&daemon->timers, time_mono());
-	daemon->gossip_store_fd = -1;
+	daemon->gossip_store.fd = -1;
+	daemon->gossip_store.num_maps = 0;
 	daemon->shutting_down = false;
 
 	/* stdin == control */
@@ -10,6 +10,7 @@
 #include <common/node_id.h>
 #include <common/pseudorand.h>
 #include <common/wireaddr.h>
+#include <connectd/gossip_store.h>
 #include <connectd/handshake.h>
 
 struct io_conn;
@@ -75,8 +76,9 @@ struct peer {
 	/* Output buffer. */
 	struct msg_queue *peer_outq;
 
-	/* Peer sent buffer (for freeing after sending) */
-	const u8 *sent_to_peer;
+	/* Encrypted messages being written to peer (reused for each write) */
+	u8 *peer_out;
+	size_t peer_out_len;
 
 	/* We stream from the gossip_store for them, when idle */
 	struct gossip_state gs;
@@ -94,6 +96,8 @@ struct peer {
 	bool dev_read_enabled;
 	/* If non-NULL, this counts down; 0 means disable */
 	u32 *dev_writes_enabled;
+	/* How well are we coalescing writes? */
+	u64 dev_msgs_written, dev_writes;
 #endif
 };
 
@@ -182,8 +186,8 @@ struct daemon {
 	/* If non-zero, port to listen for websocket connections. */
 	u16 websocket_port;
 
-	/* The gossip_store */
-	int gossip_store_fd;
+	/* The gossip_store (fd is -1 until we need it) */
+	struct gossip_store_map gossip_store;
 	size_t gossip_store_end;
 	u32 gossip_recent_time;
 	size_t gossip_store_recent_off;
@@ -6,6 +6,8 @@
 #include <fcntl.h>
 #include <gossipd/gossip_store_wiregen.h>
 #include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wire/peer_wire.h>
 
@@ -23,28 +25,93 @@ static bool timestamp_filter(u32 timestamp_min, u32 timestamp_max,
 		&& timestamp <= timestamp_max;
 }
 
-static size_t reopen_gossip_store(int *gossip_store_fd, const u8 *msg)
+static void gossip_store_unmap(struct gossip_store_map *gsm)
+{
+	if (gsm->map)
+		munmap((void *)gsm->map, gsm->len);
+	gsm->map = NULL;
+	gsm->len = 0;
+}
+
+/* Map the whole file as it is now.  We never map past the end (touching
+ * that would SIGBUS), so when gossipd appends we have to remap. */
+static void gossip_store_remap(struct gossip_store_map *gsm)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(gsm->fd, &st) != 0)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "Cannot stat %s: %s",
+			      GOSSIP_STORE_FILENAME, strerror(errno));
+
+	/* It never shrinks (compaction makes a new file). */
+	if ((size_t)st.st_size <= gsm->len)
+		return;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, gsm->fd, 0);
+	if (map == MAP_FAILED)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "Cannot mmap %s (%zu bytes): %s",
+			      GOSSIP_STORE_FILENAME, (size_t)st.st_size,
+			      strerror(errno));
+	gossip_store_unmap(gsm);
+	gsm->map = map;
+	gsm->len = st.st_size;
+	gsm->num_maps++;
+}
+
+void gossip_store_map_open(struct gossip_store_map *gsm)
+{
+	gsm->fd = open(GOSSIP_STORE_FILENAME, O_RDONLY);
+	if (gsm->fd < 0)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "Opening gossip_store %s: %s",
+			      GOSSIP_STORE_FILENAME, strerror(errno));
+	gsm->map = NULL;
+	gsm->len = 0;
+	gossip_store_remap(gsm);
+}
+
+/* Pointer to len bytes at off, or NULL if they're not (all) there yet. */
+static const u8 *gossip_store_map_get(struct gossip_store_map *gsm,
+				      size_t off, size_t len)
+{
+	if (off + len > gsm->len) {
+		gossip_store_remap(gsm);
+		if (off + len > gsm->len)
+			return NULL;
+	}
+	return gsm->map + off;
+}
+
+/* The map may not be aligned for struct gossip_hdr, so copy it out. */
+static bool gossip_store_map_hdr(struct gossip_store_map *gsm, size_t off,
+				 struct gossip_hdr *hdr)
+{
+	const u8 *p = gossip_store_map_get(gsm, off, sizeof(*hdr));
+
+	if (!p)
+		return false;
+	memcpy(hdr, p, sizeof(*hdr));
+	return true;
+}
+
+static size_t reopen_gossip_store(struct gossip_store_map *gsm, const u8 *msg)
 {
 	u64 equivalent_offset;
-	int newfd;
 
 	if (!fromwire_gossip_store_ended(msg, &equivalent_offset))
 		status_failed(STATUS_FAIL_GOSSIP_IO,
 			      "Bad gossipd GOSSIP_STORE_ENDED msg: %s",
 			      tal_hex(tmpctx, msg));
 
-	newfd = open(GOSSIP_STORE_FILENAME, O_RDONLY);
-	if (newfd < 0)
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "Cannot open %s: %s",
-			      GOSSIP_STORE_FILENAME,
-			      strerror(errno));
-
 	status_debug("gossip_store at end, new fd moved to %"PRIu64,
 		     equivalent_offset);
 
-	close(*gossip_store_fd);
-	*gossip_store_fd = newfd;
+	gossip_store_unmap(gsm);
+	close(gsm->fd);
+	gossip_store_map_open(gsm);
 	return equivalent_offset;
 }
 
@@ -110,7 +177,7 @@ static bool public_msg_type(enum peer_wire type)
 }
 
 u8 *gossip_store_next(const tal_t *ctx,
-		      int *gossip_store_fd,
+		      struct gossip_store_map *gsm,
 		      u32 timestamp_min, u32 timestamp_max,
 		      bool with_spam,
 		      size_t *off, size_t *end)
@@ -123,10 +190,10 @@ u8 *gossip_store_next(const tal_t *ctx,
 		u16 msglen, flags;
 		u32 checksum, timestamp;
 		bool ratelimited;
-		int type, r;
+		const u8 *body;
+		int type;
 
-		r = pread(*gossip_store_fd, &hdr, sizeof(hdr), *off);
-		if (r != sizeof(hdr))
+		if (!gossip_store_map_hdr(gsm, *off, &hdr))
 			return NULL;
 
 		msglen = be16_to_cpu(hdr.len);
@@ -135,7 +202,7 @@ u8 *gossip_store_next(const tal_t *ctx,
 
 		/* Skip any deleted/dying entries. */
 		if (flags & (GOSSIP_STORE_DELETED_BIT|GOSSIP_STORE_DYING_BIT)) {
-			*off += r + msglen;
+			*off += sizeof(hdr) + msglen;
 			continue;
 		}
 
@@ -143,54 +210,66 @@ u8 *gossip_store_next(const tal_t *ctx,
 		timestamp = be32_to_cpu(hdr.timestamp);
 		if (!timestamp_filter(timestamp_min, timestamp_max,
 				      timestamp)) {
-			*off += r + msglen;
+			*off += sizeof(hdr) + msglen;
 			continue;
 		}
 
-		checksum = be32_to_cpu(hdr.crc);
-		msg = tal_arr(ctx, u8, msglen);
-		r = pread(*gossip_store_fd, msg, msglen, *off + r);
-		if (r != msglen)
-			return tal_free(msg);
+		body = gossip_store_map_get(gsm, *off + sizeof(hdr), msglen);
+		if (!body)
+			return NULL;
 
-		if (checksum != crc32c(be32_to_cpu(hdr.timestamp), msg, msglen))
+		checksum = be32_to_cpu(hdr.crc);
+		if (checksum != crc32c(be32_to_cpu(hdr.timestamp), body, msglen))
 			status_failed(STATUS_FAIL_INTERNAL_ERROR,
 				      "gossip_store: bad checksum at offset %zu"
 				      "(was at %zu): %s",
-				      *off, initial_off, tal_hex(tmpctx, msg));
+				      *off, initial_off,
+				      tal_hexstr(tmpctx, body, msglen));
 
 		/* Definitely processing it now */
 		*off += sizeof(hdr) + msglen;
 		if (*off > *end)
 			*end = *off;
 
-		type = fromwire_peektype(msg);
+		/* Look before we copy: most of what we skip is never sent. */
+		type = msglen >= sizeof(be16)
+			? ((int)body[0] << 8) | body[1] : -1;
+
 		/* end can go backwards in this case! */
 		if (type == WIRE_GOSSIP_STORE_ENDED) {
-			*off = *end = reopen_gossip_store(gossip_store_fd, msg);
-			msg = tal_free(msg);
+			*off = *end = reopen_gossip_store(gsm,
+							  tal_dup_arr(tmpctx, u8,
+								      body, msglen,
+								      0));
 		/* Ignore gossipd internal messages. */
 		} else if (!public_msg_type(type)) {
-			msg = tal_free(msg);
+			continue;
 		} else if (!with_spam && ratelimited) {
-			msg = tal_free(msg);
-		}
+			continue;
+		} else
+			msg = tal_dup_arr(ctx, u8, body, msglen, 0);
 	}
 
 	return msg;
 }
 
 /* Keep seeking forward until we hit something >= timestamp */
-size_t find_gossip_store_by_timestamp(int gossip_store_fd,
+size_t find_gossip_store_by_timestamp(struct gossip_store_map *gsm,
 				      size_t off,
 				      u32 timestamp)
 {
-	u16 type, flags;
-	u32 ts;
-	size_t msglen;
+	struct gossip_hdr hdr;
+
+	while (gossip_store_map_hdr(gsm, off, &hdr)) {
+		u16 flags = be16_to_cpu(hdr.flags), msglen = be16_to_cpu(hdr.len);
+		const u8 *body = gossip_store_map_get(gsm, off + sizeof(hdr),
+						      sizeof(be16));
+		int type;
+
+		if (!body)
+			break;
+		type = ((int)body[0] << 8) | body[1];
 
-	while (gossip_store_readhdr(gossip_store_fd, off,
-				    &msglen, &ts, &flags, &type)) {
 		/* Don't swallow end marker!  Reset, as they will call
 		 * gossip_store_next and reopen file. */
 		if (type == WIRE_GOSSIP_STORE_ENDED)
@@ -199,11 +278,29 @@ size_t find_gossip_store_by_timestamp(int gossip_store_fd,
 		/* Only to-be-broadcast types have valid timestamps! */
 		if (!(flags & GOSSIP_STORE_DELETED_BIT)
 		    && public_msg_type(type)
-		    && ts >= timestamp) {
+		    && be32_to_cpu(hdr.timestamp) >= timestamp) {
 			break;
 		}
 
-		off += sizeof(struct gossip_hdr) + msglen;
+		off += sizeof(hdr) + msglen;
+	}
+	return off;
+}
+
+size_t gossip_store_map_end(struct gossip_store_map *gsm, size_t off)
+{
+	struct gossip_hdr hdr;
+
+	while (gossip_store_map_hdr(gsm, off, &hdr)) {
+		const u8 *body = gossip_store_map_get(gsm, off + sizeof(hdr),
+						      sizeof(be16));
+
+		/* Don't swallow end marker! */
+		if (!body
+		    || (((int)body[0] << 8) | body[1]) == WIRE_GOSSIP_STORE_ENDED)
+			break;
+
+		off += sizeof(hdr) + be16_to_cpu(hdr.len);
 	}
 	return off;
 }
@@ -3,15 +3,32 @@
 #include "config.h"
 #include <common/gossip_store.h>
 
+/* The gossip_store, mapped read-only.  All peers' cursors (just offsets)
+ * walk this one mapping, so streaming to a peer costs no syscalls except
+ * when gossipd has appended and we need to remap. */
+struct gossip_store_map {
+	int fd;
+	/* The first len bytes of the file (NULL if len is 0). */
+	const u8 *map;
+	size_t len;
+	/* How many times we've (re)mapped: for benchmarking. */
+	size_t num_maps;
+};
+
+/**
+ * Open and map the gossip_store (fatal if that fails).
+ */
+void gossip_store_map_open(struct gossip_store_map *gsm);
+
 /**
  * Direct store accessor: loads gossip msg from store.
  *
  * Returns NULL if there are no more gossip msgs.
  * Updates *end if the known end of file has moved.
- * Updates *gossip_store_fd if file has been compacted.
+ * Reopens @gsm if file has been compacted.
  */
 u8 *gossip_store_next(const tal_t *ctx,
-		      int *gossip_store_fd,
+		      struct gossip_store_map *gsm,
 		      u32 timestamp_min, u32 timestamp_max,
 		      bool with_spam,
 		      size_t *off, size_t *end);
@@ -19,8 +36,15 @@ u8 *gossip_store_next(const tal_t *ctx,
 /**
  * Return offset of first entry >= this timestamp.
  */
-size_t find_gossip_store_by_timestamp(int gossip_store_fd,
+size_t find_gossip_store_by_timestamp(struct gossip_store_map *gsm,
 				      size_t off,
 				      u32 timestamp);
 
+/**
+ * Return offset of the end of the store, walking from @off.
+ *
+ * Like find_gossip_store_end(), but reads from the map.
+ */
+size_t gossip_store_map_end(struct gossip_store_map *gsm, size_t off);
+
 #endif /* LIGHTNING_CONNECTD_GOSSIP_STORE_H */
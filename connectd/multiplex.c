@@ -222,7 +222,7 @@ static void update_recent_timestamp(struct daemon *daemon)
 
 	daemon->gossip_recent_time = recent;
 	daemon->gossip_store_recent_off
-		= find_gossip_store_by_timestamp(daemon->gossip_store_fd,
+		= find_gossip_store_by_timestamp(&daemon->gossip_store,
 						 daemon->gossip_store_recent_off,
 						 daemon->gossip_recent_time);
 }
@@ -231,11 +231,7 @@ static void update_recent_timestamp(struct daemon *daemon)
  * since we start at the same time as gossipd itself. */
 static void setup_gossip_store(struct daemon *daemon)
 {
-	daemon->gossip_store_fd = open(GOSSIP_STORE_FILENAME, O_RDONLY);
-	if (daemon->gossip_store_fd < 0)
-		status_failed(STATUS_FAIL_INTERNAL_ERROR,
-			      "Opening gossip_store %s: %s",
-			      GOSSIP_STORE_FILENAME, strerror(errno));
+	gossip_store_map_open(&daemon->gossip_store);
 
 	daemon->gossip_recent_time = 0;
 	daemon->gossip_store_recent_off = 1;
@@ -244,8 +240,8 @@ static void setup_gossip_store(struct daemon *daemon)
 	/* gossipd will be writing to this, and it's not atomic!  Safest
 	 * way to find the "end" is to walk through. */
 	daemon->gossip_store_end
-		= find_gossip_store_end(daemon->gossip_store_fd,
-					daemon->gossip_store_recent_off);
+		= gossip_store_map_end(&daemon->gossip_store,
+				       daemon->gossip_store_recent_off);
 }
 
 void setup_peer_gossip_store(struct peer *peer,
@@ -253,7 +249,7 @@ void setup_peer_gossip_store(struct peer *peer,
 			     const u8 *their_features)
 {
 	/* Lazy setup */
-	if (peer->daemon->gossip_store_fd == -1)
+	if (peer->daemon->gossip_store.fd == -1)
 		setup_gossip_store(peer->daemon);
 
 	peer->gs.grf = new_gossip_rcvd_filter(peer);
@@ -294,8 +290,8 @@ void setup_peer_gossip_store(struct peer *peer,
 		/* During tests, particularly, we find that the gossip_store
 		 * moves fast, so make sure it really does start at the end. */
 		peer->gs.off
-			= find_gossip_store_end(peer->daemon->gossip_store_fd,
-						peer->daemon->gossip_store_end);
+			= gossip_store_map_end(&peer->daemon->gossip_store,
+					       peer->daemon->gossip_store_end);
 	}
 }
 
@@ -413,24 +409,36 @@ static struct io_plan *io_sock_shutdown_cb(struct io_conn *conn, struct peer *un
 	return io_sock_shutdown(conn);
 }
 
-static struct io_plan *encrypt_and_send(struct peer *peer,
-					const u8 *msg TAKES,
-					struct io_plan *(*next)
-					(struct io_conn *peer_conn,
-					 struct peer *peer))
+/* We pack as many queued messages as we can into one write, up to this.
+ * It's per-peer and kept between writes, so don't make it huge. */
+#define PEER_OUT_COALESCE_MAX 16384
+
+/* Encrypt msg onto the end of peer->peer_out.  Returns false if we
+ * shouldn't put anything else in this write. */
+static bool encrypt_and_append(struct peer *peer,
+			       const u8 *msg TAKES,
+			       bool *urgent,
+			       struct io_plan *(**next)
+			       (struct io_conn *peer_conn,
+				struct peer *peer))
 {
 	int type = fromwire_peektype(msg);
+	size_t len = tal_bytelen(msg);
+	bool more = true;
 
 #if DEVELOPER
 	switch (dev_disconnect(&peer->id, type)) {
 	case DEV_DISCONNECT_BEFORE:
+		/* Send what we have so far, then close. */
 		if (taken(msg))
 			tal_free(msg);
-		return io_close(peer->to_peer);
+		*next = (void *)io_close_cb;
+		return false;
 	case DEV_DISCONNECT_AFTER:
 		/* Disallow reads from now on */
 		peer->dev_read_enabled = false;
-		next = (void *)io_close_cb;
+		*next = (void *)io_close_cb;
+		more = false;
 		break;
 	case DEV_DISCONNECT_BLACKHOLE:
 		/* Disable both reads and writes from now on */
@@ -446,7 +454,9 @@ static struct io_plan *encrypt_and_send(struct peer *peer,
 		break;
 	}
 #endif
-	set_urgent_flag(peer, is_urgent(type));
+	/* If anything in this write is urgent, the whole write is. */
+	if (is_urgent(type))
+		*urgent = true;
 
 	/* BOLT #1:
 	 *
@@ -460,15 +470,24 @@ static struct io_plan *encrypt_and_send(struct peer *peer,
 			drain_peer(peer);
 
 		/* Close as soon as we've sent this. */
-		next = io_sock_shutdown_cb;
+		*next = io_sock_shutdown_cb;
+		more = false;
 	}
 
-	/* We free this and the encrypted version in next write_to_peer */
-	peer->sent_to_peer = cryptomsg_encrypt_msg(peer, &peer->cs, msg);
-	return io_write(peer->to_peer,
-			peer->sent_to_peer,
-			tal_bytelen(peer->sent_to_peer),
-			next, peer);
+	if (peer->peer_out_len + CRYPTOMSG_HDR_SIZE + len + CRYPTOMSG_BODY_OVERHEAD
+	    > tal_count(peer->peer_out)) {
+		if (!peer->peer_out)
+			peer->peer_out = tal_arr(peer, u8, 0);
+		tal_resize(&peer->peer_out,
+			   peer->peer_out_len + CRYPTOMSG_HDR_SIZE + len
+			   + CRYPTOMSG_BODY_OVERHEAD);
+	}
+	peer->peer_out_len += cryptomsg_encrypt_msg_into(&peer->cs, msg, len,
+							 peer->peer_out
+							 + peer->peer_out_len);
+	if (taken(msg))
+		tal_free(msg);
+	return more;
 }
 
 /* Kicks off write_to_peer() to look for more gossip to send from store */
@@ -514,7 +533,7 @@ static u8 *maybe_from_gossip_store(const tal_t *ctx, struct peer *peer)
 	assert(peer->gs.gossip_timer);
 
 again:
-	msg = gossip_store_next(ctx, &peer->daemon->gossip_store_fd,
+	msg = gossip_store_next(ctx, &peer->daemon->gossip_store,
 				peer->gs.timestamp_min,
 				peer->gs.timestamp_max,
 				false,
@@ -938,47 +957,70 @@ static void maybe_update_channelid(struct subd *subd, const u8 *msg)
 static struct io_plan *write_to_peer(struct io_conn *peer_conn,
 				     struct peer *peer)
 {
-	const u8 *msg;
+	struct io_plan *(*next)(struct io_conn *, struct peer *) = write_to_peer;
+	bool urgent = false;
+
 	assert(peer->to_peer == peer_conn);
 
-	/* Free last sent one (if any) */
-	peer->sent_to_peer = tal_free(peer->sent_to_peer);
+	/* Last write is done, so we can reuse the buffer */
+	peer->peer_out_len = 0;
 
-	/* Pop tail of send queue */
-	msg = msg_dequeue(peer->peer_outq);
+	/* Gossip bursts (and busy channels) queue up lots of small messages:
+	 * pack them into one write instead of doing one each. */
+	while (peer->peer_out_len < PEER_OUT_COALESCE_MAX) {
+		/* Pop tail of send queue */
+		const u8 *msg = msg_dequeue(peer->peer_outq);
+
+		/* If they want us to send gossip, do so when nothing else. */
+		if (!msg && !peer->draining)
+			msg = maybe_from_gossip_store(NULL, peer);
+		if (!msg)
+			break;
+
+		/* dev_disconnect can disable writes */
+#if DEVELOPER
+		if (peer->dev_writes_enabled) {
+			if (*peer->dev_writes_enabled == 0) {
+				/* Continue, to drain queue */
+				tal_free(msg);
+				continue;
+			}
+			(*peer->dev_writes_enabled)--;
+		}
+		peer->dev_msgs_written++;
+#endif
+		if (!encrypt_and_append(peer, take(msg), &urgent, &next))
+			break;
+	}
 
 	/* Still nothing to send? */
-	if (!msg) {
+	if (peer->peer_out_len == 0) {
+		/* dev_disconnect before the first message */
+		if (next != write_to_peer)
+			return io_close(peer_conn);
+
 		/* Draining?  We're done when subds are done. */
 		if (peer->draining && tal_count(peer->subds) == 0)
 			return io_sock_shutdown(peer_conn);
 
-		/* If they want us to send gossip, do so now. */
-		if (!peer->draining)
-			msg = maybe_from_gossip_store(NULL, peer);
-		if (!msg) {
-			/* Tell them to read again, */
-			io_wake(&peer->subds);
+		/* Don't hang onto a huge buffer while idle */
+		if (tal_count(peer->peer_out) > 2 * PEER_OUT_COALESCE_MAX)
+			peer->peer_out = tal_free(peer->peer_out);
 
-			/* Wait for them to wake us */
-			return msg_queue_wait(peer_conn, peer->peer_outq,
-					      write_to_peer, peer);
-		}
+		/* Tell them to read again, */
+		io_wake(&peer->subds);
+
+		/* Wait for them to wake us */
+		return msg_queue_wait(peer_conn, peer->peer_outq,
+				      write_to_peer, peer);
 	}
 
-	/* dev_disconnect can disable writes */
 #if DEVELOPER
-	if (peer->dev_writes_enabled) {
-		if (*peer->dev_writes_enabled == 0) {
-			tal_free(msg);
-			/* Continue, to drain queue */
-			return write_to_peer(peer_conn, peer);
-		}
-		(*peer->dev_writes_enabled)--;
-	}
+	peer->dev_writes++;
 #endif
-
-	return encrypt_and_send(peer, take(msg), write_to_peer);
+	set_urgent_flag(peer, urgent);
+	return io_write(peer_conn, peer->peer_out, peer->peer_out_len,
+			next, peer);
 }
 
 static struct io_plan *read_from_subd(struct io_conn *subd_conn,
@@ -1206,6 +1248,11 @@ static void destroy_peer_conn(struct io_conn *peer_conn, struct peer *peer)
 {
 	assert(peer->to_peer == peer_conn);
 
+#if DEVELOPER
+	status_peer_debug(&peer->id, "Wrote %"PRIu64" messages in %"PRIu64" writes",
+			  peer->dev_msgs_written, peer->dev_writes);
+#endif
+
 	/* If subds need cleaning, this will do it */
 	if (!peer->draining)
 		drain_peer(peer);
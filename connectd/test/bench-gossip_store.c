@@ -0,0 +1,172 @@
+#include "config.h"
+/* Streaming the gossip_store to many peers: the shared map against two
+ * preads per record. */
+#include "../gossip_store.c"
+#include <ccan/err/err.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <common/setup.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fromwire_gossip_store_ended */
+bool fromwire_gossip_store_ended(const void *p UNNEEDED, u64 *equivalent_offset UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_store_ended called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for status_fmt */
+void status_fmt(enum log_level level UNNEEDED,
+		const struct node_id *peer UNNEEDED,
+		const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_fmt called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+/* Roughly a channel_update */
+#define RECORD_LEN 136
+
+static void write_store(size_t num_records)
+{
+	int fd = open(GOSSIP_STORE_FILENAME, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	/* We don't check the version. */
+	u8 version = 11;
+
+	if (fd < 0)
+		err(1, "Creating %s", GOSSIP_STORE_FILENAME);
+	if (!write_all(fd, &version, sizeof(version)))
+		err(1, "Writing version");
+
+	for (size_t i = 0; i < num_records; i++) {
+		struct gossip_hdr hdr;
+		u8 msg[RECORD_LEN];
+		u32 timestamp = 1690000000 + i;
+
+		for (size_t j = 0; j < sizeof(msg); j++)
+			msg[j] = random();
+		/* Every tenth is something we don't send. */
+		if (i % 10 == 0) {
+			msg[0] = WIRE_GOSSIP_STORE_CHANNEL_AMOUNT >> 8;
+			msg[1] = WIRE_GOSSIP_STORE_CHANNEL_AMOUNT & 0xFF;
+		} else {
+			msg[0] = WIRE_CHANNEL_UPDATE >> 8;
+			msg[1] = WIRE_CHANNEL_UPDATE & 0xFF;
+		}
+		hdr.flags = cpu_to_be16(0);
+		hdr.len = cpu_to_be16(sizeof(msg));
+		hdr.timestamp = cpu_to_be32(timestamp);
+		hdr.crc = cpu_to_be32(crc32c(timestamp, msg, sizeof(msg)));
+		if (!write_all(fd, &hdr, sizeof(hdr))
+		    || !write_all(fd, msg, sizeof(msg)))
+			err(1, "Writing record");
+	}
+	close(fd);
+}
+
+/* What gossip_store_next used to do. */
+static u8 *pread_next(const tal_t *ctx, int fd, size_t *off,
+		      size_t *num_syscalls)
+{
+	u8 *msg = NULL;
+
+	while (!msg) {
+		struct gossip_hdr hdr;
+		u16 msglen;
+		int r;
+
+		(*num_syscalls)++;
+		r = pread(fd, &hdr, sizeof(hdr), *off);
+		if (r != sizeof(hdr))
+			return NULL;
+
+		msglen = be16_to_cpu(hdr.len);
+		msg = tal_arr(ctx, u8, msglen);
+		(*num_syscalls)++;
+		r = pread(fd, msg, msglen, *off + r);
+		if (r != msglen)
+			return tal_free(msg);
+		if (be32_to_cpu(hdr.crc)
+		    != crc32c(be32_to_cpu(hdr.timestamp), msg, msglen))
+			errx(1, "Bad checksum at %zu", *off);
+
+		*off += sizeof(hdr) + msglen;
+		if (!public_msg_type(fromwire_peektype(msg)))
+			msg = tal_free(msg);
+	}
+	return msg;
+}
+
+static u64 cpu_usec(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ULL
+		+ ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+int main(int argc, char *argv[])
+{
+	char tmpdir[] = "/tmp/bench-gossip_store.XXXXXX";
+	size_t num_records = 500000, num_peers = 100;
+	size_t num_msgs, num_syscalls;
+	struct gossip_store_map gsm;
+	u64 start;
+	int fd;
+
+	common_setup(argv[0]);
+	srandom(1);
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<num-records> [<num-peers>]]", argv[0]);
+	if (argc > 1)
+		num_records = atol(argv[1]);
+	if (argc > 2)
+		num_peers = atol(argv[2]);
+
+	if (!mkdtemp(tmpdir) || chdir(tmpdir) != 0)
+		err(1, "Making temporary directory");
+	write_store(num_records);
+
+	/* Each peer has its own cursor, all sharing the one map. */
+	gsm.num_maps = 0;
+	gossip_store_map_open(&gsm);
+	num_msgs = 0;
+	start = cpu_usec();
+	for (size_t p = 0; p < num_peers; p++) {
+		size_t off = 1, end = 1;
+		u8 *msg;
+
+		while ((msg = gossip_store_next(tmpctx, &gsm, 0, UINT32_MAX,
+						false, &off, &end)) != NULL) {
+			num_msgs++;
+			tal_free(msg);
+		}
+	}
+	printf("# mmap: %zu msgs to %zu peers, %"PRIu64" usec CPU per stream, %zu maps\n",
+	       num_msgs, num_peers, (cpu_usec() - start) / num_peers,
+	       gsm.num_maps);
+
+	fd = open(GOSSIP_STORE_FILENAME, O_RDONLY);
+	num_msgs = num_syscalls = 0;
+	start = cpu_usec();
+	for (size_t p = 0; p < num_peers; p++) {
+		size_t off = 1;
+		u8 *msg;
+
+		while ((msg = pread_next(tmpctx, fd, &off, &num_syscalls)) != NULL) {
+			num_msgs++;
+			tal_free(msg);
+		}
+	}
+	printf("# pread: %zu msgs to %zu peers, %"PRIu64" usec CPU per stream, %zu syscalls per stream\n",
+	       num_msgs, num_peers, (cpu_usec() - start) / num_peers,
+	       num_syscalls / num_peers);
+	close(fd);
+
+	unlink(GOSSIP_STORE_FILENAME);
+	if (chdir("/") != 0 || rmdir(tmpdir) != 0)
+		warn("Removing %s", tmpdir);
+	common_shutdown();
+	return 0;
+}
@@ -0,0 +1,169 @@
+#include "config.h"
+#include "../gossip_store.c"
+#include <assert.h>
+#include <ccan/array_size/array_size.h>
+#include <ccan/read_write_all/read_write_all.h>
+#include <common/setup.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fromwire_gossip_store_ended */
+bool fromwire_gossip_store_ended(const void *p UNNEEDED, u64 *equivalent_offset UNNEEDED)
+{ fprintf(stderr, "fromwire_gossip_store_ended called!\n"); abort(); }
+/* Generated stub for status_failed */
+void status_failed(enum status_failreason code UNNEEDED,
+		   const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_failed called!\n"); abort(); }
+/* Generated stub for status_fmt */
+void status_fmt(enum log_level level UNNEEDED,
+		const struct node_id *peer UNNEEDED,
+		const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "status_fmt called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static const struct record {
+	int type;
+	u32 timestamp;
+	u16 flags;
+} records[] = {
+	{ WIRE_CHANNEL_ANNOUNCEMENT, 100, 0 },
+	{ WIRE_GOSSIP_STORE_CHANNEL_AMOUNT, 0, 0 },
+	{ WIRE_CHANNEL_UPDATE, 200, GOSSIP_STORE_DELETED_BIT },
+	{ WIRE_CHANNEL_UPDATE, 300, GOSSIP_STORE_RATELIMIT_BIT },
+	{ WIRE_NODE_ANNOUNCEMENT, 400, 0 },
+	{ WIRE_CHANNEL_UPDATE, 500, GOSSIP_STORE_DYING_BIT },
+	{ WIRE_CHANNEL_UPDATE, 600, 0 },
+};
+
+/* Where each record starts. */
+static size_t offsets[ARRAY_SIZE(records) + 1];
+
+static u8 *record_msg(const tal_t *ctx, size_t i)
+{
+	u8 *msg = tal_arr(ctx, u8, 20 + i);
+
+	memset(msg, i, tal_bytelen(msg));
+	msg[0] = records[i].type >> 8;
+	msg[1] = records[i].type;
+	return msg;
+}
+
+static u8 *record_bytes(const tal_t *ctx, size_t i)
+{
+	struct gossip_hdr hdr;
+	u8 *msg = record_msg(tmpctx, i), *bytes;
+
+	hdr.flags = cpu_to_be16(records[i].flags);
+	hdr.len = cpu_to_be16(tal_bytelen(msg));
+	hdr.timestamp = cpu_to_be32(records[i].timestamp);
+	hdr.crc = cpu_to_be32(crc32c(records[i].timestamp,
+				     msg, tal_bytelen(msg)));
+	bytes = tal_dup_arr(ctx, u8, (u8 *)&hdr, sizeof(hdr), tal_bytelen(msg));
+	memcpy(bytes + sizeof(hdr), msg, tal_bytelen(msg));
+	return bytes;
+}
+
+/* Writes the first @num records. */
+static int write_store(size_t num)
+{
+	int fd = open(GOSSIP_STORE_FILENAME, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	u8 version = 11;
+
+	assert(fd >= 0);
+	assert(write_all(fd, &version, sizeof(version)));
+	offsets[0] = sizeof(version);
+	for (size_t i = 0; i < num; i++) {
+		u8 *bytes = record_bytes(tmpctx, i);
+		assert(write_all(fd, bytes, tal_bytelen(bytes)));
+		offsets[i + 1] = offsets[i] + tal_bytelen(bytes);
+	}
+	return fd;
+}
+
+/* Stream the whole store, and check we get exactly @expect. */
+static void check_stream(struct gossip_store_map *gsm,
+			 u32 timestamp_min, u32 timestamp_max,
+			 bool with_spam,
+			 const size_t *expect, size_t num_expect)
+{
+	size_t off = 1, end = 1, n = 0;
+	u8 *msg;
+
+	while ((msg = gossip_store_next(tmpctx, gsm,
+					timestamp_min, timestamp_max,
+					with_spam, &off, &end)) != NULL) {
+		u8 *exp;
+
+		assert(n < num_expect);
+		exp = record_msg(tmpctx, expect[n]);
+		assert(tal_bytelen(msg) == tal_bytelen(exp));
+		assert(memcmp(msg, exp, tal_bytelen(exp)) == 0);
+		n++;
+	}
+	assert(n == num_expect);
+}
+
+int main(int argc, char *argv[])
+{
+	char tmpdir[] = "/tmp/run-gossip_store.XXXXXX";
+	struct gossip_store_map gsm;
+	size_t last = ARRAY_SIZE(records) - 1, off, end;
+	u8 *bytes;
+	int fd;
+
+	common_setup(argv[0]);
+
+	assert(mkdtemp(tmpdir) && chdir(tmpdir) == 0);
+
+	/* Everything but the last record, to start with. */
+	fd = write_store(last);
+	gossip_store_map_open(&gsm);
+	assert(gsm.num_maps == 1);
+
+	/* Deleted, dying and internal records are never sent; ratelimited
+	 * ones only if they asked for spam. */
+	check_stream(&gsm, 0, UINT32_MAX, false, (size_t[]){0, 4}, 2);
+	check_stream(&gsm, 0, UINT32_MAX, true, (size_t[]){0, 3, 4}, 3);
+	check_stream(&gsm, 250, 450, true, (size_t[]){3, 4}, 2);
+	check_stream(&gsm, 450, UINT32_MAX, true, NULL, 0);
+	assert(gsm.num_maps == 1);
+
+	assert(find_gossip_store_by_timestamp(&gsm, 1, 0) == offsets[0]);
+	assert(find_gossip_store_by_timestamp(&gsm, 1, 150) == offsets[3]);
+	assert(find_gossip_store_by_timestamp(&gsm, 1, 350) == offsets[4]);
+	/* (It doesn't care that it's dying.) */
+	assert(find_gossip_store_by_timestamp(&gsm, 1, 450) == offsets[5]);
+	assert(find_gossip_store_by_timestamp(&gsm, 1, 550) == offsets[last]);
+	assert(gossip_store_map_end(&gsm, 1) == offsets[last]);
+
+	/* gossipd appends the last record in two writes: we mustn't read
+	 * the partial record. */
+	off = end = offsets[last];
+	bytes = record_bytes(tmpctx, last);
+	offsets[last + 1] = offsets[last] + tal_bytelen(bytes);
+	assert(write_all(fd, bytes, sizeof(struct gossip_hdr) + 1));
+	assert(!gossip_store_next(tmpctx, &gsm, 0, UINT32_MAX, false,
+				  &off, &end));
+	assert(off == offsets[last] && end == offsets[last]);
+	assert(gossip_store_map_end(&gsm, 1) == offsets[last]);
+
+	assert(write_all(fd, bytes + sizeof(struct gossip_hdr) + 1,
+			 tal_bytelen(bytes) - sizeof(struct gossip_hdr) - 1));
+	bytes = gossip_store_next(tmpctx, &gsm, 0, UINT32_MAX, false,
+				  &off, &end);
+	assert(bytes);
+	assert(tal_bytelen(bytes) == tal_bytelen(record_msg(tmpctx, last)));
+	assert(off == offsets[last + 1] && end == offsets[last + 1]);
+	assert(gsm.num_maps > 1);
+
+	check_stream(&gsm, 0, UINT32_MAX, false, (size_t[]){0, 4, last}, 3);
+	assert(gossip_store_map_end(&gsm, 1) == offsets[last + 1]);
+
+	close(fd);
+	gossip_store_unmap(&gsm);
+	close(gsm.fd);
+	unlink(GOSSIP_STORE_FILENAME);
+	assert(chdir("/") == 0 && rmdir(tmpdir) == 0);
+	common_shutdown();
+	return 0;
+}
@@ -901,14 +901,16 @@ class LightningRpc(UnixDomainSocketRpc):
         return res.get("peers") and res["peers"][0] or None
 
     def getroute(self, node_id, amount_msat=None, riskfactor=None, cltv=9, fromid=None,
-                 fuzzpercent=None, exclude=None, maxhops=None, msatoshi=None):
+                 fuzzpercent=None, exclude=None, maxhops=None, msatoshi=None,
+                 guided=None):
         """
         Show route to {id} for {amount_msat}, using {riskfactor} and optional
         {cltv} (default 9). If specified search from {fromid} otherwise use
         this node as source. Randomize the route with up to {fuzzpercent}
         (0.0 -> 100.0, default 5.0). {exclude} is an optional array of
         scid/direction or node-id to exclude. Limit the number of hops in the
-        route to {maxhops}.
+        route to {maxhops}. If {guided}, use landmarks to steer the
+        shortest-route fallback.
         """
         if msatoshi:
             amount_msat = msatoshi
@@ -925,7 +927,8 @@ class LightningRpc(UnixDomainSocketRpc):
             "fromid": fromid,
             "fuzzpercent": fuzzpercent,
             "exclude": exclude,
-            "maxhops": maxhops
+            "maxhops": maxhops,
+            "guided": guided,
         }
         return self.call("getroute", payload)
 
@@ -33,6 +33,9 @@ struct db {
 	char *filename;
 	const char *in_transaction;
 
+	/* Should the driver write its backup (if any) asynchronously? */
+	bool backup_async;
+
 	/* DB-specific context */
 	void *conn;
 
@@ -61,6 +64,10 @@ struct db {
 	u32 data_version;
 
 	void (*report_changes_fn)(struct db *);
+
+	/* Prepared statement cache statistics: a hit means we reused a
+	 * statement the backend had already prepared for this query. */
+	u64 stmt_cache_hits, stmt_cache_misses;
 };
 
 struct db_query {
@@ -113,6 +120,10 @@ struct db_stmt {
 	/* Which SQL statement are we trying to execute? */
 	const struct db_query *query;
 
+	/* Index of query in db->queries->query_table, or -1 for untranslated
+	 * queries.  Backends use this to cache prepared statements. */
+	int query_idx;
+
 	/* Which parameters are we binding to the statement? */
 	struct db_binding *bindings;
 
@@ -183,6 +194,10 @@ struct db_config {
 
 	bool (*vacuum_fn)(struct db *db);
 
+	/* Optional: forget any cached prepared statements, since the schema
+	 * may have changed under them. */
+	void (*stmt_cache_flush_fn)(struct db *db);
+
 	bool (*rename_column)(struct db *db,
 			      const char *tablename,
 			      const char *from, const char *to);
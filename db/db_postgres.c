@@ -14,6 +14,24 @@
 #define INT4OID			23
 #define TEXTOID			25
 
+/* A server-side prepared statement, named "cln_q<query_idx>". */
+struct db_postgres_prepared {
+	/* The parameter types it was prepared with. */
+	Oid *types;
+};
+
+struct db_postgres {
+	PGconn *conn;
+	/* Indexed by db_stmt->query_idx: NULL if not prepared yet. */
+	struct db_postgres_prepared **prepared;
+};
+
+static inline PGconn *conn2pg(void *conn)
+{
+	struct db_postgres *wrapper = (struct db_postgres *)conn;
+	return wrapper->conn;
+}
+
 static bool db_postgres_setup(struct db *db)
 {
 	size_t prefix_len = strlen("postgres://");
@@ -27,19 +45,23 @@ static bool db_postgres_setup(struct db *db)
 	result is discarded again immediately. */
 	PQconninfoOption *info =
 	    PQconninfoParse(db->filename + prefix_len, NULL);
+	struct db_postgres *wrapper = tal(db, struct db_postgres);
 
 	if (info != NULL) {
 		PQconninfoFree(info);
-		db->conn = PQconnectdb(db->filename + prefix_len);
+		wrapper->conn = PQconnectdb(db->filename + prefix_len);
 	} else {
-		db->conn = PQconnectdb(db->filename);
+		wrapper->conn = PQconnectdb(db->filename);
 	}
 
-	if (PQstatus(db->conn) != CONNECTION_OK) {
-		db->error = tal_fmt(db, "Could not connect to %s: %s", db->filename, PQerrorMessage(db->conn));
-		db->conn = NULL;
+	if (PQstatus(wrapper->conn) != CONNECTION_OK) {
+		db->error = tal_fmt(db, "Could not connect to %s: %s", db->filename, PQerrorMessage(wrapper->conn));
+		db->conn = tal_free(wrapper);
 		return false;
 	}
+	wrapper->prepared = tal_arrz(wrapper, struct db_postgres_prepared *,
+				     db->queries->query_table_size);
+	db->conn = wrapper;
 	return true;
 }
 
@@ -47,10 +69,10 @@ static bool db_postgres_begin_tx(struct db *db)
 {
 	assert(db->conn);
 	PGresult *res;
-	res = PQexec(db->conn, "BEGIN;");
+	res = PQexec(conn2pg(db->conn), "BEGIN;");
 	if (PQresultStatus(res) != PGRES_COMMAND_OK) {
 		db->error = tal_fmt(db, "BEGIN command failed: %s",
-				    PQerrorMessage(db->conn));
+				    PQerrorMessage(conn2pg(db->conn)));
 		PQclear(res);
 		return false;
 	}
@@ -62,10 +84,10 @@ static bool db_postgres_commit_tx(struct db *db)
 {
 	assert(db->conn);
 	PGresult *res;
-	res = PQexec(db->conn, "COMMIT;");
+	res = PQexec(conn2pg(db->conn), "COMMIT;");
 	if (PQresultStatus(res) != PGRES_COMMAND_OK) {
 		db->error = tal_fmt(db, "COMMIT command failed: %s",
-				    PQerrorMessage(db->conn));
+				    PQerrorMessage(conn2pg(db->conn)));
 		PQclear(res);
 		return false;
 	}
@@ -73,6 +95,119 @@ static bool db_postgres_commit_tx(struct db *db)
 	return true;
 }
 
+static const char *prepared_name(const tal_t *ctx, int query_idx)
+{
+	return tal_fmt(ctx, "cln_q%i", query_idx);
+}
+
+/* A NULL binding has type 0: it goes with whatever type the slot was
+ * prepared with. */
+static bool types_compatible(const Oid *prepared, const Oid *types, int slots)
+{
+	for (int i = 0; i < slots; i++) {
+		if (types[i] != 0 && types[i] != prepared[i])
+			return false;
+	}
+	return true;
+}
+
+/* If it was prepared with a NULL in a slot we now have a type for, the
+ * server had to guess that type: we can prepare it again with ours. */
+static bool types_refine(const Oid *prepared, const Oid *types, int slots)
+{
+	for (int i = 0; i < slots; i++) {
+		if (prepared[i] != 0 && types[i] != 0 && types[i] != prepared[i])
+			return false;
+	}
+	return true;
+}
+
+static PGresult *db_postgres_prepare(struct db_stmt *stmt,
+				     int slots,
+				     const Oid *paramTypes)
+{
+	struct db_postgres *wrapper = stmt->db->conn;
+	struct db_postgres_prepared *prep;
+	PGresult *res;
+
+	res = PQprepare(wrapper->conn,
+			prepared_name(tmpctx, stmt->query_idx),
+			stmt->query->query, slots, paramTypes);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		return res;
+	PQclear(res);
+
+	prep = tal(wrapper->prepared, struct db_postgres_prepared);
+	prep->types = tal_dup_arr(prep, Oid, paramTypes, slots, 0);
+	wrapper->prepared[stmt->query_idx] = prep;
+	return NULL;
+}
+
+/* We prepare each query server-side the first time we see it, so the
+ * server only parses and plans it once.  The parameter types are fixed
+ * at that point, so a call binding really different types (e.g. text
+ * where we previously had an integer) just doesn't use the prepared
+ * statement. */
+static PGresult *db_postgres_exec_cached(struct db_stmt *stmt,
+					 int slots,
+					 const Oid *paramTypes,
+					 const char * const *paramValues,
+					 const int *paramLengths,
+					 const int *paramFormats,
+					 int resultFormat)
+{
+	struct db_postgres *wrapper = stmt->db->conn;
+	struct db_postgres_prepared *prep;
+	PGresult *res;
+
+	if (stmt->query_idx < 0)
+		goto uncached;
+
+	prep = wrapper->prepared[stmt->query_idx];
+	if (prep && !types_compatible(prep->types, paramTypes, slots)) {
+		Oid types[slots];
+
+		if (!types_refine(prep->types, paramTypes, slots)) {
+			stmt->db->stmt_cache_misses++;
+			goto uncached;
+		}
+
+		/* Keep the types it already had where we have a NULL. */
+		for (int i = 0; i < slots; i++)
+			types[i] = paramTypes[i] ? paramTypes[i] : prep->types[i];
+
+		res = PQexec(wrapper->conn,
+			     tal_fmt(tmpctx, "DEALLOCATE %s;",
+				     prepared_name(tmpctx, stmt->query_idx)));
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			return res;
+		PQclear(res);
+		wrapper->prepared[stmt->query_idx] = tal_free(prep);
+
+		/* Caller will report the error, just as if we'd executed. */
+		res = db_postgres_prepare(stmt, slots, types);
+		if (res)
+			return res;
+		stmt->db->stmt_cache_misses++;
+	} else if (!prep) {
+		res = db_postgres_prepare(stmt, slots, paramTypes);
+		if (res)
+			return res;
+		stmt->db->stmt_cache_misses++;
+	} else
+		stmt->db->stmt_cache_hits++;
+
+	return PQexecPrepared(wrapper->conn,
+			      prepared_name(tmpctx, stmt->query_idx),
+			      slots, paramValues, paramLengths, paramFormats,
+			      resultFormat);
+
+uncached:
+	return PQexecParams(wrapper->conn, stmt->query->query, slots,
+			    paramTypes, paramValues, paramLengths, paramFormats,
+			    resultFormat);
+}
+
 static PGresult *db_postgres_do_exec(struct db_stmt *stmt)
 {
 	int slots = stmt->query->placeholders;
@@ -129,9 +264,9 @@ static PGresult *db_postgres_do_exec(struct db_stmt *stmt)
 			break;
 		}
 	}
-	return PQexecParams(stmt->db->conn, stmt->query->query, slots,
-			    paramTypes, paramValues, paramLengths, paramFormats,
-			    resultFormat);
+	return db_postgres_exec_cached(stmt, slots, paramTypes, paramValues,
+				       paramLengths, paramFormats,
+				       resultFormat);
 }
 
 static bool db_postgres_query(struct db_stmt *stmt)
@@ -141,7 +276,7 @@ static bool db_postgres_query(struct db_stmt *stmt)
 	res = PQresultStatus(stmt->inner_stmt);
 
 	if (res != PGRES_EMPTY_QUERY && res != PGRES_TUPLES_OK) {
-		stmt->error = PQerrorMessage(stmt->db->conn);
+		stmt->error = PQerrorMessage(conn2pg(stmt->db->conn));
 		PQclear(stmt->inner_stmt);
 		stmt->inner_stmt = NULL;
 		return false;
@@ -227,14 +362,14 @@ static bool db_postgres_exec(struct db_stmt *stmt)
 	ok = PQresultStatus(stmt->inner_stmt) == PGRES_COMMAND_OK;
 
 	if (!ok)
-		stmt->error = PQerrorMessage(stmt->db->conn);
+		stmt->error = PQerrorMessage(conn2pg(stmt->db->conn));
 
 	return ok;
 }
 
 static u64 db_postgres_last_insert_id(struct db_stmt *stmt)
 {
-	PGresult *res = PQexec(stmt->db->conn, "SELECT lastval()");
+	PGresult *res = PQexec(conn2pg(stmt->db->conn), "SELECT lastval()");
 	int id = atoi(PQgetvalue(res, 0, 0));
 	PQclear(res);
 	return id;
@@ -247,6 +382,21 @@ static size_t db_postgres_count_changes(struct db_stmt *stmt)
 	return atoi(count);
 }
 
+static void db_postgres_stmt_cache_flush(struct db *db)
+{
+	struct db_postgres *wrapper = db->conn;
+	PGresult *res;
+
+	res = PQexec(wrapper->conn, "DEALLOCATE ALL;");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		db_fatal(db, "DEALLOCATE command failed: %s",
+			 PQerrorMessage(wrapper->conn));
+	PQclear(res);
+
+	for (size_t i = 0; i < tal_count(wrapper->prepared); i++)
+		wrapper->prepared[i] = tal_free(wrapper->prepared[i]);
+}
+
 static void db_postgres_teardown(struct db *db)
 {
 }
@@ -262,10 +412,10 @@ static bool db_postgres_vacuum(struct db *db)
 		return true;
 #endif
 
-	res = PQexec(db->conn, "VACUUM FULL;");
+	res = PQexec(conn2pg(db->conn), "VACUUM FULL;");
 	if (PQresultStatus(res) != PGRES_COMMAND_OK) {
 		db->error = tal_fmt(db, "VACUUM command failed: %s",
-				    PQerrorMessage(db->conn));
+				    PQerrorMessage(conn2pg(db->conn)));
 		PQclear(res);
 		return false;
 	}
@@ -324,6 +474,7 @@ struct db_config db_postgres_config = {
     .setup_fn = db_postgres_setup,
     .teardown_fn = db_postgres_teardown,
     .vacuum_fn = db_postgres_vacuum,
+    .stmt_cache_flush_fn = db_postgres_stmt_cache_flush,
     .rename_column = db_postgres_rename_column,
     .delete_columns = db_postgres_delete_columns,
 };
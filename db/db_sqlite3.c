@@ -7,13 +7,47 @@
 #include <db/utils.h>
 
 #if HAVE_SQLITE3
+  #include <pthread.h>
   #include <sqlite3.h>
 
+/* A whole transaction for the backup, as a single SQL script. */
+struct backup_batch {
+	struct backup_batch *next;
+	char sql[];
+};
+
+/* With --wallet-backup-async, we hand batches to this thread.  It shares
+ * nothing with the rest of lightningd but this (and backup_conn), so
+ * it only uses malloc/free, never tal. */
+struct backup_writer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	/* Signalled when a batch is queued, or we're told to stop. */
+	pthread_cond_t work;
+	/* Signalled when the writer goes idle. */
+	pthread_cond_t idle;
+	/* Oldest first. */
+	struct backup_batch *head, **tail;
+	bool busy, stopping;
+	/* The first failure, if any (malloc'ed). */
+	char *error;
+	sqlite3 *backup_conn;
+};
+
 struct db_sqlite3 {
 	/* The actual db connection.  */
 	sqlite3 *conn;
 	/* A replica db connection, if requested, or NULL otherwise.  */
 	sqlite3 *backup_conn;
+	/* Statements in the current transaction, replayed to the backup
+	 * in one go once the main db has committed.  NULL outside a
+	 * transaction. */
+	const char **backup_batch;
+	/* Writes to backup_conn from a separate thread, if non-NULL. */
+	struct backup_writer *writer;
+	/* Reset, unbound statements ready for reuse, indexed by
+	 * db_stmt->query_idx.  A statement is taken out while in use. */
+	sqlite3_stmt **stmt_cache;
 };
 
 /**
@@ -28,6 +62,152 @@ sqlite3 *conn2sql(void *conn)
 	return wrapper->conn;
 }
 
+/* Returns an error message (sqlite3_malloc'ed), or NULL. */
+static char *exec_backup_batch(sqlite3 *backup_conn, const char *sql)
+{
+	char *errmsg;
+
+	if (sqlite3_exec(backup_conn, sql, NULL, NULL, &errmsg) == SQLITE_OK)
+		return NULL;
+
+	/* Don't leave a half-applied transaction open. */
+	sqlite3_exec(backup_conn, "ROLLBACK;", NULL, NULL, NULL);
+	return errmsg;
+}
+
+static void *backup_writer_loop(void *arg)
+{
+	struct backup_writer *w = arg;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		struct backup_batch *b;
+		char *errmsg;
+
+		while (!w->head && !w->stopping)
+			pthread_cond_wait(&w->work, &w->lock);
+		if (!w->head)
+			break;
+
+		b = w->head;
+		w->head = b->next;
+		if (!w->head)
+			w->tail = &w->head;
+		w->busy = true;
+		pthread_mutex_unlock(&w->lock);
+
+		/* Once we've failed, the backup is useless: main thread
+		 * will notice and die, so don't make it worse.  (Only we
+		 * ever set w->error, so no lock needed to read it.) */
+		errmsg = w->error ? NULL : exec_backup_batch(w->backup_conn,
+							     b->sql);
+		free(b);
+
+		pthread_mutex_lock(&w->lock);
+		if (errmsg) {
+			w->error = strdup(errmsg);
+			sqlite3_free(errmsg);
+		}
+		w->busy = false;
+		if (!w->head)
+			pthread_cond_broadcast(&w->idle);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+static void backup_writer_check(const struct db *db,
+				struct backup_writer *w)
+{
+	pthread_mutex_lock(&w->lock);
+	if (w->error) {
+		char *error = tal_strdup(tmpctx, w->error);
+		pthread_mutex_unlock(&w->lock);
+		db_fatal(db, "Failed to replicate to backup: %s", error);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* Wait until everything queued has been written. */
+static void backup_writer_drain(const struct db *db,
+				struct backup_writer *w)
+{
+	pthread_mutex_lock(&w->lock);
+	while (w->head || w->busy)
+		pthread_cond_wait(&w->idle, &w->lock);
+	pthread_mutex_unlock(&w->lock);
+	backup_writer_check(db, w);
+}
+
+static void backup_writer_push(const struct db *db,
+			       struct backup_writer *w,
+			       const char *sql)
+{
+	size_t len = strlen(sql) + 1;
+	struct backup_batch *b = malloc(sizeof(*b) + len);
+
+	if (!b)
+		db_fatal(db, "Out of memory queueing backup batch");
+	b->next = NULL;
+	memcpy(b->sql, sql, len);
+
+	backup_writer_check(db, w);
+
+	pthread_mutex_lock(&w->lock);
+	*w->tail = b;
+	w->tail = &b->next;
+	pthread_cond_signal(&w->work);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static struct backup_writer *backup_writer_start(const struct db *db,
+						 sqlite3 *backup_conn)
+{
+	struct backup_writer *w = malloc(sizeof(*w));
+	int err;
+
+	if (!w)
+		db_fatal(db, "Out of memory starting backup writer");
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->work, NULL);
+	pthread_cond_init(&w->idle, NULL);
+	w->head = NULL;
+	w->tail = &w->head;
+	w->busy = w->stopping = false;
+	w->error = NULL;
+	w->backup_conn = backup_conn;
+
+	err = pthread_create(&w->thread, NULL, backup_writer_loop, w);
+	if (err != 0)
+		db_fatal(db, "Could not start backup writer: %s",
+			 strerror(err));
+	return w;
+}
+
+/* Writes out anything queued, then stops the thread. */
+static void backup_writer_stop(const struct db *db, struct backup_writer *w)
+{
+	char *error;
+
+	pthread_mutex_lock(&w->lock);
+	w->stopping = true;
+	pthread_cond_signal(&w->work);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	error = w->error;
+	pthread_cond_destroy(&w->idle);
+	pthread_cond_destroy(&w->work);
+	pthread_mutex_destroy(&w->lock);
+	free(w);
+
+	if (error) {
+		db_warn(db, "Failed to replicate to backup: %s", error);
+		free(error);
+	}
+}
+
+/* Replicate a statement now, outside of any transaction. */
 static void replicate_statement(const struct db *db,
 				struct db_sqlite3 *wrapper,
 				const char *qry)
@@ -38,6 +218,10 @@ static void replicate_statement(const struct db *db,
 	if (!wrapper->backup_conn)
 		return;
 
+	/* Keep the backup's order: everything before us goes first. */
+	if (wrapper->writer)
+		backup_writer_drain(db, wrapper->writer);
+
 	sqlite3_prepare_v2(wrapper->backup_conn,
 			   qry, -1, &stmt, NULL);
 	err = sqlite3_step(stmt);
@@ -50,11 +234,75 @@ static void replicate_statement(const struct db *db,
 			 qry);
 }
 
+/* Inside a transaction, changes are only replayed on commit. */
+static void replicate_change(const struct db *db,
+			     struct db_sqlite3 *wrapper,
+			     const char *qry)
+{
+	if (!wrapper->backup_conn)
+		return;
+
+	if (!wrapper->backup_batch) {
+		replicate_statement(db, wrapper, qry);
+		return;
+	}
+	tal_arr_expand(&wrapper->backup_batch,
+		       tal_strdup(wrapper->backup_batch, qry));
+}
+
+/* The whole batch as one script.  We size it up front: appending as we
+ * go would copy it again for every statement. */
+static char *backup_batch_sql(const tal_t *ctx, const char **stmts)
+{
+	size_t len = 0;
+	char *sql, *p;
+
+	for (size_t i = 0; i < tal_count(stmts); i++)
+		len += strlen(stmts[i]) + strlen(";\n");
+
+	sql = p = tal_arr(ctx, char, len + 1);
+	for (size_t i = 0; i < tal_count(stmts); i++) {
+		size_t n = strlen(stmts[i]);
+		memcpy(p, stmts[i], n);
+		memcpy(p + n, ";\n", strlen(";\n"));
+		p += n + strlen(";\n");
+	}
+	*p = '\0';
+	return sql;
+}
+
+/* The main db has committed: now the backup can catch up to it.  This
+ * ordering is what keeps the backup's data_version from ever being
+ * ahead of the main db's. */
+static void replicate_commit(const struct db *db, struct db_sqlite3 *wrapper)
+{
+	char *errmsg, *sql;
+
+	if (!wrapper->backup_batch)
+		return;
+
+	tal_arr_expand(&wrapper->backup_batch, "COMMIT");
+	sql = backup_batch_sql(tmpctx, wrapper->backup_batch);
+	if (wrapper->writer) {
+		backup_writer_push(db, wrapper->writer, sql);
+	} else {
+		errmsg = exec_backup_batch(wrapper->backup_conn, sql);
+		if (errmsg) {
+			char *msg = tal_strdup(tmpctx, errmsg);
+			sqlite3_free(errmsg);
+			db_fatal(db, "Failed to replicate transaction: %s",
+				 msg);
+		}
+	}
+	tal_free(sql);
+	wrapper->backup_batch = tal_free(wrapper->backup_batch);
+}
+
 static void db_sqlite3_changes_add(struct db_sqlite3 *wrapper,
 				   struct db_stmt *stmt,
 				   const char *qry)
 {
-	replicate_statement(stmt->db, wrapper, qry);
+	replicate_change(stmt->db, wrapper, qry);
 	db_changes_add(stmt, qry);
 }
 
@@ -139,6 +387,10 @@ static bool db_sqlite3_setup(struct db *db)
 	}
 
 	wrapper = tal(db, struct db_sqlite3);
+	wrapper->backup_batch = NULL;
+	wrapper->writer = NULL;
+	wrapper->stmt_cache = tal_arrz(wrapper, sqlite3_stmt *,
+				       db->queries->query_table_size);
 	db->conn = wrapper;
 
 	err = sqlite3_open_v2(filename, &sql, flags, NULL);
@@ -178,6 +430,9 @@ static bool db_sqlite3_setup(struct db *db)
 				 backup_filename,
 				 sqlite3_errstr(err));
 		}
+		if (db->backup_async)
+			wrapper->writer = backup_writer_start(db,
+							      wrapper->backup_conn);
 	}
 
 	/* If we have a backup db, but it does not have a matching
@@ -218,13 +473,35 @@ static bool db_sqlite3_setup(struct db *db)
 	return err == SQLITE_DONE;
 }
 
+/* Statements for the same query are often used thousands of times a
+ * second, so we only parse and plan each one once. */
+static int prepare_cached(struct db_stmt *stmt, sqlite3_stmt **s)
+{
+	struct db_sqlite3 *wrapper = (struct db_sqlite3 *)stmt->db->conn;
+
+	if (stmt->query_idx < 0)
+		return sqlite3_prepare_v2(wrapper->conn, stmt->query->query,
+					  -1, s, NULL);
+
+	*s = wrapper->stmt_cache[stmt->query_idx];
+	if (*s) {
+		wrapper->stmt_cache[stmt->query_idx] = NULL;
+		stmt->db->stmt_cache_hits++;
+		return SQLITE_OK;
+	}
+
+	/* Not prepared yet, or the cached one is in use (nested query). */
+	stmt->db->stmt_cache_misses++;
+	return sqlite3_prepare_v2(wrapper->conn, stmt->query->query,
+				  -1, s, NULL);
+}
+
 static bool db_sqlite3_query(struct db_stmt *stmt)
 {
 	sqlite3_stmt *s;
-	sqlite3 *conn = conn2sql(stmt->db->conn);
 	int err;
 
-	err = sqlite3_prepare_v2(conn, stmt->query->query, -1, &s, NULL);
+	err = prepare_cached(stmt, &s);
 
 	for (size_t i=0; i<stmt->query->placeholders; i++) {
 		struct db_binding *b = &stmt->bindings[i];
@@ -333,7 +610,10 @@ static bool db_sqlite3_begin_tx(struct db *db)
 		db->error = tal_fmt(db, "Failed to begin a transaction: %s", errmsg);
 		return false;
 	}
-	replicate_statement(db, wrapper, "BEGIN TRANSACTION;");
+	if (wrapper->backup_conn) {
+		wrapper->backup_batch = tal_arr(wrapper, const char *, 1);
+		wrapper->backup_batch[0] = "BEGIN TRANSACTION";
+	}
 	return true;
 }
 
@@ -348,9 +628,10 @@ static bool db_sqlite3_commit_tx(struct db *db)
 				    "COMMIT;", NULL, NULL, &errmsg);
 	if (err != SQLITE_OK) {
 		db->error = tal_fmt(db, "Failed to commit a transaction: %s", errmsg);
+		wrapper->backup_batch = tal_free(wrapper->backup_batch);
 		return false;
 	}
-	replicate_statement(db, wrapper, "COMMIT;");
+	replicate_commit(db, wrapper);
 	return true;
 }
 
@@ -392,11 +673,33 @@ static const unsigned char *db_sqlite3_column_text(struct db_stmt *stmt, int col
 
 static void db_sqlite3_stmt_free(struct db_stmt *stmt)
 {
-	if (stmt->inner_stmt)
+	struct db_sqlite3 *wrapper = (struct db_sqlite3 *)stmt->db->conn;
+
+	if (!stmt->inner_stmt)
+		return;
+
+	/* Put it back for next time, unless we already have one (or the
+	 * db is already closed). */
+	if (wrapper && stmt->query_idx >= 0
+	    && !wrapper->stmt_cache[stmt->query_idx]) {
+		sqlite3_reset(stmt->inner_stmt);
+		sqlite3_clear_bindings(stmt->inner_stmt);
+		wrapper->stmt_cache[stmt->query_idx] = stmt->inner_stmt;
+	} else
 		sqlite3_finalize(stmt->inner_stmt);
 	stmt->inner_stmt = NULL;
 }
 
+static void db_sqlite3_stmt_cache_flush(struct db *db)
+{
+	struct db_sqlite3 *wrapper = (struct db_sqlite3 *)db->conn;
+
+	for (size_t i = 0; i < tal_count(wrapper->stmt_cache); i++) {
+		sqlite3_finalize(wrapper->stmt_cache[i]);
+		wrapper->stmt_cache[i] = NULL;
+	}
+}
+
 static size_t db_sqlite3_count_changes(struct db_stmt *stmt)
 {
 	sqlite3 *s = conn2sql(stmt->db->conn);
@@ -407,6 +710,10 @@ static void db_sqlite3_close(struct db *db)
 {
 	struct db_sqlite3 *wrapper = (struct db_sqlite3 *) db->conn;
 
+	/* sqlite3_close() fails while there are unfinalized statements */
+	db_sqlite3_stmt_cache_flush(db);
+	if (wrapper->writer)
+		backup_writer_stop(db, wrapper->writer);
 	if (wrapper->backup_conn)
 		sqlite3_close(wrapper->backup_conn);
 	sqlite3_close(wrapper->conn);
@@ -688,6 +995,7 @@ struct db_config db_sqlite3_config = {
 	.teardown_fn = &db_sqlite3_close,
 
 	.vacuum_fn = db_sqlite3_vacuum,
+	.stmt_cache_flush_fn = db_sqlite3_stmt_cache_flush,
 	.rename_column = db_sqlite3_rename_column,
 	.delete_columns = db_sqlite3_delete_columns,
 };
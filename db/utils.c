@@ -67,7 +67,8 @@ static void db_stmt_free(struct db_stmt *stmt)
 
 static struct db_stmt *db_prepare_core(struct db *db,
 				       const char *location,
-				       const struct db_query *db_query)
+				       const struct db_query *db_query,
+				       int query_idx)
 {
 	struct db_stmt *stmt = tal(db, struct db_stmt);
 	size_t num_slots = db_query->placeholders;
@@ -79,6 +80,7 @@ static struct db_stmt *db_prepare_core(struct db *db,
 	stmt->error = NULL;
 	stmt->db = db;
 	stmt->query = db_query;
+	stmt->query_idx = query_idx;
 	stmt->executed = false;
 	stmt->inner_stmt = NULL;
 	stmt->bind_pos = -1;
@@ -118,7 +120,8 @@ struct db_stmt *db_prepare_v2_(const char *location, struct db *db,
 		pos = (pos + 1) % db->queries->query_table_size;
 	}
 
-	return db_prepare_core(db, location, &db->queries->query_table[pos]);
+	return db_prepare_core(db, location, &db->queries->query_table[pos],
+			       pos);
 }
 
 /* Provides replication and hook interface for raw SQL too */
@@ -135,7 +138,7 @@ struct db_stmt *db_prepare_untranslated(struct db *db, const char *query)
 	db_query->colnames = NULL;
 	db_query->num_colnames = 0;
 
-	stmt = db_prepare_core(db, "db_prepare_untranslated", db_query);
+	stmt = db_prepare_core(db, "db_prepare_untranslated", db_query, -1);
 	tal_steal(stmt, db_query);
 	return stmt;
 }
@@ -314,6 +317,12 @@ static struct db_query_set *db_queries_find(const struct db_config *config)
 	return NULL;
 }
 
+void db_stmt_cache_flush(struct db *db)
+{
+	if (db->config->stmt_cache_flush_fn)
+		db->config->stmt_cache_flush_fn(db);
+}
+
 void db_prepare_for_changes(struct db *db)
 {
 	assert(!db->changes);
@@ -337,6 +346,7 @@ void db_warn(const struct db *db, const char *fmt, ...)
 }
 
 struct db *db_open_(const tal_t *ctx, const char *filename,
+		    bool backup_async,
 		    void (*errorfn)(void *arg, bool fatal, const char *fmt, va_list ap),
 		    void *arg)
 {
@@ -344,6 +354,7 @@ struct db *db_open_(const tal_t *ctx, const char *filename,
 
 	db = tal(ctx, struct db);
 	db->filename = tal_strdup(db, filename);
+	db->backup_async = backup_async;
 	db->errorfn = errorfn;
 	db->errorfn_arg = arg;
 	list_head_init(&db->pending_statements);
@@ -361,6 +372,7 @@ struct db *db_open_(const tal_t *ctx, const char *filename,
 	tal_add_destructor(db, destroy_db);
 	db->in_transaction = NULL;
 	db->changes = NULL;
+	db->stmt_cache_hits = db->stmt_cache_misses = 0;
 
 	/* This must be outside a transaction, so catch it */
 	assert(!db->in_transaction);
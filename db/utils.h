@@ -84,14 +84,16 @@ struct db_stmt *db_prepare_v2_(const char *location, struct db *db,
 
 /**
  * db_open - Open or create a database
+ * @backup_async: write to any backup db from another thread (sqlite3)
  */
-#define db_open(ctx, filename, errfn, arg)				\
-	db_open_((ctx), (filename),					\
+#define db_open(ctx, filename, backup_async, errfn, arg)		\
+	db_open_((ctx), (filename), (backup_async),			\
 		 typesafe_cb_postargs(void, void *, (errfn), (arg),	\
 				      bool, const char *, va_list),		\
 		 (arg))
 
 struct db *db_open_(const tal_t *ctx, const char *filename,
+		    bool backup_async,
 		    void (*errorfn)(void *arg, bool fatal, const char *fmt, va_list ap),
 		    void *arg);
 
@@ -119,6 +121,14 @@ const char **db_changes(struct db *db);
  */
 struct db_stmt *db_prepare_untranslated(struct db *db, const char *query);
 
+/**
+ * db_stmt_cache_flush - Drop any prepared statements the backend cached.
+ *
+ * Call after migrations: a cached statement may not survive its tables
+ * changing shape.
+ */
+void db_stmt_cache_flush(struct db *db);
+
 /* Errors and warnings... */
 void db_fatal(const struct db *db, const char *fmt, ...)
 	PRINTF_FMT(2, 3);
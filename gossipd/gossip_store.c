@@ -7,10 +7,14 @@
 #include <common/gossip_store.h>
 #include <common/private_channel_announcement.h>
 #include <common/status.h>
+#include <common/timeout.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <gossipd/gossip_store.h>
 #include <gossipd/gossip_store_wiregen.h>
+#include <gossipd/gossipd.h>
+#include <gossipd/gossmap_index.h>
+#include <gossipd/seeker.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <unistd.h>
@@ -20,6 +24,15 @@
 /* We write it as major version 0, minor version 12 */
 #define GOSSIP_STORE_VER ((0 << 5) | 12)
 
+/* gossmap users share the index's channels until they read updates into
+ * them, so give them a new one once the store has grown by a tenth.  That
+ * means reading the whole store, so a child does it, and we only check now
+ * and again. */
+#define GOSSMAP_INDEX_REWRITE_FRACTION 10
+#define GOSSMAP_INDEX_REWRITE_MIN_BYTES (128 * 1024)
+#define GOSSMAP_INDEX_CHECK_SECS(dev_fast_gossip_flag) \
+	DEV_FAST_GOSSIP(dev_fast_gossip_flag, 5, 60)
+
 struct gossip_store {
 	/* This is false when we're loading */
 	bool writable;
@@ -45,6 +58,15 @@ struct gossip_store {
 
 	/* Timestamp of store when we opened it (0 if we created it) */
 	u32 timestamp;
+
+	/* How long the store was when we last wrote the gossmap index */
+	u64 index_len;
+
+	/* Child writing the gossmap index, if any */
+	pid_t index_writer;
+
+	/* Checks whether we should write a new gossmap index */
+	struct oneshot *index_timer;
 };
 
 static void gossip_store_destroy(struct gossip_store *gs)
@@ -52,6 +74,47 @@ static void gossip_store_destroy(struct gossip_store *gs)
 	close(gs->fd);
 }
 
+/* Any index the child writes would be for the store we're replacing. */
+static void write_index_now(struct gossip_store *gs)
+{
+	if (gs->index_writer) {
+		gossmap_index_bg_kill(gs->index_writer);
+		gs->index_writer = 0;
+	}
+	write_gossmap_index();
+	gs->index_len = gs->len;
+}
+
+static void gossmap_index_check(struct gossip_store *gs)
+{
+	struct daemon *daemon = gs->rstate->daemon;
+	u64 growth;
+
+	gs->index_timer
+		= new_reltimer(&daemon->timers, gs,
+			       time_from_sec(GOSSMAP_INDEX_CHECK_SECS(gs->rstate->dev_fast_gossip)),
+			       gossmap_index_check, gs);
+
+	if (gs->index_writer) {
+		if (!gossmap_index_bg_done(gs->index_writer))
+			return;
+		gs->index_writer = 0;
+	}
+
+	/* Wait until initial sync is over: most of the store is new then. */
+	if (!daemon->seeker || !seeker_synced(daemon->seeker))
+		return;
+
+	growth = gs->len - gs->index_len;
+	if (growth < GOSSMAP_INDEX_REWRITE_MIN_BYTES
+	    || growth < gs->index_len / GOSSMAP_INDEX_REWRITE_FRACTION)
+		return;
+
+	gs->index_writer = write_gossmap_index_bg();
+	if (gs->index_writer)
+		gs->index_len = gs->len;
+}
+
 #if HAVE_PWRITEV
 /* One fewer syscall for the win! */
 static ssize_t gossip_pwritev(int fd, const struct iovec *iov, int iovcnt,
@@ -278,6 +341,9 @@ struct gossip_store *gossip_store_new(struct routing_state *rstate)
 	gs->rstate = rstate;
 	gs->disable_compaction = false;
 	gs->len = sizeof(gs->version);
+	gs->index_len = 0;
+	gs->index_writer = 0;
+	gs->index_timer = NULL;
 
 	tal_add_destructor(gs, gossip_store_destroy);
 
@@ -538,6 +604,8 @@ bool gossip_store_compact(struct gossip_store *gs)
 	close(gs->fd);
 	gs->fd = fd;
 
+	/* Offsets have all changed! */
+	write_index_now(gs);
 	return true;
 
 unlink_disable:
@@ -572,6 +640,7 @@ u64 gossip_store_add(struct gossip_store *gs, const u8 *gossip_msg,
 	gs->count++;
 	if (addendum)
 		gs->count++;
+
 	return off;
 }
 
@@ -979,5 +1048,7 @@ out:
 		     stats[0], stats[1], stats[2], stats[3], gs->deleted,
 		     gs->len);
 
+	write_index_now(gs);
+	gossmap_index_check(gs);
 	return gs->timestamp;
 }
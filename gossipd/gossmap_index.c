@@ -0,0 +1,97 @@
+#include "config.h"
+#include <ccan/time/time.h>
+#include <common/gossip_constants.h>
+#include <common/gossmap.h>
+#include <common/status.h>
+#include <common/utils.h>
+#include <errno.h>
+#include <gossipd/gossmap_index.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Plugins (and anyone else using common/gossmap) would each have to read
+ * the whole store at startup: leave them an index to start from instead.
+ * This lives here because gossipd/routing.h has its own struct half_chan.
+ *
+ * We don't start from the old index: flags we changed in place since
+ * (e.g. zombies) are only seen by reading the whole store. */
+static bool try_write_index(const char **what)
+{
+	struct gossmap *map;
+	bool ok;
+
+	map = gossmap_load_noindex(tmpctx, GOSSIP_STORE_FILENAME, NULL);
+	if (!map) {
+		*what = "load " GOSSIP_STORE_FILENAME " for index";
+		return false;
+	}
+	ok = gossmap_write_index(map);
+	if (!ok)
+		*what = "write gossmap index";
+	tal_free(map);
+	return ok;
+}
+
+void write_gossmap_index(void)
+{
+	struct timeabs start = time_now();
+	const char *what;
+
+	if (!try_write_index(&what))
+		status_unusual("Could not %s: %s", what, strerror(errno));
+	else
+		status_debug("Wrote gossmap index in %"PRIu64" msec",
+			     time_to_msec(time_between(time_now(), start)));
+}
+
+pid_t write_gossmap_index_bg(void)
+{
+	const char *what;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		status_unusual("Could not fork to write gossmap index: %s",
+			       strerror(errno));
+		return 0;
+	}
+	if (pid != 0)
+		return pid;
+
+	/* Our status messages would only be queued in our copy of gossipd:
+	 * we tell the parent how it went with our exit status instead. */
+	if (!try_write_index(&what))
+		_exit(errno > 0 && errno < 256 ? errno : EIO);
+	_exit(0);
+}
+
+bool gossmap_index_bg_done(pid_t pid)
+{
+	int status;
+	pid_t ret;
+
+	ret = waitpid(pid, &status, WNOHANG);
+	if (ret == 0)
+		return false;
+
+	if (ret < 0)
+		status_broken("Waiting for gossmap index writer: %s",
+			      strerror(errno));
+	else if (WIFSIGNALED(status))
+		status_unusual("gossmap index writer killed by signal %i",
+			       WTERMSIG(status));
+	else if (WEXITSTATUS(status) != 0)
+		status_unusual("Could not write gossmap index: %s",
+			       strerror(WEXITSTATUS(status)));
+	else
+		status_debug("Wrote gossmap index in the background");
+	return true;
+}
+
+void gossmap_index_bg_kill(pid_t pid)
+{
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
@@ -0,0 +1,21 @@
+#ifndef LIGHTNING_GOSSIPD_GOSSMAP_INDEX_H
+#define LIGHTNING_GOSSIPD_GOSSMAP_INDEX_H
+#include "config.h"
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Write an index of the gossip_store for common/gossmap users. */
+void write_gossmap_index(void);
+
+/* Same, but from a child process so we don't block.  Returns its pid, or 0
+ * if we couldn't start one. */
+pid_t write_gossmap_index_bg(void);
+
+/* Has this write_gossmap_index_bg() child finished?  Logs how it went. */
+bool gossmap_index_bg_done(pid_t pid);
+
+/* Stop a write_gossmap_index_bg() child (e.g. the store is being rewritten
+ * under it). */
+void gossmap_index_bg_kill(pid_t pid);
+
+#endif /* LIGHTNING_GOSSIPD_GOSSMAP_INDEX_H */
@@ -965,6 +965,14 @@ void query_unknown_node(struct seeker *seeker, struct peer *peer)
 	set_preferred_peer(seeker, peer);
 }
 
+bool seeker_synced(const struct seeker *seeker)
+{
+	/* Probing is still part of startup, too. */
+	return seeker->state != STARTING_UP
+		&& seeker->state != PROBING_SCIDS
+		&& seeker->state != PROBING_NANNOUNCES;
+}
+
 /* Peer has died, NULL out any pointers we have */
 void seeker_peer_gone(struct seeker *seeker, const struct peer *peer)
 {
@@ -25,4 +25,7 @@ bool add_unknown_scid(struct seeker *seeker,
 
 void seeker_peer_gone(struct seeker *seeker,
 		      const struct peer *peer);
+
+/* Are we past the initial gossip sync from our first peer? */
+bool seeker_synced(const struct seeker *seeker);
 #endif /* LIGHTNING_GOSSIPD_SEEKER_H */
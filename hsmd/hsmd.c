@@ -10,6 +10,7 @@
 #include <ccan/array_size/array_size.h>
 #include <ccan/intmap/intmap.h>
 #include <ccan/io/fdpass/fdpass.h>
+#include <ccan/list/list.h>
 #include <ccan/noerr/noerr.h>
 #include <ccan/read_write_all/read_write_all.h>
 #include <ccan/tal/str/str.h>
@@ -19,15 +20,19 @@
 #include <common/status.h>
 #include <common/status_wiregen.h>
 #include <common/subdaemon.h>
+#include <common/timeout.h>
 #include <common/type_to_string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <hsmd/capabilities.h>
 /*~ _wiregen files are autogenerated by tools/generate-wire.py */
+#include <hsmd/hsmd_worker_wiregen.h>
 #include <hsmd/libhsmd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <wire/wire_io.h>
+#include <wire/wire_sync.h>
 
 /*~ Each subdaemon is started with stdin connected to lightningd (for status
  * messages), and stderr untouched (for emergency printing).  File descriptors
@@ -54,6 +59,18 @@ struct client {
 	 * it has the complete thing; this is it. */
 	u8 *msg_in;
 
+	/* When we read it, so we know how long we took to reply. */
+	struct timemono msg_in_time;
+
+	/*~ If msg_in is for a worker: our place in waiting_clients until
+	 * one is free, then the worker doing it, then its reply. */
+	struct list_node waiting;
+	struct worker *worker;
+	u8 *worker_reply;
+
+	/* If we did msg_in ourselves: what hsmd_status_bad_request said. */
+	const char *bad_request;
+
 	/*~ Useful for logging, but also used to derive the per-channel seed. */
 	struct node_id id;
 
@@ -91,6 +108,53 @@ static size_t num_dbid_zero_clients;
  * global. */
 static struct daemon_conn *status_conn;
 
+/*~ Most requests need nothing but our secrets, and some take a while (a
+ * commitment with hundreds of HTLCs), during which every other channel
+ * waits for us.  So once we have the secrets, we fork() some worker
+ * processes and hand those requests to them; everything else we still do
+ * ourselves, in order.  Why not threads?  Because tal isn't thread-safe,
+ * and libhsmd uses it for everything. */
+struct worker {
+	/* Our end of its socket. */
+	int fd;
+	struct daemon_conn *dc;
+
+	/* For logging. */
+	size_t index;
+	pid_t pid;
+
+	/* Is it doing a request?  For this client (NULL if it's gone). */
+	bool busy;
+	struct client *client;
+};
+
+/* However many cores we have, this is plenty. */
+#define MAX_WORKERS 8
+static struct worker **workers;
+
+/* Clients whose request is waiting for a worker, oldest first. */
+static LIST_HEAD(waiting_clients);
+
+/* In a worker process, its socket to us. */
+static int worker_fd = -1;
+
+/*~ How long we take to reply to each type of request (including any time
+ * it spent waiting for a worker): buckets[i] counts replies which took
+ * under 2^i usec, except the last, which counts all the slower ones. */
+#define LATENCY_BUCKETS 24
+struct latency {
+	u64 count, total_usec, max_usec;
+	u64 buckets[LATENCY_BUCKETS];
+	/* count last time we logged it. */
+	u64 logged_count;
+};
+static UINTMAP(struct latency *) latencies;
+
+/* We log the latencies this often (in seconds), if there are new ones. */
+#define LATENCY_LOG_INTERVAL 300
+static struct timers timers;
+static struct oneshot *latency_timer;
+
 /* This is used for various assertions and error cases. */
 static bool is_lightningd(const struct client *client)
 {
@@ -100,6 +164,67 @@ static bool is_lightningd(const struct client *client)
 /* Pre-declare this, due to mutual recursion */
 static struct io_plan *handle_client(struct io_conn *conn, struct client *c);
 
+static void record_latency(enum hsmd_wire t, struct timemono start)
+{
+	struct latency *l = uintmap_get(&latencies, t);
+	u64 usec = time_to_usec(timemono_since(start));
+	size_t b;
+
+	if (!l) {
+		l = talz(NULL, struct latency);
+		uintmap_add(&latencies, t, l);
+	}
+	l->count++;
+	l->total_usec += usec;
+	if (usec > l->max_usec)
+		l->max_usec = usec;
+
+	for (b = 0; b < LATENCY_BUCKETS - 1; b++) {
+		if (usec < (1ULL << b))
+			break;
+	}
+	l->buckets[b]++;
+}
+
+/* Returns the bound of the bucket where we pass this percentage. */
+static u64 latency_percentile(const struct latency *l, u64 percent)
+{
+	u64 seen = 0;
+
+	for (size_t b = 0; b < LATENCY_BUCKETS - 1; b++) {
+		seen += l->buckets[b];
+		if (seen * 100 >= l->count * percent)
+			return 1ULL << b;
+	}
+	return l->max_usec;
+}
+
+static void log_latencies(void *unused UNUSED)
+{
+	struct latency *l;
+	u64 t;
+
+	for (l = uintmap_first(&latencies, &t);
+	     l;
+	     l = uintmap_after(&latencies, &t)) {
+		if (l->count == l->logged_count)
+			continue;
+		status_debug("%s: %"PRIu64" requests, average %"PRIu64"usec,"
+			     " 50%% under %"PRIu64"usec,"
+			     " 99%% under %"PRIu64"usec, max %"PRIu64"usec",
+			     hsmd_wire_name(t), l->count,
+			     l->total_usec / l->count,
+			     latency_percentile(l, 50),
+			     latency_percentile(l, 99),
+			     l->max_usec);
+		l->logged_count = l->count;
+	}
+
+	latency_timer = new_reltimer(&timers, NULL,
+				     time_from_sec(LATENCY_LOG_INTERVAL),
+				     log_latencies, NULL);
+}
+
 /*~ ccan/compiler.h defines PRINTF_FMT as the gcc compiler hint so it will
  * check that fmt and other trailing arguments really are the correct type.
  *
@@ -179,6 +304,15 @@ static void destroy_client(struct client *c)
 			      "Failed to remove client dbid %"PRIu64, c->dbid);
 }
 
+/*~ If a client goes away while its request is waiting for a worker, or
+ * being done by one, we simply drop the reply. */
+static void destroy_client_request(struct client *c)
+{
+	list_del_init(&c->waiting);
+	if (c->worker)
+		c->worker->client = NULL;
+}
+
 static struct client *new_client(const tal_t *ctx,
 				 const struct chainparams *chainparams,
 				 const struct node_id *id,
@@ -189,6 +323,10 @@ static struct client *new_client(const tal_t *ctx,
 	struct client *c = tal(ctx, struct client);
 
 	c->msg_in = NULL;
+	list_node_init(&c->waiting);
+	c->worker = NULL;
+	c->worker_reply = NULL;
+	c->bad_request = NULL;
 
 	/*~ All-zero pubkey is used for the initial master connection */
 	if (id) {
@@ -223,6 +361,7 @@ static struct client *new_client(const tal_t *ctx,
 	 *   ctx -> c->conn -> c.
 	 */
 	tal_steal(c->conn, c);
+	tal_add_destructor(c, destroy_client_request);
 
 	/* We put the special zero-db HSM connections into an array, the rest
 	 * go into the map. */
@@ -273,6 +412,7 @@ static struct io_plan *req_reply(struct io_conn *conn,
 	 * If we were to queue outgoing messages ourselves, we *would* have to
 	 * consider such scenarios; this is why our daemons generally avoid
 	 * buffering from untrusted parties. */
+	record_latency(fromwire_peektype(c->msg_in), c->msg_in_time);
 	return io_write_wire(conn, msg_out, client_read_next, c);
 }
 
@@ -431,6 +571,198 @@ static void load_hsm(const struct secret *encryption_key)
 	close(fd);
 }
 
+/*~ This is all a worker process does, one request at a time.  It logs (and
+ * fails) through us, and tells us about bad requests so we can close that
+ * client: see hsmd_status_bad_request. */
+static void NORETURN worker_loop(int fd)
+{
+	/* These are hsmd's, not ours. */
+	status_conn = tal_free(status_conn);
+	close(REQ_FD);
+
+	worker_fd = fd;
+	status_setup_sync(fd);
+	hsmd_relock_secrets();
+	sodium_mlock(hsm_secret.data, sizeof(hsm_secret.data));
+
+	for (;;) {
+		struct node_id id;
+		u64 dbid, capabilities;
+		struct hsmd_client *client;
+		u8 *msg, *req, *reply;
+
+		msg = wire_sync_read(tmpctx, fd);
+		/* hsmd has exited. */
+		if (!msg)
+			exit(0);
+
+		if (!fromwire_hsmd_worker_req(tmpctx, msg, &id, &dbid,
+					      &capabilities, &req))
+			status_failed(STATUS_FAIL_INTERNAL_ERROR,
+				      "Bad worker request %s",
+				      tal_hex(tmpctx, msg));
+
+		if (dbid == 0) {
+			client = hsmd_client_new_main(tmpctx, capabilities,
+						      NULL);
+			client->id = id;
+		} else
+			client = hsmd_client_new_peer(tmpctx, capabilities,
+						      dbid, &id, NULL);
+
+		/* If it returns NULL, we already sent the bad request. */
+		reply = hsmd_handle_client_message(tmpctx, client, req);
+		if (reply && !wire_sync_write(fd, take(reply)))
+			exit(1);
+		clean_tmpctx();
+	}
+}
+
+static struct worker *idle_worker(void)
+{
+	for (size_t i = 0; i < tal_count(workers); i++) {
+		if (!workers[i]->busy)
+			return workers[i];
+	}
+	return NULL;
+}
+
+static void worker_start(struct worker *w, struct client *c)
+{
+	w->busy = true;
+	w->client = c;
+	c->worker = w;
+	daemon_conn_send(w->dc,
+			 take(towire_hsmd_worker_req(NULL, &c->id, c->dbid,
+						     c->capabilities,
+						     c->msg_in)));
+}
+
+static struct io_plan *worker_recv(struct io_conn *conn,
+				   const u8 *msg,
+				   struct worker *w)
+{
+	int t = fromwire_peektype(msg);
+
+	/* We already told lightningd our version; pass on everything else. */
+	if (status_wire_is_defined(t)) {
+		if (t != WIRE_STATUS_VERSION)
+			daemon_conn_send(status_conn, msg);
+		return daemon_conn_read_next(conn, w->dc);
+	}
+
+	if (!w->busy)
+		status_failed(STATUS_FAIL_INTERNAL_ERROR,
+			      "Worker %zu sent unexpected %s",
+			      w->index, tal_hex(tmpctx, msg));
+
+	/* Anything else is the reply to the client. */
+	if (w->client) {
+		w->client->worker_reply = tal_dup_talarr(w->client, u8, msg);
+		w->client->worker = NULL;
+		io_wake(w->client);
+	}
+	w->busy = false;
+	w->client = NULL;
+
+	if (!list_empty(&waiting_clients)) {
+		struct client *c = list_top(&waiting_clients,
+					    struct client, waiting);
+		list_del_init(&c->waiting);
+		worker_start(w, c);
+	}
+	return daemon_conn_read_next(conn, w->dc);
+}
+
+static void worker_gone(struct daemon_conn *dc UNUSED, struct worker *w)
+{
+	status_failed(STATUS_FAIL_INTERNAL_ERROR,
+		      "Worker %zu (pid %i) exited", w->index, (int)w->pid);
+}
+
+/* Leave one core for us, if we can. */
+static size_t num_workers(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ncpus <= 1)
+		return 0;
+	if (ncpus - 1 > MAX_WORKERS)
+		return MAX_WORKERS;
+	return ncpus - 1;
+}
+
+/*~ We do this once hsmd_init has set up the secrets, so the workers inherit
+ * them.  The only other fds we have then are lightningd's and stdin. */
+static void start_workers(size_t n)
+{
+	workers = tal_arr(NULL, struct worker *, n);
+	for (size_t i = 0; i < n; i++) {
+		struct worker *w;
+		int fds[2];
+		pid_t pid;
+
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+			status_failed(STATUS_FAIL_INTERNAL_ERROR,
+				      "creating worker fds: %s",
+				      strerror(errno));
+
+		pid = fork();
+		if (pid < 0)
+			status_failed(STATUS_FAIL_INTERNAL_ERROR,
+				      "forking worker: %s", strerror(errno));
+		if (pid == 0) {
+			/* Otherwise the others wouldn't see us exit. */
+			for (size_t j = 0; j < i; j++)
+				close(workers[j]->fd);
+			close(fds[0]);
+			worker_loop(fds[1]);
+		}
+
+		close(fds[1]);
+		w = workers[i] = tal(workers, struct worker);
+		w->fd = fds[0];
+		w->index = i;
+		w->pid = pid;
+		w->busy = false;
+		w->client = NULL;
+		w->dc = daemon_conn_new(w, w->fd, worker_recv, NULL, w);
+		tal_add_destructor2(w->dc, worker_gone, w);
+	}
+	status_debug("Started %zu workers", n);
+}
+
+/*~ io_wake() in worker_recv sends us here. */
+static struct io_plan *worker_replied(struct io_conn *conn, struct client *c)
+{
+	u8 *reply = c->worker_reply;
+	struct node_id id;
+	wirestring *error;
+	u8 *msg;
+
+	c->worker_reply = NULL;
+	if (fromwire_hsmstatus_client_bad_request(tmpctx, reply,
+						  &id, &error, &msg)) {
+		tal_free(reply);
+		return bad_req_fmt(conn, c, c->msg_in, "%s", error);
+	}
+	return req_reply(conn, c, take(reply));
+}
+
+static struct io_plan *hand_to_worker(struct io_conn *conn, struct client *c)
+{
+	struct worker *w = idle_worker();
+
+	if (w)
+		worker_start(w, c);
+	else
+		list_add_tail(&waiting_clients, &c->waiting);
+
+	/*~ io_wait() does nothing until someone calls io_wake() on the
+	 * address we give it: here, that's worker_recv with the reply. */
+	return io_wait(conn, c, worker_replied, c);
+}
+
 /*~ This is the response to lightningd's HSM_INIT request, which is the first
  * thing it sends. */
 static struct io_plan *init_hsm(struct io_conn *conn,
@@ -445,6 +777,7 @@ static struct io_plan *init_hsm(struct io_conn *conn,
 	struct bip32_key_version bip32_key_version;
 	u32 minversion, maxversion;
 	const u32 our_minversion = 2, our_maxversion = 3;
+	u8 *reply;
 
 	/* This must be lightningd. */
 	assert(is_lightningd(c));
@@ -493,7 +826,9 @@ static struct io_plan *init_hsm(struct io_conn *conn,
 	if (hsm_encryption_key)
 		discard_key(take(hsm_encryption_key));
 
-	return req_reply(conn, c, hsmd_init(hsm_secret, bip32_key_version));
+	reply = hsmd_init(hsm_secret, bip32_key_version);
+	start_workers(num_workers());
+	return req_reply(conn, c, reply);
 }
 
 /*~ Since we process requests then service them in strict order, and because
@@ -574,6 +909,9 @@ static struct io_plan *handle_memleak(struct io_conn *conn,
 	memleak_scan_region(memtable, dbid_zero_clients, sizeof(dbid_zero_clients));
 	memleak_scan_uintmap(memtable, &clients);
 	memleak_scan_obj(memtable, status_conn);
+	memleak_scan_obj(memtable, workers);
+	memleak_scan_uintmap(memtable, &latencies);
+	memleak_ptr(memtable, latency_timer);
 
 	memleak_ptr(memtable, dev_force_privkey);
 	memleak_ptr(memtable, dev_force_bip32_seed);
@@ -589,7 +927,20 @@ u8 *hsmd_status_bad_request(struct hsmd_client *client, const u8 *msg, const cha
 	/* Extract the pointer to the hsmd representation of the
 	 * client which has access to the underlying connection. */
 	struct client *c = (struct client*)client->extra;
-	bad_req_fmt(c->conn, c, msg, "%s", error);
+
+	/* In a worker, we tell hsmd, and it does this. */
+	if (worker_fd != -1) {
+		if (!wire_sync_write(worker_fd,
+				     take(towire_hsmstatus_client_bad_request(NULL,
+									      &client->id,
+									      error,
+									      msg))))
+			exit(1);
+		return NULL;
+	}
+
+	/* We can't close it here: handle_libhsmd still needs it. */
+	c->bad_request = tal_strdup(tmpctx, error);
 
 	/* We often use `return hsmd_status_bad_request` to drop out, and NULL
 	 * means we encountered an error. */
@@ -622,11 +973,25 @@ void hsmd_status_failed(enum status_failreason reason, const char *fmt, ...)
 	status_send_fatal(take(towire_status_fail(NULL, reason, str)));
 }
 
+/*~ When libhsmd says it's a bad request, we close the client here, just as
+ * worker_replied does when a worker says so: it's the same error either way. */
+static struct io_plan *handle_libhsmd(struct io_conn *conn, struct client *c)
+{
+	u8 *reply;
+
+	c->bad_request = NULL;
+	reply = hsmd_handle_client_message(tmpctx, c->hsmd_client, c->msg_in);
+	if (!reply)
+		return bad_req_fmt(conn, c, c->msg_in, "%s", c->bad_request);
+	return req_reply(conn, c, take(reply));
+}
+
 /*~ This is the core of the HSM daemon: handling requests. */
 static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 {
 	enum hsmd_wire t = fromwire_peektype(c->msg_in);
 
+	c->msg_in_time = time_mono();
 	if (!is_lightningd(c))
 		status_peer_debug(&c->id, "Got %s", hsmd_wire_name(t));
 
@@ -652,33 +1017,40 @@ static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 	case WIRE_HSMD_DEV_MEMLEAK:
 #endif /* DEVELOPER */
 
+	/* These are the busy ones, and only need the secrets: workers do
+	 * them, if we have any. */
+	case WIRE_HSMD_SIGN_COMMITMENT_TX:
+	case WIRE_HSMD_SIGN_REMOTE_COMMITMENT_TX:
+	case WIRE_HSMD_SIGN_REMOTE_HTLC_TX:
+	case WIRE_HSMD_SIGN_REMOTE_HTLC_TXS:
+	case WIRE_HSMD_SIGN_LOCAL_HTLC_TX:
+	case WIRE_HSMD_SIGN_MESSAGE:
+	case WIRE_HSMD_ECDH_REQ:
+	case WIRE_HSMD_ECDH_BATCH_REQ:
+	case WIRE_HSMD_CUPDATE_SIG_REQ:
+		if (tal_count(workers) != 0)
+			return hand_to_worker(conn, c);
+		/* fall thru */
 	case WIRE_HSMD_NEW_CHANNEL:
 	case WIRE_HSMD_READY_CHANNEL:
-	case WIRE_HSMD_SIGN_COMMITMENT_TX:
 	case WIRE_HSMD_VALIDATE_COMMITMENT_TX:
 	case WIRE_HSMD_VALIDATE_REVOCATION:
 	case WIRE_HSMD_SIGN_PENALTY_TO_US:
-	case WIRE_HSMD_SIGN_REMOTE_COMMITMENT_TX:
-	case WIRE_HSMD_SIGN_REMOTE_HTLC_TX:
 	case WIRE_HSMD_SIGN_MUTUAL_CLOSE_TX:
 	case WIRE_HSMD_SIGN_SPLICE_TX:
 	case WIRE_HSMD_GET_PER_COMMITMENT_POINT:
 	case WIRE_HSMD_SIGN_WITHDRAWAL:
 	case WIRE_HSMD_GET_CHANNEL_BASEPOINTS:
 	case WIRE_HSMD_SIGN_INVOICE:
-	case WIRE_HSMD_SIGN_MESSAGE:
 	case WIRE_HSMD_SIGN_OPTION_WILL_FUND_OFFER:
 	case WIRE_HSMD_SIGN_BOLT12:
 	case WIRE_HSMD_PREAPPROVE_INVOICE:
 	case WIRE_HSMD_PREAPPROVE_KEYSEND:
-	case WIRE_HSMD_ECDH_REQ:
 	case WIRE_HSMD_CHECK_FUTURE_SECRET:
 	case WIRE_HSMD_GET_OUTPUT_SCRIPTPUBKEY:
 	case WIRE_HSMD_DERIVE_SECRET:
 	case WIRE_HSMD_CANNOUNCEMENT_SIG_REQ:
 	case WIRE_HSMD_NODE_ANNOUNCEMENT_SIG_REQ:
-	case WIRE_HSMD_CUPDATE_SIG_REQ:
-	case WIRE_HSMD_SIGN_LOCAL_HTLC_TX:
 	case WIRE_HSMD_SIGN_REMOTE_HTLC_TO_US:
 	case WIRE_HSMD_SIGN_DELAYED_PAYMENT_TO_US:
 	case WIRE_HSMD_CHECK_PUBKEY:
@@ -689,11 +1061,10 @@ static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 	case WIRE_HSMD_SIGN_ANCHORSPEND:
 	case WIRE_HSMD_SIGN_HTLC_TX_MINGLE:
 		/* Hand off to libhsmd for processing */
-		return req_reply(conn, c,
-				 take(hsmd_handle_client_message(
-				     tmpctx, c->hsmd_client, c->msg_in)));
+		return handle_libhsmd(conn, c);
 
 	case WIRE_HSMD_ECDH_RESP:
+	case WIRE_HSMD_ECDH_BATCH_RESP:
 	case WIRE_HSMD_CANNOUNCEMENT_SIG_REPLY:
 	case WIRE_HSMD_CUPDATE_SIG_REPLY:
 	case WIRE_HSMD_CLIENT_HSMFD_REPLY:
@@ -723,6 +1094,7 @@ static struct io_plan *handle_client(struct io_conn *conn, struct client *c)
 	case WIRE_HSMD_CHECK_PUBKEY_REPLY:
 	case WIRE_HSMD_SIGN_ANCHORSPEND_REPLY:
 	case WIRE_HSMD_SIGN_HTLC_TX_MINGLE_REPLY:
+	case WIRE_HSMD_SIGN_REMOTE_HTLC_TXS_REPLY:
 		return bad_req_fmt(conn, c, c->msg_in,
 				   "Received an incoming message of type %s, "
 				   "which is not a request",
@@ -752,6 +1124,11 @@ int main(int argc, char *argv[])
 	status_conn = daemon_conn_new(NULL, STDIN_FILENO, NULL, NULL, NULL);
 	status_setup_async(status_conn);
 	uintmap_init(&clients);
+	uintmap_init(&latencies);
+	timers_init(&timers, time_mono());
+	latency_timer = new_reltimer(&timers, NULL,
+				     time_from_sec(LATENCY_LOG_INTERVAL),
+				     log_latencies, NULL);
 
 	master = new_client(NULL, NULL, NULL, 0,
 			    HSM_CAP_MASTER | HSM_CAP_SIGN_GOSSIP | HSM_CAP_ECDH,
@@ -763,14 +1140,14 @@ int main(int argc, char *argv[])
 	/* When conn closes, everything is freed. */
 	io_set_finish(master->conn, master_gone, master);
 
-	/*~ The two NULL args are a list of timers, and the timer which expired:
-	 * we don't have any timers. */
-	io_loop(NULL, NULL);
-
-	/*~ This should never be reached: io_loop only exits on io_break which
-	 * we don't call, a timer expiry which we don't have, or all connections
-	 * being closed, and closing the master calls master_gone. */
-	abort();
+	/*~ io_loop only exits on io_break which we don't call, a timer
+	 * expiry (our only one logs latencies), or all connections being
+	 * closed, and closing the master calls master_gone. */
+	for (;;) {
+		struct timer *expired;
+		io_loop(&timers, &expired);
+		timer_expired(expired);
+	}
 }
 
 /*~ Congratulations on making it through the first of the seven dwarves!
@@ -79,6 +79,7 @@ bool hsmd_check_client_capabilities(struct hsmd_client *client,
 	 */
 	switch (t) {
 	case WIRE_HSMD_ECDH_REQ:
+	case WIRE_HSMD_ECDH_BATCH_REQ:
 		return (client->capabilities & HSM_CAP_ECDH) != 0;
 
 	case WIRE_HSMD_CANNOUNCEMENT_SIG_REQ:
@@ -99,6 +100,7 @@ bool hsmd_check_client_capabilities(struct hsmd_client *client,
 
 	case WIRE_HSMD_SIGN_REMOTE_COMMITMENT_TX:
 	case WIRE_HSMD_SIGN_REMOTE_HTLC_TX:
+	case WIRE_HSMD_SIGN_REMOTE_HTLC_TXS:
 	case WIRE_HSMD_VALIDATE_COMMITMENT_TX:
 	case WIRE_HSMD_VALIDATE_REVOCATION:
 		return (client->capabilities & HSM_CAP_SIGN_REMOTE_TX) != 0;
@@ -139,6 +141,7 @@ bool hsmd_check_client_capabilities(struct hsmd_client *client,
 	/* FIXME: Since we autogenerate these, we should really generate separate
 	 * enums for replies to avoid this kind of clutter! */
 	case WIRE_HSMD_ECDH_RESP:
+	case WIRE_HSMD_ECDH_BATCH_RESP:
 	case WIRE_HSMD_CANNOUNCEMENT_SIG_REPLY:
 	case WIRE_HSMD_CUPDATE_SIG_REPLY:
 	case WIRE_HSMD_CLIENT_HSMFD_REPLY:
@@ -168,6 +171,7 @@ bool hsmd_check_client_capabilities(struct hsmd_client *client,
 	case WIRE_HSMD_CHECK_PUBKEY_REPLY:
 	case WIRE_HSMD_SIGN_ANCHORSPEND_REPLY:
 	case WIRE_HSMD_SIGN_HTLC_TX_MINGLE_REPLY:
+	case WIRE_HSMD_SIGN_REMOTE_HTLC_TXS_REPLY:
 		break;
 	}
 	return false;
@@ -860,6 +864,31 @@ static u8 *handle_ecdh(struct hsmd_client *c, const u8 *msg_in)
 	return towire_hsmd_ecdh_resp(NULL, &ss);
 }
 
+/*~ lightningd does the ECDH for every incoming onion: a commitment can add
+ * dozens, so it asks for them all at once. */
+static u8 *handle_ecdh_batch(struct hsmd_client *c, const u8 *msg_in)
+{
+	struct privkey privkey;
+	struct pubkey *points;
+	struct secret *ss;
+
+	if (!fromwire_hsmd_ecdh_batch_req(tmpctx, msg_in, &points))
+		return hsmd_status_malformed_request(c, msg_in);
+
+	node_key(&privkey, NULL);
+	ss = tal_arr(tmpctx, struct secret, tal_count(points));
+	for (size_t i = 0; i < tal_count(points); i++) {
+		if (secp256k1_ecdh(secp256k1_ctx, ss[i].data,
+				   &points[i].pubkey,
+				   privkey.secret.data, NULL, NULL) != 1) {
+			return hsmd_status_bad_request_fmt(c, msg_in,
+							   "secp256k1_ecdh fail");
+		}
+	}
+
+	return towire_hsmd_ecdh_batch_resp(NULL, ss);
+}
+
 /*~ This is used when the remote peer claims to have knowledge of future
  * commitment states (option_data_loss_protect in the spec) which means we've
  * been restored from backup or something, and may have already revealed
@@ -1317,15 +1346,52 @@ static u8 *handle_sign_any_local_htlc_tx(struct hsmd_client *c, const u8 *msg_in
 				     option_anchor_outputs);
 }
 
+/* Derives our HTLC key for the remote peer's commitment transaction. */
+static bool derive_remote_htlc_keys(struct hsmd_client *c,
+				    const struct pubkey *remote_per_commit_point,
+				    struct privkey *htlc_privkey,
+				    struct pubkey *htlc_pubkey)
+{
+	struct secret channel_seed;
+	struct secrets secrets;
+	struct basepoints basepoints;
+
+	get_channel_seed(&c->id, c->dbid, &channel_seed);
+	derive_basepoints(&channel_seed, NULL, &basepoints, &secrets, NULL);
+
+	return derive_simple_privkey(&secrets.htlc_basepoint_secret,
+				     &basepoints.htlc,
+				     remote_per_commit_point,
+				     htlc_privkey)
+		&& derive_simple_key(&basepoints.htlc,
+				     remote_per_commit_point,
+				     htlc_pubkey);
+}
+
+/* BOLT #3:
+ * ## HTLC-Timeout and HTLC-Success Transactions
+ *...
+ * * if `option_anchors` applies to this commitment transaction,
+ *   `SIGHASH_SINGLE|SIGHASH_ANYONECANPAY` is used as described in [BOLT #5]
+ */
+static void sign_remote_htlc_tx(struct bitcoin_tx *tx, const u8 *wscript,
+				const struct privkey *htlc_privkey,
+				const struct pubkey *htlc_pubkey,
+				bool option_anchor_outputs,
+				struct bitcoin_signature *sig)
+{
+	sign_tx_input(tx, 0, NULL, wscript, htlc_privkey, htlc_pubkey,
+		      option_anchor_outputs
+		      ? (SIGHASH_SINGLE|SIGHASH_ANYONECANPAY)
+		      : SIGHASH_ALL, sig);
+}
+
 /*~ This is used by channeld to create signatures for the remote peer's
  * HTLC transactions. */
 static u8 *handle_sign_remote_htlc_tx(struct hsmd_client *c, const u8 *msg_in)
 {
-	struct secret channel_seed;
 	struct bitcoin_tx *tx;
 	struct bitcoin_signature sig;
-	struct secrets secrets;
-	struct basepoints basepoints;
 	struct pubkey remote_per_commit_point;
 	u8 *wscript;
 	struct privkey htlc_privkey;
@@ -1339,36 +1405,51 @@ static u8 *handle_sign_remote_htlc_tx(struct hsmd_client *c, const u8 *msg_in)
 		return hsmd_status_malformed_request(c, msg_in);
 
 	tx->chainparams = c->chainparams;
-	get_channel_seed(&c->id, c->dbid, &channel_seed);
-	derive_basepoints(&channel_seed, NULL, &basepoints, &secrets, NULL);
-
-	if (!derive_simple_privkey(&secrets.htlc_basepoint_secret,
-				   &basepoints.htlc,
-				   &remote_per_commit_point,
-				   &htlc_privkey))
-		return hsmd_status_bad_request_fmt(
-		    c, msg_in, "Failed deriving htlc privkey");
-
-	if (!derive_simple_key(&basepoints.htlc,
-			       &remote_per_commit_point,
-			       &htlc_pubkey))
+	if (!derive_remote_htlc_keys(c, &remote_per_commit_point,
+				     &htlc_privkey, &htlc_pubkey))
 		return hsmd_status_bad_request_fmt(
-		    c, msg_in, "Failed deriving htlc pubkey");
+		    c, msg_in, "Failed deriving htlc keys");
 
-	/* BOLT #3:
-	 * ## HTLC-Timeout and HTLC-Success Transactions
-	 *...
-	 * * if `option_anchors` applies to this commitment transaction,
-	 *   `SIGHASH_SINGLE|SIGHASH_ANYONECANPAY` is used as described in [BOLT #5]
-	 */
-	sign_tx_input(tx, 0, NULL, wscript, &htlc_privkey, &htlc_pubkey,
-		      option_anchor_outputs
-		      ? (SIGHASH_SINGLE|SIGHASH_ANYONECANPAY)
-		      : SIGHASH_ALL, &sig);
+	sign_remote_htlc_tx(tx, wscript, &htlc_privkey, &htlc_pubkey,
+			    option_anchor_outputs, &sig);
 
 	return towire_hsmd_sign_tx_reply(NULL, &sig);
 }
 
+/*~ The same, for every HTLC transaction of a commitment at once: a busy
+ * channel can have hundreds, and channeld waits for each round trip before
+ * it can send `commitment_signed`. */
+static u8 *handle_sign_remote_htlc_txs(struct hsmd_client *c, const u8 *msg_in)
+{
+	struct remote_htlc_tx **htlc_txs;
+	struct bitcoin_signature *sigs;
+	struct pubkey remote_per_commit_point;
+	struct privkey htlc_privkey;
+	struct pubkey htlc_pubkey;
+	bool option_anchor_outputs;
+
+	if (!fromwire_hsmd_sign_remote_htlc_txs(tmpctx, msg_in,
+					       &htlc_txs,
+					       &remote_per_commit_point,
+					       &option_anchor_outputs))
+		return hsmd_status_malformed_request(c, msg_in);
+
+	if (!derive_remote_htlc_keys(c, &remote_per_commit_point,
+				     &htlc_privkey, &htlc_pubkey))
+		return hsmd_status_bad_request_fmt(
+		    c, msg_in, "Failed deriving htlc keys");
+
+	sigs = tal_arr(tmpctx, struct bitcoin_signature, tal_count(htlc_txs));
+	for (size_t i = 0; i < tal_count(htlc_txs); i++) {
+		htlc_txs[i]->tx->chainparams = c->chainparams;
+		sign_remote_htlc_tx(htlc_txs[i]->tx, htlc_txs[i]->wscript,
+				    &htlc_privkey, &htlc_pubkey,
+				    option_anchor_outputs, &sigs[i]);
+	}
+
+	return towire_hsmd_sign_remote_htlc_txs_reply(NULL, sigs);
+}
+
 /*~ This is used by channeld to create signatures for the remote peer's
  * commitment transaction.  It's functionally identical to signing our own,
  * but we expect to do this repeatedly as commitment transactions are
@@ -1912,6 +1993,8 @@ u8 *hsmd_handle_client_message(const tal_t *ctx, struct hsmd_client *client,
 		return handle_check_future_secret(client, msg);
 	case WIRE_HSMD_ECDH_REQ:
 		return handle_ecdh(client, msg);
+	case WIRE_HSMD_ECDH_BATCH_REQ:
+		return handle_ecdh_batch(client, msg);
 	case WIRE_HSMD_SIGN_INVOICE:
 		return handle_sign_invoice(client, msg);
 	case WIRE_HSMD_SIGN_OPTION_WILL_FUND_OFFER:
@@ -1944,6 +2027,8 @@ u8 *hsmd_handle_client_message(const tal_t *ctx, struct hsmd_client *client,
 		return handle_sign_local_htlc_tx(client, msg);
 	case WIRE_HSMD_SIGN_REMOTE_HTLC_TX:
 		return handle_sign_remote_htlc_tx(client, msg);
+	case WIRE_HSMD_SIGN_REMOTE_HTLC_TXS:
+		return handle_sign_remote_htlc_txs(client, msg);
 	case WIRE_HSMD_SIGN_REMOTE_COMMITMENT_TX:
 		return handle_sign_remote_commitment_tx(client, msg);
 	case WIRE_HSMD_SIGN_PENALTY_TO_US:
@@ -1977,6 +2062,7 @@ u8 *hsmd_handle_client_message(const tal_t *ctx, struct hsmd_client *client,
 
 	case WIRE_HSMD_DEV_MEMLEAK:
 	case WIRE_HSMD_ECDH_RESP:
+	case WIRE_HSMD_ECDH_BATCH_RESP:
 	case WIRE_HSMD_DERIVE_SECRET_REPLY:
 	case WIRE_HSMD_CANNOUNCEMENT_SIG_REPLY:
 	case WIRE_HSMD_CUPDATE_SIG_REPLY:
@@ -2006,6 +2092,7 @@ u8 *hsmd_handle_client_message(const tal_t *ctx, struct hsmd_client *client,
 	case WIRE_HSMD_CHECK_PUBKEY_REPLY:
 	case WIRE_HSMD_SIGN_ANCHORSPEND_REPLY:
 	case WIRE_HSMD_SIGN_HTLC_TX_MINGLE_REPLY:
+	case WIRE_HSMD_SIGN_REMOTE_HTLC_TXS_REPLY:
 		break;
 	}
 	return hsmd_status_bad_request(client, msg, "Unknown request");
@@ -2025,6 +2112,8 @@ u8 *hsmd_init(struct secret hsm_secret,
 		WIRE_HSMD_SIGN_ANCHORSPEND,
 		WIRE_HSMD_SIGN_HTLC_TX_MINGLE,
 		WIRE_HSMD_SIGN_SPLICE_TX,
+		WIRE_HSMD_SIGN_REMOTE_HTLC_TXS,
+		WIRE_HSMD_ECDH_BATCH_REQ,
 	};
 
 	/*~ Don't swap this. */
@@ -2163,3 +2252,10 @@ u8 *hsmd_init(struct secret hsm_secret,
 			    &node_id, &secretstuff.bip32,
 			    &bolt12));
 }
+
+void hsmd_relock_secrets(void)
+{
+	/*~ Locks aren't inherited across fork(). */
+	sodium_mlock(secretstuff.hsm_secret.data,
+		     sizeof(secretstuff.hsm_secret.data));
+}
@@ -50,6 +50,10 @@ struct hsmd_client {
 u8 *hsmd_init(struct secret hsm_secret,
 	      struct bip32_key_version bip32_key_version);
 
+/* Once hsmd_init is done, a fork()ed child can serve requests too: it
+ * needs to call this to keep the secrets out of swap. */
+void hsmd_relock_secrets(void);
+
 struct hsmd_client *hsmd_client_new_main(const tal_t *ctx, u64 capabilities,
 					 void *extra);
 
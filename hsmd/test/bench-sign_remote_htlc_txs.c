@@ -0,0 +1,218 @@
+#include "config.h"
+/* A commitment's HTLC signatures from a child hsmd: one request per HTLC
+ * against one for them all. */
+#include "../libhsmd.c"
+#include <ccan/cast/cast.h>
+#include <ccan/err/err.h>
+#include <ccan/time/time.h>
+#include <common/setup.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <wire/wire_sync.h>
+
+/* We provide these, instead of libhsmd_status.c: it would print every
+ * request we make. */
+u8 *hsmd_status_bad_request(struct hsmd_client *client, const u8 *msg,
+			    const char *error)
+{
+	errx(1, "Bad request %s: %s", tal_hex(tmpctx, msg), error);
+}
+
+void hsmd_status_fmt(enum log_level level, const struct node_id *peer,
+		     const char *fmt, ...)
+{
+}
+
+void hsmd_status_failed(enum status_failreason reason, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	verrx(1, fmt, ap);
+	va_end(ap);
+}
+
+/* Like channeld's hsmd client. */
+static struct hsmd_client *channeld_client(const tal_t *ctx)
+{
+	struct hsmd_client *c;
+	struct node_id peer_id;
+
+	memset(&peer_id, 2, sizeof(peer_id));
+	c = hsmd_client_new_peer(ctx,
+				 HSM_CAP_SIGN_GOSSIP
+				 | HSM_CAP_ECDH
+				 | HSM_CAP_COMMITMENT_POINT
+				 | HSM_CAP_SIGN_REMOTE_TX
+				 | HSM_CAP_SIGN_ONCHAIN_TX,
+				 1, &peer_id, NULL);
+	c->chainparams = chainparams;
+	return c;
+}
+
+/* The "hsmd": answer every request until they hang up. */
+static pid_t start_hsmd(int fds[2])
+{
+	struct secret hsm_secret;
+	struct bip32_key_version bip32_key_version;
+	struct hsmd_client *client;
+	const u8 *msg;
+	pid_t pid;
+
+	/* Don't let the child flush our stdout too. */
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		err(1, "fork");
+	if (pid != 0)
+		return pid;
+
+	/* Otherwise we'd never see EOF. */
+	close(fds[0]);
+	memset(&hsm_secret, 1, sizeof(hsm_secret));
+	bip32_key_version.bip32_pubkey_version = BIP32_VER_TEST_PUBLIC;
+	bip32_key_version.bip32_privkey_version = BIP32_VER_TEST_PRIVATE;
+	tal_free(hsmd_init(hsm_secret, bip32_key_version));
+	client = channeld_client(NULL);
+
+	while ((msg = wire_sync_read(tmpctx, fds[1])) != NULL) {
+		const u8 *reply = hsmd_handle_client_message(tmpctx, client,
+							     msg);
+		if (!wire_sync_write(fds[1], take(reply)))
+			err(1, "Writing reply");
+		clean_tmpctx();
+	}
+	exit(0);
+}
+
+/* Roughly an HTLC-timeout tx: what we sign doesn't matter. */
+static struct remote_htlc_tx *new_htlc_tx(const tal_t *ctx, size_t n)
+{
+	struct remote_htlc_tx *htlc_tx = tal(ctx, struct remote_htlc_tx);
+	struct bitcoin_outpoint outpoint;
+
+	memset(&outpoint.txid, 3, sizeof(outpoint.txid));
+	outpoint.n = n;
+
+	/* offered HTLC output scripts are 133 bytes */
+	htlc_tx->wscript = tal_arr(htlc_tx, u8, 133);
+	memset(htlc_tx->wscript, n, tal_bytelen(htlc_tx->wscript));
+
+	htlc_tx->tx = bitcoin_tx(htlc_tx, chainparams, 1, 1, 800000);
+	bitcoin_tx_add_input(htlc_tx->tx, &outpoint, 1, NULL,
+			     AMOUNT_SAT(100000), NULL, htlc_tx->wscript);
+	bitcoin_tx_add_output(htlc_tx->tx,
+			      scriptpubkey_p2wsh(tmpctx, htlc_tx->wscript),
+			      htlc_tx->wscript, AMOUNT_SAT(99000));
+	bitcoin_tx_finalize(htlc_tx->tx);
+	return htlc_tx;
+}
+
+/* What channeld used to do. */
+static void sign_one_by_one(int fd, struct remote_htlc_tx **htlc_txs,
+			    const struct pubkey *remote_per_commit)
+{
+	for (size_t i = 0; i < tal_count(htlc_txs); i++) {
+		struct bitcoin_signature sig;
+		const u8 *msg;
+
+		msg = towire_hsmd_sign_remote_htlc_tx(NULL, htlc_txs[i]->tx,
+						      htlc_txs[i]->wscript,
+						      remote_per_commit, true);
+		if (!wire_sync_write(fd, take(msg)))
+			err(1, "Writing sign_remote_htlc_tx");
+		msg = wire_sync_read(tmpctx, fd);
+		if (!msg || !fromwire_hsmd_sign_tx_reply(msg, &sig))
+			errx(1, "Bad sign_remote_htlc_tx reply");
+	}
+}
+
+static void sign_all(int fd, struct remote_htlc_tx **htlc_txs,
+		     const struct pubkey *remote_per_commit)
+{
+	struct bitcoin_signature *sigs;
+	const u8 *msg;
+
+	msg = towire_hsmd_sign_remote_htlc_txs(NULL,
+					       cast_const2(const struct remote_htlc_tx **,
+							   htlc_txs),
+					       remote_per_commit, true);
+	if (!wire_sync_write(fd, take(msg)))
+		err(1, "Writing sign_remote_htlc_txs");
+	msg = wire_sync_read(tmpctx, fd);
+	if (!msg
+	    || !fromwire_hsmd_sign_remote_htlc_txs_reply(tmpctx, msg, &sigs))
+		errx(1, "Bad sign_remote_htlc_txs reply");
+}
+
+static u64 run(int fd, size_t num_commitments, struct remote_htlc_tx **htlc_txs,
+	       const struct pubkey *remote_per_commit,
+	       void (*sign)(int, struct remote_htlc_tx **,
+			    const struct pubkey *))
+{
+	struct timemono start = time_mono();
+
+	for (size_t i = 0; i < num_commitments; i++) {
+		sign(fd, htlc_txs, remote_per_commit);
+		clean_tmpctx();
+	}
+	return time_to_usec(timemono_since(start));
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_commitments = 100, max_htlcs = 483;
+	struct privkey privkey;
+	struct pubkey remote_per_commit;
+	int fds[2];
+	pid_t pid;
+
+	common_setup(argv[0]);
+	chainparams = chainparams_for_network("regtest");
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<num-commitments> [<max-htlcs>]]", argv[0]);
+	if (argc > 1)
+		num_commitments = atol(argv[1]);
+	if (argc > 2)
+		max_htlcs = atol(argv[2]);
+
+	memset(&privkey, 4, sizeof(privkey));
+	if (!pubkey_from_privkey(&privkey, &remote_per_commit))
+		errx(1, "Bad privkey");
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		err(1, "socketpair");
+	pid = start_hsmd(fds);
+	close(fds[1]);
+
+	for (size_t n = 1; ; n *= 10) {
+		struct remote_htlc_tx **htlc_txs;
+		u64 one_usec, all_usec;
+
+		if (n > max_htlcs)
+			n = max_htlcs;
+		htlc_txs = tal_arr(NULL, struct remote_htlc_tx *, n);
+		for (size_t i = 0; i < n; i++)
+			htlc_txs[i] = new_htlc_tx(htlc_txs, i);
+
+		one_usec = run(fds[0], num_commitments, htlc_txs,
+			       &remote_per_commit, sign_one_by_one);
+		all_usec = run(fds[0], num_commitments, htlc_txs,
+			       &remote_per_commit, sign_all);
+		printf("# %zu htlcs: one by one %"PRIu64" usec, all at once %"PRIu64" usec per commitment\n",
+		       n,
+		       num_commitments ? one_usec / num_commitments : 0,
+		       num_commitments ? all_usec / num_commitments : 0);
+		tal_free(htlc_txs);
+		if (n == max_htlcs)
+			break;
+	}
+
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+	common_shutdown();
+	return 0;
+}
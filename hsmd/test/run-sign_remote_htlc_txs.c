@@ -0,0 +1,129 @@
+#include "config.h"
+#include "../libhsmd.c"
+#include <assert.h>
+#include <ccan/cast/cast.h>
+#include <ccan/mem/mem.h>
+#include <common/setup.h>
+#include <stdio.h>
+
+/* We provide these, instead of libhsmd_status.c. */
+u8 *hsmd_status_bad_request(struct hsmd_client *client, const u8 *msg,
+			    const char *error)
+{
+	fprintf(stderr, "Bad request %s: %s\n", tal_hex(tmpctx, msg), error);
+	abort();
+}
+
+void hsmd_status_fmt(enum log_level level, const struct node_id *peer,
+		     const char *fmt, ...)
+{
+}
+
+void hsmd_status_failed(enum status_failreason reason, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+static struct remote_htlc_tx *new_htlc_tx(const tal_t *ctx, size_t n)
+{
+	struct remote_htlc_tx *htlc_tx = tal(ctx, struct remote_htlc_tx);
+	struct bitcoin_outpoint outpoint;
+
+	memset(&outpoint.txid, 3, sizeof(outpoint.txid));
+	outpoint.n = n;
+
+	htlc_tx->wscript = tal_arr(htlc_tx, u8, 133);
+	memset(htlc_tx->wscript, n, tal_bytelen(htlc_tx->wscript));
+
+	htlc_tx->tx = bitcoin_tx(htlc_tx, chainparams, 1, 1, 800000);
+	bitcoin_tx_add_input(htlc_tx->tx, &outpoint, 1, NULL,
+			     AMOUNT_SAT(100000), NULL, htlc_tx->wscript);
+	bitcoin_tx_add_output(htlc_tx->tx,
+			      scriptpubkey_p2wsh(tmpctx, htlc_tx->wscript),
+			      htlc_tx->wscript, AMOUNT_SAT(99000));
+	bitcoin_tx_finalize(htlc_tx->tx);
+	return htlc_tx;
+}
+
+/* One request for them all must give the same signatures as one
+ * request each. */
+static void check_sigs(struct hsmd_client *client, size_t num,
+		       const struct pubkey *remote_per_commit,
+		       bool option_anchor_outputs)
+{
+	struct remote_htlc_tx **htlc_txs;
+	struct bitcoin_signature *sigs;
+	const u8 *msg;
+
+	htlc_txs = tal_arr(tmpctx, struct remote_htlc_tx *, num);
+	for (size_t i = 0; i < num; i++)
+		htlc_txs[i] = new_htlc_tx(htlc_txs, i);
+
+	msg = towire_hsmd_sign_remote_htlc_txs(tmpctx,
+					       cast_const2(const struct remote_htlc_tx **,
+							   htlc_txs),
+					       remote_per_commit,
+					       option_anchor_outputs);
+	msg = hsmd_handle_client_message(tmpctx, client, msg);
+	assert(fromwire_hsmd_sign_remote_htlc_txs_reply(tmpctx, msg, &sigs));
+	assert(tal_count(sigs) == num);
+
+	for (size_t i = 0; i < num; i++) {
+		struct bitcoin_signature sig;
+
+		msg = towire_hsmd_sign_remote_htlc_tx(tmpctx, htlc_txs[i]->tx,
+						      htlc_txs[i]->wscript,
+						      remote_per_commit,
+						      option_anchor_outputs);
+		msg = hsmd_handle_client_message(tmpctx, client, msg);
+		assert(fromwire_hsmd_sign_tx_reply(msg, &sig));
+		assert(sig.sighash_type == sigs[i].sighash_type);
+		assert(memeq(sig.s.data, sizeof(sig.s.data),
+			     sigs[i].s.data, sizeof(sigs[i].s.data)));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct secret hsm_secret;
+	struct bip32_key_version bip32_key_version;
+	struct hsmd_client *client;
+	struct privkey privkey;
+	struct pubkey remote_per_commit;
+	struct node_id peer_id;
+
+	common_setup(argv[0]);
+	chainparams = chainparams_for_network("regtest");
+
+	memset(&hsm_secret, 1, sizeof(hsm_secret));
+	bip32_key_version.bip32_pubkey_version = BIP32_VER_TEST_PUBLIC;
+	bip32_key_version.bip32_privkey_version = BIP32_VER_TEST_PRIVATE;
+	tal_free(hsmd_init(hsm_secret, bip32_key_version));
+
+	/* Like channeld's client. */
+	memset(&peer_id, 2, sizeof(peer_id));
+	client = hsmd_client_new_peer(tmpctx,
+				      HSM_CAP_SIGN_GOSSIP
+				      | HSM_CAP_ECDH
+				      | HSM_CAP_COMMITMENT_POINT
+				      | HSM_CAP_SIGN_REMOTE_TX
+				      | HSM_CAP_SIGN_ONCHAIN_TX,
+				      1, &peer_id, NULL);
+	client->chainparams = chainparams;
+
+	memset(&privkey, 4, sizeof(privkey));
+	assert(pubkey_from_privkey(&privkey, &remote_per_commit));
+
+	check_sigs(client, 0, &remote_per_commit, true);
+	check_sigs(client, 1, &remote_per_commit, true);
+	check_sigs(client, 10, &remote_per_commit, true);
+	check_sigs(client, 10, &remote_per_commit, false);
+
+	common_shutdown();
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include "config.h"
+#define main unused_main
+int unused_main(int argc, char *argv[]);
+#include "../hsmd.c"
+#include "../libhsmd.c"
+#undef main
+#include <ccan/mem/mem.h>
+#include <common/setup.h>
+#include <common/status_wiregen.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/wait.h>
+
+static void client_gone(struct client *c)
+{
+	io_break(c);
+}
+
+/* Skips everything else hsmd tells lightningd. */
+static u8 *read_status(int fd, int type)
+{
+	u8 *msg;
+
+	do {
+		msg = wire_sync_read(tmpctx, fd);
+		assert(msg);
+	} while (fromwire_peektype(msg) != type);
+	return msg;
+}
+
+/* Sends it a sign_remote_htlc_tx with nothing in it, and returns what we
+ * tell lightningd about it. */
+static u8 *bad_request(int status_fd, const struct node_id *peer_id)
+{
+	struct client *c;
+	int fds[2];
+	u8 *msg;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	c = new_client(NULL, chainparams, peer_id, 1,
+		       HSM_CAP_SIGN_GOSSIP
+		       | HSM_CAP_ECDH
+		       | HSM_CAP_COMMITMENT_POINT
+		       | HSM_CAP_SIGN_REMOTE_TX
+		       | HSM_CAP_SIGN_ONCHAIN_TX,
+		       fds[0]);
+	tal_add_destructor(c, client_gone);
+
+	msg = tal_arr(tmpctx, u8, 0);
+	towire_u16(&msg, WIRE_HSMD_SIGN_REMOTE_HTLC_TX);
+	assert(wire_sync_write(fds[1], msg));
+	assert(io_loop(NULL, NULL) == c);
+
+	/* It closed the client... */
+	assert(!wire_sync_read(tmpctx, fds[1]));
+	close(fds[1]);
+
+	/* ... and told lightningd why. */
+	daemon_conn_sync_flush(status_conn);
+	return read_status(status_fd, WIRE_HSMSTATUS_CLIENT_BAD_REQUEST);
+}
+
+static void check_dead_worker(int status_fd)
+{
+	struct worker *w = workers[0];
+	enum status_failreason reason;
+	char *desc;
+	int wstatus;
+	pid_t pid;
+	u8 *msg;
+
+	/* worker_gone doesn't return, so we watch it from here. */
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		io_loop(NULL, NULL);
+		abort();
+	}
+
+	kill(w->pid, SIGKILL);
+	assert(waitpid(w->pid, NULL, 0) == w->pid);
+
+	msg = read_status(status_fd, WIRE_STATUS_FAIL);
+	assert(fromwire_status_fail(tmpctx, msg, &reason, &desc));
+	assert(reason == STATUS_FAIL_INTERNAL_ERROR);
+	assert(streq(desc, tal_fmt(tmpctx, "Worker 0 (pid %i) exited",
+				   (int)w->pid)));
+
+	assert(waitpid(pid, &wstatus, 0) == pid);
+	assert(WIFEXITED(wstatus));
+	assert(WEXITSTATUS(wstatus) == (0x80 | STATUS_FAIL_INTERNAL_ERROR));
+}
+
+int main(int argc, char *argv[])
+{
+	struct bip32_key_version bip32_key_version;
+	struct privkey privkey;
+	struct pubkey pubkey;
+	struct node_id peer_id, id;
+	wirestring *error;
+	u8 *inline_msg, *worker_msg, *msg;
+	int status_fds[2];
+
+	common_setup(argv[0]);
+	chainparams = chainparams_for_network("regtest");
+
+	/* worker_loop closes REQ_FD: make sure that's nothing of ours. */
+	assert(dup2(open("/dev/null", O_RDONLY), REQ_FD) == REQ_FD);
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, status_fds) == 0);
+	status_conn = daemon_conn_new(NULL, status_fds[0], NULL, NULL, NULL);
+	status_setup_async(status_conn);
+	uintmap_init(&clients);
+	uintmap_init(&latencies);
+
+	memset(&hsm_secret, 1, sizeof(hsm_secret));
+	bip32_key_version.bip32_pubkey_version = BIP32_VER_TEST_PUBLIC;
+	bip32_key_version.bip32_privkey_version = BIP32_VER_TEST_PRIVATE;
+	tal_free(hsmd_init(hsm_secret, bip32_key_version));
+
+	/* new_client insists on a valid one. */
+	memset(&privkey, 2, sizeof(privkey));
+	assert(pubkey_from_privkey(&privkey, &pubkey));
+	node_id_from_pubkey(&peer_id, &pubkey);
+
+	/* No workers yet: we do it ourselves. */
+	inline_msg = bad_request(status_fds[1], &peer_id);
+	assert(fromwire_hsmstatus_client_bad_request(tmpctx, inline_msg,
+						     &id, &error, &msg));
+	assert(node_id_eq(&id, &peer_id));
+	assert(streq(error, "could not parse request"));
+
+	/* A worker must drop it just the same. */
+	start_workers(1);
+	worker_msg = bad_request(status_fds[1], &peer_id);
+	assert(memeq(inline_msg, tal_bytelen(inline_msg),
+		     worker_msg, tal_bytelen(worker_msg)));
+
+	check_dead_worker(status_fds[1]);
+
+	tal_free(workers);
+	tal_free(status_conn);
+	common_shutdown();
+	return 0;
+}
@@ -66,6 +66,7 @@ static void destroy_channel(struct channel *channel)
 	/* Must not have any HTLCs! */
 	struct htlc_out *hout = channel_has_htlc_out(channel);
 	struct htlc_in *hin = channel_has_htlc_in(channel);
+	struct lightningd *ld = channel->peer->ld;
 
 	if (hout)
 		fatal("Freeing channel %s has hout %s",
@@ -85,6 +86,70 @@ static void destroy_channel(struct channel *channel)
 	channel_set_owner(channel, NULL);
 
 	list_del_from(&channel->peer->channels, &channel->list);
+	if (channel->scid)
+		channel_scid_map_del(ld->channels_by_scid, channel);
+	if (channel->alias[LOCAL])
+		channel_alias_map_del(ld->channels_by_alias, channel);
+	if (channel->dbid)
+		channel_dbid_map_del(ld->channels_by_dbid, channel);
+	channel_cid_map_del(ld->channels_by_cid, channel);
+}
+
+void channel_set_dbid(struct channel *channel, u64 dbid)
+{
+	assert(!channel->dbid);
+	assert(dbid);
+	channel->dbid = dbid;
+	channel_dbid_map_add(channel->peer->ld->channels_by_dbid, channel);
+}
+
+void channel_set_scid(struct channel *channel,
+		      const struct short_channel_id *scid)
+{
+	struct lightningd *ld = channel->peer->ld;
+
+	if (channel->scid) {
+		channel_scid_map_del(ld->channels_by_scid, channel);
+		if (!scid) {
+			channel->scid = tal_free(channel->scid);
+			return;
+		}
+	} else if (scid)
+		channel->scid = tal(channel, struct short_channel_id);
+	else
+		return;
+
+	*channel->scid = *scid;
+	channel_scid_map_add(ld->channels_by_scid, channel);
+}
+
+void channel_set_local_alias(struct channel *channel,
+			     const struct short_channel_id *alias)
+{
+	struct lightningd *ld = channel->peer->ld;
+
+	if (channel->alias[LOCAL]) {
+		channel_alias_map_del(ld->channels_by_alias, channel);
+		if (!alias) {
+			channel->alias[LOCAL] = tal_free(channel->alias[LOCAL]);
+			return;
+		}
+	} else if (alias)
+		channel->alias[LOCAL] = tal(channel, struct short_channel_id);
+	else
+		return;
+
+	*channel->alias[LOCAL] = *alias;
+	channel_alias_map_add(ld->channels_by_alias, channel);
+}
+
+void channel_set_cid(struct channel *channel, const struct channel_id *cid)
+{
+	struct lightningd *ld = channel->peer->ld;
+
+	channel_cid_map_del(ld->channels_by_cid, channel);
+	channel->cid = *cid;
+	channel_cid_map_add(ld->channels_by_cid, channel);
 }
 
 void delete_channel(struct channel *channel STEALS)
@@ -289,6 +354,9 @@ struct channel *new_unsaved_channel(struct peer *peer,
 	channel->forgets = tal_arr(channel, struct command *, 0);
 	list_add_tail(&peer->channels, &channel->list);
 	channel->rr_number = peer->ld->rr_counter++;
+	/* Caller sets this with channel_set_cid() */
+	memset(&channel->cid, 0, sizeof(channel->cid));
+	channel_cid_map_add(ld->channels_by_cid, channel);
 	tal_add_destructor(channel, destroy_channel);
 
 	list_head_init(&channel->inflights);
@@ -544,6 +612,12 @@ struct channel *new_channel(struct peer *peer, u64 dbid,
 
 	list_add_tail(&peer->channels, &channel->list);
 	channel->rr_number = peer->ld->rr_counter++;
+	if (channel->scid)
+		channel_scid_map_add(peer->ld->channels_by_scid, channel);
+	if (channel->alias[LOCAL])
+		channel_alias_map_add(peer->ld->channels_by_alias, channel);
+	channel_dbid_map_add(peer->ld->channels_by_dbid, channel);
+	channel_cid_map_add(peer->ld->channels_by_cid, channel);
 	tal_add_destructor(channel, destroy_channel);
 
 	list_head_init(&channel->inflights);
@@ -661,81 +735,43 @@ struct channel *any_channel_by_scid(struct lightningd *ld,
 				    const struct short_channel_id *scid,
 				    bool privacy_leak_ok)
 {
-	struct peer *p;
 	struct channel *chan;
-	struct peer_node_id_map_iter it;
-
-	/* FIXME: Support lookup by scid directly! */
-	for (p = peer_node_id_map_first(ld->peers, &it);
-	     p;
-	     p = peer_node_id_map_next(ld->peers, &it)) {
-		list_for_each(&p->channels, chan, list) {
-			/* BOLT #2:
-			 * - MUST always recognize the `alias` as a
-			 *   `short_channel_id` for incoming HTLCs to this
-			 *   channel.
-			 */
-			if (chan->alias[LOCAL] &&
-			    short_channel_id_eq(scid, chan->alias[LOCAL]))
-				return chan;
-			/* BOLT #2:
-			 * - if `channel_type` has `option_scid_alias` set:
-			 *   - MUST NOT allow incoming HTLCs to this channel
-			 *     using the real `short_channel_id`
-			 */
-			if (!privacy_leak_ok
-			    && channel_type_has(chan->type, OPT_SCID_ALIAS))
-				continue;
-			if (chan->scid
-			    && short_channel_id_eq(scid, chan->scid))
-				return chan;
-		}
+	struct channel_scid_map_iter it;
+
+	/* BOLT #2:
+	 * - MUST always recognize the `alias` as a
+	 *   `short_channel_id` for incoming HTLCs to this
+	 *   channel.
+	 */
+	chan = channel_alias_map_get(ld->channels_by_alias, scid);
+	if (chan)
+		return chan;
+
+	for (chan = channel_scid_map_getfirst(ld->channels_by_scid, scid, &it);
+	     chan;
+	     chan = channel_scid_map_getnext(ld->channels_by_scid, scid, &it)) {
+		/* BOLT #2:
+		 * - if `channel_type` has `option_scid_alias` set:
+		 *   - MUST NOT allow incoming HTLCs to this channel
+		 *     using the real `short_channel_id`
+		 */
+		if (!privacy_leak_ok
+		    && channel_type_has(chan->type, OPT_SCID_ALIAS))
+			continue;
+		return chan;
 	}
 	return NULL;
 }
 
 struct channel *channel_by_dbid(struct lightningd *ld, const u64 dbid)
 {
-	struct peer *p;
-	struct channel *chan;
-	struct peer_node_id_map_iter it;
-
-	/* FIXME: Support lookup by id directly! */
-	for (p = peer_node_id_map_first(ld->peers, &it);
-	     p;
-	     p = peer_node_id_map_next(ld->peers, &it)) {
-		list_for_each(&p->channels, chan, list) {
-			if (chan->dbid == dbid)
-				return chan;
-		}
-	}
-	return NULL;
+	return channel_dbid_map_get(ld->channels_by_dbid, dbid);
 }
 
 struct channel *channel_by_cid(struct lightningd *ld,
 			       const struct channel_id *cid)
 {
-	struct peer *p;
-	struct channel *channel;
-	struct peer_node_id_map_iter it;
-
-	/* FIXME: Support lookup by cid directly! */
-	for (p = peer_node_id_map_first(ld->peers, &it);
-	     p;
-	     p = peer_node_id_map_next(ld->peers, &it)) {
-		if (p->uncommitted_channel) {
-			/* We can't use this method for old, uncommitted
-			 * channels; there's no "channel" struct here! */
-			if (channel_id_eq(&p->uncommitted_channel->cid, cid))
-				return NULL;
-		}
-		list_for_each(&p->channels, channel, list) {
-			if (channel_id_eq(&channel->cid, cid)) {
-				return channel;
-			}
-		}
-	}
-	return NULL;
+	return channel_cid_map_get(ld->channels_by_cid, cid);
 }
 
 struct channel *find_channel_by_id(const struct peer *peer,
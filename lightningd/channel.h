@@ -1,8 +1,11 @@
 #ifndef LIGHTNING_LIGHTNINGD_CHANNEL_H
 #define LIGHTNING_LIGHTNINGD_CHANNEL_H
 #include "config.h"
+#include <ccan/crypto/siphash24/siphash24.h>
+#include <ccan/htable/htable_type.h>
 #include <common/channel_id.h>
 #include <common/channel_type.h>
+#include <common/pseudorand.h>
 #include <common/scb_wiregen.h>
 #include <common/tx_roles.h>
 #include <common/utils.h>
@@ -94,7 +97,7 @@ struct channel {
 	/* Open attempt */
 	struct open_attempt *open_attempt;
 
-	/* Database ID: 0 == not in db yet */
+	/* Database ID: 0 == not in db yet (see channel_set_dbid) */
 	u64 dbid;
 
 	/* Populated by new_unsaved_channel */
@@ -150,7 +153,7 @@ struct channel {
 
 	struct amount_msat push;
 	bool remote_channel_ready;
-	/* Channel if locked locally. */
+	/* Channel if locked locally (see channel_set_scid). */
 	struct short_channel_id *scid;
 
 	/* Alias used for option_zeroconf, or option_scid_alias, if
@@ -159,6 +162,7 @@ struct channel {
 	 * use in a routehint. */
 	struct short_channel_id *alias[NUM_SIDES];
 
+	/* See channel_set_cid */
 	struct channel_id cid;
 
 	/* Amount going to us, not counting unfinished HTLCs; if we have one. */
@@ -438,6 +442,15 @@ struct channel *peer_any_unsaved_channel(struct peer *peer, bool *others);
 
 struct channel *channel_by_dbid(struct lightningd *ld, const u64 dbid);
 
+/* These keep ld's channel hash tables up to date: don't set those fields
+ * directly! */
+void channel_set_dbid(struct channel *channel, u64 dbid);
+void channel_set_scid(struct channel *channel,
+		      const struct short_channel_id *scid);
+void channel_set_local_alias(struct channel *channel,
+			     const struct short_channel_id *alias);
+void channel_set_cid(struct channel *channel, const struct channel_id *cid);
+
 /* Includes both real scids and aliases.  If !privacy_leak_ok, then private
  * channels' real scids are not included. */
 struct channel *any_channel_by_scid(struct lightningd *ld,
@@ -550,4 +563,83 @@ struct htlc_out *channel_has_htlc_out(struct channel *channel);
 const u8 *get_channel_update(struct channel *channel);
 
 struct amount_msat htlc_max_possible_send(const struct channel *channel);
+
+static inline size_t scid_hash(const struct short_channel_id *scid)
+{
+	return siphash24(siphash_seed(), scid, sizeof(*scid));
+}
+
+static const struct short_channel_id *channel_scid(const struct channel *channel)
+{
+	return channel->scid;
+}
+
+static bool channel_scid_eq(const struct channel *channel,
+			    const struct short_channel_id *scid)
+{
+	return short_channel_id_eq(channel->scid, scid);
+}
+
+/* Defines struct channel_scid_map (can have duplicates, for stub scids) */
+HTABLE_DEFINE_TYPE(struct channel,
+		   channel_scid, scid_hash, channel_scid_eq,
+		   channel_scid_map);
+
+static const struct short_channel_id *channel_local_alias(const struct channel *channel)
+{
+	return channel->alias[LOCAL];
+}
+
+static bool channel_local_alias_eq(const struct channel *channel,
+				   const struct short_channel_id *alias)
+{
+	return short_channel_id_eq(channel->alias[LOCAL], alias);
+}
+
+/* Defines struct channel_alias_map */
+HTABLE_DEFINE_TYPE(struct channel,
+		   channel_local_alias, scid_hash, channel_local_alias_eq,
+		   channel_alias_map);
+
+static inline size_t channel_dbid_hash(u64 dbid)
+{
+	return siphash24(siphash_seed(), &dbid, sizeof(dbid));
+}
+
+static u64 channel_dbid(const struct channel *channel)
+{
+	assert(channel->dbid);
+	return channel->dbid;
+}
+
+static bool channel_dbid_eq(const struct channel *channel, u64 dbid)
+{
+	return channel->dbid == dbid;
+}
+
+/* Defines struct channel_dbid_map */
+HTABLE_DEFINE_TYPE(struct channel,
+		   channel_dbid, channel_dbid_hash, channel_dbid_eq,
+		   channel_dbid_map);
+
+static inline size_t channel_id_hash(const struct channel_id *cid)
+{
+	return siphash24(siphash_seed(), cid->id, sizeof(cid->id));
+}
+
+static const struct channel_id *channel_cid(const struct channel *channel)
+{
+	return &channel->cid;
+}
+
+static bool channel_cid_eq(const struct channel *channel,
+			   const struct channel_id *cid)
+{
+	return channel_id_eq(&channel->cid, cid);
+}
+
+/* Defines struct channel_cid_map */
+HTABLE_DEFINE_TYPE(struct channel,
+		   channel_cid, channel_id_hash, channel_cid_eq,
+		   channel_cid_map);
 #endif /* LIGHTNING_LIGHTNINGD_CHANNEL_H */
@@ -14,6 +14,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <hsmd/capabilities.h>
+#include <hsmd/hsmd_wiregen.h>
 #include <lightningd/chaintopology.h>
 #include <lightningd/channel.h>
 #include <lightningd/channel_control.h>
@@ -1479,7 +1480,8 @@ bool peer_start_channeld(struct channel *channel,
 				       channel->channel_update,
 				       ld->experimental_upgrade_protocol,
 				       cast_const2(const struct inflight **,
-						   inflights));
+						   inflights),
+				       hsm_capable(ld, WIRE_HSMD_SIGN_REMOTE_HTLC_TXS));
 
 	/* We don't expect a response: we are triggered by funding_depth_cb. */
 	subd_send_msg(channel->owner, take(initmsg));
@@ -1511,6 +1513,7 @@ bool channel_tell_depth(struct lightningd *ld,
 	const char *txidstr;
 	struct txlocator *loc;
 	u32 outnum;
+	struct short_channel_id scid;
 
 	txidstr = type_to_string(tmpctx, struct bitcoin_txid, txid);
 	channel->depth = depth;
@@ -1539,7 +1542,7 @@ bool channel_tell_depth(struct lightningd *ld,
 			return false;
 		}
 
-		if (!mk_short_channel_id(channel->scid,
+		if (!mk_short_channel_id(&scid,
 					 loc->blkheight, loc->index,
 					 outnum)) {
 			channel_fail_permanent(channel,
@@ -1549,6 +1552,7 @@ bool channel_tell_depth(struct lightningd *ld,
 					       channel->funding.n);
 			return false;
 		}
+		channel_set_scid(channel, &scid);
 	}
 
 	if (streq(channel->owner->name, "dualopend")) {
@@ -574,6 +574,7 @@ static unsigned connectd_msg(struct subd *connectd, const u8 *msg, const int *fd
 	case WIRE_CONNECTD_DEV_MEMLEAK:
 	case WIRE_CONNECTD_DEV_SUPPRESS_GOSSIP:
 	case WIRE_CONNECTD_DEV_REPORT_FDS:
+	case WIRE_CONNECTD_DEV_PEER_WRITES:
 	case WIRE_CONNECTD_PEER_FINAL_MSG:
 	case WIRE_CONNECTD_PEER_CONNECT_SUBD:
 	case WIRE_CONNECTD_PING:
@@ -584,6 +585,7 @@ static unsigned connectd_msg(struct subd *connectd, const u8 *msg, const int *fd
 	case WIRE_CONNECTD_INIT_REPLY:
 	case WIRE_CONNECTD_ACTIVATE_REPLY:
 	case WIRE_CONNECTD_DEV_MEMLEAK_REPLY:
+	case WIRE_CONNECTD_DEV_PEER_WRITES_REPLY:
 	case WIRE_CONNECTD_PING_REPLY:
 	case WIRE_CONNECTD_START_SHUTDOWN_REPLY:
 		break;
@@ -882,4 +884,59 @@ static const struct json_command dev_report_fds = {
 	"Ask connectd to report status of all its open files."
 };
 AUTODATA(json_command, &dev_report_fds);
+
+static void dev_peer_writes_reply(struct subd *connectd,
+				  const u8 *msg, const int *fds,
+				  struct command *cmd)
+{
+	bool found;
+	u64 msgs_written, writes;
+	struct json_stream *response;
+
+	if (!fromwire_connectd_dev_peer_writes_reply(msg, &found,
+						     &msgs_written, &writes)) {
+		log_broken(connectd->log, "Malformed dev_peer_writes reply %s",
+			   tal_hex(tmpctx, msg));
+		was_pending(command_fail(cmd, LIGHTNINGD,
+					 "Bad reply message"));
+		return;
+	}
+
+	if (!found) {
+		was_pending(command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+					 "Peer not connected"));
+		return;
+	}
+
+	response = json_stream_success(cmd);
+	json_add_u64(response, "messages", msgs_written);
+	json_add_u64(response, "writes", writes);
+	was_pending(command_success(cmd, response));
+}
+
+static struct command_result *json_dev_peer_writes(struct command *cmd,
+						   const char *buffer,
+						   const jsmntok_t *obj UNNEEDED,
+						   const jsmntok_t *params)
+{
+	struct node_id *id;
+
+	if (!param(cmd, buffer, params,
+		   p_req("id", param_node_id, &id),
+		   NULL))
+		return command_param_failed();
+
+	subd_req(cmd, cmd->ld->connectd,
+		 take(towire_connectd_dev_peer_writes(NULL, id)),
+		 -1, 0, dev_peer_writes_reply, cmd);
+	return command_still_pending(cmd);
+}
+
+static const struct json_command dev_peer_writes = {
+	"dev-peer-writes",
+	"developer",
+	json_dev_peer_writes,
+	"Ask connectd how many messages it has sent to peer {id}, in how many writes."
+};
+AUTODATA(json_command, &dev_peer_writes);
 #endif /* DEVELOPER */
@@ -698,7 +698,7 @@ openchannel2_hook_cb(struct openchannel2_payload *payload STEALS)
 	} else
 		our_shutdown_script_wallet_index = NULL;
 
-	channel->cid = payload->channel_id;
+	channel_set_cid(channel, &payload->channel_id);
 	channel->opener = REMOTE;
 	channel->open_attempt = new_channel_open_attempt(channel);
 	channel->req_confirmed_ins[REMOTE] =
@@ -1220,6 +1220,7 @@ wallet_commit_channel(struct lightningd *ld,
 {
 	struct amount_msat our_msat, lease_fee_msat;
 	struct channel_inflight *inflight;
+	struct short_channel_id alias;
 	bool any_active = peer_any_active_channel(channel->peer, NULL);
 
 	if (!amount_sat_to_msat(&our_msat, our_funding)) {
@@ -1246,7 +1247,7 @@ wallet_commit_channel(struct lightningd *ld,
 
 	/* Promote the unsaved_dbid to the dbid */
 	assert(channel->unsaved_dbid != 0);
-	channel->dbid = channel->unsaved_dbid;
+	channel_set_dbid(channel, channel->unsaved_dbid);
 	channel->unsaved_dbid = 0;
 
 	channel->funding = *funding;
@@ -1295,8 +1296,8 @@ wallet_commit_channel(struct lightningd *ld,
 	 /* Can't have gotten their alias for this channel yet. */
 	channel->alias[REMOTE] = NULL;
 	/* We do generate one ourselves however. */
-	channel->alias[LOCAL] = tal(channel, struct short_channel_id);
-	randombytes_buf(channel->alias[LOCAL], sizeof(struct short_channel_id));
+	randombytes_buf(&alias, sizeof(alias));
+	channel_set_local_alias(channel, &alias);
 
 	channel->remote_upfront_shutdown_script
 		= tal_steal(channel, remote_upfront_shutdown_script);
@@ -2792,6 +2793,7 @@ static struct command_result *json_openchannel_init(struct command *cmd,
 	struct node_id *id;
 	struct peer *peer;
 	struct channel *channel;
+	struct channel_id cid;
 	bool *announce_channel;
 	u32 *feerate_per_kw_funding;
 	u32 *feerate_per_kw;
@@ -2915,8 +2917,8 @@ static struct command_result *json_openchannel_init(struct command *cmd,
 				      peer->ld->config.fee_base,
 				      peer->ld->config.fee_per_satoshi);
 	/* We derive initial channel_id *now*, so we can tell it to connectd. */
-	derive_tmp_channel_id(&channel->cid,
-			      &channel->local_basepoints.revocation);
+	derive_tmp_channel_id(&cid, &channel->local_basepoints.revocation);
+	channel_set_cid(channel, &cid);
 
 	/* Get a new open_attempt going */
 	channel->opener = LOCAL;
@@ -3094,7 +3096,7 @@ static void handle_psbt_changed(struct subd *dualopend,
 			return;
 		}
 		/* This might be the first time we learn the channel_id */
-		channel->cid = cid;
+		channel_set_cid(channel, &cid);
 		response = json_stream_success(cmd);
 		json_add_string(response, "channel_id",
 				type_to_string(tmpctx, struct channel_id,
@@ -3406,6 +3408,7 @@ static struct command_result *json_queryrates(struct command *cmd,
 	struct node_id *id;
 	struct peer *peer;
 	struct channel *channel;
+	struct channel_id cid;
 	u32 *feerate_per_kw_funding;
 	u32 *feerate_per_kw;
 	struct amount_sat *amount, *request_amt;
@@ -3445,8 +3448,8 @@ static struct command_result *json_queryrates(struct command *cmd,
 
 	/* We derive initial channel_id *now*, so we can tell it to
 	 * connectd. */
-	derive_tmp_channel_id(&channel->cid,
-			      &channel->local_basepoints.revocation);
+	derive_tmp_channel_id(&cid, &channel->local_basepoints.revocation);
+	channel_set_cid(channel, &cid);
 
 	if (!feature_negotiated(cmd->ld->our_features,
 			        peer->their_features,
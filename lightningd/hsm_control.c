@@ -229,6 +229,30 @@ const u8 *hsm_sync_req(const tal_t *ctx, struct lightningd *ld, const u8 *msg)
 	return msg;
 }
 
+void hsm_ecdh_batch(struct lightningd *ld,
+		    const struct pubkey *points,
+		    struct secret *ss)
+{
+	size_t n = tal_count(points);
+	struct secret *secrets;
+	const u8 *msg;
+
+	/* Don't assume hsmd supports it! */
+	if (n < 2 || !hsm_capable(ld, WIRE_HSMD_ECDH_BATCH_REQ)) {
+		for (size_t i = 0; i < n; i++)
+			ecdh(&points[i], &ss[i]);
+		return;
+	}
+
+	msg = towire_hsmd_ecdh_batch_req(NULL, points);
+	msg = hsm_sync_req(tmpctx, ld, take(msg));
+	if (!fromwire_hsmd_ecdh_batch_resp(tmpctx, msg, &secrets)
+	    || tal_count(secrets) != n)
+		fatal("Invalid ecdh_batch_resp from hsm: %s",
+		      tal_hex(tmpctx, msg));
+	memcpy(ss, secrets, n * sizeof(*ss));
+}
+
 static struct command_result *json_makesecret(struct command *cmd,
 					   const char *buffer,
 					   const jsmntok_t *obj UNNEEDED,
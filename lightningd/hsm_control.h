@@ -6,6 +6,8 @@
 struct lightningd;
 struct node_id;
 struct ext_key;
+struct pubkey;
+struct secret;
 
 /* Ask HSM for a new fd for a subdaemon to use. */
 int hsm_get_client_fd(struct lightningd *ld,
@@ -27,6 +29,12 @@ const u8 *hsm_sync_req(const tal_t *ctx,
 		       struct lightningd *ld,
 		       const u8 *msg TAKES);
 
+/* ecdh() for each of @points (a tal array) into @ss, in one request if
+ * the HSM can do that. */
+void hsm_ecdh_batch(struct lightningd *ld,
+		    const struct pubkey *points,
+		    struct secret *ss);
+
 /* Get (and check!) a bip32 derived pubkey */
 void bip32_pubkey(struct lightningd *ld, struct pubkey *pubkey, u32 index);
 
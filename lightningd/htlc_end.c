@@ -43,15 +43,108 @@ struct htlc_in *remove_htlc_in_by_dbid(struct htlc_in_map *remaining_htlcs_in,
 	return NULL;
 }
 
+/* All the HTLCs with one cltv_expiry */
+struct htlc_expiry {
+	struct list_head ins, outs;
+};
+
+static void destroy_htlc_expiries(struct htlc_expiries *expiries)
+{
+	/* The buckets themselves are tal children of expiries. */
+	uintmap_clear(&expiries->map);
+}
+
+struct htlc_expiries *new_htlc_expiries(const tal_t *ctx)
+{
+	struct htlc_expiries *expiries = tal(ctx, struct htlc_expiries);
+
+	uintmap_init(&expiries->map);
+	tal_add_destructor(expiries, destroy_htlc_expiries);
+	return expiries;
+}
+
+static struct htlc_expiry *htlc_expiry_get(struct htlc_expiries *expiries,
+					   u32 cltv_expiry)
+{
+	struct htlc_expiry *e = uintmap_get(&expiries->map, cltv_expiry);
+
+	if (!e) {
+		e = tal(expiries, struct htlc_expiry);
+		list_head_init(&e->ins);
+		list_head_init(&e->outs);
+		uintmap_add(&expiries->map, cltv_expiry, e);
+	}
+	return e;
+}
+
+static void htlc_expiry_del(struct htlc_expiries *expiries,
+			    u32 cltv_expiry, struct list_node *n)
+{
+	struct htlc_expiry *e = uintmap_get(&expiries->map, cltv_expiry);
+
+	list_del(n);
+	if (list_empty(&e->ins) && list_empty(&e->outs)) {
+		uintmap_del(&expiries->map, cltv_expiry);
+		tal_free(e);
+	}
+}
+
+struct htlc_key *htlc_in_keys_expiring(const tal_t *ctx,
+				       const struct htlc_expiries *expiries,
+				       u32 max_cltv_expiry)
+{
+	struct htlc_key *keys = tal_arr(ctx, struct htlc_key, 0);
+	struct htlc_expiry *e;
+	u64 idx;
+
+	for (e = uintmap_first(&expiries->map, &idx);
+	     e && idx <= max_cltv_expiry;
+	     e = uintmap_after(&expiries->map, &idx)) {
+		struct htlc_in *hin;
+		list_for_each(&e->ins, hin, expiry_list)
+			tal_arr_expand(&keys, hin->key);
+	}
+	return keys;
+}
+
+struct htlc_key *htlc_out_keys_expiring(const tal_t *ctx,
+					const struct htlc_expiries *expiries,
+					u32 max_cltv_expiry)
+{
+	struct htlc_key *keys = tal_arr(ctx, struct htlc_key, 0);
+	struct htlc_expiry *e;
+	u64 idx;
+
+	for (e = uintmap_first(&expiries->map, &idx);
+	     e && idx <= max_cltv_expiry;
+	     e = uintmap_after(&expiries->map, &idx)) {
+		struct htlc_out *hout;
+		list_for_each(&e->outs, hout, expiry_list)
+			tal_arr_expand(&keys, hout->key);
+	}
+	return keys;
+}
+
 static void destroy_htlc_in(struct htlc_in *hend, struct htlc_in_map *map)
 {
 	htlc_in_map_del(map, hend);
 }
 
-void connect_htlc_in(struct htlc_in_map *map, struct htlc_in *hend)
+static void destroy_htlc_in_expiry(struct htlc_in *hend,
+				   struct htlc_expiries *expiries)
+{
+	htlc_expiry_del(expiries, hend->cltv_expiry, &hend->expiry_list);
+}
+
+void connect_htlc_in(struct htlc_in_map *map,
+		     struct htlc_expiries *expiries,
+		     struct htlc_in *hend)
 {
 	tal_add_destructor2(hend, destroy_htlc_in, map);
 	htlc_in_map_add(map, hend);
+	tal_add_destructor2(hend, destroy_htlc_in_expiry, expiries);
+	list_add_tail(&htlc_expiry_get(expiries, hend->cltv_expiry)->ins,
+		      &hend->expiry_list);
 }
 
 struct htlc_out *find_htlc_out(const struct htlc_out_map *map,
@@ -67,10 +160,21 @@ static void destroy_htlc_out(struct htlc_out *hend, struct htlc_out_map *map)
 	htlc_out_map_del(map, hend);
 }
 
-void connect_htlc_out(struct htlc_out_map *map, struct htlc_out *hend)
+static void destroy_htlc_out_expiry(struct htlc_out *hend,
+				    struct htlc_expiries *expiries)
+{
+	htlc_expiry_del(expiries, hend->cltv_expiry, &hend->expiry_list);
+}
+
+void connect_htlc_out(struct htlc_out_map *map,
+		      struct htlc_expiries *expiries,
+		      struct htlc_out *hend)
 {
 	tal_add_destructor2(hend, destroy_htlc_out, map);
 	htlc_out_map_add(map, hend);
+	tal_add_destructor2(hend, destroy_htlc_out_expiry, expiries);
+	list_add_tail(&htlc_expiry_get(expiries, hend->cltv_expiry)->outs,
+		      &hend->expiry_list);
 }
 
 static void *corrupt(const char *abortstr, const char *fmt, ...)
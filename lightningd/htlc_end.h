@@ -2,6 +2,8 @@
 #define LIGHTNING_LIGHTNINGD_HTLC_END_H
 #include "config.h"
 #include <ccan/htable/htable_type.h>
+#include <ccan/intmap/intmap.h>
+#include <ccan/list/list.h>
 #include <ccan/time/time.h>
 #include <common/htlc_state.h>
 #include <common/sphinx.h>
@@ -58,6 +60,9 @@ struct htlc_in {
 
 	/* The decoded onion payload after hooks processed it. */
 	struct onion_payload *payload;
+
+	/* In htlc_expiries, with others of the same cltv_expiry. */
+	struct list_node expiry_list;
 };
 
 struct htlc_out {
@@ -106,6 +111,9 @@ struct htlc_out {
 
 	/* Timer we use in case they don't add an HTLC in a timely manner. */
 	struct oneshot *timeout;
+
+	/* In htlc_expiries, with others of the same cltv_expiry. */
+	struct list_node expiry_list;
 };
 
 static inline const struct htlc_key *keyof_htlc_in(const struct htlc_in *in)
@@ -138,6 +146,23 @@ HTABLE_DEFINE_TYPE(struct htlc_in, keyof_htlc_in, hash_htlc_key, htlc_in_eq,
 HTABLE_DEFINE_TYPE(struct htlc_out, keyof_htlc_out, hash_htlc_key, htlc_out_eq,
 		   htlc_out_map);
 
+/* HTLCs by cltv_expiry, so each block we only look at those near their
+ * deadline, not every HTLC in flight. */
+struct htlc_expiries {
+	UINTMAP(struct htlc_expiry *) map;
+};
+
+struct htlc_expiries *new_htlc_expiries(const tal_t *ctx);
+
+/* Keys of HTLCs with cltv_expiry <= max_cltv_expiry, earliest first.  Keys,
+ * not HTLCs, because failing a channel can free HTLCs further along. */
+struct htlc_key *htlc_in_keys_expiring(const tal_t *ctx,
+				       const struct htlc_expiries *expiries,
+				       u32 max_cltv_expiry);
+struct htlc_key *htlc_out_keys_expiring(const tal_t *ctx,
+					const struct htlc_expiries *expiries,
+					u32 max_cltv_expiry);
+
 struct htlc_in *find_htlc_in(const struct htlc_in_map *map,
 			     const struct channel *channel,
 			     u64 htlc_id);
@@ -174,8 +199,12 @@ struct htlc_out *new_htlc_out(const tal_t *ctx,
 			      u64 groupid,
 			      struct htlc_in *in);
 
-void connect_htlc_in(struct htlc_in_map *map, struct htlc_in *hin);
-void connect_htlc_out(struct htlc_out_map *map, struct htlc_out *hout);
+void connect_htlc_in(struct htlc_in_map *map,
+		     struct htlc_expiries *expiries,
+		     struct htlc_in *hin);
+void connect_htlc_out(struct htlc_out_map *map,
+		      struct htlc_expiries *expiries,
+		      struct htlc_out *hout);
 
 /* Set up hout->in to be hin (non-NULL), and clear if hin freed. */
 void htlc_out_connect_htlc_in(struct htlc_out *hout, struct htlc_in *hin);
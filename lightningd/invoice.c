@@ -1224,52 +1224,69 @@ static const struct json_command invoice_command = {
 	"(default autogenerated)"};
 AUTODATA(json_command, &invoice_command);
 
-static void json_add_invoices(struct json_stream *response,
-			      struct wallet *wallet,
-			      const struct json_escape *label,
-			      const struct sha256 *payment_hash,
-			      const struct sha256 *local_offer_id,
-			      const enum wait_index *listindex,
-			      u64 liststart,
-			      const u32 *listlimit)
+struct listinvoices_info {
+	struct command *cmd;
+	struct json_stream *response;
+	const struct sha256 *local_offer_id;
+	const enum wait_index *listindex;
+	/* Where to start the next chunk */
+	u64 liststart;
+	/* How many more they want, if they said */
+	u32 *listlimit;
+};
+
+static void listinvoices_next(struct listinvoices_info *info);
+
+static struct command_result *listinvoices_chunk(struct listinvoices_info *info)
 {
+	struct wallet *wallet = info->cmd->ld->wallet;
 	const struct invoice_details *details;
+	struct db_stmt *stmt;
+	const u32 *limit = info->listlimit;
+	u32 chunk = COMMAND_CHUNK_SIZE, num = 0;
 	u64 inv_dbid;
 
-	/* Don't iterate entire db if we're just after one. */
-	if (label) {
-		if (invoices_find_by_label(wallet->invoices, &inv_dbid, label)) {
-			details =
-			    invoices_get_details(tmpctx, wallet->invoices, inv_dbid);
-			json_add_invoice(response, NULL, details);
-		}
-	} else if (payment_hash != NULL) {
-		if (invoices_find_by_rhash(wallet->invoices, &inv_dbid,
-						 payment_hash)) {
-			details =
-			    invoices_get_details(tmpctx, wallet->invoices, inv_dbid);
-			json_add_invoice(response, NULL, details);
-		}
-	} else {
-		struct db_stmt *stmt;
-
-		for (stmt = invoices_first(wallet->invoices,
-					   listindex, liststart, listlimit,
-					   &inv_dbid);
-		     stmt;
-		     stmt = invoices_next(wallet->invoices, stmt, &inv_dbid)) {
-			details = invoices_get_details(tmpctx,
-						       wallet->invoices, inv_dbid);
-			/* FIXME: db can filter this better! */
-			if (local_offer_id) {
-				if (!details->local_offer_id
-				    || !sha256_eq(local_offer_id,
-						  details->local_offer_id))
-					continue;
-			}
-			json_add_invoice(response, NULL, details);
+	/* Many updated_index are 0, so we can't carry on from the middle of
+	 * those: that's done in one go. */
+	if (!info->listindex || *info->listindex == WAIT_INDEX_CREATED) {
+		if (!limit || *limit > chunk)
+			limit = &chunk;
+	}
+
+	for (stmt = invoices_first(wallet->invoices,
+				   info->listindex, info->liststart, limit,
+				   &inv_dbid);
+	     stmt;
+	     stmt = invoices_next(wallet->invoices, stmt, &inv_dbid)) {
+		num++;
+		info->liststart = inv_dbid + 1;
+		details = invoices_get_details(tmpctx,
+					       wallet->invoices, inv_dbid);
+		/* FIXME: db can filter this better! */
+		if (info->local_offer_id) {
+			if (!details->local_offer_id
+			    || !sha256_eq(info->local_offer_id,
+					  details->local_offer_id))
+				continue;
 		}
+		json_add_invoice(info->response, NULL, details);
 	}
+
+	if (info->listlimit)
+		*info->listlimit -= num;
+
+	/* There may be more: let others run before we write those. */
+	if (limit == &chunk && num == chunk
+	    && (!info->listlimit || *info->listlimit != 0))
+		return command_next_chunk(info->cmd, listinvoices_next, info);
+
+	json_array_end(info->response);
+	return command_success(info->cmd, info->response);
+}
+
+static void listinvoices_next(struct listinvoices_info *info)
+{
+	was_pending(listinvoices_chunk(info));
 }
 
 static struct command_result *json_listinvoices(struct command *cmd,
@@ -1279,6 +1296,7 @@ static struct command_result *json_listinvoices(struct command *cmd,
 {
 	struct json_escape *label;
 	struct json_stream *response;
+	struct listinvoices_info *info;
 	struct wallet *wallet = cmd->ld->wallet;
 	const char *invstring;
 	struct sha256 *payment_hash, *offer_id;
@@ -1337,10 +1355,36 @@ static struct command_result *json_listinvoices(struct command *cmd,
 
 	response = json_stream_success(cmd);
 	json_array_start(response, "invoices");
-	json_add_invoices(response, wallet, label, payment_hash, offer_id,
-			  listindex, *liststart, listlimit);
-	json_array_end(response);
-	return command_success(cmd, response);
+
+	/* Don't iterate entire db if we're just after one. */
+	if (label || payment_hash) {
+		u64 inv_dbid;
+		bool found;
+
+		if (label)
+			found = invoices_find_by_label(wallet->invoices,
+						       &inv_dbid, label);
+		else
+			found = invoices_find_by_rhash(wallet->invoices,
+						       &inv_dbid, payment_hash);
+		if (found)
+			json_add_invoice(response, NULL,
+					 invoices_get_details(tmpctx,
+							      wallet->invoices,
+							      inv_dbid));
+		json_array_end(response);
+		return command_success(cmd, response);
+	}
+
+	info = tal(cmd, struct listinvoices_info);
+	info->cmd = cmd;
+	info->response = response;
+	info->local_offer_id = offer_id;
+	info->listindex = listindex;
+	info->liststart = *liststart;
+	info->listlimit = listlimit;
+
+	return listinvoices_chunk(info);
 }
 
 static const struct json_command listinvoices_command = {
@@ -1433,6 +1477,55 @@ static const struct json_command delinvoice_command = {
 };
 AUTODATA(json_command, &delinvoice_command);
 
+static struct command_result *json_delinvoicerange(struct command *cmd,
+						   const char *buffer,
+						   const jsmntok_t *obj UNNEEDED,
+						   const jsmntok_t *params)
+{
+	const char *status;
+	enum invoice_status state;
+	u64 *maxtime, *start, *end, num_deleted;
+	struct json_stream *response;
+
+	if (!param(cmd, buffer, params,
+		   p_req("status", param_string, &status),
+		   p_req("maxtime", param_u64, &maxtime),
+		   p_opt_def("start", param_u64, &start, 0),
+		   /* The db stores these signed. */
+		   p_opt_def("end", param_u64, &end, INT64_MAX),
+		   NULL))
+		return command_param_failed();
+
+	if (streq(status, "paid"))
+		state = PAID;
+	else if (streq(status, "expired"))
+		state = EXPIRED;
+	else
+		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+				    "Can only delete paid or expired invoices");
+
+	if (*end > INT64_MAX)
+		*end = INT64_MAX;
+	if (*start > *end)
+		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
+				    "{start} must not be greater than {end}");
+
+	num_deleted = invoices_delete_range(cmd->ld->wallet->invoices, state,
+					    *maxtime, *start, *end);
+
+	response = json_stream_success(cmd);
+	json_add_u64(response, "deleted", num_deleted);
+	return command_success(cmd, response);
+}
+
+static const struct json_command delinvoicerange_command = {
+	"delinvoicerange",
+	"payment",
+	json_delinvoicerange,
+	"Delete all invoices with {status} (paid or expired) as of {maxtime}, with created_index from {start} to {end}",
+};
+AUTODATA(json_command, &delinvoicerange_command);
+
 static struct command_result *json_delexpiredinvoice(struct command *cmd,
 						     const char *buffer,
 						     const jsmntok_t *obj UNNEEDED,
@@ -76,6 +76,7 @@ struct json_connection {
 	size_t len_read;
 
 	/* JSON parsing state. */
+	struct json_input input;
 	jsmn_parser input_parser;
 	jsmntok_t *input_toks;
 
@@ -524,6 +525,24 @@ struct command_result *command_still_pending(struct command *cmd)
 	return &pending;
 }
 
+/* If more than this is waiting to go out, don't add more just yet. */
+#define CHUNK_MAX_PENDING (1024 * 1024)
+
+struct command_result *command_next_chunk_(struct command *cmd,
+					   void (*cb)(void *arg), void *arg)
+{
+	struct timerel delay = time_from_sec(0);
+	size_t len;
+
+	/* Nobody will drain it if they've gone away. */
+	json_out_contents(cmd->json_stream->jout, &len);
+	if (cmd->jcon && len > CHUNK_MAX_PENDING)
+		delay = time_from_msec(10);
+
+	new_reltimer(cmd->ld->timers, cmd, delay, cb, arg);
+	return command_still_pending(cmd);
+}
+
 static void json_command_malformed(struct json_connection *jcon,
 				   const char *id,
 				   const char *error)
@@ -885,6 +904,7 @@ parse_request(struct json_connection *jcon, const jsmntok_t tok[])
 	const jsmntok_t *method, *id, *params, *filter, *jsonrpc;
 	struct command *c;
 	struct rpc_command_hook_payload *rpc_hook;
+	jsmntok_t *request;
 	bool completed;
 
 	if (tok[0].type != JSMN_OBJECT) {
@@ -969,9 +989,17 @@ parse_request(struct json_connection *jcon, const jsmntok_t tok[])
 
 	rpc_hook = tal(c, struct rpc_command_hook_payload);
 	rpc_hook->cmd = c;
-	/* Duplicate since we might outlive the connection */
-	rpc_hook->buffer = tal_dup_talarr(rpc_hook, char, jcon->buffer);
-	rpc_hook->request = tal_dup_talarr(rpc_hook, jsmntok_t, tok);
+	/* Duplicate since we might outlive the connection: just this
+	 * request though, not everything else buffered around it. */
+	rpc_hook->buffer = tal_dup_arr(rpc_hook, char,
+				       jcon->buffer + tok[0].start,
+				       tok[0].end - tok[0].start, 0);
+	request = tal_dup_talarr(rpc_hook, jsmntok_t, tok);
+	for (size_t i = 0; i < tal_count(request) - 1; i++) {
+		request[i].start -= tok[0].start;
+		request[i].end -= tok[0].start;
+	}
+	rpc_hook->request = request;
 
 	/* NULL the custom_ values for the hooks */
 	rpc_hook->custom_result = NULL;
@@ -1046,10 +1074,7 @@ static struct io_plan *read_json(struct io_conn *conn,
 		log_io(jcon->log, LOG_IO_IN, NULL, "",
 		       jcon->buffer + jcon->used, jcon->len_read);
 
-	/* Resize larger if we're full. */
 	jcon->used += jcon->len_read;
-	if (jcon->used == tal_count(jcon->buffer))
-		tal_resize(&jcon->buffer, jcon->used * 2);
 
 	/* We wait for pending output to be consumed, to avoid DoS */
 	if (tal_count(jcon->js_arr) != 0) {
@@ -1058,13 +1083,16 @@ static struct io_plan *read_json(struct io_conn *conn,
 	}
 
 again:
-	if (!json_parse_input(&jcon->input_parser, &jcon->input_toks,
+	if (!json_input_parse(&jcon->input,
+			      &jcon->input_parser, &jcon->input_toks,
 			      jcon->buffer, jcon->used,
 			      &complete)) {
+		size_t off = json_input_consumed(&jcon->input);
 		json_command_malformed(
 		    jcon, "null",
 		    tal_fmt(tmpctx, "Invalid token in json input: '%s'",
-			    tal_hexstr(tmpctx, jcon->buffer, jcon->used)));
+			    tal_hexstr(tmpctx, jcon->buffer + off,
+				       jcon->used - off)));
 		if (in_transaction)
 			db_commit_transaction(jcon->ld->wallet->db);
 		return io_halfclose(conn);
@@ -1073,33 +1101,15 @@ again:
 	if (!complete)
 		goto read_more;
 
-	/* Empty buffer? (eg. just whitespace). */
-	if (tal_count(jcon->input_toks) == 1) {
-		jcon->used = 0;
-
-		/* Reset parser. */
-		jsmn_init(&jcon->input_parser);
-		toks_reset(jcon->input_toks);
-		goto read_more;
-	}
-
 	if (!in_transaction) {
 		db_begin_transaction(jcon->ld->wallet->db);
 		in_transaction = true;
 	}
 	parse_request(jcon, jcon->input_toks);
 
-	/* Remove first {}. */
-	memmove(jcon->buffer, jcon->buffer + jcon->input_toks[0].end,
-		tal_count(jcon->buffer) - jcon->input_toks[0].end);
-	jcon->used -= jcon->input_toks[0].end;
-
-	/* Reset parser. */
-	jsmn_init(&jcon->input_parser);
-	toks_reset(jcon->input_toks);
-
-	/* Do we have more already read? */
-	if (jcon->used) {
+	/* Do we have more already read?  We don't move it down the
+	 * buffer, just parse it where it is. */
+	if (json_input_consumed(&jcon->input) != jcon->used) {
 		if (!jcon->db_batching) {
 			db_commit_transaction(jcon->ld->wallet->db);
 			in_transaction = false;
@@ -1122,6 +1132,7 @@ again:
 read_more:
 	if (in_transaction)
 		db_commit_transaction(jcon->ld->wallet->db);
+	json_input_make_room(&jcon->input, &jcon->buffer, &jcon->used);
 	return io_read_partial(conn, jcon->buffer + jcon->used,
 			       tal_count(jcon->buffer) - jcon->used,
 			       &jcon->len_read, read_json, jcon);
@@ -1140,6 +1151,7 @@ static struct io_plan *jcon_connected(struct io_conn *conn,
 	jcon->buffer = tal_arr(jcon, char, 64);
 	jcon->js_arr = tal_arr(jcon, struct json_stream *, 0);
 	jcon->len_read = 0;
+	json_input_init(&jcon->input);
 	jsmn_init(&jcon->input_parser);
 	jcon->input_toks = toks_alloc(jcon);
 	jcon->notifications_enabled = false;
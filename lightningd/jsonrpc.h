@@ -2,6 +2,7 @@
 #define LIGHTNING_LIGHTNINGD_JSONRPC_H
 #include "config.h"
 #include <ccan/list/list.h>
+#include <ccan/typesafe_cb/typesafe_cb.h>
 #include <common/autodata.h>
 #include <common/json_stream.h>
 #include <common/status_levels.h>
@@ -134,6 +135,18 @@ struct command_result *command_failed(struct command *cmd,
 struct command_result *command_still_pending(struct command *cmd)
 	 WARN_UNUSED_RESULT;
 
+/* How many entries list commands write before giving others a turn. */
+#define COMMAND_CHUNK_SIZE 1000
+
+/* For commands which write huge lists: call @cb(@arg) again from a
+ * timer, to write the next chunk (and eventually complete).  Waits a
+ * little longer if the client isn't keeping up with what we've written. */
+#define command_next_chunk(cmd, cb, arg)				\
+	command_next_chunk_((cmd), typesafe_cb(void, void *, (cb), (arg)), (arg))
+struct command_result *command_next_chunk_(struct command *cmd,
+					   void (*cb)(void *arg), void *arg)
+	 WARN_UNUSED_RESULT;
+
 /* For low-level JSON stream access: */
 struct json_stream *json_stream_raw_for_cmd(struct command *cmd);
 void json_stream_log_suppress_for_cmd(struct json_stream *js,
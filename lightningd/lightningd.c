@@ -52,6 +52,7 @@
 #include <common/hsm_encryption.h>
 #include <common/json_stream.h>
 #include <common/memleak.h>
+#include <common/sphinx_batch.h>
 #include <common/timeout.h>
 #include <common/trace.h>
 #include <common/type_to_string.h>
@@ -87,6 +88,18 @@ static void memleak_help_alt_subdaemons(struct htable *memtable,
 					struct lightningd *ld);
 #endif /* DEVELOPER */
 
+/* Onion peeling threads: leave one core for us (and a few for others). */
+static size_t num_sphinx_threads(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ncpus <= 1)
+		return 0;
+	if (ncpus - 1 > 3)
+		return 3;
+	return ncpus - 1;
+}
+
 /*~ The core lightning object: it's passed everywhere, and is basically a
  * global variable.  This new_xxx pattern is something we'll see often:
  * it allocates and initializes a new structure, using *tal*, the hierarchical
@@ -182,6 +195,17 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	ld->htlcs_out = tal(ld, struct htlc_out_map);
 	htlc_out_map_init(ld->htlcs_out);
 
+	/*~ Every block we need the HTLCs which are close to timing out.
+	 * Walking all of them each time gets slow on a busy node, so we
+	 * also keep them ordered by cltv_expiry. */
+	ld->htlc_expiries = new_htlc_expiries(ld);
+
+	/*~ A busy channel can add hundreds of HTLCs in one commitment, and
+	 * peeling each onion is mostly (parallelizable) crypto.  The threads
+	 * only start when first needed, which is after we've forked into the
+	 * background with --daemon. */
+	ld->sphinx_batch = sphinx_batch_new(ld, num_sphinx_threads());
+
 	/*~ This is the hash table of peers: converted from a
 	 *  linked-list as part of the 100k-peers project! */
 	ld->peers = tal(ld, struct peer_node_id_map);
@@ -190,6 +214,17 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	ld->peers_by_dbid = tal(ld, struct peer_dbid_map);
 	peer_dbid_map_init(ld->peers_by_dbid);
 
+	/*~ Forwarding looks up the outgoing channel for every HTLC, so we
+	 * don't want to walk every peer's channels for that. */
+	ld->channels_by_scid = tal(ld, struct channel_scid_map);
+	channel_scid_map_init(ld->channels_by_scid);
+	ld->channels_by_alias = tal(ld, struct channel_alias_map);
+	channel_alias_map_init(ld->channels_by_alias);
+	ld->channels_by_dbid = tal(ld, struct channel_dbid_map);
+	channel_dbid_map_init(ld->channels_by_dbid);
+	ld->channels_by_cid = tal(ld, struct channel_cid_map);
+	channel_cid_map_init(ld->channels_by_cid);
+
 	/*~ For multi-part payments, we need to keep some incoming payments
 	 * in limbo until we get all the parts, or we time them out. */
 	ld->htlc_sets = tal(ld, struct htlc_set_map);
@@ -260,6 +295,7 @@ static struct lightningd *new_lightningd(const tal_t *ctx)
 	ld->daemon_parent_fd = -1;
 	ld->proxyaddr = NULL;
 	ld->always_use_proxy = false;
+	ld->wallet_backup_async = false;
 	ld->pure_tor_setup = false;
 	ld->tor_service_password = NULL;
 	ld->websocket_port = 0;
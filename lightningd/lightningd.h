@@ -208,6 +208,12 @@ struct lightningd {
 	/* And those in database by dbid */
 	struct peer_dbid_map *peers_by_dbid;
 
+	/* All channels, by scid, local alias, dbid and channel_id */
+	struct channel_scid_map *channels_by_scid;
+	struct channel_alias_map *channels_by_alias;
+	struct channel_dbid_map *channels_by_dbid;
+	struct channel_cid_map *channels_by_cid;
+
 	/* Outstanding connect commands. */
 	struct list_head connects;
 
@@ -220,6 +226,10 @@ struct lightningd {
 	/* HTLCs in flight. */
 	struct htlc_in_map *htlcs_in;
 	struct htlc_out_map *htlcs_out;
+	/* The same HTLCs, by cltv_expiry. */
+	struct htlc_expiries *htlc_expiries;
+	/* For peeling their onions, a commitment at a time. */
+	struct sphinx_batch *sphinx_batch;
 
 	/* Sets of HTLCs we are holding onto for MPP. */
 	struct htlc_set_map *htlc_sets;
@@ -344,6 +354,8 @@ struct lightningd {
 	struct plugins *plugins;
 
 	char *wallet_dsn;
+	/* Write the wallet's backup db (if any) from another thread. */
+	bool wallet_backup_async;
 
 	bool encrypted_hsm;
 	/* What (additional) messages the HSM accepts */
@@ -13,8 +13,10 @@
 #include <fcntl.h>
 #include <lightningd/log.h>
 #include <lightningd/notification.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
+#include <unistd.h>
 
 /* What logging level to use if they didn't specify */
 #define DEFAULT_LOGLEVEL LOG_INFORM
@@ -33,8 +35,47 @@ struct print_filter {
 struct log_file {
 	struct list_head print_filters;
 	FILE *f;
+
+	/* Once the log_writer is running: lines waiting for it, and the ones
+	 * it's writing out now.  It swaps them, under its lock. */
+	char *pending, *writing;
+	size_t pending_len, writing_len;
+	/* How many lines we dropped, because pending was full. */
+	size_t dropped;
+};
+
+/* Each log file can have this much waiting to be written (and as much again
+ * being written). */
+#define LOG_QUEUE_SIZE (1024 * 1024)
+
+/* How long we'll wait for that to be written when we exit (or crash). */
+#define LOG_FLUSH_TIMEOUT_MSEC 5000
+
+/* A thread which writes the log files, so a slow disk (or a full pipe)
+ * doesn't stall everything else. */
+struct log_writer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	/* We signal wake when we add lines, it signals done when it swaps
+	 * them out, and again once they're written. */
+	pthread_cond_t wake, done;
+	/* log_book->log_files, or a single stdout one if there are none.
+	 * tal isn't thread-safe, so it uses num_files, not tal_count(). */
+	struct log_file **files;
+	size_t num_files;
+	/* It's writing out a batch. */
+	bool busy;
+	/* Finish up, and exit. */
+	bool exiting;
+	/* Drop lines if a file's queue is full, rather than waiting. */
+	bool drop_when_full;
+	/* Who started it (children don't have the thread!). */
+	pid_t pid;
 };
 
+/* Once logging_options_parsed, this writes out all the log lines. */
+static struct log_writer *log_writer;
+
 struct log_book {
 	size_t mem_used;
 	size_t max_mem;
@@ -51,8 +92,14 @@ struct log_book {
 	/* Array of log files: one per ld->logfiles[] */
 	struct log_file **log_files;
 	bool print_timestamps;
+	/* If log files can't keep up, drop lines instead of waiting. */
+	bool drop_when_full;
 
 	struct log_entry *log;
+	/* Each entry's log string (and io) in order, with gaps where
+	 * prune_log deleted them until we next need room. */
+	char *text;
+	size_t text_used;
 	/* Prefix this to every entry as you output */
 	const char *prefix;
 
@@ -189,6 +236,216 @@ static void lowest_filter(const struct list_head *print_filters,
 	}
 }
 
+static bool log_writer_pending(const struct log_writer *w)
+{
+	for (size_t i = 0; i < w->num_files; i++) {
+		if (w->files[i]->pending_len)
+			return true;
+	}
+	return false;
+}
+
+static void *log_writer_thread(struct log_writer *w)
+{
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		if (!log_writer_pending(w)) {
+			if (w->exiting)
+				break;
+			pthread_cond_wait(&w->wake, &w->lock);
+			continue;
+		}
+
+		/* Take everything that's queued, so they can queue more
+		 * while we write it. */
+		for (size_t i = 0; i < w->num_files; i++) {
+			struct log_file *lf = w->files[i];
+			char *tmp = lf->writing;
+
+			lf->writing = lf->pending;
+			lf->writing_len = lf->pending_len;
+			lf->pending = tmp;
+			lf->pending_len = 0;
+		}
+		w->busy = true;
+		pthread_cond_broadcast(&w->done);
+		pthread_mutex_unlock(&w->lock);
+
+		for (size_t i = 0; i < w->num_files; i++) {
+			struct log_file *lf = w->files[i];
+
+			if (!lf->writing_len)
+				continue;
+			fwrite(lf->writing, lf->writing_len, 1, lf->f);
+			fflush(lf->f);
+			lf->writing_len = 0;
+		}
+
+		pthread_mutex_lock(&w->lock);
+		w->busy = false;
+		pthread_cond_broadcast(&w->done);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+/* Children don't have the thread, and if it crashes, it can't wait for
+ * itself! */
+static struct log_writer *log_writer_usable(void)
+{
+	if (!log_writer
+	    || log_writer->pid != getpid()
+	    || pthread_equal(log_writer->thread, pthread_self()))
+		return NULL;
+	return log_writer;
+}
+
+/* Wait until everything queued is written. */
+static void log_writer_flush(struct log_writer *w)
+{
+	pthread_mutex_lock(&w->lock);
+	while (w->busy || log_writer_pending(w)) {
+		pthread_cond_signal(&w->wake);
+		pthread_cond_wait(&w->done, &w->lock);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* Like log_writer_flush, but give up after a while: when exiting or
+ * crashing, a stuck pipe or slow disk mustn't stop us.  We might have
+ * crashed holding the lock, too, so we don't wait for that either. */
+static bool log_writer_flush_bounded(struct log_writer *w)
+{
+	struct timeabs deadline = timeabs_add(time_now(),
+					      time_from_msec(LOG_FLUSH_TIMEOUT_MSEC));
+	bool flushed = true;
+
+	while (pthread_mutex_trylock(&w->lock) != 0) {
+		if (time_after(time_now(), deadline))
+			return false;
+		/* The writer only holds it for a moment. */
+		usleep(1000);
+	}
+	while (w->busy || log_writer_pending(w)) {
+		pthread_cond_signal(&w->wake);
+		if (pthread_cond_timedwait(&w->done, &w->lock,
+					   &deadline.ts) == ETIMEDOUT) {
+			flushed = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+	return flushed;
+}
+
+static void log_writer_stop(struct log_writer *w)
+{
+	log_writer_flush(w);
+	pthread_mutex_lock(&w->lock);
+	w->exiting = true;
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+}
+
+/* So we don't lose what's queued if someone calls exit() */
+static void log_writer_atexit(void)
+{
+	struct log_writer *w = log_writer_usable();
+
+	if (w)
+		log_writer_flush_bounded(w);
+}
+
+static void log_writer_start(struct log_book *log_book)
+{
+	struct log_writer *w = tal(log_book, struct log_writer);
+	sigset_t all, old;
+	int ret;
+
+	if (log_book->log_files)
+		w->files = log_book->log_files;
+	else {
+		/* Default is stdout. */
+		w->files = tal_arr(w, struct log_file *, 1);
+		w->files[0] = tal(w->files, struct log_file);
+		list_head_init(&w->files[0]->print_filters);
+		w->files[0]->f = stdout;
+	}
+	w->num_files = tal_count(w->files);
+	for (size_t i = 0; i < w->num_files; i++) {
+		w->files[i]->pending = tal_arr(w, char, LOG_QUEUE_SIZE);
+		w->files[i]->writing = tal_arr(w, char, LOG_QUEUE_SIZE);
+		w->files[i]->pending_len = w->files[i]->writing_len = 0;
+		w->files[i]->dropped = 0;
+	}
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->wake, NULL);
+	pthread_cond_init(&w->done, NULL);
+	w->busy = w->exiting = false;
+	w->drop_when_full = log_book->drop_when_full;
+	w->pid = getpid();
+
+	/* Signals are for the main thread. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	ret = pthread_create(&w->thread, NULL,
+			     (void *(*)(void *))log_writer_thread, w);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (ret != 0)
+		fatal("Could not start log writer: %s", strerror(ret));
+
+	log_writer = w;
+	atexit(log_writer_atexit);
+}
+
+/* Until the writer starts, we write directly. */
+static void log_file_write(struct log_file *lf, FILE *f, const char *entry)
+{
+	struct log_writer *w = log_writer_usable();
+	size_t len = strlen(entry);
+
+	if (!w) {
+		fwrite(entry, len, 1, f);
+		fflush(f);
+		return;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	while (lf->pending_len + len > LOG_QUEUE_SIZE) {
+		if (w->drop_when_full) {
+			lf->dropped++;
+			goto out;
+		}
+		/* Too big to ever queue?  Write it once the rest is out. */
+		if (len > LOG_QUEUE_SIZE && !w->busy && !lf->pending_len) {
+			fwrite(entry, len, 1, lf->f);
+			fflush(lf->f);
+			goto out;
+		}
+		pthread_cond_signal(&w->wake);
+		pthread_cond_wait(&w->done, &w->lock);
+	}
+
+	if (lf->dropped) {
+		char note[sizeof("[18446744073709551615 log lines dropped]\n")];
+		size_t notelen = snprintf(note, sizeof(note),
+					  "[%zu log lines dropped]\n",
+					  lf->dropped);
+		if (lf->pending_len + notelen + len <= LOG_QUEUE_SIZE) {
+			memcpy(lf->pending + lf->pending_len, note, notelen);
+			lf->pending_len += notelen;
+			lf->dropped = 0;
+		}
+	}
+	memcpy(lf->pending + lf->pending_len, entry, len);
+	lf->pending_len += len;
+	pthread_cond_signal(&w->wake);
+
+out:
+	pthread_mutex_unlock(&w->lock);
+}
+
 static void log_to_files(const char *log_prefix,
 			 const char *entry_prefix,
 			 enum log_level level,
@@ -257,10 +514,9 @@ static void log_to_files(const char *log_prefix,
 	}
 
 	/* Default if nothing set is stdout */
-	if (!log_files) {
-		fwrite(entry, strlen(entry), 1, stdout);
-		fflush(stdout);
-	}
+	if (!log_files)
+		log_file_write(log_writer ? log_writer->files[0] : NULL,
+			       stdout, entry);
 
 	/* We may have to apply per-file filters. */
 	for (size_t i = 0; i < tal_count(log_files); i++) {
@@ -280,14 +536,61 @@ static void log_to_files(const char *log_prefix,
 		}
 		if (level < filter)
 			continue;
-		fwrite(entry, strlen(entry), 1, log_files[i]->f);
-		fflush(log_files[i]->f);
+		log_file_write(log_files[i], log_files[i]->f, entry);
 	}
 }
 
+static size_t text_len(const struct log_entry *e)
+{
+	return strlen(e->log) + 1 + e->io_len;
+}
+
 static size_t mem_used(const struct log_entry *e)
 {
-	return sizeof(*e) + strlen(e->log) + 1 + tal_count(e->io);
+	return sizeof(*e) + text_len(e);
+}
+
+/* Make room for @len bytes of text after the existing entries, moving them
+ * down over any gaps (into a larger buffer if it's more than half full, so
+ * we don't have to do this often). */
+static void make_text_room(struct log_book *log, size_t len)
+{
+	size_t live = log->mem_used - log->num_entries * sizeof(struct log_entry);
+	char *text = log->text, *p;
+
+	if ((live + len) * 2 > tal_count(text))
+		text = tal_arr(log, char, (live + len) * 2);
+
+	p = text;
+	for (size_t i = 0; i < log->num_entries; i++) {
+		struct log_entry *l = &log->log[i];
+		size_t slen = strlen(l->log) + 1;
+
+		memmove(p, l->log, slen + l->io_len);
+		l->log = p;
+		if (l->io)
+			l->io = (u8 *)p + slen;
+		p += slen + l->io_len;
+	}
+	log->text_used = p - text;
+
+	if (text != log->text) {
+		tal_free(log->text);
+		log->text = text;
+	}
+}
+
+/* This may move other entries' text! */
+static char *text_alloc(struct log_book *log, size_t len)
+{
+	char *p;
+
+	if (log->text_used + len > tal_count(log->text))
+		make_text_room(log, len);
+
+	p = log->text + log->text_used;
+	log->text_used += len;
+	return p;
 }
 
 /* Threshold (of 1000) to delete */
@@ -319,9 +622,7 @@ static size_t delete_entry(struct log_book *log, struct log_entry *i)
 	log->num_entries--;
 	if (i->nc && --i->nc->count == 0)
 		tal_free(i->nc);
-	free(i->log);
 	log_prefix_drop(i->prefix);
-	tal_free(i->io);
 
 	return 1 + i->skipped;
 }
@@ -366,6 +667,12 @@ static void destroy_log_book(struct log_book *log)
 
 	assert(log->num_entries == 0);
 	assert(log->mem_used == 0);
+
+	/* It's writing our files, so stop it first. */
+	if (log_writer && tal_parent(log_writer) == log) {
+		log_writer_stop(log_writer);
+		log_writer = NULL;
+	}
 }
 
 struct log_book *new_log_book(struct lightningd *ld, size_t max_mem)
@@ -388,7 +695,10 @@ struct log_book *new_log_book(struct lightningd *ld, size_t max_mem)
 	log_book->cache = tal(log_book, struct node_id_map);
 	node_id_map_init(log_book->cache);
 	log_book->log = tal_arr(log_book, struct log_entry, 128);
+	log_book->text = tal_arr(log_book, char, 8192);
+	log_book->text_used = 0;
 	log_book->print_timestamps = true;
+	log_book->drop_when_full = false;
 	tal_add_destructor(log_book, destroy_log_book);
 
 	return log_book;
@@ -508,6 +818,7 @@ static struct log_entry *new_log_entry(struct logger *log, enum log_level level,
 	l->skipped = 0;
 	l->prefix = log_prefix_get(log->prefix);
 	l->io = NULL;
+	l->io_len = 0;
 	if (!node_id)
 		node_id = log->default_node_id;
 	if (node_id) {
@@ -534,7 +845,7 @@ static void maybe_print(struct logger *log, const struct log_entry *l)
 			     l->nc ? &l->nc->node_id : NULL,
 			     log->need_refiltering ? &log->log_book->print_filters : NULL,
 			     &l->time, l->log,
-			     l->io, tal_bytelen(l->io),
+			     l->io, l->io_len,
 			     log->log_book->print_timestamps,
 			     log->log_book->default_print_level,
 			     log->log_book->log_files);
@@ -547,13 +858,23 @@ void logv(struct logger *log, enum log_level level,
 {
 	int save_errno = errno;
 	struct log_entry *l = new_log_entry(log, level, node_id);
+	struct log_book *log_book = log->log_book;
+	size_t room = tal_count(log_book->text) - log_book->text_used;
+	va_list ap2;
+	size_t log_len;
+	int ret;
 
-	/* This is WARN_UNUSED_RESULT, because everyone should somehow deal
-	 * with OOM, even though nobody does. */
-	if (vasprintf(&l->log, fmt, ap) == -1)
+	/* Usually it fits straight into the text buffer: if not, make room
+	 * and do it again. */
+	va_copy(ap2, ap);
+	ret = vsnprintf(log_book->text + log_book->text_used, room, fmt, ap);
+	if (ret < 0)
 		abort();
-
-	size_t log_len = strlen(l->log);
+	log_len = ret;
+	l->log = text_alloc(log_book, log_len + 1);
+	if (log_len + 1 > room)
+		vsnprintf(l->log, log_len + 1, fmt, ap2);
+	va_end(ap2);
 
 	/* Sanitize any non-printable characters, and replace with '?' */
 	for (size_t i=0; i<log_len; i++)
@@ -577,6 +898,7 @@ void log_io(struct logger *log, enum log_level dir,
 {
 	int save_errno = errno;
 	struct log_entry *l = new_log_entry(log, dir, node_id);
+	size_t slen;
 
 	assert(dir == LOG_IO_IN || dir == LOG_IO_OUT);
 
@@ -591,20 +913,22 @@ void log_io(struct logger *log, enum log_level dir,
 			     log->log_book->default_print_level,
 			     log->log_book->log_files);
 
-	/* Save a tal header, by using raw malloc. */
-	l->log = strdup(str);
-	if (taken(str))
-		tal_free(str);
-
 	/* Don't immediately fill buffer with giant IOs */
 	if (len > log->log_book->max_mem / 64) {
 		l->skipped++;
 		len = log->log_book->max_mem / 64;
 	}
 
-	/* FIXME: We could save 4 pointers by using a raw allow, but saving
-	 * the length. */
-	l->io = tal_dup_arr(log->log_book, u8, data, len, 0);
+	/* The io goes straight after the string. */
+	slen = strlen(str) + 1;
+	l->log = text_alloc(log->log_book, slen + len);
+	memcpy(l->log, str, slen);
+	l->io = memcpy(l->log + slen, data, len);
+	l->io_len = len;
+	if (taken(str))
+		tal_free(str);
+	if (taken(data))
+		tal_free(data);
 
 	add_entry(log, &l);
 	errno = save_errno;
@@ -631,7 +955,8 @@ void log_(struct logger *log, enum log_level level,
 					   const struct node_id *,	\
 					   const char *,		\
 					   const char *,		\
-					   const u8 *), (arg))
+					   const u8 *,			\
+					   size_t), (arg))
 
 static void log_each_line_(const struct log_book *log_book,
 			   void (*func)(unsigned int skipped,
@@ -641,6 +966,7 @@ static void log_each_line_(const struct log_book *log_book,
 					const char *prefix,
 					const char *log,
 					const u8 *io,
+					size_t io_len,
 					void *arg),
 			   void *arg)
 {
@@ -649,7 +975,7 @@ static void log_each_line_(const struct log_book *log_book,
 
 		func(l->skipped, time_between(l->time, log_book->init_time),
 		     l->level, l->nc ? &l->nc->node_id : NULL,
-		     l->prefix->prefix, l->log, l->io, arg);
+		     l->prefix->prefix, l->log, l->io, l->io_len, arg);
 	}
 }
 
@@ -665,6 +991,7 @@ static void log_one_line(unsigned int skipped,
 			 const char *prefix,
 			 const char *log,
 			 const u8 *io,
+			 size_t io_len,
 			 struct log_data *data)
 {
 	char buf[101];
@@ -691,11 +1018,11 @@ static void log_one_line(unsigned int skipped,
 	write_all(data->fd, buf, strlen(buf));
 	write_all(data->fd, log, strlen(log));
 	if (level == LOG_IO_IN || level == LOG_IO_OUT) {
-		size_t off, used, len = tal_count(io);
+		size_t off, used;
 
 		/* No allocations, may be in signal handler. */
-		for (off = 0; off < len; off += used) {
-			used = len - off;
+		for (off = 0; off < io_len; off += used) {
+			used = io_len - off;
 			if (hex_str_size(used) > sizeof(buf))
 				used = hex_data_size(sizeof(buf));
 			hex_encode(io + off, used, buf, hex_str_size(used));
@@ -806,6 +1133,10 @@ static struct io_plan *setup_read(struct io_conn *conn, struct lightningd *ld);
 static struct io_plan *rotate_log(struct io_conn *conn, struct lightningd *ld)
 {
 	log_info(ld->log, "Ending log due to SIGHUP");
+	/* Once it's written everything, it won't touch the files until we
+	 * queue more. */
+	if (log_writer)
+		log_writer_flush(log_writer);
 	for (size_t i = 0; i < tal_count(ld->log->log_book->log_files); i++) {
 		if (streq(ld->logfiles[i], "-"))
 			continue;
@@ -908,6 +1239,10 @@ void opt_register_logging(struct lightningd *ld)
 		       OPT_EARLY|OPT_MULTI,
 		       arg_log_to_file, NULL, ld,
 		       "Also log to file (- for stdout)");
+	clnopt_witharg("--log-drop-when-full", OPT_EARLY|OPT_SHOWBOOL,
+		       opt_set_bool_arg, opt_show_bool,
+		       &ld->log_book->drop_when_full,
+		       "drop log lines (and say so) if log files can't keep up, rather than waiting");
 }
 
 void logging_options_parsed(struct log_book *log_book)
@@ -937,11 +1272,14 @@ void logging_options_parsed(struct log_book *log_book)
 				     l->nc ? &l->nc->node_id : NULL,
 				     &log_book->print_filters,
 				     &l->time, l->log,
-				     l->io, tal_bytelen(l->io),
+				     l->io, l->io_len,
 				     log_book->print_timestamps,
 				     log_book->default_print_level,
 				     log_book->log_files);
 	}
+
+	/* From now on, a thread writes to the log files. */
+	log_writer_start(log_book);
 }
 
 void log_backtrace_print(const char *fmt, ...)
@@ -1007,6 +1345,12 @@ void log_backtrace_exit(void)
 		close(fd);
 		fprintf(stderr, "Log dumped in %s\n", logfile);
 	}
+
+	/* Now we have crash.log, try to get the backtrace out to the log
+	 * files too. */
+	if (log_writer_usable()
+	    && !log_writer_flush_bounded(log_writer))
+		fprintf(stderr, "Timed out writing log files\n");
 }
 
 void fatal_vfmt(const char *fmt, va_list ap)
@@ -1062,6 +1406,7 @@ static void log_to_json(unsigned int skipped,
 			const char *prefix,
 			const char *log,
 			const u8 *io,
+			size_t io_len,
 			struct log_info *info)
 {
 	info->num_skipped += skipped;
@@ -1093,7 +1438,7 @@ static void log_to_json(unsigned int skipped,
 	json_add_string(info->response, "source", prefix);
 	json_add_string(info->response, "log", log);
 	if (io)
-		json_add_hex_talarr(info->response, "data", io);
+		json_add_hex(info->response, "data", io, io_len);
 
 	json_object_end(info->response);
 }
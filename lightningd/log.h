@@ -84,9 +84,11 @@ struct log_entry {
 	unsigned int skipped;
 	struct node_id_cache *nc;
 	struct log_prefix *prefix;
+	/* These point into the log_book's text: don't keep them! */
 	char *log;
 	/* Iff LOG_IO */
 	const u8 *io;
+	size_t io_len;
 };
 
 /* For options.c's listconfig */
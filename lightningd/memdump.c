@@ -155,6 +155,7 @@ static void finish_report(const struct leak_detect *leaks)
 	memleak_scan_htable(memtable, &ld->topology->outgoing_txs->raw);
 	memleak_scan_htable(memtable, &ld->htlcs_in->raw);
 	memleak_scan_htable(memtable, &ld->htlcs_out->raw);
+	memleak_scan_uintmap(memtable, &ld->htlc_expiries->map);
 	memleak_scan_htable(memtable, &ld->htlc_sets->raw);
 	memleak_scan_htable(memtable, &ld->peers->raw);
 	memleak_scan_htable(memtable, &ld->peers_by_dbid->raw);
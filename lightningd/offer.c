@@ -243,7 +243,7 @@ static struct command_result *prev_payment(struct command *cmd,
 
 	invreq_offer_id(invreq, &invreq_oid);
 	assert(!invreq->invreq_metadata);
-	payments = wallet_payment_list(cmd, cmd->ld->wallet, NULL);
+	payments = wallet_payment_list(cmd, cmd->ld->wallet, NULL, 0, NULL);
 
 	for (size_t i = 0; i < tal_count(payments); i++) {
 		const struct tlv_invoice *inv;
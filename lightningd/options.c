@@ -1385,6 +1385,10 @@ static void register_opts(struct lightningd *ld)
 	opt_register_early_arg("--wallet", opt_set_talstr, NULL,
 			       &ld->wallet_dsn,
 			       "Location of the wallet database.");
+	opt_register_early_noarg("--wallet-backup-async", opt_set_bool,
+				 &ld->wallet_backup_async,
+				 "Write the --wallet backup database from a"
+				 " separate thread");
 
 	opt_register_early_arg("--recover", opt_set_codex32, NULL,
 				ld,
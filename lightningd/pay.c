@@ -904,7 +904,7 @@ static struct command_result *check_progress(struct lightningd *ld,
 	*old_payment = NULL;
 
 	/* Now, do we already have one or more payments? */
-	payments = wallet_payment_list(tmpctx, ld->wallet, rhash);
+	payments = wallet_payment_list(tmpctx, ld->wallet, rhash, 0, NULL);
 	for (size_t i = 0; i < tal_count(payments); i++) {
 		log_debug(ld->log, "Payment %zu/%zu: %s %s",
 			  i, tal_count(payments),
@@ -1698,13 +1698,57 @@ static struct command_result *param_payment_status(struct command *cmd,
 				     "should be an invoice status");
 }
 
+struct listsendpays_info {
+	struct command *cmd;
+	struct json_stream *response;
+	const struct sha256 *rhash;
+	const enum payment_status *status;
+	/* Where to start the next chunk */
+	u64 next_id;
+};
+
+static void listsendpays_next(struct listsendpays_info *info);
+
+static struct command_result *listsendpays_chunk(struct listsendpays_info *info)
+{
+	const struct wallet_payment **payments;
+	u32 limit = COMMAND_CHUNK_SIZE;
+	size_t num_stored = 0;
+
+	payments = wallet_payment_list(tmpctx, info->cmd->ld->wallet,
+				       info->rhash, info->next_id, &limit);
+	for (size_t i = 0; i < tal_count(payments); i++) {
+		/* Unstored ones come last, with no id */
+		if (payments[i]->id) {
+			info->next_id = payments[i]->id + 1;
+			num_stored++;
+		}
+		if (info->status && payments[i]->status != *info->status)
+			continue;
+		json_object_start(info->response, NULL);
+		json_add_payment_fields(info->response, payments[i]);
+		json_object_end(info->response);
+	}
+
+	/* There may be more: let others run before we write those. */
+	if (num_stored == limit)
+		return command_next_chunk(info->cmd, listsendpays_next, info);
+
+	json_array_end(info->response);
+	return command_success(info->cmd, info->response);
+}
+
+static void listsendpays_next(struct listsendpays_info *info)
+{
+	was_pending(listsendpays_chunk(info));
+}
+
 static struct command_result *json_listsendpays(struct command *cmd,
 						const char *buffer,
 						const jsmntok_t *obj UNNEEDED,
 						const jsmntok_t *params)
 {
-	const struct wallet_payment **payments;
-	struct json_stream *response;
+	struct listsendpays_info *info;
 	struct sha256 *rhash;
 	const char *invstring;
 	enum payment_status *status;
@@ -1745,20 +1789,15 @@ static struct command_result *json_listsendpays(struct command *cmd,
 		}
 	}
 
-	payments = wallet_payment_list(cmd, cmd->ld->wallet, rhash);
-	response = json_stream_success(cmd);
-
-	json_array_start(response, "payments");
-	for (size_t i = 0; i < tal_count(payments); i++) {
-		if (status && payments[i]->status != *status)
-			continue;
-		json_object_start(response, NULL);
-		json_add_payment_fields(response, payments[i]);
-		json_object_end(response);
-	}
-	json_array_end(response);
+	info = tal(cmd, struct listsendpays_info);
+	info->cmd = cmd;
+	info->rhash = rhash;
+	info->status = status;
+	info->next_id = 0;
+	info->response = json_stream_success(cmd);
+	json_array_start(info->response, "payments");
 
-	return command_success(cmd, response);
+	return listsendpays_chunk(info);
 }
 
 static const struct json_command listsendpays_command = {
@@ -1818,7 +1857,7 @@ static struct command_result *json_delpay(struct command *cmd,
 		return command_fail(cmd, JSONRPC2_INVALID_PARAMS,
 				    "Must set both partid and groupid, or neither");
 
-	payments = wallet_payment_list(cmd, cmd->ld->wallet, payment_hash);
+	payments = wallet_payment_list(cmd, cmd->ld->wallet, payment_hash, 0, NULL);
 
 	if (tal_count(payments) == 0)
 		return command_fail(cmd, PAY_NO_SUCH_PAYMENT, "Unknown payment with payment_hash: %s",
@@ -1617,7 +1617,7 @@ void peer_spoke(struct lightningd *ld, const u8 *msg)
 		channel = new_unsaved_channel(peer,
 					      peer->ld->config.fee_base,
 					      peer->ld->config.fee_per_satoshi);
-		channel->cid = channel_id;
+		channel_set_cid(channel, &channel_id);
 		if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) != 0) {
 			log_broken(ld->log,
 				   "Failed to create socketpair: %s",
@@ -1897,9 +1897,7 @@ static enum watch_result funding_depth_cb(struct lightningd *ld,
 		/* If we restart, we could already have peer->scid from database,
 		 * we don't need to update scid for stub channels(1x1x1) */
 		if (!channel->scid || channel->state == CHANNELD_AWAITING_SPLICE) {
-			if(!channel->scid)
-				channel->scid = tal(channel, struct short_channel_id);
-			*channel->scid = scid;
+			channel_set_scid(channel, &scid);
 			wallet_channel_save(ld->wallet, channel);
 
 		} else if (!short_channel_id_eq(channel->scid, &scid) &&
@@ -1923,7 +1921,7 @@ static enum watch_result funding_depth_cb(struct lightningd *ld,
 					       short_channel_id_to_str(tmpctx, &scid),
 					       short_channel_id_to_str(tmpctx, channel->scid));
 
-			*channel->scid = scid;
+			channel_set_scid(channel, &scid);
 			wallet_channel_save(ld->wallet, channel);
 			return KEEP_WATCHING;
 		}
@@ -2332,7 +2330,8 @@ struct htlc_in_map *load_channels_from_wallet(struct lightningd *ld)
 		list_for_each(&peer->channels, channel, list) {
 			if (!wallet_htlcs_load_in_for_channel(ld->wallet,
 							      channel,
-							      ld->htlcs_in)) {
+							      ld->htlcs_in,
+							      ld->htlc_expiries)) {
 				fatal("could not load htlcs for channel");
 			}
 		}
@@ -2351,6 +2350,7 @@ struct htlc_in_map *load_channels_from_wallet(struct lightningd *ld)
 			if (!wallet_htlcs_load_out_for_channel(ld->wallet,
 							       channel,
 							       ld->htlcs_out,
+							       ld->htlc_expiries,
 							       unconnected_htlcs_in)) {
 				fatal("could not load outgoing htlcs for channel");
 			}
@@ -4,11 +4,11 @@
 #include <channeld/channeld_wiregen.h>
 #include <common/blinding.h>
 #include <common/configdir.h>
-#include <common/ecdh.h>
 #include <common/json_command.h>
 #include <common/json_param.h>
 #include <common/onion_decode.h>
 #include <common/onionreply.h>
+#include <common/sphinx_batch.h>
 #include <common/timeout.h>
 #include <common/type_to_string.h>
 #include <connectd/connectd_wiregen.h>
@@ -17,6 +17,7 @@
 #include <lightningd/chaintopology.h>
 #include <lightningd/channel.h>
 #include <lightningd/coin_mvts.h>
+#include <lightningd/hsm_control.h>
 #include <lightningd/pay.h>
 #include <lightningd/peer_control.h>
 #include <lightningd/peer_htlcs.h>
@@ -568,7 +569,7 @@ static void rcvd_htlc_reply(struct subd *subd, const u8 *msg, const int *fds UNU
 	}
 
 	/* Add it to lookup table now we know id. */
-	connect_htlc_out(subd->ld->htlcs_out, hout);
+	connect_htlc_out(subd->ld->htlcs_out, subd->ld->htlc_expiries, hout);
 
 	/* When channeld includes it in commitment, we'll make it persistent. */
 }
@@ -1164,34 +1165,6 @@ htlc_accepted_hook_final(struct htlc_accepted_hook_payload *request STEALS)
 	tal_free(request);
 }
 
-/* Apply tweak to ephemeral key if blinding is non-NULL, then do ECDH */
-static bool ecdh_maybe_blinding(const struct pubkey *ephemeral_key,
-				const struct pubkey *blinding,
-				struct secret *ss)
-{
-	struct pubkey point = *ephemeral_key;
-
-	if (blinding) {
-		struct secret hmac;
-		struct secret blinding_ss;
-
-		ecdh(blinding, &blinding_ss);
-		/* b(i) = HMAC256("blinded_node_id", ss(i)) * k(i) */
-		subkey_from_hmac("blinded_node_id", &blinding_ss, &hmac);
-
-		/* We instead tweak the *ephemeral* key from the onion and use
-		 * our normal privkey: since hsmd knows only how to ECDH with
-		 * our real key */
-		if (secp256k1_ec_pubkey_tweak_mul(secp256k1_ctx,
-						  &point.pubkey,
-						  hmac.data) != 1) {
-			return false;
-		}
-	}
-	ecdh(&point, ss);
-	return true;
-}
-
 REGISTER_PLUGIN_HOOK(htlc_accepted,
 		     htlc_accepted_hook_deserialize,
 		     htlc_accepted_hook_final,
@@ -1283,6 +1256,54 @@ static struct channel_id *calc_forwarding_channel(struct lightningd *ld,
 	return tal_dup(hp, struct channel_id, &best->cid);
 }
 
+/* An incoming HTLC's onion, peeled. */
+struct peeled_onion {
+	/* NULL if it didn't parse: badonion says why. */
+	struct onionpacket *op;
+	enum onion_wire badonion;
+	/* NULL if it didn't process. */
+	struct route_step *rs;
+};
+
+/* Peel the onions for these (non-NULL) hins all at once: the hard part is
+ * spread over ld->sphinx_batch's threads. */
+static struct peeled_onion *peel_onions(const tal_t *ctx,
+					struct lightningd *ld,
+					struct htlc_in **hins)
+{
+	struct peeled_onion *peeled;
+	struct sphinx_batch_onion *onions;
+	size_t *idx;
+
+	peeled = tal_arrz(ctx, struct peeled_onion, tal_count(hins));
+	onions = tal_arr(tmpctx, struct sphinx_batch_onion, 0);
+	idx = tal_arr(tmpctx, size_t, 0);
+	for (size_t i = 0; i < tal_count(hins); i++) {
+		struct sphinx_batch_onion onion;
+
+		if (!hins[i])
+			continue;
+		peeled[i].op = parse_onionpacket(ctx,
+						 hins[i]->onion_routing_packet,
+						 sizeof(hins[i]->onion_routing_packet),
+						 &peeled[i].badonion);
+		if (!peeled[i].op)
+			continue;
+
+		onion.packet = peeled[i].op;
+		onion.shared_secret = hins[i]->shared_secret;
+		onion.assocdata = hins[i]->payment_hash.u.u8;
+		onion.assocdatalen = sizeof(hins[i]->payment_hash);
+		tal_arr_expand(&onions, onion);
+		tal_arr_expand(&idx, i);
+	}
+
+	sphinx_batch_process(ctx, ld->sphinx_batch, onions);
+	for (size_t i = 0; i < tal_count(onions); i++)
+		peeled[idx[i]].rs = onions[i].rs;
+	return peeled;
+}
+
 /**
  * Everyone is committed to this htlc of theirs
  *
@@ -1291,6 +1312,7 @@ static struct channel_id *calc_forwarding_channel(struct lightningd *ld,
  * @param id: the ID of the HTLC we accepted
  * @param replay: Are we loading from the database and therefore should not
  *        perform the transition to RCVD_ADD_ACK_REVOCATION?
+ * @param peeled: Its onion, from peel_onions.
  * @param[out] badonion: Set non-zero if the onion was bad.
  * @param[out] failmsg: If there was some other error.
  *
@@ -1299,12 +1321,12 @@ static struct channel_id *calc_forwarding_channel(struct lightningd *ld,
 static bool peer_accepted_htlc(const tal_t *ctx,
 			       struct channel *channel, u64 id,
 			       bool replay,
+			       const struct peeled_onion *peeled,
 			       enum onion_wire *badonion,
 			       u8 **failmsg)
 {
 	struct htlc_in *hin;
 	struct route_step *rs;
-	struct onionpacket *op;
 	struct lightningd *ld = channel->peer->ld;
 	struct htlc_accepted_hook_payload *hook_payload;
 	const bool opt_blinding
@@ -1369,10 +1391,8 @@ static bool peer_accepted_htlc(const tal_t *ctx,
 	 * a subset of the cltv check done in handle_localpay and
 	 * forward_htlc. */
 
-	op = parse_onionpacket(tmpctx, hin->onion_routing_packet,
-			       sizeof(hin->onion_routing_packet),
-			       badonion);
-	if (!op) {
+	if (!peeled->op) {
+		*badonion = peeled->badonion;
 		log_debug(channel->log,
 			  "Rejecting their htlc %"PRIu64
 			  " since onion is unparsable %s",
@@ -1381,9 +1401,7 @@ static bool peer_accepted_htlc(const tal_t *ctx,
 		goto fail;
 	}
 
-	rs = process_onionpacket(tmpctx, op, hin->shared_secret,
-				 hin->payment_hash.u.u8,
-				 sizeof(hin->payment_hash), true);
+	rs = peeled->rs;
 	if (!rs) {
 		*badonion = WIRE_INVALID_ONION_HMAC;
 		log_debug(channel->log,
@@ -2136,14 +2154,95 @@ void peer_sending_commitsig(struct channel *channel, const u8 *msg)
 		      take(towire_channeld_sending_commitsig_reply(msg)));
 }
 
+/* What channel_added_their_htlc needs from each onion. */
+struct added_onion {
+	/* Did it parse?  If not, we'll fail it in peer_accepted_htlc. */
+	bool parsed;
+	/* Could we apply the blinding tweak (if any)? */
+	bool tweaked;
+	struct secret shared_secret;
+};
+
+/* Each ECDH is a round trip to hsmd, so we do them for all the added
+ * HTLCs at once.  Blinded ones need another ECDH first, to tweak the
+ * ephemeral key, so that's two (batched) rounds. */
+static struct added_onion *added_onions_ecdh(const tal_t *ctx,
+					     struct lightningd *ld,
+					     const struct added_htlc *added)
+{
+	size_t n = tal_count(added);
+	struct added_onion *onions = tal_arr(ctx, struct added_onion, n);
+	struct pubkey *ephemeralkeys = tal_arr(tmpctx, struct pubkey, n);
+	struct pubkey *blindings, *points;
+	struct secret *blinding_ss, *ss;
+	size_t b, p;
+
+	blindings = tal_arr(tmpctx, struct pubkey, 0);
+	for (size_t i = 0; i < n; i++) {
+		struct onionpacket *op;
+		enum onion_wire failcode;
+
+		/* FIXME: We do this *again* in peer_accepted_htlc! */
+		op = parse_onionpacket(tmpctx, added[i].onion_routing_packet,
+				       sizeof(added[i].onion_routing_packet),
+				       &failcode);
+		onions[i].parsed = (op != NULL);
+		onions[i].tweaked = true;
+		if (!op)
+			continue;
+		ephemeralkeys[i] = op->ephemeralkey;
+		if (added[i].blinding)
+			tal_arr_expand(&blindings, *added[i].blinding);
+	}
+
+	blinding_ss = tal_arr(tmpctx, struct secret, tal_count(blindings));
+	hsm_ecdh_batch(ld, blindings, blinding_ss);
+
+	points = tal_arr(tmpctx, struct pubkey, 0);
+	b = 0;
+	for (size_t i = 0; i < n; i++) {
+		struct pubkey point = ephemeralkeys[i];
+
+		if (!onions[i].parsed)
+			continue;
+
+		if (added[i].blinding) {
+			struct secret hmac;
+
+			/* b(i) = HMAC256("blinded_node_id", ss(i)) * k(i) */
+			subkey_from_hmac("blinded_node_id", &blinding_ss[b++],
+					 &hmac);
+
+			/* We instead tweak the *ephemeral* key from the onion
+			 * and use our normal privkey: since hsmd knows only
+			 * how to ECDH with our real key */
+			if (secp256k1_ec_pubkey_tweak_mul(secp256k1_ctx,
+							  &point.pubkey,
+							  hmac.data) != 1) {
+				onions[i].tweaked = false;
+				continue;
+			}
+		}
+		tal_arr_expand(&points, point);
+	}
+
+	ss = tal_arr(tmpctx, struct secret, tal_count(points));
+	hsm_ecdh_batch(ld, points, ss);
+
+	p = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (onions[i].parsed && onions[i].tweaked)
+			onions[i].shared_secret = ss[p++];
+	}
+	return onions;
+}
+
 static bool channel_added_their_htlc(struct channel *channel,
-				     const struct added_htlc *added)
+				     const struct added_htlc *added,
+				     const struct added_onion *onion)
 {
 	struct lightningd *ld = channel->peer->ld;
 	struct htlc_in *hin;
-	struct secret shared_secret;
-	struct onionpacket *op;
-	enum onion_wire failcode;
 
 	/* BOLT #2:
 	 *
@@ -2165,26 +2264,17 @@ static bool channel_added_their_htlc(struct channel *channel,
 		return false;
 	}
 
-	/* Do the work of extracting shared secret now if possible. */
-	/* FIXME: We do this *again* in peer_accepted_htlc! */
-	op = parse_onionpacket(tmpctx, added->onion_routing_packet,
-			       sizeof(added->onion_routing_packet),
-			       &failcode);
-	if (op) {
-		if (!ecdh_maybe_blinding(&op->ephemeralkey,
-					 added->blinding,
-					 &shared_secret)) {
-			log_debug(channel->log, "htlc %"PRIu64
-				  ": can't tweak pubkey", added->id);
-			return false;
-		}
+	if (!onion->tweaked) {
+		log_debug(channel->log, "htlc %"PRIu64
+			  ": can't tweak pubkey", added->id);
+		return false;
 	}
 
 	/* This stays around even if we fail it immediately: it *is*
 	 * part of the current commitment. */
 	hin = new_htlc_in(channel, channel, added->id, added->amount,
 			  added->cltv_expiry, &added->payment_hash,
-			  op ? &shared_secret : NULL,
+			  onion->parsed ? &onion->shared_secret : NULL,
 			  added->blinding,
 			  added->onion_routing_packet,
 			  added->fail_immediate);
@@ -2196,7 +2286,8 @@ static bool channel_added_their_htlc(struct channel *channel,
 					     added->amount);
 
 	log_debug(channel->log, "Adding their HTLC %"PRIu64, added->id);
-	connect_htlc_in(channel->peer->ld->htlcs_in, hin);
+	connect_htlc_in(channel->peer->ld->htlcs_in,
+			channel->peer->ld->htlc_expiries, hin);
 	return true;
 }
 
@@ -2265,6 +2356,7 @@ void peer_got_commitsig(struct channel *channel, const u8 *msg)
 	struct bitcoin_tx *tx;
 	struct commitsig **inflight_commit_sigs;
 	struct channel_inflight *inflight;
+	struct added_onion *added_onions;
 	size_t i;
 	struct lightningd *ld = channel->peer->ld;
 
@@ -2331,8 +2423,10 @@ void peer_got_commitsig(struct channel *channel, const u8 *msg)
 	}
 
 	/* New HTLCs */
+	added_onions = added_onions_ecdh(tmpctx, ld, added);
 	for (i = 0; i < tal_count(added); i++) {
-		if (!channel_added_their_htlc(channel, &added[i]))
+		if (!channel_added_their_htlc(channel, &added[i],
+					      &added_onions[i]))
 			return;
 	}
 
@@ -2455,6 +2549,8 @@ void peer_got_revoke(struct channel *channel, const u8 *msg)
 	struct changed_htlc *changed;
 	enum onion_wire *badonions;
 	u8 **failmsgs;
+	struct htlc_in **hins;
+	struct peeled_onion *peeled;
 	size_t i;
 	struct lightningd *ld = channel->peer->ld;
 	struct fee_states *fee_states;
@@ -2482,6 +2578,26 @@ void peer_got_revoke(struct channel *channel, const u8 *msg)
 		  "got revoke %"PRIu64": %zu changed",
 		  revokenum, tal_count(changed));
 
+	/* Peel all the new onions at once: we still call the hooks in
+	 * order, below.  Don't bother with ones peer_accepted_htlc() will
+	 * fail (or ignore) without looking at the onion. */
+	hins = tal_arrz(tmpctx, struct htlc_in *, tal_count(changed));
+	for (i = 0; i < tal_count(changed); i++) {
+		struct htlc_in *hin;
+
+		if (changed[i].newstate != RCVD_ADD_ACK_REVOCATION)
+			continue;
+		hin = find_htlc_in(ld->htlcs_in, channel, changed[i].id);
+		if (!hin || hin->fail_immediate)
+			continue;
+#if DEVELOPER
+		if (channel->peer->ignore_htlcs)
+			continue;
+#endif
+		hins[i] = hin;
+	}
+	peeled = peel_onions(msg, ld, hins);
+
 	/* Save any immediate failures for after we reply. */
 	badonions = tal_arrz(msg, enum onion_wire, tal_count(changed));
 	failmsgs = tal_arrz(msg, u8 *, tal_count(changed));
@@ -2490,6 +2606,7 @@ void peer_got_revoke(struct channel *channel, const u8 *msg)
 		if (changed[i].newstate == RCVD_ADD_ACK_REVOCATION) {
 			peer_accepted_htlc(failmsgs,
 					   channel, changed[i].id, false,
+					   &peeled[i],
 					   &badonions[i], &failmsgs[i]);
 		} else {
 			if (!changed_htlc(channel, &changed[i])) {
@@ -2757,7 +2874,7 @@ static void consider_failing_incoming(struct lightningd *ld,
 
 void htlcs_notify_new_block(struct lightningd *ld, u32 height)
 {
-	bool removed;
+	const struct htlc_key *keys;
 
 	/* BOLT #2:
 	 *
@@ -2766,42 +2883,39 @@ void htlcs_notify_new_block(struct lightningd *ld, u32 height)
 	 *     - SHOULD send an `error` to the receiving peer (if connected).
 	 *     - MUST fail the channel.
 	 */
-	/* FIXME: use db to look this up in one go (earliest deadline per-peer) */
-	do {
-		struct htlc_out *hout;
-		struct htlc_out_map_iter outi;
-
-		removed = false;
-
-		for (hout = htlc_out_map_first(ld->htlcs_out, &outi);
-		     hout;
-		     hout = htlc_out_map_next(ld->htlcs_out, &outi)) {
-			/* Not timed out yet? */
-			if (height < htlc_out_deadline(hout))
-				continue;
-
-			/* Peer on chain already? */
-			if (channel_on_chain(hout->key.channel)) {
-				consider_failing_incoming(ld, height, hout);
-				continue;
-			}
+	/* htlc_out_deadline() is cltv_expiry + 1 */
+	keys = htlc_out_keys_expiring(tmpctx, ld->htlc_expiries, height - 1);
+	for (size_t i = 0; i < tal_count(keys); i++) {
+		/* Failing a channel can free its HTLCs, so look it up again */
+		struct htlc_out *hout = find_htlc_out(ld->htlcs_out,
+						      keys[i].channel,
+						      keys[i].id);
+		if (!hout)
+			continue;
 
-			/* Peer already failed, or we hit it? */
-			if (hout->key.channel->error)
-				continue;
+		/* Not timed out yet?  (We asked for height - 1, which can
+		 * wrap) */
+		if (height < htlc_out_deadline(hout))
+			continue;
 
-			channel_fail_permanent(hout->key.channel,
-					       REASON_PROTOCOL,
-					       "Offered HTLC %"PRIu64
-					       " %s cltv %u hit deadline",
-					       hout->key.id,
-					       htlc_state_name(hout->hstate),
-					       hout->cltv_expiry);
-			removed = true;
+		/* Peer on chain already? */
+		if (channel_on_chain(hout->key.channel)) {
+			consider_failing_incoming(ld, height, hout);
+			continue;
 		}
-	/* Iteration while removing is safe, but can skip entries! */
-	} while (removed);
 
+		/* Peer already failed, or we hit it? */
+		if (hout->key.channel->error)
+			continue;
+
+		channel_fail_permanent(hout->key.channel,
+				       REASON_PROTOCOL,
+				       "Offered HTLC %"PRIu64
+				       " %s cltv %u hit deadline",
+				       hout->key.id,
+				       htlc_state_name(hout->hstate),
+				       hout->cltv_expiry);
+	}
 
 	/* BOLT #2:
 	 *
@@ -2813,44 +2927,42 @@ void htlcs_notify_new_block(struct lightningd *ld, u32 height)
 	 *     - SHOULD send an `error` to the offering peer (if connected).
 	 *     - MUST fail the channel.
 	 */
-	do {
-		struct htlc_in *hin;
-		struct htlc_in_map_iter ini;
-
-		removed = false;
-
-		for (hin = htlc_in_map_first(ld->htlcs_in, &ini);
-		     hin;
-		     hin = htlc_in_map_next(ld->htlcs_in, &ini)) {
-			struct channel *channel = hin->key.channel;
+	keys = htlc_in_keys_expiring(tmpctx, ld->htlc_expiries,
+				     height + (ld->config.cltv_expiry_delta + 1)/2);
+	for (size_t i = 0; i < tal_count(keys); i++) {
+		struct htlc_in *hin = find_htlc_in(ld->htlcs_in,
+						   keys[i].channel,
+						   keys[i].id);
+		struct channel *channel;
+
+		if (!hin)
+			continue;
+		channel = hin->key.channel;
 
-			/* Not fulfilled?  If overdue, that's their problem... */
-			if (!hin->preimage)
-				continue;
+		/* Not fulfilled?  If overdue, that's their problem... */
+		if (!hin->preimage)
+			continue;
 
-			/* Not timed out yet? */
-			if (height < htlc_in_deadline(ld, hin))
-				continue;
+		/* Not timed out yet? */
+		if (height < htlc_in_deadline(ld, hin))
+			continue;
 
-			/* Peer on chain already? */
-			if (channel_on_chain(channel))
-				continue;
+		/* Peer on chain already? */
+		if (channel_on_chain(channel))
+			continue;
 
-			/* Peer already failed, or we hit it? */
-			if (channel->error)
-				continue;
+		/* Peer already failed, or we hit it? */
+		if (channel->error)
+			continue;
 
-			channel_fail_permanent(channel,
-					       REASON_PROTOCOL,
-					       "Fulfilled HTLC %"PRIu64
-					       " %s cltv %u hit deadline",
-					       hin->key.id,
-					       htlc_state_name(hin->hstate),
-					       hin->cltv_expiry);
-			removed = true;
-		}
-	/* Iteration while removing is safe, but can skip entries! */
-	} while (removed);
+		channel_fail_permanent(channel,
+				       REASON_PROTOCOL,
+				       "Fulfilled HTLC %"PRIu64
+				       " %s cltv %u hit deadline",
+				       hin->key.id,
+				       htlc_state_name(hin->hstate),
+				       hin->cltv_expiry);
+	}
 }
 
 #ifdef COMPAT_V061
@@ -2917,23 +3029,30 @@ void fixup_htlcs_out(struct lightningd *ld)
 void htlcs_resubmit(struct lightningd *ld,
 		    struct htlc_in_map *unconnected_htlcs_in STEALS)
 {
-	struct htlc_in *hin;
+	struct htlc_in *hin, **hins;
 	struct htlc_in_map_iter ini;
+	struct peeled_onion *peeled;
 	enum onion_wire badonion COMPILER_WANTS_INIT("gcc7.4.0 bad, 8.3 OK");
 	u8 *failmsg;
 
-	/* Now retry any which were stuck. */
+	/* Now retry any which were stuck: peel them all first. */
+	hins = tal_arr(tmpctx, struct htlc_in *, 0);
 	for (hin = htlc_in_map_first(unconnected_htlcs_in, &ini);
 	     hin;
 	     hin = htlc_in_map_next(unconnected_htlcs_in, &ini)) {
-		if (hin->hstate != RCVD_ADD_ACK_REVOCATION)
-			continue;
+		if (hin->hstate == RCVD_ADD_ACK_REVOCATION)
+			tal_arr_expand(&hins, hin);
+	}
+	peeled = peel_onions(tmpctx, ld, hins);
 
+	for (size_t i = 0; i < tal_count(hins); i++) {
+		hin = hins[i];
 		log_unusual(hin->key.channel->log,
 			    "Replaying old unprocessed HTLC #%"PRIu64,
 			    hin->key.id);
 		if (!peer_accepted_htlc(tmpctx, hin->key.channel, hin->key.id,
-					true, &badonion, &failmsg)) {
+					true, &peeled[i],
+					&badonion, &failmsg)) {
 			if (failmsg)
 				local_fail_in_htlc(hin, failmsg);
 			else
@@ -3044,24 +3163,50 @@ void json_add_forwarding_object(struct json_stream *response,
 	json_object_end(response);
 }
 
-static void listforwardings_add_forwardings(struct json_stream *response,
-					    struct wallet *wallet,
-					    enum forward_status status,
-					    const struct short_channel_id *chan_in,
-					    const struct short_channel_id *chan_out)
+struct listforwards_info {
+	struct command *cmd;
+	struct json_stream *response;
+	enum forward_status status;
+	struct short_channel_id *chan_in, *chan_out;
+	/* The previous chunk, so we can carry on from its last one */
+	const struct forwarding *prev;
+};
+
+static void listforwards_next(struct listforwards_info *info);
+
+static struct command_result *listforwards_chunk(struct listforwards_info *info)
 {
 	const struct forwarding *forwardings;
+	u32 limit = COMMAND_CHUNK_SIZE;
+	size_t num;
 
-	forwardings = wallet_forwarded_payments_get(wallet, tmpctx, status, chan_in, chan_out);
+	forwardings = wallet_forwarded_payments_get(info->cmd->ld->wallet, info,
+						    info->status,
+						    info->chan_in,
+						    info->chan_out,
+						    info->prev
+						    ? &info->prev[tal_count(info->prev)-1]
+						    : NULL,
+						    &limit);
+	tal_free(info->prev);
+	info->prev = forwardings;
 
-	json_array_start(response, "forwards");
-	for (size_t i=0; i<tal_count(forwardings); i++) {
-		const struct forwarding *cur = &forwardings[i];
-		json_add_forwarding_object(response, NULL, cur, NULL);
-	}
-	json_array_end(response);
+	num = tal_count(forwardings);
+	for (size_t i = 0; i < num; i++)
+		json_add_forwarding_object(info->response, NULL,
+					   &forwardings[i], NULL);
+
+	/* There may be more: let others run before we write those. */
+	if (num == limit)
+		return command_next_chunk(info->cmd, listforwards_next, info);
 
-	tal_free(forwardings);
+	json_array_end(info->response);
+	return command_success(info->cmd, info->response);
+}
+
+static void listforwards_next(struct listforwards_info *info)
+{
+	was_pending(listforwards_chunk(info));
 }
 
 static struct command_result *param_forward_status(struct command *cmd,
@@ -3085,8 +3230,7 @@ static struct command_result *json_listforwards(struct command *cmd,
 						const jsmntok_t *obj UNNEEDED,
 						const jsmntok_t *params)
 {
-
-	struct json_stream *response;
+	struct listforwards_info *info;
 	struct short_channel_id *chan_in, *chan_out;
 	enum forward_status *status;
 
@@ -3098,10 +3242,16 @@ static struct command_result *json_listforwards(struct command *cmd,
 		   NULL))
 		return command_param_failed();
 
-	response = json_stream_success(cmd);
-	listforwardings_add_forwardings(response, cmd->ld->wallet, *status, chan_in, chan_out);
+	info = tal(cmd, struct listforwards_info);
+	info->cmd = cmd;
+	info->status = *status;
+	info->chan_in = chan_in;
+	info->chan_out = chan_out;
+	info->prev = NULL;
+	info->response = json_stream_success(cmd);
+	json_array_start(info->response, "forwards");
 
-	return command_success(cmd, response);
+	return listforwards_chunk(info);
 }
 
 static const struct json_command listforwards_command = {
@@ -3203,34 +3353,45 @@ static struct command_result *param_channel(struct command *cmd,
 				     "must be channel id or short channel id");
 }
 
-static struct command_result *json_listhtlcs(struct command *cmd,
-					     const char *buffer,
-					     const jsmntok_t *obj UNNEEDED,
-					     const jsmntok_t *params)
-{
+struct listhtlcs_info {
+	struct command *cmd;
 	struct json_stream *response;
-	struct channel *chan;
+	/* Channel's dbid, if they specified one (else 0) */
+	u64 chan_dbid;
+	/* Where to start the next chunk */
+	u64 next_dbid;
+};
+
+static void listhtlcs_next(struct listhtlcs_info *info);
+
+static struct command_result *listhtlcs_chunk(struct listhtlcs_info *info)
+{
+	struct json_stream *response = info->response;
+	struct channel *chan = NULL;
 	struct wallet_htlc_iter *i;
 	struct short_channel_id scid;
-	u64 htlc_id;
+	u64 htlc_id, dbid;
 	int cltv_expiry;
 	enum side owner;
 	struct amount_msat msat;
 	struct sha256 payment_hash;
 	enum htlc_state hstate;
+	u32 limit = COMMAND_CHUNK_SIZE;
+	size_t num = 0;
 
-	if (!param(cmd, buffer, params,
-		   p_opt("id", param_channel, &chan),
-		   NULL))
-		return command_param_failed();
+	/* It might have been forgotten since the last chunk. */
+	if (info->chan_dbid) {
+		chan = channel_by_dbid(info->cmd->ld, info->chan_dbid);
+		if (!chan)
+			goto done;
+	}
 
-	response = json_stream_success(cmd);
-	json_array_start(response, "htlcs");
-	for (i = wallet_htlcs_first(cmd, cmd->ld->wallet, chan,
+	for (i = wallet_htlcs_first(info, info->cmd->ld->wallet, chan,
+				    info->next_dbid, &limit, &dbid,
 				    &scid, &htlc_id, &cltv_expiry, &owner, &msat,
 				    &payment_hash, &hstate);
 	     i;
-	     i = wallet_htlcs_next(cmd->ld->wallet, i,
+	     i = wallet_htlcs_next(info->cmd->ld->wallet, i, &dbid,
 				   &scid, &htlc_id, &cltv_expiry, &owner, &msat,
 				   &payment_hash, &hstate)) {
 		json_object_start(response, NULL);
@@ -3243,10 +3404,45 @@ static struct command_result *json_listhtlcs(struct command *cmd,
 		json_add_sha256(response, "payment_hash", &payment_hash);
 		json_add_string(response, "state", htlc_state_name(hstate));
 		json_object_end(response);
+		info->next_dbid = dbid + 1;
+		num++;
 	}
+
+	/* There may be more: let others run before we write those. */
+	if (num == limit)
+		return command_next_chunk(info->cmd, listhtlcs_next, info);
+
+done:
 	json_array_end(response);
+	return command_success(info->cmd, response);
+}
+
+static void listhtlcs_next(struct listhtlcs_info *info)
+{
+	was_pending(listhtlcs_chunk(info));
+}
+
+static struct command_result *json_listhtlcs(struct command *cmd,
+					     const char *buffer,
+					     const jsmntok_t *obj UNNEEDED,
+					     const jsmntok_t *params)
+{
+	struct listhtlcs_info *info;
+	struct channel *chan;
+
+	if (!param(cmd, buffer, params,
+		   p_opt("id", param_channel, &chan),
+		   NULL))
+		return command_param_failed();
+
+	info = tal(cmd, struct listhtlcs_info);
+	info->cmd = cmd;
+	info->chan_dbid = chan ? chan->dbid : 0;
+	info->next_dbid = 0;
+	info->response = json_stream_success(cmd);
+	json_array_start(info->response, "htlcs");
 
-	return command_success(cmd, response);
+	return listhtlcs_chunk(info);
 }
 
 static const struct json_command listhtlcs_command = {
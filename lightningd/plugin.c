@@ -296,6 +296,7 @@ struct plugin *plugin_register(struct plugins *plugins, const char* path TAKES,
 	p->subscriptions = NULL;
 	p->dynamic = false;
 	p->non_numeric_ids = false;
+	p->length_prefixed = false;
 	p->index = plugins->plugin_idx++;
 
 	p->log = new_logger(p, plugins->ld->log_book, NULL, "plugin-%s", p->shortname);
@@ -619,12 +620,13 @@ static const char *plugin_read_json_one(struct plugin *plugin,
 	/* Note that in the case of 'plugin stop' this can free request (since
 	 * plugin is parent), so detect that case */
 
-	if (!json_parse_input(&plugin->parser, &plugin->toks,
+	if (!json_input_parse(&plugin->input, &plugin->parser, &plugin->toks,
 			      plugin->buffer, plugin->used,
 			      complete)) {
+		size_t off = json_input_consumed(&plugin->input);
 		return tal_fmt(plugin,
 			       "Failed to parse JSON response '%.*s'",
-			       (int)plugin->used, plugin->buffer);
+			       (int)(plugin->used - off), plugin->buffer + off);
 	}
 
 	if (!*complete) {
@@ -632,16 +634,6 @@ static const char *plugin_read_json_one(struct plugin *plugin,
 		return NULL;
 	}
 
-	/* Empty buffer? (eg. just whitespace). */
-	if (tal_count(plugin->toks) == 1) {
-		plugin->used = 0;
-		jsmn_init(&plugin->parser);
-		toks_reset(plugin->toks);
-		/* We need more. */
-		*complete = false;
-		return NULL;
-	}
-
 	if (plugin->toks->type != JSMN_OBJECT)
 		return tal_fmt(
 		    plugin,
@@ -704,16 +696,8 @@ static const char *plugin_read_json_one(struct plugin *plugin,
 
 	/* Corner case: rpc_command hook can destroy plugin for 'plugin
 	 * stop'! */
-	if (was_plugin_destroyed(pd)) {
+	if (was_plugin_destroyed(pd))
 		*destroyed = true;
-	} else {
-		/* Move this object out of the buffer */
-		memmove(plugin->buffer, plugin->buffer + plugin->toks[0].end,
-			tal_count(plugin->buffer) - plugin->toks[0].end);
-		plugin->used -= plugin->toks[0].end;
-		jsmn_init(&plugin->parser);
-		toks_reset(plugin->toks);
-	}
 	return err;
 }
 
@@ -721,45 +705,34 @@ static struct io_plan *plugin_read_json(struct io_conn *conn,
 					struct plugin *plugin)
 {
 	bool success;
-	bool have_full;
 
 	log_io(plugin->log, LOG_IO_IN, NULL, "",
 	       plugin->buffer + plugin->used, plugin->len_read);
 
-	/* Our JSON parser is pretty good at incremental parsing, but
-	 * `getrawblock` gives a giant 2MB token, which forces it to re-parse
-	 * every time until we have all of it. However, we can't complete a
-	 * JSON object without a '}', so we do a cheaper check here.
-	 */
-	have_full = memchr(plugin->buffer + plugin->used, '}',
-			   plugin->len_read);
-
 	plugin->used += plugin->len_read;
-	if (plugin->used == tal_count(plugin->buffer))
-		tal_resize(&plugin->buffer, plugin->used * 2);
-
-	/* Read and process all messages from the connection */
-	if (have_full) {
-		do {
-			bool destroyed;
-			const char *err;
-			err =
-			    plugin_read_json_one(plugin, &success, &destroyed);
-
-			/* If it's destroyed, conn is already freed! */
-			if (destroyed)
-				return io_close(NULL);
-
-			if (err) {
-				plugin_kill(plugin, LOG_UNUSUAL,
-					    "%s", err);
-				/* plugin_kill frees plugin */
-				return io_close(NULL);
-			}
-		} while (success);
-	}
+
+	/* Read and process all messages from the connection.  We only
+	 * tokenize once a whole message is here, so a giant one (like
+	 * `getrawblock`'s 2MB) isn't re-parsed for every read. */
+	do {
+		bool destroyed;
+		const char *err;
+		err = plugin_read_json_one(plugin, &success, &destroyed);
+
+		/* If it's destroyed, conn is already freed! */
+		if (destroyed)
+			return io_close(NULL);
+
+		if (err) {
+			plugin_kill(plugin, LOG_UNUSUAL,
+				    "%s", err);
+			/* plugin_kill frees plugin */
+			return io_close(NULL);
+		}
+	} while (success);
 
 	/* Now read more from the connection */
+	json_input_make_room(&plugin->input, &plugin->buffer, &plugin->used);
 	return io_read_partial(plugin->stdout_conn,
 			       plugin->buffer + plugin->used,
 			       tal_count(plugin->buffer) - plugin->used,
@@ -786,6 +759,9 @@ static struct io_plan *plugin_write_json(struct io_conn *conn,
 					 struct plugin *plugin)
 {
 	if (tal_count(plugin->js_arr)) {
+		/* Only getmanifest itself goes out before we know. */
+		if (plugin->length_prefixed)
+			return json_stream_output_framed(plugin->js_arr[0], plugin->stdin_conn, plugin_stream_complete, plugin);
 		return json_stream_output(plugin->js_arr[0], plugin->stdin_conn, plugin_stream_complete, plugin);
 	}
 
@@ -1633,6 +1609,18 @@ static const char *plugin_parse_getmanifest_response(const char *buffer,
 		/* Default is false in deprecated mode */
 		plugin->non_numeric_ids = !plugin->plugins->ld->deprecated_apis;
 
+	tok = json_get_member(buffer, resulttok, "lengthprefixed");
+	if (tok) {
+		if (!json_to_bool(buffer, tok, &plugin->length_prefixed))
+			return tal_fmt(plugin,
+				       "Invalid lengthprefixed: %.*s",
+				       json_tok_full_len(tok),
+				       json_tok_full(buffer, tok));
+		/* Everything it sends after this is framed. */
+		if (plugin->length_prefixed)
+			json_input_set_framed(&plugin->input);
+	}
+
 	err = plugin_notifications_add(buffer, resulttok, plugin);
 	if (!err)
 		err = plugin_opts_add(plugin, buffer, resulttok);
@@ -1830,6 +1818,7 @@ const char *plugin_send_getmanifest(struct plugin *p, const char *cmd_id)
 
 	log_debug(p->plugins->log, "started(%u) %s", p->pid, p->cmd);
 	p->buffer = tal_arr(p, char, 64);
+	json_input_init(&p->input);
 	jsmn_init(&p->parser);
 	p->toks = toks_alloc(p);
 
@@ -1841,6 +1830,7 @@ const char *plugin_send_getmanifest(struct plugin *p, const char *cmd_id)
 				    p->log, NULL, plugin_manifest_cb, p);
 	json_add_bool(req->stream, "allow-deprecated-apis",
 		      p->plugins->ld->deprecated_apis);
+	json_add_bool(req->stream, "lengthprefixed", true);
 	jsonrpc_request_end(req);
 	plugin_request_send(p, req);
 	p->plugin_state = AWAITING_GETMANIFEST_RESPONSE;
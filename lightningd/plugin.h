@@ -51,6 +51,7 @@ struct plugin {
 	/* Stuff we read */
 	char *buffer;
 	size_t used, len_read;
+	struct json_input input;
 	jsmn_parser parser;
 	jsmntok_t *toks;
 
@@ -84,6 +85,9 @@ struct plugin {
 	/* Can this handle non-numeric JSON ids? */
 	bool non_numeric_ids;
 
+	/* Are messages after getmanifest length-prefixed? */
+	bool length_prefixed;
+
 	/* Parameters for dynamically-started plugins. */
 	const char *parambuf;
 	const jsmntok_t *params;
@@ -0,0 +1,174 @@
+#include "config.h"
+/* Finding an incoming HTLC's channel: the hash tables against walking every
+ * peer's channels. */
+#include <ccan/err/err.h>
+#include <ccan/time/time.h>
+#include <common/channel_type.h>
+#include <common/setup.h>
+#include <inttypes.h>
+#include <lightningd/channel.h>
+#include <lightningd/peer_control.h>
+#include <stdio.h>
+
+/* Each peer has this many channels. */
+#define CHANNELS_PER_PEER 2
+
+struct bench {
+	struct peer **peers;
+	struct channel **channels;
+	struct channel_scid_map *scids;
+	struct channel_alias_map *aliases;
+};
+
+/* What any_channel_by_scid used to do. */
+static struct channel *walk_by_scid(const struct bench *b,
+				    const struct short_channel_id *scid,
+				    bool privacy_leak_ok)
+{
+	struct channel *chan;
+
+	for (size_t i = 0; i < tal_count(b->peers); i++) {
+		list_for_each(&b->peers[i]->channels, chan, list) {
+			if (chan->alias[LOCAL] &&
+			    short_channel_id_eq(scid, chan->alias[LOCAL]))
+				return chan;
+			if (!privacy_leak_ok
+			    && channel_type_has(chan->type, OPT_SCID_ALIAS))
+				continue;
+			if (chan->scid
+			    && short_channel_id_eq(scid, chan->scid))
+				return chan;
+		}
+	}
+	return NULL;
+}
+
+/* What any_channel_by_scid does now. */
+static struct channel *map_by_scid(const struct bench *b,
+				   const struct short_channel_id *scid,
+				   bool privacy_leak_ok)
+{
+	struct channel *chan;
+	struct channel_scid_map_iter it;
+
+	chan = channel_alias_map_get(b->aliases, scid);
+	if (chan)
+		return chan;
+
+	for (chan = channel_scid_map_getfirst(b->scids, scid, &it);
+	     chan;
+	     chan = channel_scid_map_getnext(b->scids, scid, &it)) {
+		if (!privacy_leak_ok
+		    && channel_type_has(chan->type, OPT_SCID_ALIAS))
+			continue;
+		return chan;
+	}
+	return NULL;
+}
+
+static struct bench *new_bench(const tal_t *ctx, size_t num_channels)
+{
+	struct bench *b = tal(ctx, struct bench);
+
+	b->peers = tal_arr(b, struct peer *, 0);
+	b->channels = tal_arr(b, struct channel *, num_channels);
+	b->scids = tal(b, struct channel_scid_map);
+	channel_scid_map_init(b->scids);
+	b->aliases = tal(b, struct channel_alias_map);
+	channel_alias_map_init(b->aliases);
+
+	for (size_t i = 0; i < num_channels; i++) {
+		struct channel *chan = tal(b, struct channel);
+		struct peer *peer;
+		struct channel_type *type;
+
+		if (i % CHANNELS_PER_PEER == 0) {
+			peer = tal(b, struct peer);
+			list_head_init(&peer->channels);
+			tal_arr_expand(&b->peers, peer);
+		} else
+			peer = b->peers[tal_count(b->peers) - 1];
+
+		type = channel_type_anchors_zero_fee_htlc(chan);
+		/* A quarter are private, with option_scid_alias. */
+		if (i % 4 == 0)
+			channel_type_set_scid_alias(type);
+		chan->peer = peer;
+		chan->type = type;
+		chan->scid = tal(chan, struct short_channel_id);
+		if (!mk_short_channel_id(chan->scid, 700000 + i, 1, 0))
+			abort();
+		chan->alias[LOCAL] = tal(chan, struct short_channel_id);
+		chan->alias[LOCAL]->u64 = pseudorand_u64();
+		chan->alias[REMOTE] = NULL;
+		list_add_tail(&peer->channels, &chan->list);
+		channel_scid_map_add(b->scids, chan);
+		channel_alias_map_add(b->aliases, chan);
+		b->channels[i] = chan;
+	}
+	return b;
+}
+
+static u64 run(const struct bench *b,
+	       struct channel *(*fn)(const struct bench *,
+				     const struct short_channel_id *, bool),
+	       size_t num_lookups, size_t *found)
+{
+	size_t num = tal_count(b->channels);
+	struct timemono start = time_mono();
+
+	*found = 0;
+
+	for (size_t i = 0; i < num_lookups; i++) {
+		/* Spread over the channels, by real scid and by alias. */
+		const struct channel *chan = b->channels[(i * 7919) % num];
+		const struct short_channel_id *scid;
+		bool by_alias = (i % 2 == 0)
+			|| channel_type_has(chan->type, OPT_SCID_ALIAS);
+
+		scid = by_alias ? chan->alias[LOCAL] : chan->scid;
+		if (fn(b, scid, false))
+			(*found)++;
+	}
+	return time_to_usec(timemono_since(start));
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_lookups = 100000, max_channels = 100000;
+
+	common_setup(argv[0]);
+
+	if (argc > 3)
+		errx(1, "Usage: %s [<num-lookups> [<max-channels>]]", argv[0]);
+	if (argc > 1)
+		num_lookups = atol(argv[1]);
+	if (argc > 2)
+		max_channels = atol(argv[2]);
+
+	for (size_t n = 10; n <= max_channels; n *= 10) {
+		struct bench *b = new_bench(tmpctx, n);
+		u64 map_usec, walk_usec;
+		size_t map_found, walk_found;
+		/* The walk is O(n): don't wait all day for it. */
+		size_t walk_lookups = num_lookups;
+
+		if (n > 1000)
+			walk_lookups = num_lookups * 1000 / n;
+
+		map_usec = run(b, map_by_scid, num_lookups, &map_found);
+		walk_usec = run(b, walk_by_scid, walk_lookups, &walk_found);
+		printf("# %zu channels: hash tables %"PRIu64" nsec per lookup"
+		       " (%zu/%zu found), walk %"PRIu64" nsec per lookup"
+		       " (%zu/%zu found)\n",
+		       n,
+		       num_lookups ? map_usec * 1000 / num_lookups : 0,
+		       map_found, num_lookups,
+		       walk_lookups ? walk_usec * 1000 / walk_lookups : 0,
+		       walk_found, walk_lookups);
+		clean_tmpctx();
+	}
+
+	common_shutdown();
+	return 0;
+}
@@ -0,0 +1,315 @@
+#include "config.h"
+#include "../channel.c"
+#include <assert.h>
+#include <common/setup.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for command_fail */
+struct command_result *command_fail(struct command *cmd UNNEEDED, enum jsonrpc_errcode code UNNEEDED,
+				    const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "command_fail called!\n"); abort(); }
+/* Generated stub for command_success */
+struct command_result *command_success(struct command *cmd UNNEEDED,
+				       struct json_stream *response)
+
+{ fprintf(stderr, "command_success called!\n"); abort(); }
+/* Generated stub for dev_disconnect_permanent */
+bool dev_disconnect_permanent(struct lightningd *ld UNNEEDED)
+{ fprintf(stderr, "dev_disconnect_permanent called!\n"); abort(); }
+/* Generated stub for drop_to_chain */
+void drop_to_chain(struct lightningd *ld UNNEEDED, struct channel *channel UNNEEDED, bool cooperative UNNEEDED)
+{ fprintf(stderr, "drop_to_chain called!\n"); abort(); }
+/* Generated stub for dup_fee_states */
+struct fee_states *dup_fee_states(const tal_t *ctx UNNEEDED,
+				  const struct fee_states *fee_states TAKES UNNEEDED)
+{ fprintf(stderr, "dup_fee_states called!\n"); abort(); }
+/* Generated stub for dup_height_states */
+struct height_states *dup_height_states(const tal_t *ctx UNNEEDED,
+					const struct height_states *states TAKES UNNEEDED)
+{ fprintf(stderr, "dup_height_states called!\n"); abort(); }
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* Generated stub for fromwire_hsmd_get_channel_basepoints_reply */
+bool fromwire_hsmd_get_channel_basepoints_reply(const void *p UNNEEDED, struct basepoints *basepoints UNNEEDED, struct pubkey *funding_pubkey UNNEEDED)
+{ fprintf(stderr, "fromwire_hsmd_get_channel_basepoints_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsmd_new_channel_reply */
+bool fromwire_hsmd_new_channel_reply(const void *p UNNEEDED)
+{ fprintf(stderr, "fromwire_hsmd_new_channel_reply called!\n"); abort(); }
+/* Generated stub for hsm_sync_req */
+const u8 *hsm_sync_req(const tal_t *ctx UNNEEDED,
+		       struct lightningd *ld UNNEEDED,
+		       const u8 *msg TAKES UNNEEDED)
+{ fprintf(stderr, "hsm_sync_req called!\n"); abort(); }
+/* Generated stub for json_add_bool */
+void json_add_bool(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		   bool value UNNEEDED)
+{ fprintf(stderr, "json_add_bool called!\n"); abort(); }
+/* Generated stub for json_add_channel_id */
+void json_add_channel_id(struct json_stream *response UNNEEDED,
+			 const char *fieldname UNNEEDED,
+			 const struct channel_id *cid UNNEEDED)
+{ fprintf(stderr, "json_add_channel_id called!\n"); abort(); }
+/* Generated stub for json_add_string */
+void json_add_string(struct json_stream *js UNNEEDED,
+		     const char *fieldname UNNEEDED,
+		     const char *str TAKES UNNEEDED)
+{ fprintf(stderr, "json_add_string called!\n"); abort(); }
+/* Generated stub for json_stream_success */
+struct json_stream *json_stream_success(struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_success called!\n"); abort(); }
+/* Generated stub for log_ */
+void log_(struct logger *logger UNNEEDED, enum log_level level UNNEEDED,
+	  const struct node_id *node_id UNNEEDED,
+	  bool call_notifier UNNEEDED,
+	  const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "log_ called!\n"); abort(); }
+/* Generated stub for maybe_delete_peer */
+void maybe_delete_peer(struct peer *peer UNNEEDED)
+{ fprintf(stderr, "maybe_delete_peer called!\n"); abort(); }
+/* Generated stub for new_logger */
+struct logger *new_logger(const tal_t *ctx UNNEEDED, struct log_book *record UNNEEDED,
+			  const struct node_id *default_node_id UNNEEDED,
+			  const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "new_logger called!\n"); abort(); }
+/* Generated stub for notify_channel_open_failed */
+void notify_channel_open_failed(struct lightningd *ld UNNEEDED,
+                                const struct channel_id *cid UNNEEDED)
+{ fprintf(stderr, "notify_channel_open_failed called!\n"); abort(); }
+/* Generated stub for notify_channel_state_changed */
+void notify_channel_state_changed(struct lightningd *ld UNNEEDED,
+				  struct node_id *peer_id UNNEEDED,
+				  struct channel_id *cid UNNEEDED,
+				  struct short_channel_id *scid UNNEEDED,
+				  struct timeabs *timestamp UNNEEDED,
+				  enum channel_state old_state UNNEEDED,
+				  enum channel_state new_state UNNEEDED,
+				  enum state_change cause UNNEEDED,
+				  char *message UNNEEDED)
+{ fprintf(stderr, "notify_channel_state_changed called!\n"); abort(); }
+/* Generated stub for p2tr_for_keyidx */
+u8 *p2tr_for_keyidx(const tal_t *ctx UNNEEDED, struct lightningd *ld UNNEEDED, u64 keyidx UNNEEDED)
+{ fprintf(stderr, "p2tr_for_keyidx called!\n"); abort(); }
+/* Generated stub for p2wpkh_for_keyidx */
+u8 *p2wpkh_for_keyidx(const tal_t *ctx UNNEEDED, struct lightningd *ld UNNEEDED, u64 keyidx UNNEEDED)
+{ fprintf(stderr, "p2wpkh_for_keyidx called!\n"); abort(); }
+/* Generated stub for subd_release_channel */
+void subd_release_channel(struct subd *owner UNNEEDED, const void *channel UNNEEDED)
+{ fprintf(stderr, "subd_release_channel called!\n"); abort(); }
+/* Generated stub for towire_errorfmt */
+u8 *towire_errorfmt(const tal_t *ctx UNNEEDED,
+		    const struct channel_id *channel UNNEEDED,
+		    const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "towire_errorfmt called!\n"); abort(); }
+/* Generated stub for towire_hsmd_get_channel_basepoints */
+u8 *towire_hsmd_get_channel_basepoints(const tal_t *ctx UNNEEDED, const struct node_id *peerid UNNEEDED, u64 dbid UNNEEDED)
+{ fprintf(stderr, "towire_hsmd_get_channel_basepoints called!\n"); abort(); }
+/* Generated stub for towire_hsmd_new_channel */
+u8 *towire_hsmd_new_channel(const tal_t *ctx UNNEEDED, const struct node_id *id UNNEEDED, u64 dbid UNNEEDED)
+{ fprintf(stderr, "towire_hsmd_new_channel called!\n"); abort(); }
+/* Generated stub for txfilter_add_scriptpubkey */
+void txfilter_add_scriptpubkey(struct txfilter *filter UNNEEDED, const u8 *script TAKES UNNEEDED)
+{ fprintf(stderr, "txfilter_add_scriptpubkey called!\n"); abort(); }
+/* Generated stub for wallet_channel_close */
+void wallet_channel_close(struct wallet *w UNNEEDED, u64 wallet_id UNNEEDED)
+{ fprintf(stderr, "wallet_channel_close called!\n"); abort(); }
+/* Generated stub for wallet_channel_save */
+void wallet_channel_save(struct wallet *w UNNEEDED, struct channel *chan UNNEEDED)
+{ fprintf(stderr, "wallet_channel_save called!\n"); abort(); }
+/* Generated stub for wallet_get_channel_dbid */
+u64 wallet_get_channel_dbid(struct wallet *wallet UNNEEDED)
+{ fprintf(stderr, "wallet_get_channel_dbid called!\n"); abort(); }
+/* Generated stub for wallet_state_change_add */
+void wallet_state_change_add(struct wallet *w UNNEEDED,
+			     const u64 channel_id UNNEEDED,
+			     struct timeabs *timestamp UNNEEDED,
+			     enum channel_state old_state UNNEEDED,
+			     enum channel_state new_state UNNEEDED,
+			     enum state_change cause UNNEEDED,
+			     char *message UNNEEDED)
+{ fprintf(stderr, "wallet_state_change_add called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+#define NUM_PEERS 10
+#define CHANNELS_PER_PEER 10
+
+static struct peer *peers[NUM_PEERS];
+
+/* What any_channel_by_scid used to do. */
+static struct channel *walk_by_scid(const struct short_channel_id *scid,
+				    bool privacy_leak_ok)
+{
+	struct channel *chan;
+
+	for (size_t i = 0; i < NUM_PEERS; i++) {
+		list_for_each(&peers[i]->channels, chan, list) {
+			if (chan->alias[LOCAL] &&
+			    short_channel_id_eq(scid, chan->alias[LOCAL]))
+				return chan;
+			if (!privacy_leak_ok
+			    && channel_type_has(chan->type, OPT_SCID_ALIAS))
+				continue;
+			if (chan->scid
+			    && short_channel_id_eq(scid, chan->scid))
+				return chan;
+		}
+	}
+	return NULL;
+}
+
+static struct short_channel_id test_scid(u32 blocknum, u64 n)
+{
+	struct short_channel_id scid;
+
+	assert(mk_short_channel_id(&scid, blocknum, n, 0));
+	return scid;
+}
+
+static struct channel_id test_cid(u64 n, u8 gen)
+{
+	struct channel_id cid;
+
+	memset(&cid, gen, sizeof(cid));
+	memcpy(cid.id, &n, sizeof(n));
+	return cid;
+}
+
+/* Just enough channel for the lookups. */
+static struct channel *new_test_channel(struct peer *peer, u64 n)
+{
+	struct channel *chan = talz(peer, struct channel);
+	struct short_channel_id scid = test_scid(700000, n);
+	struct short_channel_id alias = test_scid(1, n);
+	struct channel_type *type = channel_type_anchors_zero_fee_htlc(chan);
+
+	/* A quarter are private, with option_scid_alias. */
+	if (n % 4 == 0)
+		channel_type_set_scid_alias(type);
+	chan->peer = peer;
+	chan->type = type;
+	chan->cid = test_cid(n, 0);
+	list_add_tail(&peer->channels, &chan->list);
+	channel_cid_map_add(peer->ld->channels_by_cid, chan);
+
+	channel_set_dbid(chan, n + 1);
+	channel_set_local_alias(chan, &alias);
+	/* Some aren't confirmed yet. */
+	if (n % 5 != 0)
+		channel_set_scid(chan, &scid);
+	return chan;
+}
+
+/* The tables must agree with a walk over every channel. */
+static void check_lookups(struct lightningd *ld)
+{
+	for (size_t i = 0; i < NUM_PEERS; i++) {
+		struct channel *chan;
+
+		list_for_each(&peers[i]->channels, chan, list) {
+			assert(channel_by_dbid(ld, chan->dbid) == chan);
+			assert(channel_by_cid(ld, &chan->cid) == chan);
+			if (chan->alias[LOCAL]) {
+				assert(any_channel_by_scid(ld, chan->alias[LOCAL], false)
+				       == chan);
+				assert(walk_by_scid(chan->alias[LOCAL], false)
+				       == chan);
+			}
+			if (chan->scid) {
+				for (int leak = 0; leak < 2; leak++)
+					assert(any_channel_by_scid(ld, chan->scid, leak)
+					       == walk_by_scid(chan->scid, leak));
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct lightningd *ld;
+	struct short_channel_id scid, old_scid, old_alias;
+	struct channel_id cid, old_cid;
+	struct channel *chan;
+	u64 n = 0;
+
+	common_setup(argv[0]);
+
+	ld = talz(tmpctx, struct lightningd);
+	ld->channels_by_scid = tal(ld, struct channel_scid_map);
+	channel_scid_map_init(ld->channels_by_scid);
+	ld->channels_by_alias = tal(ld, struct channel_alias_map);
+	channel_alias_map_init(ld->channels_by_alias);
+	ld->channels_by_dbid = tal(ld, struct channel_dbid_map);
+	channel_dbid_map_init(ld->channels_by_dbid);
+	ld->channels_by_cid = tal(ld, struct channel_cid_map);
+	channel_cid_map_init(ld->channels_by_cid);
+
+	for (size_t i = 0; i < NUM_PEERS; i++) {
+		peers[i] = talz(ld, struct peer);
+		peers[i]->ld = ld;
+		list_head_init(&peers[i]->channels);
+		for (size_t j = 0; j < CHANNELS_PER_PEER; j++)
+			new_test_channel(peers[i], n++);
+	}
+	check_lookups(ld);
+
+	/* Nothing that isn't there. */
+	scid = test_scid(700000, n);
+	assert(!any_channel_by_scid(ld, &scid, true));
+	scid = test_scid(1, n);
+	assert(!any_channel_by_scid(ld, &scid, true));
+	assert(!channel_by_dbid(ld, n + 1));
+
+	/* Private channels can't be found by real scid, unless we say so. */
+	chan = list_top(&peers[0]->channels, struct channel, list);
+	scid = test_scid(700000, 0);
+	channel_set_scid(chan, &scid);
+	assert(channel_type_has(chan->type, OPT_SCID_ALIAS));
+	assert(!any_channel_by_scid(ld, chan->scid, false));
+	assert(any_channel_by_scid(ld, chan->scid, true) == chan);
+
+	/* Change everything about one channel: the tables follow. */
+	chan = list_tail(&peers[1]->channels, struct channel, list);
+	old_scid = *chan->scid;
+	old_alias = *chan->alias[LOCAL];
+	old_cid = chan->cid;
+	scid = test_scid(800000, 1);
+	channel_set_scid(chan, &scid);
+	scid = test_scid(2, 1);
+	channel_set_local_alias(chan, &scid);
+	cid = test_cid(1, 1);
+	channel_set_cid(chan, &cid);
+	assert(!any_channel_by_scid(ld, &old_scid, true));
+	assert(!any_channel_by_scid(ld, &old_alias, true));
+	assert(!channel_by_cid(ld, &old_cid));
+	check_lookups(ld);
+
+	/* And when they go. */
+	old_scid = *chan->scid;
+	old_alias = *chan->alias[LOCAL];
+	channel_set_scid(chan, NULL);
+	channel_set_local_alias(chan, NULL);
+	assert(!chan->scid && !chan->alias[LOCAL]);
+	assert(!any_channel_by_scid(ld, &old_scid, true));
+	assert(!any_channel_by_scid(ld, &old_alias, true));
+	check_lookups(ld);
+
+	/* Stub scids can be shared: we find one of them. */
+	scid = test_scid(900000, 0);
+	for (size_t i = 0; i < 2; i++) {
+		chan = list_tail(&peers[2 + i]->channels, struct channel, list);
+		channel_set_scid(chan, &scid);
+	}
+	chan = any_channel_by_scid(ld, &scid, true);
+	assert(chan);
+	assert(chan == list_tail(&peers[2]->channels, struct channel, list)
+	       || chan == list_tail(&peers[3]->channels, struct channel, list));
+	channel_set_scid(chan, NULL);
+	assert(any_channel_by_scid(ld, &scid, true) == walk_by_scid(&scid, true));
+	assert(any_channel_by_scid(ld, &scid, true) != NULL);
+
+	common_shutdown();
+	return 0;
+}
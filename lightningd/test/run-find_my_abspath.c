@@ -161,6 +161,9 @@ bool log_status_msg(struct logger *log UNNEEDED,
  		    const struct node_id *node_id UNNEEDED,
 		    const u8 *msg UNNEEDED)
 { fprintf(stderr, "log_status_msg called!\n"); abort(); }
+/* Generated stub for new_htlc_expiries */
+struct htlc_expiries *new_htlc_expiries(const tal_t *ctx UNNEEDED)
+{ fprintf(stderr, "new_htlc_expiries called!\n"); abort(); }
 /* Generated stub for new_log_book */
 struct log_book *new_log_book(struct lightningd *ld UNNEEDED, size_t max_mem UNNEEDED)
 { fprintf(stderr, "new_log_book called!\n"); abort(); }
@@ -220,6 +223,9 @@ void setup_topology(struct chain_topology *topology UNNEEDED,
 /* Generated stub for shutdown_plugins */
 void shutdown_plugins(struct lightningd *ld UNNEEDED)
 { fprintf(stderr, "shutdown_plugins called!\n"); abort(); }
+/* Generated stub for sphinx_batch_new */
+struct sphinx_batch *sphinx_batch_new(const tal_t *ctx UNNEEDED, size_t num_threads UNNEEDED)
+{ fprintf(stderr, "sphinx_batch_new called!\n"); abort(); }
 /* Generated stub for stop_topology */
 void stop_topology(struct chain_topology *topo UNNEEDED)
 { fprintf(stderr, "stop_topology called!\n"); abort(); }
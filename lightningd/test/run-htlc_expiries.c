@@ -0,0 +1,104 @@
+#include "config.h"
+#include "../htlc_end.c"
+#include <common/setup.h>
+#include <stdio.h>
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for fatal */
+void   fatal(const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "fatal called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+static struct htlc_in *add_in(const tal_t *ctx,
+			      struct htlc_in_map *map,
+			      struct htlc_expiries *expiries,
+			      struct channel *channel, u64 id, u32 cltv_expiry)
+{
+	struct htlc_in *hin = tal(ctx, struct htlc_in);
+
+	hin->key.channel = channel;
+	hin->key.id = id;
+	hin->cltv_expiry = cltv_expiry;
+	connect_htlc_in(map, expiries, hin);
+	return hin;
+}
+
+static struct htlc_out *add_out(const tal_t *ctx,
+				struct htlc_out_map *map,
+				struct htlc_expiries *expiries,
+				struct channel *channel, u64 id, u32 cltv_expiry)
+{
+	struct htlc_out *hout = tal(ctx, struct htlc_out);
+
+	hout->key.channel = channel;
+	hout->key.id = id;
+	hout->cltv_expiry = cltv_expiry;
+	connect_htlc_out(map, expiries, hout);
+	return hout;
+}
+
+int main(int argc, char *argv[])
+{
+	struct htlc_in_map *htlcs_in;
+	struct htlc_out_map *htlcs_out;
+	struct htlc_expiries *expiries;
+	struct htlc_in *hin[4];
+	struct htlc_out *hout[2];
+	struct htlc_key *keys;
+	/* We only use these as keys. */
+	struct channel *c1, *c2;
+
+	common_setup(argv[0]);
+
+	c1 = (struct channel *)tal(tmpctx, char);
+	c2 = (struct channel *)tal(tmpctx, char);
+	htlcs_in = tal(tmpctx, struct htlc_in_map);
+	htlc_in_map_init(htlcs_in);
+	htlcs_out = tal(tmpctx, struct htlc_out_map);
+	htlc_out_map_init(htlcs_out);
+	expiries = new_htlc_expiries(tmpctx);
+
+	hin[0] = add_in(tmpctx, htlcs_in, expiries, c1, 0, 105);
+	hin[1] = add_in(tmpctx, htlcs_in, expiries, c1, 1, 101);
+	hin[2] = add_in(tmpctx, htlcs_in, expiries, c2, 0, 101);
+	hin[3] = add_in(tmpctx, htlcs_in, expiries, c2, 1, 100);
+	hout[0] = add_out(tmpctx, htlcs_out, expiries, c1, 0, 101);
+	hout[1] = add_out(tmpctx, htlcs_out, expiries, c2, 0, 110);
+
+	/* Nothing yet. */
+	assert(tal_count(htlc_in_keys_expiring(tmpctx, expiries, 99)) == 0);
+	assert(tal_count(htlc_out_keys_expiring(tmpctx, expiries, 100)) == 0);
+
+	/* Earliest first, then in the order added. */
+	keys = htlc_in_keys_expiring(tmpctx, expiries, 101);
+	assert(tal_count(keys) == 3);
+	assert(keys[0].channel == c2 && keys[0].id == 1);
+	assert(keys[1].channel == c1 && keys[1].id == 1);
+	assert(keys[2].channel == c2 && keys[2].id == 0);
+
+	keys = htlc_out_keys_expiring(tmpctx, expiries, 101);
+	assert(tal_count(keys) == 1);
+	assert(keys[0].channel == c1 && keys[0].id == 0);
+
+	/* Freeing removes them. */
+	tal_free(hin[1]);
+	tal_free(hin[3]);
+	keys = htlc_in_keys_expiring(tmpctx, expiries, 200);
+	assert(tal_count(keys) == 2);
+	assert(keys[0].channel == c2 && keys[0].id == 0);
+	assert(keys[1].channel == c1 && keys[1].id == 0);
+	assert(!find_htlc_in(htlcs_in, c1, 1));
+
+	/* Bucket 101 still has hout[0] in it. */
+	tal_free(hin[2]);
+	assert(uintmap_get(&expiries->map, 101));
+	tal_free(hout[0]);
+	assert(!uintmap_get(&expiries->map, 101));
+
+	tal_free(hin[0]);
+	tal_free(hout[1]);
+	assert(uintmap_empty(&expiries->map));
+
+	common_shutdown();
+	return 0;
+}
@@ -98,11 +98,18 @@ void channel_internal_error(struct channel *channel UNNEEDED, const char *fmt UN
 /* Generated stub for channel_last_funding_feerate */
 u32 channel_last_funding_feerate(const struct channel *channel UNNEEDED)
 { fprintf(stderr, "channel_last_funding_feerate called!\n"); abort(); }
+/* Generated stub for channel_set_cid */
+void channel_set_cid(struct channel *channel UNNEEDED, const struct channel_id *cid UNNEEDED)
+{ fprintf(stderr, "channel_set_cid called!\n"); abort(); }
 /* Generated stub for channel_set_last_tx */
 void channel_set_last_tx(struct channel *channel UNNEEDED,
 			 struct bitcoin_tx *tx UNNEEDED,
 			 const struct bitcoin_signature *sig UNNEEDED)
 { fprintf(stderr, "channel_set_last_tx called!\n"); abort(); }
+/* Generated stub for channel_set_scid */
+void channel_set_scid(struct channel *channel UNNEEDED,
+		      const struct short_channel_id *scid UNNEEDED)
+{ fprintf(stderr, "channel_set_scid called!\n"); abort(); }
 /* Generated stub for channel_state_name */
 const char *channel_state_name(const struct channel *channel UNNEEDED)
 { fprintf(stderr, "channel_state_name called!\n"); abort(); }
@@ -152,6 +159,11 @@ struct command_result *command_its_complicated(const char *why UNNEEDED)
 /* Generated stub for command_log */
 struct logger *command_log(struct command *cmd UNNEEDED)
 { fprintf(stderr, "command_log called!\n"); abort(); }
+/* Generated stub for command_next_chunk_ */
+struct command_result *command_next_chunk_(struct command *cmd UNNEEDED,
+					   void (*cb)(void *arg) UNNEEDED, void *arg UNNEEDED)
+
+{ fprintf(stderr, "command_next_chunk_ called!\n"); abort(); }
 /* Generated stub for command_param_failed */
 struct command_result *command_param_failed(void)
 
@@ -386,6 +398,12 @@ bool invoices_delete_description(struct invoices *invoices UNNEEDED,
 void invoices_delete_expired(struct invoices *invoices UNNEEDED,
 			     u64 max_expiry_time UNNEEDED)
 { fprintf(stderr, "invoices_delete_expired called!\n"); abort(); }
+/* Generated stub for invoices_delete_range */
+u64 invoices_delete_range(struct invoices *invoices UNNEEDED,
+			  enum invoice_status status UNNEEDED,
+			  u64 max_time UNNEEDED,
+			  u64 start UNNEEDED, u64 end UNNEEDED)
+{ fprintf(stderr, "invoices_delete_range called!\n"); abort(); }
 /* Generated stub for invoices_find_by_label */
 bool invoices_find_by_label(struct invoices *invoices UNNEEDED,
 			    u64 *inv_dbid UNNEEDED,
@@ -963,12 +981,14 @@ void wallet_delete_peer_if_unused(struct wallet *w UNNEEDED, u64 peer_dbid UNNEE
 /* Generated stub for wallet_htlcs_load_in_for_channel */
 bool wallet_htlcs_load_in_for_channel(struct wallet *wallet UNNEEDED,
 				      struct channel *chan UNNEEDED,
-				      struct htlc_in_map *htlcs_in UNNEEDED)
+				      struct htlc_in_map *htlcs_in UNNEEDED,
+				      struct htlc_expiries *expiries UNNEEDED)
 { fprintf(stderr, "wallet_htlcs_load_in_for_channel called!\n"); abort(); }
 /* Generated stub for wallet_htlcs_load_out_for_channel */
 bool wallet_htlcs_load_out_for_channel(struct wallet *wallet UNNEEDED,
 				       struct channel *chan UNNEEDED,
 				       struct htlc_out_map *htlcs_out UNNEEDED,
+				       struct htlc_expiries *expiries UNNEEDED,
 				       struct htlc_in_map *remaining_htlcs_in UNNEEDED)
 { fprintf(stderr, "wallet_htlcs_load_out_for_channel called!\n"); abort(); }
 /* Generated stub for wallet_init_channels */
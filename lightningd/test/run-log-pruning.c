@@ -27,11 +27,10 @@ bool fromwire_channel_id(const u8 **cursor UNNEEDED, size_t *max UNNEEDED,
 /* Generated stub for fromwire_node_id */
 void fromwire_node_id(const u8 **cursor UNNEEDED, size_t *max UNNEEDED, struct node_id *id UNNEEDED)
 { fprintf(stderr, "fromwire_node_id called!\n"); abort(); }
-/* Generated stub for json_add_hex_talarr */
-void json_add_hex_talarr(struct json_stream *result UNNEEDED,
-			 const char *fieldname UNNEEDED,
-			 const tal_t *data UNNEEDED)
-{ fprintf(stderr, "json_add_hex_talarr called!\n"); abort(); }
+/* Generated stub for json_add_hex */
+void json_add_hex(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  const void *data UNNEEDED, size_t len UNNEEDED)
+{ fprintf(stderr, "json_add_hex called!\n"); abort(); }
 /* Generated stub for json_add_node_id */
 void json_add_node_id(struct json_stream *response UNNEEDED,
 				const char *fieldname UNNEEDED,
@@ -148,6 +147,29 @@ int main(int argc, char *argv[])
 		total += 1 + lb->log[i].skipped;
 	assert(total == 102);
 
+	/* Keep going, so the text buffer has to be compacted (many times) */
+	for (size_t i = 0; i < 10000; i++) {
+		if (i % 7 == 0)
+			log_io(l, LOG_IO_IN, NULL, "io", &i, sizeof(i));
+		else
+			log_debug(l, "test %06zi", i);
+	}
+	/* Last ones are intact (between any pruning messages) */
+	for (size_t i = 10000, pos = lb->num_entries; i > 10000 - 10; pos--) {
+		if (strstarts(lb->log[pos-1].log, "Log pruned"))
+			continue;
+		i--;
+		if (i % 7 == 0) {
+			assert(streq(lb->log[pos-1].log, "io"));
+			assert(lb->log[pos-1].io_len == sizeof(i));
+			assert(memcmp(lb->log[pos-1].io, &i, sizeof(i)) == 0);
+		} else
+			assert(streq(lb->log[pos-1].log,
+				     tal_fmt(lb, "test %06zi", i)));
+	}
+	/* It never needed to grow */
+	assert(tal_count(lb->text) == 8192);
+
 	/* Freeing (last) log frees logbook */
 	tal_free(l);
 	common_shutdown();
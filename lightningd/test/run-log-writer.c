@@ -0,0 +1,212 @@
+#include "config.h"
+#include <common/node_id.c>
+#include <common/setup.h>
+#include <common/status_levels.c>
+#include <stdio.h>
+#include "../log.c"
+
+/* AUTOGENERATED MOCKS START */
+/* Generated stub for command_fail */
+struct command_result *command_fail(struct command *cmd UNNEEDED, enum jsonrpc_errcode code UNNEEDED,
+				    const char *fmt UNNEEDED, ...)
+
+{ fprintf(stderr, "command_fail called!\n"); abort(); }
+/* Generated stub for command_param_failed */
+struct command_result *command_param_failed(void)
+
+{ fprintf(stderr, "command_param_failed called!\n"); abort(); }
+/* Generated stub for command_success */
+struct command_result *command_success(struct command *cmd UNNEEDED,
+				       struct json_stream *response)
+
+{ fprintf(stderr, "command_success called!\n"); abort(); }
+/* Generated stub for fromwire_bigsize */
+bigsize_t fromwire_bigsize(const u8 **cursor UNNEEDED, size_t *max UNNEEDED)
+{ fprintf(stderr, "fromwire_bigsize called!\n"); abort(); }
+/* Generated stub for fromwire_channel_id */
+bool fromwire_channel_id(const u8 **cursor UNNEEDED, size_t *max UNNEEDED,
+			 struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "fromwire_channel_id called!\n"); abort(); }
+/* Generated stub for json_add_hex */
+void json_add_hex(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  const void *data UNNEEDED, size_t len UNNEEDED)
+{ fprintf(stderr, "json_add_hex called!\n"); abort(); }
+/* Generated stub for json_add_node_id */
+void json_add_node_id(struct json_stream *response UNNEEDED,
+				const char *fieldname UNNEEDED,
+				const struct node_id *id UNNEEDED)
+{ fprintf(stderr, "json_add_node_id called!\n"); abort(); }
+/* Generated stub for json_add_num */
+void json_add_num(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+		  unsigned int value UNNEEDED)
+{ fprintf(stderr, "json_add_num called!\n"); abort(); }
+/* Generated stub for json_add_str_fmt */
+void json_add_str_fmt(struct json_stream *js UNNEEDED,
+		      const char *fieldname UNNEEDED,
+		      const char *fmt UNNEEDED, ...)
+{ fprintf(stderr, "json_add_str_fmt called!\n"); abort(); }
+/* Generated stub for json_add_string */
+void json_add_string(struct json_stream *js UNNEEDED,
+		     const char *fieldname UNNEEDED,
+		     const char *str TAKES UNNEEDED)
+{ fprintf(stderr, "json_add_string called!\n"); abort(); }
+/* Generated stub for json_add_time */
+void json_add_time(struct json_stream *result UNNEEDED, const char *fieldname UNNEEDED,
+			  struct timespec ts UNNEEDED)
+{ fprintf(stderr, "json_add_time called!\n"); abort(); }
+/* Generated stub for json_array_end */
+void json_array_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_array_end called!\n"); abort(); }
+/* Generated stub for json_array_start */
+void json_array_start(struct json_stream *js UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_array_start called!\n"); abort(); }
+/* Generated stub for json_object_end */
+void json_object_end(struct json_stream *js UNNEEDED)
+{ fprintf(stderr, "json_object_end called!\n"); abort(); }
+/* Generated stub for json_object_start */
+void json_object_start(struct json_stream *ks UNNEEDED, const char *fieldname UNNEEDED)
+{ fprintf(stderr, "json_object_start called!\n"); abort(); }
+/* Generated stub for json_stream_log_suppress_for_cmd */
+void json_stream_log_suppress_for_cmd(struct json_stream *js UNNEEDED,
+					    const struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_log_suppress_for_cmd called!\n"); abort(); }
+/* Generated stub for json_stream_success */
+struct json_stream *json_stream_success(struct command *cmd UNNEEDED)
+{ fprintf(stderr, "json_stream_success called!\n"); abort(); }
+/* Generated stub for notify_warning */
+void notify_warning(struct lightningd *ld UNNEEDED, struct log_entry *l UNNEEDED)
+{ fprintf(stderr, "notify_warning called!\n"); abort(); }
+/* Generated stub for param */
+bool param(struct command *cmd UNNEEDED, const char *buffer UNNEEDED,
+	   const jsmntok_t params[] UNNEEDED, ...)
+{ fprintf(stderr, "param called!\n"); abort(); }
+/* Generated stub for towire_bigsize */
+void towire_bigsize(u8 **pptr UNNEEDED, const bigsize_t val UNNEEDED)
+{ fprintf(stderr, "towire_bigsize called!\n"); abort(); }
+/* Generated stub for towire_channel_id */
+void towire_channel_id(u8 **pptr UNNEEDED, const struct channel_id *channel_id UNNEEDED)
+{ fprintf(stderr, "towire_channel_id called!\n"); abort(); }
+/* AUTOGENERATED MOCKS END */
+
+#define NUM_LINES 200000
+
+/* Like a log reader (e.g. a pipe to logger(1)), but we can make it slow. */
+struct reader {
+	int fd;
+	char *buf;
+	size_t len;
+};
+
+static void *read_pipe(struct reader *r)
+{
+	size_t max = 1024;
+	ssize_t ret;
+
+	r->buf = malloc(max);
+	r->len = 0;
+	while ((ret = read(r->fd, r->buf + r->len, max - r->len)) > 0) {
+		r->len += ret;
+		if (r->len == max)
+			r->buf = realloc(r->buf, max *= 2);
+	}
+	return NULL;
+}
+
+/* Returns how many lines we saw, and checks they're in order (and that we
+ * said how many we dropped, if any). */
+static size_t check_lines(char *buf, size_t len)
+{
+	size_t seen = 0, dropped = 0, last = 0;
+	char *p = buf, *end = buf + len;
+
+	while (p < end) {
+		char *nl = memchr(p, '\n', end - p);
+		size_t n;
+
+		assert(nl);
+		/* Otherwise sscanf does strlen() on the whole rest! */
+		*nl = '\0';
+		if (sscanf(p, "[%zu log lines dropped]", &n) == 1) {
+			dropped += n;
+		} else if (sscanf(p, "DEBUG   test: line %zu", &n) == 1) {
+			/* Dropped count includes others (e.g. "Log pruned") */
+			assert(n > last && n <= last + 1 + dropped);
+			last = n;
+			dropped = 0;
+			seen++;
+		}
+		p = nl + 1;
+	}
+	/* The last line always gets through. */
+	assert(last == NUM_LINES);
+	return seen;
+}
+
+static size_t run(bool drop_when_full)
+{
+	struct lightningd *ld;
+	struct log_book *lb;
+	struct logger *log;
+	struct reader reader;
+	pthread_t reader_thread;
+	FILE *f;
+	int fds[2];
+	size_t seen;
+
+	assert(pipe(fds) == 0);
+
+	ld = tal(tmpctx, struct lightningd);
+	ld->logfiles = NULL;
+	lb = ld->log_book = new_log_book(ld, 1024*1024);
+	ld->log = new_logger(ld, lb, NULL, "dummy");
+	lb->print_timestamps = false;
+	lb->drop_when_full = drop_when_full;
+	assert(arg_log_to_file(tal_fmt(tmpctx, "/dev/fd/%i", fds[1]), ld)
+	       == NULL);
+	close(fds[1]);
+	assert(opt_log_level("debug", lb) == NULL);
+	logging_options_parsed(lb);
+	assert(log_writer);
+
+	log = new_logger(ld, lb, NULL, "test");
+	reader.fd = fds[0];
+	if (!drop_when_full)
+		assert(pthread_create(&reader_thread, NULL,
+				      (void *(*)(void *))read_pipe, &reader) == 0);
+	for (size_t i = 1; i < NUM_LINES; i++)
+		log_debug(log, "line %06zu", i);
+
+	/* Nobody was reading, so it can't have kept up. */
+	if (drop_when_full) {
+		assert(lb->log_files[0]->dropped > 0);
+		assert(pthread_create(&reader_thread, NULL,
+				      (void *(*)(void *))read_pipe, &reader) == 0);
+		log_writer_flush(log_writer);
+	}
+	log_debug(log, "line %06zu", (size_t)NUM_LINES);
+
+	/* Freeing the log book waits for the writer. */
+	f = lb->log_files[0]->f;
+	tal_free(log);
+	tal_free(ld->log);
+	assert(!log_writer);
+	fclose(f);
+
+	pthread_join(reader_thread, NULL);
+	close(fds[0]);
+	seen = check_lines(reader.buf, reader.len);
+	free(reader.buf);
+	return seen;
+}
+
+int main(int argc, char *argv[])
+{
+	common_setup(argv[0]);
+
+	/* Slow reader just slows us down. */
+	assert(run(false) == NUM_LINES);
+	/* Otherwise we drop some, and say so. */
+	assert(run(true) < NUM_LINES);
+
+	common_shutdown();
+}
@@ -45,6 +45,9 @@ static bool json_to_subsystem(const char *buffer, const jsmntok_t *tok,
 	return false;
 }
 
+/* How many invoices we ask listinvoices for at once. */
+#define INVOICES_PAGE_SIZE 1000
+
 /* Usually this refers to the global one, but for autoclean-once
  * it's a temporary. */
 struct clean_info {
@@ -53,6 +56,14 @@ struct clean_info {
 	u64 subsystem_age[NUM_SUBSYSTEM];
 	u64 num_cleaned[NUM_SUBSYSTEM];
 	u64 num_uncleaned;
+
+	/* Paging through listinvoices by created_index: where the next page
+	 * starts, and the first invoice we might still clean later
+	 * (UINT64_MAX if none yet). */
+	u64 invoices_next;
+	u64 invoices_pending;
+	/* Which invoice subsystems were enabled when we started. */
+	u64 invoices_mask;
 };
 
 /* For deprecated API, setting this to zero disabled autoclean */
@@ -63,6 +74,10 @@ static u64 total_cleaned[NUM_SUBSYSTEM];
 static struct plugin *plugin;
 /* This is NULL if it's running now. */
 static struct plugin_timer *cleantimer;
+/* The timer's invoice scan starts here: everything earlier is either
+ * cleaned or belongs to a subsystem which wasn't in invoices_start_mask.
+ * Kept in the datastore, so a cycle only looks at new invoices. */
+static u64 invoices_start, invoices_start_mask;
 
 static void do_clean_timer(void *unused);
 
@@ -85,6 +100,40 @@ static const char *datastore_path(const tal_t *ctx,
 		       subsystem_to_str(subsystem), field);
 }
 
+/* Bitmask of enabled invoice subsystems */
+static u64 invoices_mask(const struct clean_info *cinfo)
+{
+	u64 mask = 0;
+
+	if (cinfo->subsystem_age[PAIDINVOICES])
+		mask |= (1ULL << PAIDINVOICES);
+	if (cinfo->subsystem_age[EXPIREDINVOICES])
+		mask |= (1ULL << EXPIREDINVOICES);
+	return mask;
+}
+
+static void save_invoices_start(struct clean_info *cinfo)
+{
+	u64 start = cinfo->invoices_pending;
+
+	if (cinfo->invoices_next < start)
+		start = cinfo->invoices_next;
+	if (start == invoices_start && cinfo->invoices_mask == invoices_start_mask)
+		return;
+
+	plugin_log(plugin, LOG_DBG, "invoices now start at %"PRIu64, start);
+	invoices_start = start;
+	invoices_start_mask = cinfo->invoices_mask;
+	jsonrpc_set_datastore_string(plugin, cinfo->cmd,
+				     "autoclean/invoices/start",
+				     tal_fmt(tmpctx, "%"PRIu64, invoices_start),
+				     "create-or-replace", NULL, NULL, NULL);
+	jsonrpc_set_datastore_string(plugin, cinfo->cmd,
+				     "autoclean/invoices/mask",
+				     tal_fmt(tmpctx, "%"PRIu64, invoices_start_mask),
+				     "create-or-replace", NULL, NULL, NULL);
+}
+
 static struct command_result *clean_finished(struct clean_info *cinfo)
 {
 	for (enum subsystem i = 0; i < NUM_SUBSYSTEM; i++) {
@@ -144,8 +193,13 @@ static struct command_result *del_done(struct command *cmd,
 				       struct del_data *del_data)
 {
 	struct clean_info *cinfo = del_data->cinfo;
+	u64 deleted;
 
-	cinfo->num_cleaned[del_data->subsystem]++;
+	/* delinvoicerange tells us how many it did, the others do one. */
+	if (json_scan(tmpctx, buf, result, "{deleted:%}",
+		      JSON_SCAN(json_to_u64, &deleted)) != NULL)
+		deleted = 1;
+	cinfo->num_cleaned[del_data->subsystem] += deleted;
 	tal_free(del_data);
 	return clean_finished_one(cinfo);
 }
@@ -178,6 +232,35 @@ static struct out_req *del_request_start(const char *method,
 				     del_done, del_failed, del_data);
 }
 
+static struct command_result *listinvoices_done(struct command *cmd,
+						const char *buf,
+						const jsmntok_t *result,
+						struct clean_info *cinfo);
+static struct command_result *listinvoices_failed(struct command *cmd,
+						  const char *buf,
+						  const jsmntok_t *result,
+						  void *unused);
+
+static void listinvoices_page(struct clean_info *cinfo)
+{
+	struct out_req *req;
+
+	req = jsonrpc_request_start(plugin, NULL, "listinvoices",
+				    listinvoices_done, listinvoices_failed,
+				    cinfo);
+	json_add_string(req->js, "index", "created");
+	json_add_u64(req->js, "start", cinfo->invoices_next);
+	json_add_u32(req->js, "limit", INVOICES_PAGE_SIZE);
+	send_outreq(plugin, req);
+}
+
+/* We might clean this one in a later cycle: don't skip over it next time. */
+static void invoice_pending(struct clean_info *cinfo, u64 created_index)
+{
+	if (created_index < cinfo->invoices_pending)
+		cinfo->invoices_pending = created_index;
+}
+
 static struct command_result *listinvoices_done(struct command *cmd,
 						const char *buf,
 						const jsmntok_t *result,
@@ -186,12 +269,24 @@ static struct command_result *listinvoices_done(struct command *cmd,
 	const jsmntok_t *t, *inv = json_get_member(buf, result, "invoices");
 	size_t i;
 	u64 now = time_now().ts.tv_sec;
+	u64 first = 0, last = 0, num_old[NUM_SUBSYSTEM];
 
+	memset(num_old, 0, sizeof(num_old));
 	json_for_each_arr(i, t, inv) {
 		const jsmntok_t *status = json_get_member(buf, t, "status");
 		const jsmntok_t *time;
 		enum subsystem subsys;
-		u64 invtime;
+		u64 invtime, created_index;
+
+		if (!json_to_u64(buf, json_get_member(buf, t, "created_index"),
+				 &created_index)) {
+			plugin_err(plugin, "Bad created_index in '%.*s'",
+				   json_tok_full_len(t),
+				   json_tok_full(buf, t));
+		}
+		if (i == 0)
+			first = created_index;
+		last = created_index;
 
 		if (json_tok_streq(buf, status, "expired")) {
 			subsys = EXPIREDINVOICES;
@@ -200,6 +295,8 @@ static struct command_result *listinvoices_done(struct command *cmd,
 			subsys = PAIDINVOICES;
 			time = json_get_member(buf, t, "paid_at");
 		} else {
+			/* Unpaid: will be paid or expire eventually. */
+			invoice_pending(cinfo, created_index);
 			cinfo->num_uncleaned++;
 			continue;
 		}
@@ -216,18 +313,42 @@ static struct command_result *listinvoices_done(struct command *cmd,
 				   json_tok_full(buf, time));
 		}
 
-		if (invtime <= now - cinfo->subsystem_age[subsys]) {
-			struct out_req *req;
-			const jsmntok_t *label = json_get_member(buf, t, "label");
-
-			req = del_request_start("delinvoice", cinfo, subsys);
-			json_add_tok(req->js, "label", label, buf);
-			json_add_tok(req->js, "status", status, buf);
-			send_outreq(plugin, req);
-		} else
+		if (invtime <= now - cinfo->subsystem_age[subsys])
+			num_old[subsys]++;
+		else {
+			invoice_pending(cinfo, created_index);
 			cinfo->num_uncleaned++;
+		}
 	}
 
+	/* One delinvoicerange per status covers the whole page. */
+	for (enum subsystem subsys = 0; subsys < NUM_SUBSYSTEM; subsys++) {
+		struct out_req *req;
+
+		if (!num_old[subsys])
+			continue;
+		req = del_request_start("delinvoicerange", cinfo, subsys);
+		json_add_string(req->js, "status",
+				subsys == PAIDINVOICES ? "paid" : "expired");
+		json_add_u64(req->js, "maxtime",
+			     now - cinfo->subsystem_age[subsys]);
+		json_add_u64(req->js, "start", first);
+		json_add_u64(req->js, "end", last);
+		send_outreq(plugin, req);
+	}
+
+	if (inv->size != 0)
+		cinfo->invoices_next = last + 1;
+
+	/* Full page?  There may be more. */
+	if (inv->size == INVOICES_PAGE_SIZE) {
+		listinvoices_page(cinfo);
+		return command_still_pending(cinfo->cmd);
+	}
+
+	/* Timer remembers where it got to. */
+	if (!cinfo->cmd)
+		save_invoices_start(cinfo);
 	return clean_finished_one(cinfo);
 }
 
@@ -415,10 +536,17 @@ static struct command_result *do_clean(struct clean_info *cinfo)
 
 	if (cinfo->subsystem_age[EXPIREDINVOICES] != 0
 	    || cinfo->subsystem_age[PAIDINVOICES] != 0) {
-		req = jsonrpc_request_start(plugin, NULL, "listinvoices",
-					    listinvoices_done, listinvoices_failed,
-					    cinfo);
-		send_outreq(plugin, req);
+		cinfo->invoices_mask = invoices_mask(cinfo);
+		cinfo->invoices_pending = UINT64_MAX;
+		/* autoclean-once looks at everything.  The timer starts
+		 * where it left off, unless we now care about invoices we
+		 * skipped over last time. */
+		if (!cinfo->cmd
+		    && !(cinfo->invoices_mask & ~invoices_start_mask))
+			cinfo->invoices_next = invoices_start;
+		else
+			cinfo->invoices_next = 0;
+		listinvoices_page(cinfo);
 		cinfo->cleanup_reqs_remaining++;
 	}
 
@@ -583,6 +711,12 @@ static const char *init(struct plugin *p,
 				       datastore_path(tmpctx, i, "num"),
 				       JSON_SCAN(json_to_u64, &total_cleaned[i]));
 	}
+	/* Only trust the start if we have both. */
+	if (rpc_scan_datastore_str(tmpctx, plugin, "autoclean/invoices/start",
+				   JSON_SCAN(json_to_u64, &invoices_start))
+	    || rpc_scan_datastore_str(tmpctx, plugin, "autoclean/invoices/mask",
+				      JSON_SCAN(json_to_u64, &invoices_start_mask)))
+		invoices_start = invoices_start_mask = 0;
 
 	/* Optimization FTW! */
 	rpc_enable_batching(p);
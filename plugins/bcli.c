@@ -3,15 +3,21 @@
 #include <ccan/array_size/array_size.h>
 #include <ccan/cast/cast.h>
 #include <ccan/io/io.h>
+#include <ccan/json_escape/json_escape.h>
+#include <ccan/noerr/noerr.h>
 #include <ccan/pipecmd/pipecmd.h>
 #include <ccan/read_write_all/read_write_all.h>
 #include <ccan/tal/grab_file/grab_file.h>
+#include <ccan/tal/path/path.h>
 #include <ccan/tal/str/str.h>
+#include <common/base64.h>
 #include <common/json_param.h>
 #include <common/json_stream.h>
 #include <common/memleak.h>
 #include <errno.h>
+#include <netdb.h>
 #include <plugins/libplugin.h>
+#include <sys/socket.h>
 
 /* Bitcoind's web server has a default of 4 threads, with queue depth 16.
  * It will *fail* rather than queue beyond that, so we must not stress it!
@@ -19,6 +25,9 @@
  * This is how many request for each priority level we have.
  */
 #define BITCOIND_MAX_PARALLEL 4
+/* With the http client, we send up to this many requests as one JSON-RPC
+ * batch: bitcoind executes a batch within a single worker thread. */
+#define BITCOIND_HTTP_MAX_BATCH 16
 #define RPC_TRANSACTION_ALREADY_IN_CHAIN -27
 
 enum bitcoind_prio {
@@ -60,6 +69,20 @@ struct bitcoind {
 	/* Passthrough parameters for bitcoin-cli */
 	char *rpcuser, *rpcpass, *rpcconnect, *rpcport;
 
+	/* Talk JSON-RPC over HTTP directly, instead of running bitcoin-cli? */
+	bool use_http;
+
+	/* For the http client: where bitcoind is (and what we call it in the
+	 * Host: header), and our Basic auth token. */
+	struct addrinfo *rpcaddr;
+	const char *rpchost;
+	const char *rpcauth;
+	/* Non-NULL if rpcauth came from bitcoind's .cookie file. */
+	const char *cookiefile;
+
+	/* Connected http clients waiting for work. */
+	struct list_head http_idle;
+
 	/* Whether we fake fees (regtest) */
 	bool fake_fees;
 
@@ -86,6 +109,9 @@ struct bitcoin_cli {
 	struct command *cmd;
 	/* Used to stash content between multiple calls */
 	void *stash;
+	/* For the http client: the method and its (NULL-terminated) params */
+	const char *method;
+	const char **params;
 };
 
 /* Add the n'th arg to *args, incrementing n and keeping args of size n+1 */
@@ -197,7 +223,7 @@ static void retry_bcli(void *cb_arg)
 	tal_del_destructor(bcli, destroy_bcli);
 
 	list_add_tail(&bitcoind->pending[bcli->prio], &bcli->list);
-	tal_free(bcli->output);
+	bcli->output = tal_free(bcli->output);
 	next_bcli(bcli->prio);
 }
 
@@ -232,9 +258,9 @@ static void bcli_failure(struct bitcoin_cli *bcli,
 	plugin_timer(bcli->cmd->plugin, time_from_sec(1), retry_bcli, bcli);
 }
 
-static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
+/* Common completion path for both bitcoin-cli and the http client. */
+static void bcli_complete(struct bitcoin_cli *bcli, int exitstatus)
 {
-	int ret, status;
 	struct command_result *res;
 	enum bitcoind_prio prio = bcli->prio;
 	u64 msec = time_to_msec(time_between(time_now(), bcli->start));
@@ -245,7 +271,33 @@ static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
 		           "bitcoin-cli: finished %s (%"PRIu64" ms)",
 		           bcli_args(tmpctx, bcli), msec);
 
-	assert(bitcoind->num_requests[prio] > 0);
+	/* Implicit nonzero_exit_ok == false */
+	if (!bcli->exitstatus) {
+		if (exitstatus != 0) {
+			bcli_failure(bcli, exitstatus);
+			goto done;
+		}
+	} else
+		*bcli->exitstatus = exitstatus;
+
+	if (exitstatus == 0)
+		bitcoind->error_count = 0;
+
+	res = bcli->process(bcli);
+	if (!res)
+		bcli_failure(bcli, exitstatus);
+	else
+		tal_free(bcli);
+
+done:
+	next_bcli(prio);
+}
+
+static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
+{
+	int ret, status;
+
+	assert(bitcoind->num_requests[bcli->prio] > 0);
 
 	/* FIXME: If we waited for SIGCHILD, this could never hang! */
 	while ((ret = waitpid(bcli->pid, &status, 0)) < 0 && errno == EINTR);
@@ -258,29 +310,424 @@ static void bcli_finished(struct io_conn *conn UNUSED, struct bitcoin_cli *bcli)
 		           bcli_args(tmpctx, bcli),
 		           WTERMSIG(status));
 
-	/* Implicit nonzero_exit_ok == false */
-	if (!bcli->exitstatus) {
-		if (WEXITSTATUS(status) != 0) {
-			bcli_failure(bcli, WEXITSTATUS(status));
-			bitcoind->num_requests[prio]--;
-			goto done;
+	bitcoind->num_requests[bcli->prio]--;
+	bcli_complete(bcli, WEXITSTATUS(status));
+}
+
+/* A keep-alive HTTP/1.1 connection to bitcoind's RPC port.  It carries
+ * one JSON-RPC batch at a time, and counts as one request against
+ * BITCOIND_MAX_PARALLEL for its priority while it does. */
+struct bcli_http {
+	/* In bitcoind->http_idle, when idle. */
+	struct list_node list;
+	bool idle;
+
+	struct io_conn *conn;
+	enum bitcoind_prio prio;
+
+	/* The requests in the batch currently in flight, or NULL. */
+	struct bitcoin_cli **batch;
+	/* Has a batch already completed on this connection? */
+	bool reused;
+
+	char *request;
+	char *response;
+	size_t response_bytes, new_response;
+};
+
+/* bitcoin-cli hands these parameters to bitcoind as JSON values, not
+ * strings (see vRPCConvertParams in bitcoin's src/rpc/client.cpp). */
+static const struct rpc_convert_param {
+	const char *method;
+	size_t idx;
+} rpc_convert_params[] = {
+	{ "getblockhash", 0 },
+	{ "getblock", 1 },
+	{ "estimatesmartfee", 0 },
+	{ "gettxout", 1 },
+	{ "gettxout", 2 },
+	{ "sendrawtransaction", 1 },
+};
+
+static bool rpc_param_is_json(const char *method, size_t idx)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(rpc_convert_params); i++) {
+		if (rpc_convert_params[i].idx == idx
+		    && streq(rpc_convert_params[i].method, method))
+			return true;
+	}
+	return false;
+}
+
+static void add_rpc_request(char **body, size_t id,
+			    const char *method, const char **params)
+{
+	tal_append_fmt(body,
+		       "{\"jsonrpc\":\"1.0\",\"id\":%zu,"
+		       "\"method\":\"%s\",\"params\":[",
+		       id, method);
+	for (size_t i = 0; params[i]; i++) {
+		if (i)
+			tal_append_fmt(body, ",");
+		if (rpc_param_is_json(method, i))
+			tal_append_fmt(body, "%s", params[i]);
+		else
+			tal_append_fmt(body, "\"%s\"",
+				       json_escape(tmpctx, params[i])->s);
+	}
+	tal_append_fmt(body, "]}");
+}
+
+static char *http_post(const tal_t *ctx, const char *body)
+{
+	return tal_fmt(ctx,
+		       "POST / HTTP/1.1\r\n"
+		       "Host: %s\r\n"
+		       "Connection: keep-alive\r\n"
+		       "Authorization: Basic %s\r\n"
+		       "Content-Type: application/json\r\n"
+		       "Content-Length: %zu\r\n"
+		       "\r\n"
+		       "%s",
+		       bitcoind->rpchost,
+		       bitcoind->rpcauth, strlen(body), body);
+}
+
+/* We always send a batch (even of one): bitcoind then replies 200 with
+ * an array of individual results, rather than varying the HTTP status. */
+static char *http_batch_request(const tal_t *ctx, struct bitcoin_cli **batch)
+{
+	char *body = tal_strdup(tmpctx, "[");
+
+	for (size_t i = 0; i < tal_count(batch); i++) {
+		if (i)
+			tal_append_fmt(&body, ",");
+		add_rpc_request(&body, i, batch[i]->method, batch[i]->params);
+	}
+	tal_append_fmt(&body, "]");
+	return http_post(ctx, body);
+}
+
+static const char *find_header(const char *hdrs, size_t hdrlen,
+			       const char *name)
+{
+	const char *p = hdrs, *end = hdrs + hdrlen;
+	size_t namelen = strlen(name);
+
+	while (p < end) {
+		const char *eol = memmem(p, end - p, "\r\n", 2);
+		if (!eol)
+			eol = end;
+		if (eol - p > namelen && p[namelen] == ':'
+		    && strncasecmp(p, name, namelen) == 0) {
+			p += namelen + 1;
+			while (p < eol && cisspace(*p))
+				p++;
+			return tal_strndup(tmpctx, p, eol - p);
 		}
-	} else
-		*bcli->exitstatus = WEXITSTATUS(status);
+		p = eol + 2;
+	}
+	return NULL;
+}
 
-	if (WEXITSTATUS(status) == 0)
-		bitcoind->error_count = 0;
+/* Returns false if we need more data.  Sets *status to 0 if the response
+ * is malformed. */
+static bool parse_http_response(const char *buf, size_t len,
+				int *status, size_t *body_off,
+				size_t *body_len, bool *keepalive)
+{
+	const char *hdrend, *clen, *connection;
+	char *endp;
+
+	hdrend = memmem(buf, len, "\r\n\r\n", 4);
+	if (!hdrend)
+		return false;
+
+	*status = 0;
+	if (len < strlen("HTTP/1.1 200") || !strstarts(buf, "HTTP/1."))
+		return true;
+	*status = strtol(buf + strlen("HTTP/1.1 "), NULL, 10);
+
+	/* bitcoind (libevent) always sets Content-Length. */
+	clen = find_header(buf, hdrend - buf, "Content-Length");
+	if (!clen) {
+		*status = 0;
+		return true;
+	}
+	*body_len = strtoul(clen, &endp, 10);
+	*body_off = hdrend + 4 - buf;
+	if (*body_off + *body_len > len)
+		return false;
+
+	connection = find_header(buf, hdrend - buf, "Connection");
+	*keepalive = !connection || strcasecmp(connection, "close") != 0;
+	return true;
+}
 
-	bitcoind->num_requests[bcli->prio]--;
+/* Turn one JSON-RPC reply into what bitcoin-cli would have printed, and
+ * the exit status it would have returned, so process callbacks don't care
+ * which client we used. */
+static int rpc_reply_to_output(const tal_t *ctx,
+			       const char *buf,
+			       const jsmntok_t *reply,
+			       char **output)
+{
+	const jsmntok_t *result, *error, *code, *msg;
+	s64 errcode;
+
+	error = json_get_member(buf, reply, "error");
+	if (error && !json_tok_is_null(buf, error)) {
+		code = json_get_member(buf, error, "code");
+		msg = json_get_member(buf, error, "message");
+		if (!code || !json_to_s64(buf, code, &errcode))
+			errcode = -1;
+		*output = tal_fmt(ctx, "error code: %"PRId64"\n"
+				  "error message:\n%.*s\n",
+				  errcode,
+				  msg ? msg->end - msg->start : 0,
+				  msg ? buf + msg->start : "");
+		/* bitcoin-cli exits with abs(code) */
+		return errcode < 0 ? -errcode : errcode;
+	}
 
-	res = bcli->process(bcli);
-	if (!res)
-		bcli_failure(bcli, WEXITSTATUS(status));
+	result = json_get_member(buf, reply, "result");
+	if (!result || json_tok_is_null(buf, result))
+		*output = tal_strdup(ctx, "");
+	else if (result->type == JSMN_STRING)
+		*output = tal_fmt(ctx, "%.*s\n",
+				  result->end - result->start,
+				  buf + result->start);
 	else
-		tal_free(bcli);
+		*output = tal_fmt(ctx, "%.*s\n",
+				  json_tok_full_len(result),
+				  json_tok_full(buf, result));
+	return 0;
+}
 
-done:
-	next_bcli(prio);
+static void bcli_http_set_output(struct bitcoin_cli *bcli, char *output)
+{
+	tal_free(bcli->output);
+	bcli->output = tal_steal(bcli, output);
+	bcli->output_bytes = strlen(output);
+}
+
+static void reload_cookie(void);
+static struct io_plan *http_send(struct io_conn *conn, struct bcli_http *hc);
+
+/* We've got a whole response: feed results back to their commands. */
+static struct io_plan *http_response_done(struct io_conn *conn,
+					  struct bcli_http *hc,
+					  int status,
+					  size_t body_off, size_t body_len,
+					  bool keepalive)
+{
+	struct bitcoin_cli **batch = tal_steal(tmpctx, hc->batch);
+	const char *body = hc->response + body_off;
+	const jsmntok_t *toks = NULL, *t;
+	int *exitstatus = tal_arrz(tmpctx, int, tal_count(batch));
+	size_t i;
+
+	hc->batch = NULL;
+	hc->reused = true;
+	tal_steal(tmpctx, hc->response);
+	hc->response = NULL;
+
+	if (status == 401) {
+		/* bitcoind may have restarted, with a new cookie */
+		if (bitcoind->cookiefile)
+			reload_cookie();
+		plugin_log(batch[0]->cmd->plugin, LOG_UNUSUAL,
+			   "bitcoind rejected our RPC credentials");
+	} else if (status == 200)
+		toks = json_parse_simple(tmpctx, body, body_len);
+
+	/* Anything we don't get a reply for fails like bitcoin-cli would:
+	 * exit status 1, and whatever the server said. */
+	for (i = 0; i < tal_count(batch); i++) {
+		exitstatus[i] = -1;
+		bcli_http_set_output(batch[i],
+				     tal_fmt(NULL, "HTTP %i: %.*s", status,
+					     (int)body_len, body));
+	}
+
+	if (toks && toks->type == JSMN_ARRAY) {
+		json_for_each_arr(i, t, toks) {
+			const jsmntok_t *idtok = json_get_member(body, t, "id");
+			u32 id;
+			char *output;
+
+			if (!idtok || !json_to_u32(body, idtok, &id)
+			    || id >= tal_count(batch) || exitstatus[id] != -1)
+				continue;
+			exitstatus[id] = rpc_reply_to_output(NULL, body, t,
+							     &output);
+			bcli_http_set_output(batch[id], output);
+		}
+	}
+
+	/* Make ourselves available before calling back: the common
+	 * getblockhash -> getblock chain will want us again. */
+	assert(bitcoind->num_requests[hc->prio] > 0);
+	bitcoind->num_requests[hc->prio]--;
+	/* Most recently used first: we keep reusing the same few
+	 * connections, and bitcoind times out the ones we don't need. */
+	if (keepalive) {
+		list_add(&bitcoind->http_idle, &hc->list);
+		hc->idle = true;
+	}
+
+	for (i = 0; i < tal_count(batch); i++)
+		bcli_complete(batch[i], exitstatus[i] == -1 ? 1 : exitstatus[i]);
+
+	if (!keepalive)
+		return io_close(conn);
+
+	/* One of those callbacks may have given us more work already. */
+	if (hc->batch)
+		return http_send(conn, hc);
+	return io_wait(conn, hc, http_send, hc);
+}
+
+static struct io_plan *http_read_more(struct io_conn *conn,
+				      struct bcli_http *hc)
+{
+	int status;
+	size_t body_off, body_len;
+	bool keepalive;
+
+	hc->response_bytes += hc->new_response;
+	if (parse_http_response(hc->response, hc->response_bytes,
+				&status, &body_off, &body_len, &keepalive)) {
+		if (status == 0) {
+			plugin_log(hc->batch[0]->cmd->plugin, LOG_BROKEN,
+				   "Malformed HTTP response from bitcoind: %.*s",
+				   (int)hc->response_bytes, hc->response);
+			/* So http_conn_finished says why. */
+			errno = EPROTO;
+			return io_close(conn);
+		}
+		return http_response_done(conn, hc, status,
+					  body_off, body_len, keepalive);
+	}
+
+	if (hc->response_bytes == tal_count(hc->response))
+		tal_resize(&hc->response, hc->response_bytes * 2);
+	return io_read_partial(conn, hc->response + hc->response_bytes,
+			       tal_count(hc->response) - hc->response_bytes,
+			       &hc->new_response, http_read_more, hc);
+}
+
+static struct io_plan *http_read_response(struct io_conn *conn,
+					  struct bcli_http *hc)
+{
+	hc->response_bytes = hc->new_response = 0;
+	hc->response = tal_arr(hc, char, 4096);
+	return http_read_more(conn, hc);
+}
+
+static struct io_plan *http_send(struct io_conn *conn, struct bcli_http *hc)
+{
+	assert(hc->batch);
+	return io_write(conn, hc->request, strlen(hc->request),
+			http_read_response, hc);
+}
+
+static void http_conn_finished(struct io_conn *conn, struct bcli_http *hc)
+{
+	/* Why the connection failed: anything below may change errno. */
+	int err = errno;
+
+	if (hc->idle)
+		list_del_from(&bitcoind->http_idle, &hc->list);
+
+	if (hc->batch) {
+		enum bitcoind_prio prio = hc->prio;
+
+		bitcoind->num_requests[prio]--;
+		/* Backwards, so requeued requests keep their order. */
+		for (size_t i = tal_count(hc->batch); i-- > 0;) {
+			struct bitcoin_cli *bcli = hc->batch[i];
+
+			/* bitcoind closes idle connections after
+			 * -rpcservertimeout: that's not an error, just
+			 * try again on a fresh connection. */
+			if (hc->reused) {
+				list_del_from(&bitcoind->current, &bcli->list);
+				tal_del_destructor(bcli, destroy_bcli);
+				list_add(&bitcoind->pending[prio], &bcli->list);
+				continue;
+			}
+			bcli_http_set_output(bcli,
+					     tal_fmt(NULL,
+						     "Connection to bitcoind"
+						     " failed: %s",
+						     strerror(err)));
+			bcli_failure(bcli, 1);
+		}
+	}
+	tal_free(hc);
+
+	for (size_t i = 0; i < BITCOIND_NUM_PRIO; i++)
+		next_bcli(i);
+}
+
+static struct io_plan *http_conn_init(struct io_conn *conn,
+				      struct bcli_http *hc)
+{
+	hc->conn = conn;
+	io_set_finish(conn, http_conn_finished, hc);
+	return io_connect(conn, bitcoind->rpcaddr, http_send, hc);
+}
+
+static void next_bcli_http(enum bitcoind_prio prio)
+{
+	struct bcli_http *hc;
+	struct bitcoin_cli *bcli;
+	int fd;
+
+	hc = list_pop(&bitcoind->http_idle, struct bcli_http, list);
+	if (hc)
+		hc->idle = false;
+	else {
+		hc = tal(bitcoind, struct bcli_http);
+		hc->idle = false;
+		hc->reused = false;
+		hc->conn = NULL;
+		hc->request = NULL;
+		hc->response = NULL;
+	}
+
+	hc->prio = prio;
+	hc->batch = tal_arr(hc, struct bitcoin_cli *, 0);
+	while (tal_count(hc->batch) < BITCOIND_HTTP_MAX_BATCH
+	       && (bcli = list_pop(&bitcoind->pending[prio],
+				   struct bitcoin_cli, list)) != NULL) {
+		bcli->start = time_now();
+		tal_arr_expand(&hc->batch, bcli);
+		list_add_tail(&bitcoind->current, &bcli->list);
+		tal_add_destructor(bcli, destroy_bcli);
+	}
+	tal_free(hc->request);
+	hc->request = http_batch_request(hc, hc->batch);
+
+	bitcoind->num_requests[prio]++;
+
+	if (hc->conn) {
+		/* Harmless if it's not waiting yet: http_response_done
+		 * checks hc->batch before it waits. */
+		io_wake(hc);
+		return;
+	}
+
+	fd = socket(bitcoind->rpcaddr->ai_family, SOCK_STREAM, 0);
+	if (fd < 0)
+		plugin_err(hc->batch[0]->cmd->plugin,
+			   "Creating socket for bitcoind: %s",
+			   strerror(errno));
+
+	/* We don't keep a pointer to this, but it's not a leak.  If the
+	 * connect fails immediately, this frees hc. */
+	notleak(io_new_conn(bitcoind, fd, http_conn_init, hc));
 }
 
 static void next_bcli(enum bitcoind_prio prio)
@@ -292,6 +739,12 @@ static void next_bcli(enum bitcoind_prio prio)
 	if (bitcoind->num_requests[prio] >= BITCOIND_MAX_PARALLEL)
 		return;
 
+	if (bitcoind->use_http) {
+		if (!list_empty(&bitcoind->pending[prio]))
+			next_bcli_http(prio);
+		return;
+	}
+
 	bcli = list_pop(&bitcoind->pending[prio], struct bitcoin_cli, list);
 	if (!bcli)
 		return;
@@ -331,19 +784,30 @@ start_bitcoin_cliv(const tal_t *ctx,
 		   va_list ap)
 {
 	struct bitcoin_cli *bcli = tal(bitcoind, struct bitcoin_cli);
+	const char *arg;
+	va_list ap2;
 
 	bcli->process = process;
 	bcli->cmd = cmd;
 	bcli->prio = prio;
+	bcli->output = NULL;
 
 	if (nonzero_exit_ok)
 		bcli->exitstatus = tal(bcli, int);
 	else
 		bcli->exitstatus = NULL;
 
+	va_copy(ap2, ap);
 	bcli->args = gather_argsv(bcli, method, ap);
 	bcli->stash = stash;
 
+	bcli->method = method;
+	bcli->params = tal_arr(bcli, const char *, 0);
+	while ((arg = va_arg(ap2, const char *)) != NULL)
+		tal_arr_expand(&bcli->params, arg);
+	tal_arr_expand(&bcli->params, NULL);
+	va_end(ap2);
+
 	list_add_tail(&bitcoind->pending[bcli->prio], &bcli->list);
 	next_bcli(bcli->prio);
 }
@@ -1012,6 +1476,180 @@ static void wait_and_check_bitcoind(struct plugin *p)
 	tal_free(cmd);
 }
 
+/* bitcoind puts non-mainnet data (including .cookie) in a subdirectory. */
+static const char *cookie_subdir(void)
+{
+	if (streq(chainparams->network_name, "bitcoin"))
+		return "";
+	if (streq(chainparams->network_name, "testnet"))
+		return "testnet3/";
+	if (streq(chainparams->network_name, "regtest")
+	    || streq(chainparams->network_name, "signet"))
+		return tal_fmt(tmpctx, "%s/", chainparams->network_name);
+	return tal_fmt(tmpctx, "%s/", chainparams->bip70_name);
+}
+
+static void reload_cookie(void)
+{
+	char *cookie = grab_file(tmpctx, bitcoind->cookiefile);
+
+	/* We'll complain when bitcoind rejects us. */
+	if (!cookie)
+		return;
+	strip_trailing_whitespace(cookie, tal_count(cookie) - 1);
+	tal_free(bitcoind->rpcauth);
+	bitcoind->rpcauth = b64_encode(bitcoind, cookie, strlen(cookie));
+}
+
+static void setup_http_client(struct plugin *p)
+{
+	struct addrinfo hints;
+	const char *host, *port;
+	int err;
+
+	host = bitcoind->rpcconnect ? bitcoind->rpcconnect : "127.0.0.1";
+	port = bitcoind->rpcport ? bitcoind->rpcport
+		: tal_fmt(tmpctx, "%i", chainparams->rpc_port);
+	/* HTTP/1.1 wants the port too, and IPv6 literals in brackets. */
+	if (strchr(host, ':'))
+		bitcoind->rpchost = tal_fmt(bitcoind, "[%s]:%s", host, port);
+	else
+		bitcoind->rpchost = tal_fmt(bitcoind, "%s:%s", host, port);
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	err = getaddrinfo(host, port, &hints, &bitcoind->rpcaddr);
+	if (err)
+		plugin_err(p, "Could not resolve bitcoin-rpcconnect %s:%s: %s",
+			   host, port, gai_strerror(err));
+
+	/* Like bitcoin-cli, we use the .cookie file unless told otherwise. */
+	if (bitcoind->rpcpass) {
+		const char *userpass
+			= tal_fmt(tmpctx, "%s:%s",
+				  bitcoind->rpcuser ? bitcoind->rpcuser : "",
+				  bitcoind->rpcpass);
+		bitcoind->rpcauth = b64_encode(bitcoind, userpass,
+					       strlen(userpass));
+	} else {
+		const char *datadir = bitcoind->datadir;
+		if (!datadir)
+			datadir = path_join(tmpctx, getenv("HOME"), ".bitcoin");
+		bitcoind->cookiefile = tal_fmt(bitcoind, "%s/%s.cookie",
+					       datadir, cookie_subdir());
+		bitcoind->rpcauth = tal_strdup(bitcoind, "");
+		reload_cookie();
+	}
+}
+
+/* Synchronous single call, for startup: returns what bitcoin-cli would have
+ * printed and sets *exitstatus to what it would have exited with, or
+ * returns NULL if we cannot talk to bitcoind at all. */
+static char *http_call_sync(const tal_t *ctx, const char *method,
+			    int *exitstatus)
+{
+	const char *params[] = { NULL };
+	char *body = tal_strdup(tmpctx, "[");
+	char *request, *buf;
+	size_t len = 0, body_off, body_len;
+	int fd, status;
+	bool keepalive;
+	const jsmntok_t *toks;
+	char *output;
+
+	add_rpc_request(&body, 0, method, params);
+	tal_append_fmt(&body, "]");
+	request = http_post(tmpctx, body);
+
+	fd = socket(bitcoind->rpcaddr->ai_family, SOCK_STREAM, 0);
+	if (fd < 0)
+		return NULL;
+	if (connect(fd, bitcoind->rpcaddr->ai_addr,
+		    bitcoind->rpcaddr->ai_addrlen) != 0
+	    || !write_all(fd, request, strlen(request))) {
+		close_noerr(fd);
+		return NULL;
+	}
+
+	buf = tal_arr(tmpctx, char, 4096);
+	for (;;) {
+		ssize_t r;
+
+		if (len == tal_count(buf))
+			tal_resize(&buf, len * 2);
+		r = read(fd, buf + len, tal_count(buf) - len);
+		if (r <= 0) {
+			/* Our caller reports errno. */
+			if (r == 0)
+				errno = ECONNRESET;
+			close_noerr(fd);
+			return NULL;
+		}
+		len += r;
+		if (parse_http_response(buf, len, &status,
+					&body_off, &body_len, &keepalive))
+			break;
+	}
+	close(fd);
+
+	if (status == 401 && bitcoind->cookiefile) {
+		*exitstatus = 1;
+		return tal_fmt(ctx, "Authorization failed using %s",
+			       bitcoind->cookiefile);
+	}
+
+	toks = json_parse_simple(tmpctx, buf + body_off, body_len);
+	if (status != 200 || !toks || toks->type != JSMN_ARRAY
+	    || toks->size != 1) {
+		*exitstatus = 1;
+		return tal_fmt(ctx, "HTTP %i: %.*s",
+			       status, (int)body_len, buf + body_off);
+	}
+	*exitstatus = rpc_reply_to_output(ctx, buf + body_off,
+					  json_get_arr(toks, 0), &output);
+	return output;
+}
+
+static void wait_and_check_bitcoind_http(struct plugin *p)
+{
+	bool printed = false;
+	char *output;
+	int exitstatus;
+
+	setup_http_client(p);
+
+	for (;;) {
+		output = http_call_sync(tmpctx, "getnetworkinfo", &exitstatus);
+		if (!output)
+			bitcoind_failure(p, tal_fmt(tmpctx,
+						    "Could not connect to bitcoind"
+						    " RPC port: %s. Is bitcoind"
+						    " running?",
+						    strerror(errno)));
+		if (exitstatus == 0)
+			break;
+
+		/* RPC_IN_WARMUP */
+		if (exitstatus != 28)
+			bitcoind_failure(p, tal_fmt(tmpctx,
+						    "getnetworkinfo failed: %s",
+						    output));
+
+		if (!printed) {
+			plugin_log(p, LOG_UNUSUAL,
+				   "Waiting for bitcoind to warm up...");
+			printed = true;
+		}
+		sleep(1);
+		/* Cookie may not have been written yet */
+		if (bitcoind->cookiefile)
+			reload_cookie();
+	}
+
+	parse_getnetworkinfo_result(p, output);
+}
+
 #if DEVELOPER
 static void memleak_mark_bitcoind(struct plugin *p, struct htable *memtable)
 {
@@ -1022,7 +1660,10 @@ static void memleak_mark_bitcoind(struct plugin *p, struct htable *memtable)
 static const char *init(struct plugin *p, const char *buffer UNUSED,
 			const jsmntok_t *config UNUSED)
 {
-	wait_and_check_bitcoind(p);
+	if (bitcoind->use_http)
+		wait_and_check_bitcoind_http(p);
+	else
+		wait_and_check_bitcoind(p);
 
 	/* Usually we fake up fees in regtest */
 	if (streq(chainparams->network_name, "regtest"))
@@ -1079,6 +1720,19 @@ static const struct plugin_command commands[] = {
 	},
 };
 
+static char *rpcclient_option(struct plugin *plugin, const char *arg,
+			      bool *use_http)
+{
+	if (streq(arg, "http"))
+		*use_http = true;
+	else if (streq(arg, "bitcoin-cli"))
+		*use_http = false;
+	else
+		return tal_fmt(tmpctx, "Unknown bitcoin-rpcclient '%s':"
+			       " expected 'bitcoin-cli' or 'http'", arg);
+	return NULL;
+}
+
 static struct bitcoind *new_bitcoind(const tal_t *ctx)
 {
 	bitcoind = tal(ctx, struct bitcoind);
@@ -1096,6 +1750,12 @@ static struct bitcoind *new_bitcoind(const tal_t *ctx)
 	bitcoind->rpcpass = NULL;
 	bitcoind->rpcconnect = NULL;
 	bitcoind->rpcport = NULL;
+	bitcoind->use_http = false;
+	bitcoind->rpcaddr = NULL;
+	bitcoind->rpchost = NULL;
+	bitcoind->rpcauth = NULL;
+	bitcoind->cookiefile = NULL;
+	list_head_init(&bitcoind->http_idle);
 #if DEVELOPER
 	bitcoind->no_fake_fees = false;
 #endif
@@ -1137,6 +1797,11 @@ int main(int argc, char *argv[])
 				  "int",
 				  "bitcoind RPC host's port",
 				  charp_option, &bitcoind->rpcport),
+		    plugin_option("bitcoin-rpcclient",
+				  "string",
+				  "How to talk to bitcoind: 'bitcoin-cli' (default)"
+				  " or 'http' (built-in JSON-RPC client)",
+				  rpcclient_option, &bitcoind->use_http),
 		    plugin_option("bitcoin-retry-timeout",
 				  "string",
 				  "how long to keep retrying to contact bitcoind"
@@ -126,6 +126,9 @@ static bool db_migrate(struct plugin *p, struct db *db, bool *created)
 
 	while (current < available) {
 		current++;
+		/* postgres won't re-plan a statement we cached before the
+		 * last step changed the schema under it. */
+		db_stmt_cache_flush(db);
 		if (db_migrations[current].sql) {
 			stmt = db_prepare_v2(db, db_migrations[current].sql);
 			db_exec_prepared_v2(take(stmt));
@@ -200,7 +203,7 @@ struct db *db_setup(const tal_t *ctx, struct plugin *p,
 	bool migrated;
 	struct db *db;
 
-	db = db_open(ctx, db_dsn, db_error, p);
+	db = db_open(ctx, db_dsn, false, db_error, p);
 	db->report_changes_fn = NULL;
 
 	db_begin_transaction(db);
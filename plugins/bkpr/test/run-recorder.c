@@ -96,6 +96,25 @@ const char *json_get_id(const tal_t *ctx UNNEEDED,
 const jsmntok_t *json_get_member(const char *buffer UNNEEDED, const jsmntok_t tok[] UNNEEDED,
 				 const char *label UNNEEDED)
 { fprintf(stderr, "json_get_member called!\n"); abort(); }
+/* Generated stub for json_input_consumed */
+size_t json_input_consumed(const struct json_input *in UNNEEDED)
+{ fprintf(stderr, "json_input_consumed called!\n"); abort(); }
+/* Generated stub for json_input_init */
+void json_input_init(struct json_input *in UNNEEDED)
+{ fprintf(stderr, "json_input_init called!\n"); abort(); }
+/* Generated stub for json_input_make_room */
+void json_input_make_room(struct json_input *in UNNEEDED, char **buffer UNNEEDED, size_t *used UNNEEDED)
+{ fprintf(stderr, "json_input_make_room called!\n"); abort(); }
+/* Generated stub for json_input_parse */
+bool json_input_parse(struct json_input *in UNNEEDED,
+		      jsmn_parser *parser UNNEEDED,
+		      jsmntok_t **toks UNNEEDED,
+		      const char *input UNNEEDED, size_t len UNNEEDED,
+		      bool *complete UNNEEDED)
+{ fprintf(stderr, "json_input_parse called!\n"); abort(); }
+/* Generated stub for json_input_set_framed */
+void json_input_set_framed(struct json_input *in UNNEEDED)
+{ fprintf(stderr, "json_input_set_framed called!\n"); abort(); }
 /* Generated stub for json_next */
 const jsmntok_t *json_next(const jsmntok_t *tok UNNEEDED)
 { fprintf(stderr, "json_next called!\n"); abort(); }
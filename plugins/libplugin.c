@@ -37,6 +37,8 @@ struct rpc_conn {
 struct jstream {
 	struct list_node list;
 	struct json_stream *js;
+	/* Send it length-prefixed? */
+	bool framed;
 };
 
 struct plugin {
@@ -50,6 +52,7 @@ struct plugin {
 	/* To read from lightningd */
 	char *buffer;
 	size_t used, len_read;
+	struct json_input input;
 	jsmn_parser parser;
 	jsmntok_t *toks;
 
@@ -87,6 +90,8 @@ struct plugin {
 	bool manifested;
 	/* Has init been received ? */
 	bool initialized;
+	/* Are messages (both ways) after getmanifest length-prefixed? */
+	bool length_prefixed;
 	/* Are we exiting? */
 	bool exiting;
 
@@ -142,6 +147,7 @@ static void ld_send(struct plugin *plugin, struct json_stream *stream)
 {
 	struct jstream *jstr = tal(plugin, struct jstream);
 	jstr->js = tal_steal(jstr, stream);
+	jstr->framed = plugin->length_prefixed;
 	list_add_tail(&plugin->js_list, &jstr->list);
 	io_wake(plugin);
 }
@@ -310,7 +316,8 @@ static struct command_result *command_complete(struct command *cmd,
 	/* Global object */
 	json_object_end(result);
 	json_stream_close(result, cmd);
-	ld_send(cmd->plugin, result);
+	if (!cmd->streaming)
+		ld_send(cmd->plugin, result);
 	tal_free(cmd);
 
 	return &complete;
@@ -333,6 +340,14 @@ struct command_result *command_finished(struct command *cmd,
 	return command_complete(cmd, response);
 }
 
+void command_stream_start(struct command *cmd, struct json_stream *response)
+{
+	assert(!cmd->streaming);
+	assert(response->writer == cmd);
+	cmd->streaming = true;
+	ld_send(cmd->plugin, response);
+}
+
 struct command_result *WARN_UNUSED_RESULT
 command_still_pending(struct command *cmd)
 {
@@ -899,8 +914,9 @@ handle_getmanifest(struct command *getmanifest_cmd,
 {
 	struct json_stream *params = jsonrpc_stream_success(getmanifest_cmd);
 	struct plugin *p = getmanifest_cmd->plugin;
-	const jsmntok_t *dep;
-	bool has_shutdown_notif;
+	const jsmntok_t *dep, *lp;
+	bool has_shutdown_notif, length_prefixed;
+	struct command_result *ret;
 
 	/* This was added post 0.9.0 */
 	dep = json_get_member(buf, getmanifest_params, "allow-deprecated-apis");
@@ -913,6 +929,16 @@ handle_getmanifest(struct command *getmanifest_cmd,
 				   json_tok_full(buf, dep));
 	}
 
+	/* Can lightningd frame messages, instead of us scanning for the
+	 * end of each one? */
+	lp = json_get_member(buf, getmanifest_params, "lengthprefixed");
+	if (!lp)
+		length_prefixed = false;
+	else if (!json_to_bool(buf, lp, &length_prefixed))
+		plugin_err(p, "Invalid lengthprefixed '%.*s'",
+			   json_tok_full_len(lp),
+			   json_tok_full(buf, lp));
+
 	json_array_start(params, "options");
 	for (size_t i = 0; i < tal_count(p->opts); i++) {
 		json_object_start(params, NULL);
@@ -993,6 +1019,8 @@ handle_getmanifest(struct command *getmanifest_cmd,
 
 	json_add_bool(params, "dynamic", p->restartability == PLUGIN_RESTARTABLE);
 	json_add_bool(params, "nonnumericids", true);
+	if (length_prefixed)
+		json_add_bool(params, "lengthprefixed", true);
 
 	json_array_start(params, "notifications");
 	for (size_t i = 0; p->notif_topics && i < p->num_notif_topics; i++) {
@@ -1002,7 +1030,15 @@ handle_getmanifest(struct command *getmanifest_cmd,
 	}
 	json_array_end(params);
 
-	return command_finished(getmanifest_cmd, params);
+	ret = command_finished(getmanifest_cmd, params);
+
+	/* The manifest goes out as-is, but everything after it (both ways)
+	 * is length-prefixed. */
+	if (length_prefixed) {
+		p->length_prefixed = true;
+		json_input_set_framed(&p->input);
+	}
+	return ret;
 }
 
 static void rpc_conn_finished(struct io_conn *conn,
@@ -1324,6 +1360,7 @@ static void setup_command_usage(struct plugin *p)
 	/* This is how common/param can tell it's just a usage request */
 	usage_cmd->usage_only = true;
 	usage_cmd->plugin = p;
+	usage_cmd->streaming = false;
 	for (size_t i = 0; i < p->num_commands; i++) {
 		struct command_result *res;
 
@@ -1575,6 +1612,7 @@ static void ld_command_handle(struct plugin *plugin,
 	cmd->plugin = plugin;
 	cmd->usage_only = false;
 	cmd->filter = NULL;
+	cmd->streaming = false;
 	cmd->methodname = json_strdup(cmd, plugin->buffer, methtok);
 	cmd->id = json_get_id(cmd, plugin->buffer, toks);
 
@@ -1698,11 +1736,12 @@ static bool ld_read_json_one(struct plugin *plugin)
 {
 	bool complete;
 
-	if (!json_parse_input(&plugin->parser, &plugin->toks,
+	if (!json_input_parse(&plugin->input, &plugin->parser, &plugin->toks,
 			      plugin->buffer, plugin->used,
 			      &complete)) {
+		size_t off = json_input_consumed(&plugin->input);
 		plugin_err(plugin, "Failed to parse JSON response '%.*s'",
-			   (int)plugin->used, plugin->buffer);
+			   (int)(plugin->used - off), plugin->buffer + off);
 		return false;
 	}
 
@@ -1711,25 +1750,10 @@ static bool ld_read_json_one(struct plugin *plugin)
 		return false;
 	}
 
-	/* Empty buffer? (eg. just whitespace). */
-	if (tal_count(plugin->toks) == 1) {
-		toks_reset(plugin->toks);
-		jsmn_init(&plugin->parser);
-		plugin->used = 0;
-		return false;
-	}
-
 	/* FIXME: Spark doesn't create proper jsonrpc 2.0!  So we don't
 	 * check for "jsonrpc" here. */
 	ld_command_handle(plugin, plugin->toks);
 
-	/* Move this object out of the buffer */
-	memmove(plugin->buffer, plugin->buffer + plugin->toks[0].end,
-		tal_count(plugin->buffer) - plugin->toks[0].end);
-	plugin->used -= plugin->toks[0].end;
-	toks_reset(plugin->toks);
-	jsmn_init(&plugin->parser);
-
 	return true;
 }
 
@@ -1737,14 +1761,13 @@ static struct io_plan *ld_read_json(struct io_conn *conn,
 				    struct plugin *plugin)
 {
 	plugin->used += plugin->len_read;
-	if (plugin->used && plugin->used == tal_count(plugin->buffer))
-		tal_resize(&plugin->buffer, plugin->used * 2);
 
 	/* Read and process all messages from the connection */
 	while (ld_read_json_one(plugin))
 		;
 
 	/* Now read more from the connection */
+	json_input_make_room(&plugin->input, &plugin->buffer, &plugin->used);
 	return io_read_partial(plugin->stdin_conn,
 			       plugin->buffer + plugin->used,
 			       tal_count(plugin->buffer) - plugin->used,
@@ -1770,6 +1793,9 @@ static struct io_plan *ld_write_json(struct io_conn *conn,
 				     struct plugin *plugin)
 {
 	struct jstream *jstr = list_top(&plugin->js_list, struct jstream, list);
+	if (jstr && jstr->framed)
+		return json_stream_output_framed(jstr->js, plugin->stdout_conn,
+						 ld_stream_complete, plugin);
 	if (jstr)
 		return json_stream_output(jstr->js, plugin->stdout_conn,
 					  ld_stream_complete, plugin);
@@ -1838,6 +1864,7 @@ static struct plugin *new_plugin(const tal_t *ctx,
 	list_head_init(&p->js_list);
 	p->used = 0;
 	p->len_read = 0;
+	json_input_init(&p->input);
 	jsmn_init(&p->parser);
 	p->toks = toks_alloc(p);
 	/* Async RPC */
@@ -1861,6 +1888,7 @@ static struct plugin *new_plugin(const tal_t *ctx,
 
 	p->init = init;
 	p->manifested = p->initialized = p->exiting = false;
+	p->length_prefixed = false;
 	p->restartability = restartability;
 	strmap_init(&p->usagemap);
 	p->in_timer = 0;
@@ -57,6 +57,8 @@ struct command {
 	struct plugin *plugin;
 	/* Optional output field filter. */
 	struct json_filter *filter;
+	/* Have we already started sending the response? */
+	bool streaming;
 };
 
 /* Create an array of these, one for each command you support. */
@@ -255,6 +257,12 @@ struct command_result *jsonrpc_get_datastore_(struct plugin *plugin,
 WARN_UNUSED_RESULT
 struct command_result *command_finished(struct command *cmd, struct json_stream *response);
 
+/* Start sending @response to lightningd now, rather than waiting for
+ * command_finished(): for huge responses, which can then be built a
+ * piece at a time (call json_stream_flush() after each piece).  Any
+ * other output is queued behind it until command_finished(). */
+void command_stream_start(struct command *cmd, struct json_stream *response);
+
 /* Helper for a command that'll be finished in a callback. */
 WARN_UNUSED_RESULT
 struct command_result *command_still_pending(struct command *cmd);
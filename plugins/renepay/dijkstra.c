@@ -20,8 +20,9 @@ struct dijkstra {
 
 static const s64 INFINITE = INT64_MAX;
 
-/* Required a global dijkstra for gheap. */
-static struct dijkstra *global_dijkstra;
+/* Required a global dijkstra for gheap: per thread, since minflow() runs
+ * several searches at once. */
+static __thread struct dijkstra *global_dijkstra;
 
 /* The heap comparer for Dijkstra search. Since the top element must be the one
  * with the smallest distance, we use the operator >, rather than <. */
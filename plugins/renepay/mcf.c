@@ -1,10 +1,10 @@
 #include "config.h"
 #include <assert.h>
 #include <ccan/list/list.h>
-#include <ccan/lqueue/lqueue.h>
 #include <ccan/tal/tal.h>
 #include <common/type_to_string.h>
 #include <math.h>
+#include <pthread.h>
 #include <plugins/renepay/debug.h>
 #include <plugins/renepay/dijkstra.h>
 #include <plugins/renepay/flow.h>
@@ -334,19 +334,36 @@ struct pay_parameters {
 	u32 prob_cost_factor;
 };
 
-/* Representation of the linear MCF network.
- * This contains the topology of the extended network (after linearization and
- * addition of arc duality).
- * This contains also the arc probability and linear fee cost, as well as
- * capacity; these quantities remain constant during MCF execution. */
-struct linear_network
+/* Topology of the extended network (after linearization and addition of arc
+ * duality).  It only depends on the gossmap, so we build it once per gossmap
+ * generation and share it between payments and attempts.
+ *
+ * The outgoing arcs of `node` are stored contiguously (compressed sparse
+ * row): node_arcs[node_arcs_start[node] .. node_arcs_start[node+1]). */
+struct linear_topology
 {
+	/* What this was built from. */
+	const struct gossmap *gossmap;
+	u64 generation;
+
+	/* INVALID_INDEX for arcs which don't exist. */
 	u32 *arc_tail_node;
-	// notice that a tail node is not needed,
-	// because the tail of arc is the head of dual(arc)
+	// notice that a head node is not needed,
+	// because the head of arc is the tail of dual(arc)
+
+	u32 *node_arcs_start;
+	struct arc *node_arcs;
 
-	struct arc *node_adjacency_next_arc;
-	struct arc *node_adjacency_first_arc;
+	size_t max_num_arcs,max_num_nodes;
+};
+
+/* Representation of the linear MCF network.
+ * This contains the (shared) topology plus the arc probability and linear fee
+ * cost, as well as capacity; these quantities depend on the payment and
+ * remain constant during MCF execution. */
+struct linear_network
+{
+	const struct linear_topology *topology;
 
 	// probability and fee cost associated to an arc
 	s64 *arc_prob_cost, *arc_fee_cost;
@@ -368,6 +385,19 @@ struct residual_network {
 	s64 *potential;
 };
 
+/* Scratch space for path searches: allocated once per minflow() and reused by
+ * every search, rather than allocating as we go. */
+struct mcf_scratch {
+	/* prev[node] is the arc that lead to node. */
+	struct arc *prev;
+
+	/* BFS queue: each node is enqueued at most once. */
+	u32 *queue;
+
+	/* Nodes permanently labeled by Dijkstra. */
+	bitmap *visited;
+};
+
 /* Helper function.
  * Given an arc idx, return the dual's idx in the residual network. */
 static struct arc arc_dual(struct arc arc)
@@ -399,8 +429,8 @@ static s64 get_arc_flow(
 static u32 arc_tail(const struct linear_network *linear_network,
                     const struct arc arc)
 {
-	assert(arc.idx < tal_count(linear_network->arc_tail_node));
-	return linear_network->arc_tail_node[ arc.idx ];
+	assert(arc.idx < tal_count(linear_network->topology->arc_tail_node));
+	return linear_network->topology->arc_tail_node[ arc.idx ];
 }
 /* Helper function.
  * Given an arc idx, return the node that this arc is pointing to in the residual network. */
@@ -408,36 +438,30 @@ static u32 arc_head(const struct linear_network *linear_network,
                     const struct arc arc)
 {
 	const struct arc dual = arc_dual(arc);
-	assert(dual.idx < tal_count(linear_network->arc_tail_node));
-	return linear_network->arc_tail_node[dual.idx];
+	assert(dual.idx < tal_count(linear_network->topology->arc_tail_node));
+	return linear_network->topology->arc_tail_node[dual.idx];
 }
 
 /* Helper function.
- * Given node idx `node`, return the idx of the first arc whose tail is `node`.
- * */
-static struct arc node_adjacency_begin(
+ * Given node idx `node`, return the first arc whose tail is `node`. */
+static const struct arc *node_adjacency_begin(
 		const struct linear_network * linear_network,
 		const u32 node)
 {
-	assert(node < tal_count(linear_network->node_adjacency_first_arc));
-	return linear_network->node_adjacency_first_arc[node];
+	const struct linear_topology *topology = linear_network->topology;
+	assert(node < linear_network->max_num_nodes);
+	return topology->node_arcs + topology->node_arcs_start[node];
 }
 
 /* Helper function.
- * Is this the end of the adjacency list. */
-static bool node_adjacency_end(const struct arc arc)
-{
-	return arc.idx == INVALID_INDEX;
-}
-
-/* Helper function.
- * Given node idx `node` and `arc`, returns the idx of the next arc whose tail is `node`. */
-static struct arc node_adjacency_next(
-		const struct linear_network *linear_network,
-		const struct arc arc)
+ * Given node idx `node`, return one past the last arc whose tail is `node`. */
+static const struct arc *node_adjacency_end(
+		const struct linear_network * linear_network,
+		const u32 node)
 {
-	assert(arc.idx < tal_count(linear_network->node_adjacency_next_arc));
-	return linear_network->node_adjacency_next_arc[arc.idx];
+	const struct linear_topology *topology = linear_network->topology;
+	assert(node < linear_network->max_num_nodes);
+	return topology->node_arcs + topology->node_arcs_start[node+1];
 }
 
 // TODO(eduardo): unit test this
@@ -534,11 +558,11 @@ static void combine_cost_function(
 		struct residual_network *residual_network,
 		s64 mu)
 {
-	for(struct arc arc = {0};arc.idx < linear_network->max_num_arcs; ++arc.idx)
-	{
-		if(arc_tail(linear_network,arc)==INVALID_INDEX)
-			continue;
+	const struct linear_topology *topology = linear_network->topology;
 
+	for(size_t i=0;i<tal_count(topology->node_arcs);++i)
+	{
+		const struct arc arc = topology->node_arcs[i];
 		const s64 pcost = linear_network->arc_prob_cost[arc.idx],
 		          fcost = linear_network->arc_fee_cost[arc.idx];
 
@@ -551,172 +575,246 @@ static void combine_cost_function(
 	}
 }
 
-static void linear_network_add_adjacenct_arc(
-		struct linear_network *linear_network,
+/* The topology of the last gossmap we were asked about; it's a child of that
+ * gossmap, so it goes away with it. */
+static struct linear_topology *cached_topology;
+
+static void destroy_linear_topology(struct linear_topology *topology)
+{
+	if (cached_topology == topology)
+		cached_topology = NULL;
+}
+
+static void linear_topology_add_arc(
+		struct linear_topology *topology,
+		u32 *fill,
 		const u32 node_idx,
 		const struct arc arc)
 {
-	assert(arc.idx < tal_count(linear_network->arc_tail_node));
-	linear_network->arc_tail_node[arc.idx] = node_idx;
-
-	assert(node_idx < tal_count(linear_network->node_adjacency_first_arc));
-	const struct arc first_arc = linear_network->node_adjacency_first_arc[node_idx];
-
-	assert(arc.idx < tal_count(linear_network->node_adjacency_next_arc));
-	linear_network->node_adjacency_next_arc[arc.idx]=first_arc;
-
-	assert(node_idx < tal_count(linear_network->node_adjacency_first_arc));
-	linear_network->node_adjacency_first_arc[node_idx]=arc;
+	assert(arc.idx < tal_count(topology->arc_tail_node));
+	topology->arc_tail_node[arc.idx] = node_idx;
+
+	/* We fill each node's arcs from the back, which gives the same order
+	 * the old linked-list adjacency did, so searches break ties the same
+	 * way. */
+	assert(node_idx < topology->max_num_nodes);
+	assert(fill[node_idx] > topology->node_arcs_start[node_idx]);
+	topology->node_arcs[--fill[node_idx]] = arc;
 }
 
-
-static void init_linear_network(
-		const struct pay_parameters *params,
-		struct linear_network *linear_network)
+/* Walk every channel direction which becomes arcs of the network.  If `fill`
+ * is NULL we just count the arcs of each node into node_arcs_start[node+1],
+ * otherwise we place them. */
+static void linear_topology_scan(
+		const struct gossmap *gossmap,
+		struct linear_topology *topology,
+		u32 *fill)
 {
-	const size_t max_num_chans = gossmap_max_chan_idx(params->gossmap);
-	const size_t max_num_arcs = max_num_chans * ARCS_PER_CHANNEL;
-	const size_t max_num_nodes = gossmap_max_node_idx(params->gossmap);
-
-	linear_network->max_num_arcs = max_num_arcs;
-	linear_network->max_num_nodes = max_num_nodes;
-
-	linear_network->arc_tail_node = tal_arr(linear_network,u32,max_num_arcs);
-	for(size_t i=0;i<tal_count(linear_network->arc_tail_node);++i)
-		linear_network->arc_tail_node[i]=INVALID_INDEX;
-
-	linear_network->node_adjacency_next_arc = tal_arr(linear_network,struct arc,max_num_arcs);
-	for(size_t i=0;i<tal_count(linear_network->node_adjacency_next_arc);++i)
-		linear_network->node_adjacency_next_arc[i].idx=INVALID_INDEX;
-
-	linear_network->node_adjacency_first_arc = tal_arr(linear_network,struct arc,max_num_nodes);
-	for(size_t i=0;i<tal_count(linear_network->node_adjacency_first_arc);++i)
-		linear_network->node_adjacency_first_arc[i].idx=INVALID_INDEX;
-
-	linear_network->arc_prob_cost = tal_arr(linear_network,s64,max_num_arcs);
-	for(size_t i=0;i<tal_count(linear_network->arc_prob_cost);++i)
-		linear_network->arc_prob_cost[i]=INFINITE;
-
-	linear_network->arc_fee_cost = tal_arr(linear_network,s64,max_num_arcs);
-	for(size_t i=0;i<tal_count(linear_network->arc_fee_cost);++i)
-		linear_network->arc_fee_cost[i]=INFINITE;
-
-	linear_network->capacity = tal_arrz(linear_network,s64,max_num_arcs);
-
-	for(struct gossmap_node *node = gossmap_first_node(params->gossmap);
+	for(struct gossmap_node *node = gossmap_first_node(gossmap);
 	    node;
-	    node=gossmap_next_node(params->gossmap,node))
+	    node=gossmap_next_node(gossmap,node))
 	{
-		const u32 node_id = gossmap_node_idx(params->gossmap,node);
+		const u32 node_id = gossmap_node_idx(gossmap,node);
 
 		for(size_t j=0;j<node->num_chans;++j)
 		{
-
-
 			int half;
-			const struct gossmap_chan *c = gossmap_nth_chan(params->gossmap,
+			const struct gossmap_chan *c = gossmap_nth_chan(gossmap,
 			                                                node, j, &half);
 
 			if (!gossmap_chan_set(c,half))
 				continue;
 
-			const u32 chan_id = gossmap_chan_idx(params->gossmap, c);
-
-			if (params->disabled && bitmap_test_bit(params->disabled,chan_id))
-				continue;
-
+			const u32 chan_id = gossmap_chan_idx(gossmap, c);
 
-			const struct gossmap_node *next = gossmap_nth_node(params->gossmap,
+			const struct gossmap_node *next = gossmap_nth_node(gossmap,
 									   c,!half);
 
-			const u32 next_id = gossmap_node_idx(params->gossmap,next);
+			const u32 next_id = gossmap_node_idx(gossmap,next);
 
 			if(node_id==next_id)
 				continue;
 
-			// `cost` is the word normally used to denote cost per
-			// unit of flow in the context of MCF.
-			s64 prob_cost[CHANNEL_PARTS], capacity[CHANNEL_PARTS];
-
-			// split this channel direction to obtain the arcs
-			// that are outgoing to `node`
-			linearize_channel(params,c,half,capacity,prob_cost);
-
-			const s64 fee_cost = linear_fee_cost(c,half,
-						params->base_fee_penalty,
-						params->delay_feefactor);
-
 			// let's subscribe the 4 parts of the channel direction
 			// (c,half), the dual of these guys will be subscribed
 			// when the `i` hits the `next` node.
+			if(!fill)
+			{
+				topology->node_arcs_start[node_id+1] += CHANNEL_PARTS;
+				topology->node_arcs_start[next_id+1] += CHANNEL_PARTS;
+				continue;
+			}
 			for(size_t k=0;k<CHANNEL_PARTS;++k)
 			{
-				// if(capacity[k]==0)continue;
-
 				struct arc arc = arc_from_parts(chan_id, half, k, false);
 
-				linear_network_add_adjacenct_arc(linear_network,node_id,arc);
+				linear_topology_add_arc(topology,fill,node_id,arc);
 
-				linear_network->capacity[arc.idx] = capacity[k];
-				linear_network->arc_prob_cost[arc.idx] = prob_cost[k];
+				// + the respective dual
+				linear_topology_add_arc(topology,fill,next_id,
+							arc_dual(arc));
+			}
+		}
+	}
+}
 
-				linear_network->arc_fee_cost[arc.idx] = fee_cost;
+/* Get the topology for this gossmap, building it if the gossmap changed. */
+static const struct linear_topology *get_linear_topology(
+		struct gossmap *gossmap)
+{
+	struct linear_topology *topology;
+	u32 *fill;
 
-				// + the respective dual
-				struct arc dual = arc_dual(arc);
+	if (cached_topology
+	    && cached_topology->gossmap == gossmap
+	    && cached_topology->generation == gossmap_generation(gossmap))
+		return cached_topology;
 
-				linear_network_add_adjacenct_arc(linear_network,next_id,dual);
+	tal_free(cached_topology);
 
-				linear_network->capacity[dual.idx] = 0;
-				linear_network->arc_prob_cost[dual.idx] = -prob_cost[k];
+	const size_t max_num_chans = gossmap_max_chan_idx(gossmap);
+	const size_t max_num_arcs = max_num_chans * ARCS_PER_CHANNEL;
+	const size_t max_num_nodes = gossmap_max_node_idx(gossmap);
 
-				linear_network->arc_fee_cost[dual.idx] = -fee_cost;
-			}
+	topology = tal(gossmap, struct linear_topology);
+	topology->gossmap = gossmap;
+	topology->generation = gossmap_generation(gossmap);
+	topology->max_num_arcs = max_num_arcs;
+	topology->max_num_nodes = max_num_nodes;
+
+	topology->arc_tail_node = tal_arr(topology,u32,max_num_arcs);
+	for(size_t i=0;i<max_num_arcs;++i)
+		topology->arc_tail_node[i]=INVALID_INDEX;
+
+	/* Count, then turn counts into offsets, then place. */
+	topology->node_arcs_start = tal_arrz(topology,u32,max_num_nodes+1);
+	linear_topology_scan(gossmap,topology,NULL);
+	for(size_t i=0;i<max_num_nodes;++i)
+		topology->node_arcs_start[i+1] += topology->node_arcs_start[i];
+
+	topology->node_arcs = tal_arr(topology,struct arc,
+				      topology->node_arcs_start[max_num_nodes]);
+	fill = tal_dup_arr(tmpctx,u32,topology->node_arcs_start+1,max_num_nodes,0);
+	linear_topology_scan(gossmap,topology,fill);
+	tal_free(fill);
+
+	tal_add_destructor(topology, destroy_linear_topology);
+	cached_topology = topology;
+	return topology;
+}
+
+static void init_linear_network(
+		const struct pay_parameters *params,
+		struct linear_network *linear_network)
+{
+	const struct linear_topology *topology
+		= get_linear_topology(params->gossmap);
+	const size_t max_num_arcs = topology->max_num_arcs;
+
+	linear_network->topology = topology;
+	linear_network->max_num_arcs = max_num_arcs;
+	linear_network->max_num_nodes = topology->max_num_nodes;
+
+	/* Costs are only ever read for arcs in the topology. */
+	linear_network->arc_prob_cost = tal_arr(linear_network,s64,max_num_arcs);
+	linear_network->arc_fee_cost = tal_arr(linear_network,s64,max_num_arcs);
+	linear_network->capacity = tal_arrz(linear_network,s64,max_num_arcs);
+
+	for(size_t i=0;i<tal_count(topology->node_arcs);++i)
+	{
+		u32 chan_id, part;
+		int half;
+		bool is_dual;
+
+		// each channel direction sets all its parts and duals at once
+		arc_to_parts(topology->node_arcs[i],&chan_id,&half,&part,&is_dual);
+		if(is_dual || part!=0)
+			continue;
+
+		const struct gossmap_chan *c = gossmap_chan_byidx(params->gossmap,
+								  chan_id);
+
+		// `cost` is the word normally used to denote cost per
+		// unit of flow in the context of MCF.
+		s64 prob_cost[CHANNEL_PARTS], capacity[CHANNEL_PARTS];
+		s64 fee_cost;
+
+		/* Disabled channels stay in the topology, but can't carry
+		 * anything. */
+		if (params->disabled && bitmap_test_bit(params->disabled,chan_id))
+		{
+			for(size_t k=0;k<CHANNEL_PARTS;++k)
+				capacity[k]=prob_cost[k]=0;
+			fee_cost = 0;
+		} else {
+			// split this channel direction to obtain the arcs
+			// that are outgoing to `node`
+			linearize_channel(params,c,half,capacity,prob_cost);
+
+			fee_cost = linear_fee_cost(c,half,
+						   params->base_fee_penalty,
+						   params->delay_feefactor);
+		}
+
+		for(size_t k=0;k<CHANNEL_PARTS;++k)
+		{
+			struct arc arc = arc_from_parts(chan_id, half, k, false);
+
+			linear_network->capacity[arc.idx] = capacity[k];
+			linear_network->arc_prob_cost[arc.idx] = prob_cost[k];
+
+			linear_network->arc_fee_cost[arc.idx] = fee_cost;
+
+			// + the respective dual
+			struct arc dual = arc_dual(arc);
+
+			linear_network->capacity[dual.idx] = 0;
+			linear_network->arc_prob_cost[dual.idx] = -prob_cost[k];
+
+			linear_network->arc_fee_cost[dual.idx] = -fee_cost;
 		}
 	}
 }
 
-/* Simple queue to traverse the network. */
-struct queue_data
+static struct mcf_scratch *mcf_scratch_new(const tal_t *ctx,
+					   size_t max_num_nodes)
 {
-	u32 idx;
-	struct lqueue_link ql;
-};
+	struct mcf_scratch *scratch = tal(ctx, struct mcf_scratch);
+
+	scratch->prev = tal_arr(scratch,struct arc,max_num_nodes);
+	scratch->queue = tal_arr(scratch,u32,max_num_nodes);
+	scratch->visited = tal_arr(scratch,bitmap,BITMAP_NWORDS(max_num_nodes));
+	return scratch;
+}
 
 // TODO(eduardo): unit test this
 /* Finds an admissible path from source to target, traversing arcs in the
  * residual network with capacity greater than 0.
- * The path is encoded into prev, which contains the idx of the arcs that are
- * traversed.
+ * The path is encoded into scratch->prev, which contains the idx of the arcs
+ * that are traversed.
  * Returns RENEPAY_ERR_OK if the path exists. */
 static int find_admissible_path(
 		const struct linear_network *linear_network,
 		const struct residual_network *residual_network,
                 const u32 source,
 		const u32 target,
-		struct arc *prev)
+		struct mcf_scratch *scratch)
 {
-	tal_t *this_ctx = tal(tmpctx,tal_t);
-
 	int ret = RENEPAY_ERR_NOFEASIBLEFLOW;
+	struct arc *prev = scratch->prev;
+	u32 *queue = scratch->queue;
+	size_t queue_head = 0, queue_tail = 0;
+
 	for(size_t i=0;i<tal_count(prev);++i)
 		prev[i].idx=INVALID_INDEX;
 
 	// The graph is dense, and the farthest node is just a few hops away,
 	// hence let's BFS search.
-	LQUEUE(struct queue_data,ql) myqueue = LQUEUE_INIT;
-	struct queue_data *qdata;
-
-	qdata = tal(this_ctx,struct queue_data);
-	qdata->idx = source;
-	lqueue_enqueue(&myqueue,qdata);
+	queue[queue_tail++] = source;
 
-	while(!lqueue_empty(&myqueue))
+	while(queue_head < queue_tail)
 	{
-		qdata = lqueue_dequeue(&myqueue);
-		u32 cur = qdata->idx;
-
-		tal_free(qdata);
+		u32 cur = queue[queue_head++];
 
 		if(cur==target)
 		{
@@ -724,10 +822,13 @@ static int find_admissible_path(
 			break;
 		}
 
-		for(struct arc arc = node_adjacency_begin(linear_network,cur);
-		        !node_adjacency_end(arc);
-			arc = node_adjacency_next(linear_network,arc))
+		for(const struct arc *a = node_adjacency_begin(linear_network,cur),
+		        *end = node_adjacency_end(linear_network,cur);
+			a != end;
+			++a)
 		{
+			const struct arc arc = *a;
+
 			// check if this arc is traversable
 			if(residual_network->cap[arc.idx] <= 0)
 				continue;
@@ -737,17 +838,15 @@ static int find_admissible_path(
 			assert(next < tal_count(prev));
 
 			// if that node has been seen previously
-			if(prev[next].idx!=INVALID_INDEX)
+			if(next==source || prev[next].idx!=INVALID_INDEX)
 				continue;
 
 			prev[next] = arc;
 
-			qdata = tal(tmpctx,struct queue_data);
-			qdata->idx = next;
-			lqueue_enqueue(&myqueue,qdata);
+			assert(queue_tail < tal_count(queue));
+			queue[queue_tail++] = next;
 		}
 	}
-	tal_free(this_ctx);
 	return ret;
 }
 
@@ -824,23 +923,23 @@ static int find_feasible_flow(
 		struct residual_network *residual_network,
 		const u32 source,
 		const u32 target,
-		s64 amount)
+		s64 amount,
+		struct mcf_scratch *scratch)
 {
 	assert(amount>=0);
 
-	tal_t *this_ctx = tal(tmpctx,tal_t);
 	int ret = RENEPAY_ERR_OK;
 
 	/* path information
 	 * prev: is the id of the arc that lead to the node. */
-	struct arc *prev = tal_arr(this_ctx,struct arc,linear_network->max_num_nodes);
+	const struct arc *prev = scratch->prev;
 
 	while(amount>0)
 	{
 		// find a path from source to target
 		int err = find_admissible_path(
 					linear_network,
-					residual_network,source,target,prev);
+					residual_network,source,target,scratch);
 
 		if(err!=RENEPAY_ERR_OK)
 		{
@@ -861,7 +960,6 @@ static int find_feasible_flow(
 		amount -= delta;
 	}
 
-	tal_free(this_ctx);
 	return ret;
 }
 
@@ -874,13 +972,13 @@ static int  find_optimal_path(
 		const struct residual_network* residual_network,
 		const u32 source,
 		const u32 target,
-		struct arc *prev)
+		struct mcf_scratch *scratch)
 {
-	tal_t *this_ctx = tal(tmpctx,tal_t);
 	int ret = RENEPAY_ERR_NOFEASIBLEFLOW;
+	struct arc *prev = scratch->prev;
+	bitmap *visited = scratch->visited;
 
-	bitmap *visited = tal_arrz(this_ctx, bitmap,
-					BITMAP_NWORDS(linear_network->max_num_nodes));
+	bitmap_zero(visited, linear_network->max_num_nodes);
 
 	for(size_t i=0;i<tal_count(prev);++i)
 		prev[i].idx=INVALID_INDEX;
@@ -906,10 +1004,13 @@ static int  find_optimal_path(
 			break;
 		}
 
-		for(struct arc arc = node_adjacency_begin(linear_network,cur);
-		        !node_adjacency_end(arc);
-			arc = node_adjacency_next(linear_network,arc))
+		for(const struct arc *a = node_adjacency_begin(linear_network,cur),
+		        *end = node_adjacency_end(linear_network,cur);
+			a != end;
+			++a)
 		{
+			const struct arc arc = *a;
+
 			// check if this arc is traversable
 			if(residual_network->cap[arc.idx] <= 0)
 				continue;
@@ -930,7 +1031,6 @@ static int  find_optimal_path(
 			prev[next]=arc;
 		}
 	}
-	tal_free(this_ctx);
 	return ret;
 }
 
@@ -942,10 +1042,12 @@ static void zero_flow(
 	for(u32 node=0;node<linear_network->max_num_nodes;++node)
 	{
 		residual_network->potential[node]=0;
-		for(struct arc arc=node_adjacency_begin(linear_network,node);
-			  !node_adjacency_end(arc);
-			  arc = node_adjacency_next(linear_network,arc))
+		for(const struct arc *a = node_adjacency_begin(linear_network,node),
+			  *end = node_adjacency_end(linear_network,node);
+			  a != end;
+			  ++a)
 		{
+			const struct arc arc = *a;
 			if(arc_is_dual(arc))continue;
 
 			struct arc dual = arc_dual(arc);
@@ -971,15 +1073,15 @@ static int optimize_mcf(
 		struct residual_network *residual_network,
 		const u32 source,
 		const u32 target,
-		const s64 amount)
+		const s64 amount,
+		struct mcf_scratch *scratch)
 {
 	assert(amount>=0);
-	tal_t *this_ctx = tal(tmpctx,tal_t);
 
 	int ret = RENEPAY_ERR_OK;
 
 	zero_flow(linear_network,residual_network);
-	struct arc *prev = tal_arr(this_ctx,struct arc,linear_network->max_num_nodes);
+	const struct arc *prev = scratch->prev;
 
 	const s64 *const distance = dijkstra_distance_data(dijkstra);
 
@@ -987,7 +1089,7 @@ static int optimize_mcf(
 
 	while(remaining_amount>0)
 	{
-		int err = find_optimal_path(dijkstra,linear_network,residual_network,source,target,prev);
+		int err = find_optimal_path(dijkstra,linear_network,residual_network,source,target,scratch);
 		if(err!=RENEPAY_ERR_OK)
 		{
 			// unexpected error
@@ -1023,10 +1125,78 @@ static int optimize_mcf(
 			 * */
 		}
 	}
-	tal_free(this_ctx);
 	return ret;
 }
 
+/* One value of `mu` to try in minflow().  Each candidate has its own residual
+ * network and search state, and only reads the linear network, so several can
+ * be solved at once.  The workers must not allocate: tal isn't thread-safe. */
+struct mcf_candidate
+{
+	const struct linear_network *linear_network;
+	u32 source, target;
+	s64 amount;
+	s64 mu;
+
+	struct residual_network *residual_network;
+	struct dijkstra *dijkstra;
+	struct mcf_scratch *scratch;
+
+	pthread_t thread;
+	bool threaded;
+};
+
+static struct mcf_candidate *mcf_candidate_new(
+		const tal_t *ctx,
+		const struct linear_network *linear_network,
+		u32 source, u32 target, s64 amount)
+{
+	struct mcf_candidate *cand = tal(ctx, struct mcf_candidate);
+
+	cand->linear_network = linear_network;
+	cand->source = source;
+	cand->target = target;
+	cand->amount = amount;
+
+	cand->residual_network = tal(cand, struct residual_network);
+	alloc_residual_netork(linear_network, cand->residual_network);
+	cand->dijkstra = dijkstra_new(cand, linear_network->max_num_nodes);
+	cand->scratch = mcf_scratch_new(cand, linear_network->max_num_nodes);
+	return cand;
+}
+
+static void *solve_candidate(void *arg)
+{
+	struct mcf_candidate *cand = arg;
+
+	combine_cost_function(cand->linear_network, cand->residual_network,
+			      cand->mu);
+	optimize_mcf(cand->dijkstra, cand->linear_network,
+		     cand->residual_network, cand->source, cand->target,
+		     cand->amount, cand->scratch);
+	return NULL;
+}
+
+/* Solve candidates [0, n): the first one in this thread, the rest in their
+ * own threads (or here too, if we can't start one). */
+static void solve_candidates(struct mcf_candidate **cands, size_t n)
+{
+	for (size_t i = 1; i < n; i++) {
+		cands[i]->threaded = pthread_create(&cands[i]->thread, NULL,
+						    solve_candidate,
+						    cands[i]) == 0;
+		if (!cands[i]->threaded)
+			solve_candidate(cands[i]);
+	}
+
+	solve_candidate(cands[0]);
+
+	for (size_t i = 1; i < n; i++) {
+		if (cands[i]->threaded)
+			pthread_join(cands[i]->thread, NULL);
+	}
+}
+
 // flow on directed channels
 struct chan_flow
 {
@@ -1143,10 +1313,12 @@ static struct flow **
 	// Compute balance on the nodes.
 	for(u32 n = 0;n<max_num_nodes;++n)
 	{
-		for(struct arc arc = node_adjacency_begin(linear_network,n);
-		        !node_adjacency_end(arc);
-			arc = node_adjacency_next(linear_network,arc))
+		for(const struct arc *a = node_adjacency_begin(linear_network,n),
+		        *end = node_adjacency_end(linear_network,n);
+			a != end;
+			++a)
 		{
+			const struct arc arc = *a;
 			if(arc_is_dual(arc))
 				continue;
 			u32 m = arc_head(linear_network,arc);
@@ -1378,12 +1550,14 @@ struct flow** minflow(
 		double min_probability,
 		double delay_feefactor,
 		double base_fee_penalty,
-		u32 prob_cost_factor )
+		u32 prob_cost_factor,
+		size_t num_threads)
 {
 	tal_t *this_ctx = tal(tmpctx,tal_t);
 
 	struct pay_parameters *params = tal(this_ctx,struct pay_parameters);
-	struct dijkstra *dijkstra;
+	struct mcf_scratch *scratch;
+	struct mcf_candidate **cands;
 
 	params->gossmap = gossmap;
 	params->source = source;
@@ -1423,7 +1597,7 @@ struct flow** minflow(
 	struct residual_network *residual_network = tal(this_ctx,struct residual_network);
 	alloc_residual_netork(linear_network,residual_network);
 
-	dijkstra = dijkstra_new(this_ctx, gossmap_max_node_idx(params->gossmap));
+	scratch = mcf_scratch_new(this_ctx, linear_network->max_num_nodes);
 
 	const u32 target_idx = gossmap_node_idx(params->gossmap,target);
 	const u32 source_idx = gossmap_node_idx(params->gossmap,source);
@@ -1455,7 +1629,7 @@ struct flow** minflow(
 		= amount_msat(pay_amount_msats ? 1000 - pay_amount_msats : 0);
 
 	int err = find_feasible_flow(linear_network,residual_network,source_idx,target_idx,
-	                             pay_amount_sats);
+	                             pay_amount_sats,scratch);
 
 	if(err!=RENEPAY_ERR_OK)
 	{
@@ -1472,64 +1646,93 @@ struct flow** minflow(
 						params->chan_extra_map);
 	best_fee = flow_set_fee(best_flow_paths);
 
-	// binary search for a value of `mu` that fits our fee and prob.
+	// search for a value of `mu` that fits our fee and prob.
 	// constraints.
 	// mu=0 corresponds to only probabilities
 	// mu=MU_MAX-1 corresponds to only fee
+	//
+	// Each round we try num_threads values of mu at once, evenly spread
+	// over [mu_left,mu_right); with one thread this is a binary search.
+	// The outcome only depends on num_threads, not on thread timing,
+	// since we judge the candidates in order of mu once all are done.
+	num_threads = MIN(MAX(num_threads, 1), MINFLOW_MAX_THREADS);
+	cands = tal_arr(this_ctx, struct mcf_candidate *, num_threads);
+	for(size_t i=0;i<num_threads;++i)
+		cands[i] = mcf_candidate_new(cands, linear_network,
+					     source_idx, target_idx,
+					     pay_amount_sats);
+
 	s64 mu_left = 0, mu_right = MU_MAX;
 	while(mu_left<mu_right)
 	{
+		size_t num_cands = 0;
 
-		s64 mu = (mu_left + mu_right)/2;
-
-		combine_cost_function(linear_network,residual_network,mu);
+		for(size_t i=0;i<num_threads;++i)
+		{
+			s64 mu = mu_left + (mu_right-mu_left)*(s64)(i+1)/(s64)(num_threads+1);
 
-		optimize_mcf(dijkstra,linear_network,residual_network,
-				source_idx,target_idx,pay_amount_sats);
+			// small ranges give duplicates
+			if(num_cands && mu<=cands[num_cands-1]->mu)
+				continue;
+			cands[num_cands++]->mu = mu;
+		}
 
-		struct flow **flow_paths;
-		flow_paths = get_flow_paths(this_ctx,params->gossmap,params->chan_extra_map,
-		                            linear_network,residual_network,
-					    excess);
+		solve_candidates(cands, num_cands);
 
-		double prob_success = flow_set_probability(
-						flow_paths,
-						params->gossmap,
-						params->chan_extra_map);
-		struct amount_msat fee = flow_set_fee(flow_paths);
-
-		/* Is this better than the previous one? */
-		if(!best_flow_paths ||
-			is_better(params->max_fee,params->min_probability,
-				  fee,prob_success,
-			          best_fee, best_prob_success))
+		bool narrowed = false;
+		for(size_t i=0;i<num_cands;++i)
 		{
-			struct flow **tmp = best_flow_paths;
-			best_flow_paths = tal_steal(ctx,flow_paths);
-			tal_free(tmp);
+			const s64 mu = cands[i]->mu;
+			struct flow **flow_paths;
+			flow_paths = get_flow_paths(this_ctx,params->gossmap,params->chan_extra_map,
+			                            linear_network,cands[i]->residual_network,
+						    excess);
+
+			double prob_success = flow_set_probability(
+							flow_paths,
+							params->gossmap,
+							params->chan_extra_map);
+			struct amount_msat fee = flow_set_fee(flow_paths);
+
+			/* Is this better than the previous one? */
+			if(!best_flow_paths ||
+				is_better(params->max_fee,params->min_probability,
+					  fee,prob_success,
+				          best_fee, best_prob_success))
+			{
+				struct flow **tmp = best_flow_paths;
+				best_flow_paths = tal_steal(ctx,flow_paths);
+				tal_free(tmp);
 
-			best_fee = fee;
-			best_prob_success=prob_success;
-			flow_paths = NULL;
-		}
-		/* I don't like this candidate. */
-		else
-			tal_free(flow_paths);
+				best_fee = fee;
+				best_prob_success=prob_success;
+				flow_paths = NULL;
+			}
+			/* I don't like this candidate. */
+			else
+				tal_free(flow_paths);
 
-		if(amount_msat_greater(fee,params->max_fee))
-		{
-			// too expensive
-			mu_left = mu+1;
+			/* Candidates above the one which sent us left are still
+			 * worth comparing, but they don't move the range. */
+			if(narrowed)
+				continue;
 
-		}else if(prob_success < params->min_probability)
-		{
-			// too unlikely
-			mu_right = mu;
-		}else
-		{
-			// with mu constraints are satisfied, now let's optimize
-			// the fees
-			mu_left = mu+1;
+			if(amount_msat_greater(fee,params->max_fee))
+			{
+				// too expensive
+				mu_left = mu+1;
+
+			}else if(prob_success < params->min_probability)
+			{
+				// too unlikely
+				mu_right = mu;
+				narrowed = true;
+			}else
+			{
+				// with mu constraints are satisfied, now let's optimize
+				// the fees
+				mu_left = mu+1;
+			}
 		}
 	}
 
@@ -7,6 +7,9 @@
 
 struct chan_extra_map;
 
+/* Most threads minflow() will use. */
+#define MINFLOW_MAX_THREADS 8
+
 enum {
 	RENEPAY_ERR_OK,
 	// No feasible flow found, either there is not enough known liquidity (or capacity)
@@ -53,6 +56,10 @@ enum {
  *
  * 	cost(payment) = - k_microsat * log Prob(payment)
  *
+ * @num_threads: how many tradeoffs between fees and probability to solve in
+ * parallel (capped at MINFLOW_MAX_THREADS).  For a given value the result is
+ * deterministic; 1 does a plain binary search.
+ *
  * Return a series of subflows which deliver amount to target, or NULL.
  */
 struct flow** minflow(
@@ -67,5 +74,6 @@ struct flow** minflow(
 		double min_probability,
 		double delay_feefactor,
 		double base_fee_penalty,
-		u32 prob_cost_factor);
+		u32 prob_cost_factor,
+		size_t num_threads);
 #endif /* LIGHTNING_PLUGINS_RENEPAY_MCF_H */
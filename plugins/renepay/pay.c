@@ -16,6 +16,7 @@
 #include <plugins/renepay/pay.h>
 #include <plugins/renepay/pay_flow.h>
 #include <plugins/renepay/uncertainty_network.h>
+#include <unistd.h>
 
 // TODO(eduardo): maybe there are too many debug_err and plugin_err and
 // plugin_log(...,LOG_BROKEN,...) that could be resolved with a command_fail
@@ -1777,7 +1778,14 @@ static const struct plugin_notification notifications[] = {
 
 int main(int argc, char *argv[])
 {
+	long num_cpus;
+
 	setup_locale();
+
+	/* Beyond a few threads, the extra candidates aren't worth the memory. */
+	num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	pay_plugin->mcf_threads = num_cpus > 0 ? MIN(num_cpus, 4) : 1;
+
 	plugin_main(
 		argv,
 		init,
@@ -1794,6 +1802,9 @@ int main(int argc, char *argv[])
 		plugin_option("renepay-debug-payflow", "flag",
 			"Enable renepay payment flows debug info.",
 			flag_option, &pay_plugin->debug_payflow),
+		plugin_option("renepay-threads", "int",
+			"Number of threads to use for planning payments.",
+			u32_option, &pay_plugin->mcf_threads),
 		NULL);
 
 	// TODO(eduardo): I think this is actually never executed
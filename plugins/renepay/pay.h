@@ -75,6 +75,9 @@ struct pay_plugin {
 	bool debug_mcf;
 	bool debug_payflow;
 
+	/* How many threads minflow() may use. */
+	u32 mcf_threads;
+
 	/* I'll allocate all global (controlled by pay_plugin) variables tied to
 	 * this tal_t. */
 	tal_t *ctx;
@@ -379,7 +379,8 @@ struct pay_flow **get_payflows(struct renepay * renepay,
 				p->min_prob_success ,
 				p->delay_feefactor,
 				p->base_fee_penalty,
-				p->prob_cost_factor);
+				p->prob_cost_factor,
+				pay_plugin->mcf_threads);
 		if (!flows) {
 			debug_paynote(p,
 				      "minflow couldn't find a feasible flow for %s",
@@ -0,0 +1,190 @@
+#include "config.h"
+/* minflow() between random nodes, of a gossip_store or (without one, or with
+ * "-") a generated network. */
+#define RENEPAY_UNITTEST // logs are written in /tmp/debug.txt
+#include "../payment.c"
+#include "../flow.c"
+#include "../uncertainty_network.c"
+#include "../mcf.c"
+
+#include <ccan/read_write_all/read_write_all.h>
+#include <ccan/time/time.h>
+#include <common/bigsize.h>
+#include <common/channel_id.h>
+#include <common/node_id.h>
+#include <common/setup.h>
+#include <common/type_to_string.h>
+#include <common/wireaddr.h>
+#include <err.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define SYNTH_NODES 2000
+#define SYNTH_CHANS_PER_NODE 4
+
+static u8 empty_map[] = {
+	0
+};
+
+static void synth_node_id(u32 idx, struct node_id *id)
+{
+	memset(id->k, 0, sizeof(id->k));
+	id->k[0] = 0x02;
+	id->k[PUBKEY_CMPR_LEN-4] = idx >> 24;
+	id->k[PUBKEY_CMPR_LEN-3] = idx >> 16;
+	id->k[PUBKEY_CMPR_LEN-2] = idx >> 8;
+	id->k[PUBKEY_CMPR_LEN-1] = idx;
+}
+
+/* Random network of local channels, with fees and capacities all over. */
+static struct gossmap *synth_gossmap(const tal_t *ctx,
+				     struct chan_extra_map *chan_extra_map)
+{
+	int fd;
+	char *gossfile;
+	struct gossmap *gossmap;
+	struct gossmap_localmods *mods;
+	u32 blocknum = 1;
+
+	fd = tmpdir_mkstemp(tmpctx, "bench-mcf.XXXXXX", &gossfile);
+	if (!write_all(fd, empty_map, sizeof(empty_map)))
+		err(1, "Writing %s", gossfile);
+	close(fd);
+
+	gossmap = gossmap_load(ctx, gossfile, NULL);
+	if (!gossmap)
+		err(1, "Loading %s", gossfile);
+	remove(gossfile);
+
+	mods = gossmap_localmods_new(ctx);
+	for (u32 i = 0; i < SYNTH_NODES; i++) {
+		for (size_t j = 0; j < SYNTH_CHANS_PER_NODE; j++) {
+			struct node_id n1, n2;
+			struct short_channel_id scid;
+			struct amount_msat cap;
+			u32 peer = random() % SYNTH_NODES;
+
+			if (peer == i)
+				continue;
+			synth_node_id(i, &n1);
+			synth_node_id(peer, &n2);
+			if (node_id_cmp(&n1, &n2) > 0) {
+				struct node_id tmp = n1;
+				n1 = n2;
+				n2 = tmp;
+			}
+			if (!mk_short_channel_id(&scid, blocknum++, 1, 0))
+				abort();
+
+			cap = amount_msat((1000000 + random() % 9000000) * 1000ULL);
+			if (!gossmap_local_addchan(mods, &n1, &n2, &scid, NULL))
+				abort();
+			for (int dir = 0; dir < 2; dir++) {
+				if (!gossmap_local_updatechan(mods, &scid,
+							      AMOUNT_MSAT(0), cap,
+							      random() % 1000,
+							      1 + random() % 2000,
+							      6 + random() % 140,
+							      true, dir))
+					abort();
+			}
+			/* The local chans have no "capacity", so set it
+			 * manually. */
+			new_chan_extra(chan_extra_map, scid, cap);
+		}
+	}
+	gossmap_apply_localmods(gossmap, mods);
+	return gossmap;
+}
+
+static struct gossmap_node *random_node(struct gossmap *gossmap)
+{
+	struct gossmap_node *n;
+
+	do {
+		n = gossmap_node_byidx(gossmap,
+				       random() % gossmap_max_node_idx(gossmap));
+	} while (!n || n->num_chans == 0);
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	const tal_t *ctx;
+	struct gossmap *gossmap;
+	struct chan_extra_map *chan_extra_map;
+	struct timemono tstart, tstop;
+	u64 first_usec = 0, total_usec = 0;
+	size_t num_payments = 100, num_run = 0, num_solved = 0;
+	size_t num_threads = 1;
+
+	common_setup(argv[0]);
+	ctx = tal(NULL, char);
+	srandom(1);
+
+	if (argc > 4)
+		errx(1, "Usage: %s [<gossip_store> [<num-payments> [<num-threads>]]]",
+		     argv[0]);
+	if (argc > 2)
+		num_payments = atol(argv[2]);
+	if (argc > 3)
+		num_threads = atol(argv[3]);
+
+	chan_extra_map = tal(ctx, struct chan_extra_map);
+	chan_extra_map_init(chan_extra_map);
+
+	tstart = time_mono();
+	if (argc > 1 && !streq(argv[1], "-")) {
+		gossmap = gossmap_load(ctx, argv[1], NULL);
+		if (!gossmap)
+			err(1, "Loading gossip store %s", argv[1]);
+		uncertainty_network_update(gossmap, chan_extra_map);
+	} else
+		gossmap = synth_gossmap(ctx, chan_extra_map);
+	tstop = time_mono();
+
+	printf("# Loaded %zu nodes and %zu channels in %"PRIu64" msec\n",
+	       gossmap_num_nodes(gossmap), gossmap_num_chans(gossmap),
+	       time_to_msec(timemono_between(tstop, tstart)));
+
+	for (size_t i = 0; i < num_payments; i++) {
+		struct gossmap_node *src = random_node(gossmap),
+			*dst = random_node(gossmap);
+		struct flow **flows;
+		u64 usec;
+
+		if (src == dst)
+			continue;
+
+		tstart = time_mono();
+		flows = minflow(tmpctx, gossmap, src, dst,
+				chan_extra_map, NULL,
+				/* amount = */ AMOUNT_MSAT(100000000), // 100k sats
+				/* max_fee = */ AMOUNT_MSAT(1000000), // 1k sats
+				/* min probability = */ 0.1,
+				/* delay fee factor = */ 1e-6,
+				/* base fee penalty */ 10,
+				/* prob cost factor = */ 10,
+				num_threads);
+		tstop = time_mono();
+
+		usec = time_to_usec(timemono_between(tstop, tstart));
+		/* The first one also builds the network topology. */
+		if (num_run++ == 0)
+			first_usec = usec;
+		total_usec += usec;
+		if (flows)
+			num_solved++;
+		clean_tmpctx();
+	}
+
+	printf("# First payment: %"PRIu64" usec\n", first_usec);
+	printf("# %zu payments (%zu solved): %"PRIu64" usec total, %"PRIu64" usec average\n",
+	       num_run, num_solved, total_usec,
+	       num_run ? total_usec / num_run : 0);
+
+	tal_free(ctx);
+	common_shutdown();
+	return 0;
+}
@@ -147,10 +147,50 @@ int main(int argc, char *argv[])
 			 /* min probability = */ 0.8, // 80%
 			 /* delay fee factor = */ 0,
 			 /* base fee penalty */ 0,
-			 /* prob cost factor = */ 1);
+			 /* prob cost factor = */ 1,
+			 /* num threads = */ 1);
 
 	debug_info("%s\n",
 		print_flows(tmpctx,"Simple minflow", gossmap,chan_extra_map, flows));
 
+	/* Trying several tradeoffs at once must be repeatable, and must still
+	 * deliver everything. */
+	struct flow **flows2 = NULL;
+	for (size_t i = 0; i < 2; i++) {
+		struct amount_msat delivered = AMOUNT_MSAT(0);
+		struct flow **f;
+
+		f = minflow(tmpctx, gossmap,
+			    gossmap_find_node(gossmap, &l1),
+			    gossmap_find_node(gossmap, &l4),
+			    chan_extra_map, NULL,
+			    AMOUNT_MSAT(1000000),
+			    /* max_fee = */ AMOUNT_MSAT(10000),
+			    /* min probability = */ 0.8,
+			    /* delay fee factor = */ 0,
+			    /* base fee penalty */ 0,
+			    /* prob cost factor = */ 1,
+			    /* num threads = */ 4);
+		assert(f);
+		for (size_t j = 0; j < tal_count(f); j++) {
+			struct amount_msat last
+				= f[j]->amounts[tal_count(f[j]->amounts)-1];
+			assert(amount_msat_add(&delivered, delivered, last));
+		}
+		assert(amount_msat_eq(delivered, AMOUNT_MSAT(1000000)));
+
+		if (flows2) {
+			assert(tal_count(f) == tal_count(flows2));
+			for (size_t j = 0; j < tal_count(f); j++) {
+				assert(tal_count(f[j]->path) == tal_count(flows2[j]->path));
+				for (size_t k = 0; k < tal_count(f[j]->path); k++)
+					assert(f[j]->path[k] == flows2[j]->path[k]);
+				assert(amount_msat_eq(f[j]->amounts[0],
+						      flows2[j]->amounts[0]));
+			}
+		}
+		flows2 = f;
+	}
+
 	common_shutdown();
 }
@@ -308,7 +308,8 @@ int main(int argc, char *argv[])
 			 /* min probability = */ 0.1,
 			 /* delay fee factor = */ 1,
 			 /* base fee penalty */ 1,
-			 /* prob cost factor = */ 10);
+			 /* prob cost factor = */ 10,
+			 /* num threads = */ 1);
 	commit_flow_set(gossmap,chan_extra_map,flows);
 	debug_info("%s\n",
 		print_flows(tmpctx,"Flow via single path l1->l2->l3", gossmap, flows));
@@ -396,7 +397,8 @@ int main(int argc, char *argv[])
 	// 		 /* min probability = */ 0.4,
 	// 		 /* delay fee factor = */ 1,
 	// 		 /* base fee penalty */ 1,
-	// 		 /* prob cost factor = */ 10);
+	// 		 /* prob cost factor = */ 10,
+	// 		 /* num threads = */ 1);
 
 	// print_flows("Flow via two paths, low mu", gossmap, flows);
 
@@ -454,7 +456,8 @@ int main(int argc, char *argv[])
 			 /* min probability = */ 0.1, // 10%
 			 /* delay fee factor = */ 1,
 			 /* base fee penalty */ 1,
-			 /* prob cost factor = */ 10);
+			 /* prob cost factor = */ 10,
+			 /* num threads = */ 1);
 	debug_info("%s\n",
 		print_flows(tmpctx,"Flow via two paths, high mu", gossmap, flows2));
 	assert(tal_count(flows2) == 2);
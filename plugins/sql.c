@@ -2,6 +2,7 @@
 #include "config.h"
 #include <ccan/array_size/array_size.h>
 #include <ccan/err/err.h>
+#include <ccan/json_out/json_out.h>
 #include <ccan/strmap/strmap.h>
 #include <ccan/tal/str/str.h>
 #include <common/gossip_store.h>
@@ -87,9 +88,18 @@ struct column {
 };
 
 struct db_query {
+	struct command *cmd;
 	sqlite3_stmt *stmt;
 	struct table_desc **tables;
 	const char *authfail;
+	/* Which index we're paging through, for indexed_refresh */
+	const char *indexname;
+	/* The response, once we have one */
+	struct json_stream *ret;
+	size_t num_rows;
+	char *errmsg;
+	/* Waiting for lightningd to read what we've sent so far */
+	bool waiting_drain;
 };
 
 struct table_desc {
@@ -110,7 +120,27 @@ struct table_desc {
 	struct command_result *(*refresh)(struct command *cmd,
 					  const struct table_desc *td,
 					  struct db_query *dbq);
+	/* If non-NULL, we can refresh by index (see indexed_refresh) */
+	struct indexed_state *indexed;
+};
+
+/* Some list commands can be paged by created_index and updated_index
+ * (see lightning-wait(7)), so we only need to fetch what changed. */
+struct indexed_state {
+	const char *subsystem;
+	/* The highest index values we've seen so far. */
+	u64 created_index, updated_index, deleted_index;
+};
+
+static const struct {
+	const char *tablename;
+	const char *subsystem;
+} indexed_tables[] = {
+	{ "invoices", "invoices" },
 };
+
+/* How many entries to ask for at once when paging */
+#define INDEXED_PAGE_SIZE 10000
 static STRMAP(struct table_desc *) tablemap;
 static size_t max_dbmem = 500000000;
 static struct sqlite3 *db;
@@ -118,6 +148,15 @@ static char *dbfilename;
 static int gosstore_fd = -1;
 static size_t gosstore_nodes_off = 0, gosstore_channels_off = 0;
 static u64 next_rowid = 1;
+/* Query we're currently running, if any */
+static struct db_query *current_query;
+/* Queries waiting for it to finish */
+static struct db_query **waiting_queries;
+
+/* Large results are sent in chunks of this many rows */
+#define ROWS_PER_CHUNK 1000
+/* Wait for lightningd to read it all before buffering more than this */
+#define MAX_PENDING_OUTPUT (1024 * 1024)
 
 /* It was tempting to put these in the schema, but they're really
  * just for our usage.  Though that would allow us to autogen the
@@ -311,96 +350,156 @@ static int sqlite_authorize(void *dbq_, int code,
 	return SQLITE_DENY;
 }
 
-static struct command_result *refresh_complete(struct command *cmd,
-					       struct db_query *dbq)
+/* Add a row of results to the response */
+static void json_add_row(struct command *cmd,
+			 struct json_stream *ret,
+			 struct db_query *dbq)
 {
-	char *errmsg;
-	int err, num_cols;
-	size_t num_rows;
-	struct json_stream *ret;
+	int num_cols = sqlite3_column_count(dbq->stmt);
+
+	json_array_start(ret, NULL);
+	for (size_t i = 0; i < num_cols; i++) {
+		/* The returned value is one of
+		 * SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT,
+		 * SQLITE_BLOB, or SQLITE_NULL */
+		switch (sqlite3_column_type(dbq->stmt, i)) {
+		case SQLITE_INTEGER: {
+			s64 v = sqlite3_column_int64(dbq->stmt, i);
+			json_add_s64(ret, NULL, v);
+			break;
+		}
+		case SQLITE_FLOAT: {
+			double v = sqlite3_column_double(dbq->stmt, i);
+			json_add_primitive_fmt(ret, NULL, "%f", v);
+			break;
+		}
+		case SQLITE_TEXT: {
+			const char *c = (char *)sqlite3_column_text(dbq->stmt, i);
+			if (!utf8_check(c, strlen(c))) {
+				json_add_str_fmt(ret, NULL,
+						 "INVALID UTF-8 STRING %s",
+						 tal_hexstr(tmpctx, c, strlen(c)));
+				dbq->errmsg = tal_fmt(cmd, "Invalid UTF-8 string row %zu column %zu",
+						      dbq->num_rows, i);
+			} else
+				json_add_string(ret, NULL, c);
+			break;
+		}
+		case SQLITE_BLOB:
+			json_add_hex(ret, NULL,
+				     sqlite3_column_blob(dbq->stmt, i),
+				     sqlite3_column_bytes(dbq->stmt, i));
+			break;
+		case SQLITE_NULL:
+			json_add_primitive(ret, NULL, "null");
+			break;
+		default:
+			dbq->errmsg = tal_fmt(cmd, "Unknown column type %i in row %zu column %zu",
+					      sqlite3_column_type(dbq->stmt, i),
+					      dbq->num_rows, i);
+		}
+	}
+	json_array_end(ret);
+	dbq->num_rows++;
+}
 
-	num_cols = sqlite3_column_count(dbq->stmt);
+static struct command_result *output_rows(struct command *cmd,
+					  struct db_query *dbq);
 
-	/* We normally hit an error immediately, so return a simple error then */
-	ret = NULL;
-	num_rows = 0;
-	errmsg = NULL;
-
-	while ((err = sqlite3_step(dbq->stmt)) == SQLITE_ROW) {
-		if (!ret) {
-			ret = jsonrpc_stream_success(cmd);
-			json_array_start(ret, "rows");
-		}
-		json_array_start(ret, NULL);
-		for (size_t i = 0; i < num_cols; i++) {
-			/* The returned value is one of
-			 * SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT,
-			 * SQLITE_BLOB, or SQLITE_NULL */
-			switch (sqlite3_column_type(dbq->stmt, i)) {
-			case SQLITE_INTEGER: {
-				s64 v = sqlite3_column_int64(dbq->stmt, i);
-				json_add_s64(ret, NULL, v);
-				break;
-			}
-			case SQLITE_FLOAT: {
-				double v = sqlite3_column_double(dbq->stmt, i);
-				json_add_primitive_fmt(ret, NULL, "%f", v);
-				break;
-			}
-			case SQLITE_TEXT: {
-				const char *c = (char *)sqlite3_column_text(dbq->stmt, i);
-				if (!utf8_check(c, strlen(c))) {
-					json_add_str_fmt(ret, NULL,
-							 "INVALID UTF-8 STRING %s",
-							 tal_hexstr(tmpctx, c, strlen(c)));
-					errmsg = tal_fmt(cmd, "Invalid UTF-8 string row %zu column %zu",
-							 num_rows, i);
-				} else
-					json_add_string(ret, NULL, c);
-				break;
-			}
-			case SQLITE_BLOB:
-				json_add_hex(ret, NULL,
-					     sqlite3_column_blob(dbq->stmt, i),
-					     sqlite3_column_bytes(dbq->stmt, i));
-				break;
-			case SQLITE_NULL:
-				json_add_primitive(ret, NULL, "null");
-				break;
-			default:
-				errmsg = tal_fmt(cmd, "Unknown column type %i in row %zu column %zu",
-						 sqlite3_column_type(dbq->stmt, i),
-						 num_rows, i);
-			}
+static void output_rows_timer(struct db_query *dbq)
+{
+	/* This may free dbq! */
+	struct plugin *plugin = dbq->cmd->plugin;
+
+	output_rows(dbq->cmd, dbq);
+	timer_complete(plugin);
+}
+
+/* We're called from the io loop, so continue from a timer */
+static void output_drained(struct db_query *dbq)
+{
+	dbq->waiting_drain = false;
+	plugin_timer(dbq->cmd->plugin, time_from_sec(0),
+		     output_rows_timer, dbq);
+}
+
+/* Bytes we've output but lightningd hasn't read yet */
+static size_t output_pending(const struct json_stream *js)
+{
+	size_t len;
+
+	json_out_contents(js->jout, &len);
+	return len;
+}
+
+static struct command_result *output_rows(struct command *cmd,
+					  struct db_query *dbq)
+{
+	int err;
+	size_t n;
+
+	for (n = 0; n < ROWS_PER_CHUNK; n++) {
+		err = sqlite3_step(dbq->stmt);
+		if (err != SQLITE_ROW)
+			break;
+		if (!dbq->ret) {
+			dbq->ret = jsonrpc_stream_success(cmd);
+			json_array_start(dbq->ret, "rows");
 		}
-		json_array_end(ret);
-		num_rows++;
+		json_add_row(cmd, dbq->ret, dbq);
+	}
+
+	/* More to come?  Send what we have, and let lightningd catch up if
+	 * it's falling behind. */
+	if (err == SQLITE_ROW) {
+		if (!cmd->streaming)
+			command_stream_start(cmd, dbq->ret);
+		json_stream_flush(dbq->ret);
+		if (output_pending(dbq->ret) > MAX_PENDING_OUTPUT) {
+			dbq->waiting_drain = true;
+			json_stream_when_drained(dbq->ret, output_drained, dbq);
+		} else
+			plugin_timer(cmd->plugin, time_from_sec(0),
+				     output_rows_timer, dbq);
+		return command_still_pending(cmd);
 	}
+
 	if (err != SQLITE_DONE)
-		errmsg = tal_fmt(cmd, "Executing statement: %s",
-				 sqlite3_errmsg(db));
+		dbq->errmsg = tal_fmt(cmd, "Executing statement: %s",
+				      sqlite3_errmsg(db));
 
 	sqlite3_finalize(dbq->stmt);
-
+	dbq->stmt = NULL;
 
 	/* OK, did we hit some error during?  Simple if we didn't
 	 * already start answering! */
-	if (errmsg) {
-		if (!ret)
-			return command_fail(cmd, LIGHTNINGD, "%s", errmsg);
+	if (dbq->errmsg) {
+		if (!dbq->ret)
+			return command_fail(cmd, LIGHTNINGD, "%s", dbq->errmsg);
 
 		/* Otherwise, add it as a warning */
-		json_array_end(ret);
-		json_add_string(ret, "warning_db_failure", errmsg);
+		json_array_end(dbq->ret);
+		json_add_string(dbq->ret, "warning_db_failure", dbq->errmsg);
 	} else {
 		/* Empty result is possible, OK. */
-		if (!ret) {
-			ret = jsonrpc_stream_success(cmd);
-			json_array_start(ret, "rows");
+		if (!dbq->ret) {
+			dbq->ret = jsonrpc_stream_success(cmd);
+			json_array_start(dbq->ret, "rows");
 		}
-		json_array_end(ret);
+		json_array_end(dbq->ret);
 	}
-	return command_finished(cmd, ret);
+	return command_finished(cmd, dbq->ret);
+}
+
+static struct command_result *refresh_complete(struct command *cmd,
+					       struct db_query *dbq)
+{
+	/* We normally hit an error immediately, so return a simple error then */
+	dbq->ret = NULL;
+	dbq->num_rows = 0;
+	dbq->errmsg = NULL;
+
+	return output_rows(cmd, dbq);
 }
 
 /* Recursion */
@@ -425,7 +524,7 @@ static struct command_result *process_json_list(struct command *cmd,
 /* Process all subobject columns */
 static struct command_result *process_json_subobjs(struct command *cmd,
 						   const char *buf,
-						   const jsmntok_t *t,
+						   struct json_member_index *idx,
 						   const struct table_desc *td,
 						   u64 this_rowid)
 {
@@ -437,7 +536,7 @@ static struct command_result *process_json_subobjs(struct command *cmd,
 		if (!col->sub)
 			continue;
 
-		coltok = json_get_member(buf, t, col->jsonname);
+		coltok = json_member_index_get(idx, col->jsonname);
 		if (!coltok)
 			continue;
 
@@ -446,8 +545,10 @@ static struct command_result *process_json_subobjs(struct command *cmd,
 			ret = process_json_list(cmd, buf, coltok, &this_rowid,
 						col->sub);
 		} else {
-			ret = process_json_subobjs(cmd, buf, coltok, col->sub,
-						   this_rowid);
+			ret = process_json_subobjs(cmd, buf,
+						   json_member_index(tmpctx, buf,
+								     coltok),
+						   col->sub, this_rowid);
 		}
 		if (ret)
 			return ret;
@@ -466,6 +567,8 @@ static struct command_result *process_json_obj(struct command *cmd,
 					       size_t *sqloff,
 					       sqlite3_stmt *stmt)
 {
+	struct json_member_index *idx;
+	struct command_result *ret;
 	int err;
 
 	/* Subtables have row, arrindex as first two columns. */
@@ -474,18 +577,19 @@ static struct command_result *process_json_obj(struct command *cmd,
 		sqlite3_bind_int64(stmt, (*sqloff)++, row);
 	}
 
-	/* FIXME: This is O(n^2): hash td->columns and look up the other way. */
+	/* We look up every column, so index the members rather than walking
+	 * them for each one. */
+	idx = t ? json_member_index(tmpctx, buf, t) : NULL;
 	for (size_t i = 0; i < tal_count(td->columns); i++) {
 		const struct column *col = &td->columns[i];
 		const jsmntok_t *coltok;
 
 		if (col->sub) {
-			struct command_result *ret;
 			/* Handle sub-tables below: we need rowid! */
 			if (!col->sub->is_subobject)
 				continue;
 
-			coltok = json_get_member(buf, t, col->jsonname);
+			coltok = idx ? json_member_index_get(idx, col->jsonname) : NULL;
 			ret = process_json_obj(cmd, buf, coltok, col->sub, row, this_rowid,
 					       NULL, sqloff, stmt);
 			if (ret)
@@ -501,7 +605,7 @@ static struct command_result *process_json_obj(struct command *cmd,
 			if (!col->jsonname)
 				coltok = t;
 			else
-				coltok = json_get_member(buf, t, col->jsonname);
+				coltok = json_member_index_get(idx, col->jsonname);
 		}
 
 		if (!coltok) {
@@ -590,8 +694,10 @@ static struct command_result *process_json_obj(struct command *cmd,
 	}
 
 	/* Sub objects get folded into parent's SQL */
-	if (td->parent && td->is_subobject)
+	if (td->parent && td->is_subobject) {
+		tal_free(idx);
 		return NULL;
+	}
 
 	err = sqlite3_step(stmt);
 	if (err != SQLITE_DONE) {
@@ -602,15 +708,19 @@ static struct command_result *process_json_obj(struct command *cmd,
 				    sqlite3_errmsg(db));
 	}
 
-	return process_json_subobjs(cmd, buf, t, td, this_rowid);
+	ret = process_json_subobjs(cmd, buf, idx, td, this_rowid);
+	tal_free(idx);
+	return ret;
 }
 
 /* A list, such as in the top-level reply, or for a sub-table */
-static struct command_result *process_json_list(struct command *cmd,
-						const char *buf,
-						const jsmntok_t *arr,
-						const u64 *parent_rowid,
-						const struct table_desc *td)
+/* If @skip is non-NULL, entries with skip[i] set are ignored. */
+static struct command_result *process_json_list_skip(struct command *cmd,
+						     const char *buf,
+						     const jsmntok_t *arr,
+						     const u64 *parent_rowid,
+						     const struct table_desc *td,
+						     const bool *skip)
 {
 	size_t i;
 	const jsmntok_t *t;
@@ -628,7 +738,11 @@ static struct command_result *process_json_list(struct command *cmd,
 	json_for_each_arr(i, t, arr) {
 		/* sqlite3 columns are 1-based! */
 		size_t off = 1;
-		u64 this_rowid = next_rowid++;
+		u64 this_rowid;
+
+		if (skip && skip[i])
+			continue;
+		this_rowid = next_rowid++;
 
 		/* First entry is always the rowid */
 		sqlite3_bind_int64(stmt, off++, this_rowid);
@@ -641,6 +755,15 @@ static struct command_result *process_json_list(struct command *cmd,
 	return ret;
 }
 
+static struct command_result *process_json_list(struct command *cmd,
+						const char *buf,
+						const jsmntok_t *arr,
+						const u64 *parent_rowid,
+						const struct table_desc *td)
+{
+	return process_json_list_skip(cmd, buf, arr, parent_rowid, td, NULL);
+}
+
 /* Process top-level JSON result object */
 static struct command_result *process_json_result(struct command *cmd,
 						  const char *buf,
@@ -688,6 +811,200 @@ static struct command_result *default_refresh(struct command *cmd,
 	return send_outreq(cmd->plugin, req);
 }
 
+static struct command_result *indexed_fetch(struct command *cmd,
+					    const struct table_desc *td,
+					    struct db_query *dbq,
+					    const char *indexname,
+					    u64 start);
+
+/* Find the highest @indexname in the list of results */
+static u64 max_index(const char *buf, const jsmntok_t *arr,
+		     const char *indexname, u64 prev)
+{
+	size_t i;
+	const jsmntok_t *t;
+
+	json_for_each_arr(i, t, arr) {
+		const jsmntok_t *idxtok = json_get_member(buf, t, indexname);
+		u64 idx;
+
+		if (idxtok && json_to_u64(buf, idxtok, &idx) && idx > prev)
+			prev = idx;
+	}
+	return prev;
+}
+
+static void delete_created_index_from_db(struct command *cmd,
+					 const struct table_desc *td,
+					 u64 created_index)
+{
+	int err;
+	char *errmsg;
+
+	/* Subtables go with it, thanks to ON DELETE CASCADE */
+	err = sqlite3_exec(db,
+			   tal_fmt(tmpctx,
+				   "DELETE FROM %s WHERE created_index = %"PRIu64,
+				   td->name, created_index),
+			   NULL, NULL, &errmsg);
+	if (err != SQLITE_OK)
+		plugin_err(cmd->plugin, "Could not delete from %s: %s",
+			   td->name, errmsg);
+}
+
+static struct command_result *indexed_page_done(struct command *cmd,
+						const char *buf,
+						const jsmntok_t *result,
+						struct db_query *dbq)
+{
+	struct table_desc *td = dbq->tables[0];
+	const jsmntok_t *arr = json_get_member(buf, result, td->arrname);
+	const char *indexname = dbq->indexname;
+	struct command_result *ret;
+	bool *skip = NULL;
+	u64 *idx;
+
+	if (streq(indexname, "updated")) {
+		size_t i;
+		const jsmntok_t *t;
+
+		skip = tal_arrz(tmpctx, bool, arr->size);
+		/* Replace any old version of these. */
+		json_for_each_arr(i, t, arr) {
+			const jsmntok_t *ctok;
+			u64 created_index;
+
+			ctok = json_get_member(buf, t, "created_index");
+			if (!ctok || !json_to_u64(buf, ctok, &created_index))
+				return command_fail(cmd, LIGHTNINGD,
+						    "%s entry without created_index: %.*s",
+						    td->cmdname,
+						    json_tok_full_len(t),
+						    json_tok_full(buf, t));
+			/* Created since our "created" pass?  The next one
+			 * will get it: if we added it now, it'd add it
+			 * again. */
+			if (created_index > td->indexed->created_index) {
+				skip[i] = true;
+				continue;
+			}
+			delete_created_index_from_db(cmd, td, created_index);
+		}
+		idx = &td->indexed->updated_index;
+	} else
+		idx = &td->indexed->created_index;
+
+	ret = process_json_list_skip(cmd, buf, arr, NULL, td, skip);
+	if (ret)
+		return ret;
+
+	*idx = max_index(buf, arr, tal_fmt(tmpctx, "%s_index", indexname),
+			 *idx);
+
+	/* A full page means there may be more. */
+	if (arr->size == INDEXED_PAGE_SIZE)
+		return indexed_fetch(cmd, td, dbq, indexname, *idx + 1);
+
+	/* New ones first, then changed ones, then we're done. */
+	if (streq(indexname, "created"))
+		return indexed_fetch(cmd, td, dbq, "updated",
+				     td->indexed->updated_index + 1);
+
+	return one_refresh_done(cmd, dbq);
+}
+
+static struct command_result *indexed_fetch(struct command *cmd,
+					    const struct table_desc *td,
+					    struct db_query *dbq,
+					    const char *indexname,
+					    u64 start)
+{
+	struct out_req *req;
+
+	dbq->indexname = indexname;
+	req = jsonrpc_request_start(cmd->plugin, cmd, td->cmdname,
+				    indexed_page_done, forward_error,
+				    dbq);
+	json_add_string(req->js, "index", indexname);
+	json_add_u64(req->js, "start", start);
+	json_add_u32(req->js, "limit", INDEXED_PAGE_SIZE);
+	return send_outreq(cmd->plugin, req);
+}
+
+static struct command_result *indexed_wait_updated_done(struct command *cmd,
+							const char *buf,
+							const jsmntok_t *result,
+							struct db_query *dbq)
+{
+	struct table_desc *td = dbq->tables[0];
+	const char *err;
+
+	/* Everything updated before now will show up when we list by
+	 * created, so we only need to look at updates after this. */
+	err = json_scan(tmpctx, buf, result, "{updated:%}",
+			JSON_SCAN(json_to_u64, &td->indexed->updated_index));
+	if (err)
+		plugin_err(cmd->plugin, "Bad wait response: %s", err);
+
+	return indexed_fetch(cmd, td, dbq, "created", 1);
+}
+
+static struct command_result *indexed_wait_deleted_done(struct command *cmd,
+							const char *buf,
+							const jsmntok_t *result,
+							struct db_query *dbq)
+{
+	struct table_desc *td = dbq->tables[0];
+	struct out_req *req;
+	const char *err;
+	char *errmsg;
+	u64 deleted;
+
+	err = json_scan(tmpctx, buf, result, "{deleted:%}",
+			JSON_SCAN(json_to_u64, &deleted));
+	if (err)
+		plugin_err(cmd->plugin, "Bad wait response: %s", err);
+
+	/* Nothing deleted since last time?  Just get new and changed ones. */
+	if (deleted == td->indexed->deleted_index)
+		return indexed_fetch(cmd, td, dbq, "created",
+				     td->indexed->created_index + 1);
+
+	/* We can't tell what was deleted, so start again. */
+	if (sqlite3_exec(db, tal_fmt(tmpctx, "DELETE FROM %s;", td->name),
+			 NULL, NULL, &errmsg) != SQLITE_OK) {
+		return command_fail(cmd, LIGHTNINGD, "cleaning '%s' failed: %s",
+				    td->name, errmsg);
+	}
+	td->indexed->deleted_index = deleted;
+	td->indexed->created_index = 0;
+
+	req = jsonrpc_request_start(cmd->plugin, cmd, "wait",
+				    indexed_wait_updated_done, forward_error,
+				    dbq);
+	json_add_string(req->js, "subsystem", td->indexed->subsystem);
+	json_add_string(req->js, "indexname", "updated");
+	json_add_u64(req->js, "nextvalue", 0);
+	return send_outreq(cmd->plugin, req);
+}
+
+/* We ask for the deleted index first: if anything was deleted, we
+ * need to start afresh. */
+static struct command_result *indexed_refresh(struct command *cmd,
+					      const struct table_desc *td,
+					      struct db_query *dbq)
+{
+	struct out_req *req;
+
+	req = jsonrpc_request_start(cmd->plugin, cmd, "wait",
+				    indexed_wait_deleted_done, forward_error,
+				    dbq);
+	json_add_string(req->js, "subsystem", td->indexed->subsystem);
+	json_add_string(req->js, "indexname", "deleted");
+	json_add_u64(req->js, "nextvalue", 0);
+	return send_outreq(cmd->plugin, req);
+}
+
 static bool extract_scid(int gosstore_fd, size_t off, u16 type,
 			 struct short_channel_id *scid)
 {
@@ -979,6 +1296,50 @@ static struct command_result *refresh_tables(struct command *cmd,
 	return td->refresh(cmd, dbq->tables[0], dbq);
 }
 
+static void start_next_query(struct plugin *plugin)
+{
+	struct db_query *dbq;
+
+	dbq = waiting_queries[0];
+	tal_arr_remove(&waiting_queries, 0);
+	current_query = dbq;
+	refresh_tables(dbq->cmd, dbq);
+	timer_complete(plugin);
+}
+
+static void destroy_db_query(struct db_query *dbq)
+{
+	/* If we failed part way, this is still live */
+	if (dbq->stmt)
+		sqlite3_finalize(dbq->stmt);
+
+	/* Once streaming, libplugin owns the response, so it's still here */
+	if (dbq->waiting_drain)
+		json_stream_when_drained(dbq->ret, NULL, NULL);
+
+	current_query = NULL;
+	if (tal_count(waiting_queries) != 0)
+		plugin_timer(dbq->cmd->plugin, time_from_sec(0),
+			     start_next_query, dbq->cmd->plugin);
+}
+
+/* We run one query at a time: two refreshing the same table would
+ * trip over each other, and while sending results in chunks the
+ * statement is still live, so we can't touch the tables.  Running the
+ * next one alongside wouldn't get its answer out sooner anyway: a
+ * streaming response holds our output to lightningd until it's done. */
+static struct command_result *start_query(struct command *cmd,
+					  struct db_query *dbq)
+{
+	tal_add_destructor(dbq, destroy_db_query);
+	if (current_query) {
+		tal_arr_expand(&waiting_queries, dbq);
+		return command_still_pending(cmd);
+	}
+	current_query = dbq;
+	return refresh_tables(cmd, dbq);
+}
+
 static struct command_result *json_sql(struct command *cmd,
 				       const char *buffer,
 				       const jsmntok_t *params)
@@ -992,8 +1353,10 @@ static struct command_result *json_sql(struct command *cmd,
 		   NULL))
 		return command_param_failed();
 
+	dbq->cmd = cmd;
 	dbq->tables = tal_arr(dbq, struct table_desc *, 0);
 	dbq->authfail = NULL;
+	dbq->waiting_drain = false;
 
 	/* This both checks we're not altering, *and* tells us what
 	 * tables to refresh. */
@@ -1013,7 +1376,7 @@ static struct command_result *json_sql(struct command *cmd,
 		return command_fail(cmd, LIGHTNINGD, "%s", errmsg);
 	}
 
-	return refresh_tables(cmd, dbq);
+	return start_query(cmd, dbq);
 }
 
 static bool ignore_column(const struct table_desc *td, const jsmntok_t *t)
@@ -1279,6 +1642,7 @@ static struct table_desc *new_table_desc(struct table_desc *parent,
 	td->is_subobject = is_subobject;
 	td->arrname = json_strdup(td, schemas, arrname);
 	td->columns = tal_arr(td, struct column, 0);
+	td->indexed = NULL;
 	if (streq(td->name, "channels"))
 		td->refresh = channels_refresh;
 	else if (streq(td->name, "nodes"))
@@ -1286,6 +1650,18 @@ static struct table_desc *new_table_desc(struct table_desc *parent,
 	else
 		td->refresh = default_refresh;
 
+	for (size_t i = 0; i < ARRAY_SIZE(indexed_tables); i++) {
+		if (parent || !streq(td->name, indexed_tables[i].tablename))
+			continue;
+		td->indexed = tal(td, struct indexed_state);
+		td->indexed->subsystem = indexed_tables[i].subsystem;
+		td->indexed->created_index = 0;
+		td->indexed->updated_index = 0;
+		/* Never matches, so first refresh starts from scratch */
+		td->indexed->deleted_index = -1ULL;
+		td->refresh = indexed_refresh;
+	}
+
 	/* sub-objects are a JSON thing, not a real table! */
 	if (!td->is_subobject)
 		strmap_add(&tablemap, td->name, td);
@@ -1477,6 +1853,21 @@ static void init_indices(struct plugin *plugin)
 		if (err != SQLITE_OK)
 			plugin_err(plugin, "Failed '%s': %s", cmd, errmsg);
 	}
+
+	/* indexed_refresh replaces entries by created_index */
+	for (size_t i = 0; i < ARRAY_SIZE(indexed_tables); i++) {
+		char *errmsg, *cmd;
+		int err;
+
+		cmd = tal_fmt(tmpctx,
+			      "CREATE INDEX %s_created_index_idx"
+			      " ON %s (created_index);",
+			      indexed_tables[i].tablename,
+			      indexed_tables[i].tablename);
+		err = sqlite3_exec(db, cmd, NULL, NULL, &errmsg);
+		if (err != SQLITE_OK)
+			plugin_err(plugin, "Failed '%s': %s", cmd, errmsg);
+	}
 }
 
 #if DEVELOPER
@@ -1491,6 +1882,7 @@ static const char *init(struct plugin *plugin,
 			const char *buf UNUSED, const jsmntok_t *config UNUSED)
 {
 	db = sqlite_setup(plugin);
+	waiting_queries = tal_arr(plugin, struct db_query *, 0);
 	init_tablemap(plugin);
 	init_indices(plugin);
 
@@ -28,6 +28,22 @@ static struct gossmap *get_gossmap(void)
 	return global_gossmap;
 }
 
+/* How many landmarks to guide getroute with. */
+#define GETROUTE_LANDMARKS 8
+
+/* Rebuilt on demand whenever the gossmap changes. */
+static struct dijkstra_landmarks *landmarks;
+
+static const struct dijkstra_landmarks *get_landmarks(struct gossmap *gossmap)
+{
+	if (!landmarks || !dijkstra_landmarks_valid(landmarks, gossmap)) {
+		tal_free(landmarks);
+		landmarks = dijkstra_landmarks_new(gossmap, gossmap,
+						   GETROUTE_LANDMARKS);
+	}
+	return landmarks;
+}
+
 /* Convenience global since route_score_fuzz doesn't take args. 0 to 1. */
 static double fuzz;
 
@@ -122,7 +138,9 @@ static struct command_result *json_getroute(struct command *cmd,
 	u64 *riskfactor_millionths, *fuzz_millionths;
 	struct route_exclusion **excluded;
 	u32 *max_hops;
+	bool *guided;
 	const struct dijkstra *dij;
+	const struct dijkstra_landmarks *lm;
 	struct route_hop *route;
 	struct gossmap_node *src, *dst;
 	struct json_stream *js;
@@ -138,6 +156,7 @@ static struct command_result *json_getroute(struct command *cmd,
 			     5000000),
 		   p_opt("exclude", param_route_exclusion_array, &excluded),
 		   p_opt_def("maxhops", param_number, &max_hops, ROUTING_MAX_HOPS),
+		   p_opt_def("guided", param_bool, &guided, false),
 		   NULL))
 		return command_param_failed();
 
@@ -161,10 +180,12 @@ static struct command_result *json_getroute(struct command *cmd,
 				    "%s: unknown destination node_id (no public channels?)",
 				    type_to_string(tmpctx, struct node_id, destination));
 
+	/* We only need the path from src, so we stop once we have it. */
 	fuzz = 0;
-	dij = dijkstra(tmpctx, gossmap, dst, *msat,
-		       *riskfactor_millionths / 1000000.0,
-		       can_carry, route_score_fuzz, excluded);
+	dij = dijkstra_to(tmpctx, gossmap, dst, src, *msat,
+			  *riskfactor_millionths / 1000000.0,
+			  can_carry, route_score_fuzz,
+			  NULL, NULL, excluded);
 	route = route_from_dijkstra(dij, gossmap, dij, src, *msat, *cltv);
 	if (!route)
 		return command_fail(cmd, PAY_ROUTE_NOT_FOUND, "Could not find a route");
@@ -173,9 +194,15 @@ static struct command_result *json_getroute(struct command *cmd,
 	if (tal_count(route) > *max_hops) {
 		plugin_notify_message(cmd, LOG_INFORM, "Cheapest route %zu hops: seeking shorter (no fuzz)",
 				      tal_count(route));
-		dij = dijkstra(tmpctx, gossmap, dst, *msat,
-			       *riskfactor_millionths / 1000000.0,
-			       can_carry, route_score_shorter, excluded);
+		/* Hops dominate this score, so the landmarks' hop counts
+		 * are a real lower bound and can steer us towards src.  Fees
+		 * have no such bound, so the cheapest search is never
+		 * guided. */
+		lm = *guided ? get_landmarks(gossmap) : NULL;
+		dij = dijkstra_to(tmpctx, gossmap, dst, src, *msat,
+				  *riskfactor_millionths / 1000000.0,
+				  can_carry, route_score_shorter,
+				  lm, route_bound_shorter, excluded);
 		route = route_from_dijkstra(dij, gossmap, dij, src, *msat, *cltv);
 		if (tal_count(route) > *max_hops)
 			return command_fail(cmd, PAY_ROUTE_NOT_FOUND, "Shortest route was %zu",
@@ -646,7 +673,8 @@ static const struct plugin_command commands[] = {
 		"Randomize the route with up to {fuzzpercent} (default 5.0). "
 		"{exclude} an array of short-channel-id/direction (e.g. [ '564334x877x1/0', '564195x1292x0/1' ]) "
 		"or node-id from consideration. "
-		"Set the {maxhops} the route can take (default 20).",
+		"Set the {maxhops} the route can take (default 20). "
+		"If {guided}, aim the shortest-route fallback at {fromid} using precomputed landmarks.",
 		json_getroute,
 	},
 	{
@@ -82,6 +82,46 @@ def test_long_forward_payment(node_factory, benchmark):
     benchmark(do_pay, nodes[0], nodes[-1])
 
 
+@pytest.mark.parametrize("backup", [None, "sync", "async"])
+def test_pay_db_backup(node_factory, benchmark, backup):
+    """Payment (i.e. HTLC commitment) latency with a sqlite3 backup db"""
+    opts = {}
+    if backup is not None:
+        # We need to know the db path, which needs the node.
+        opts['start'] = False
+    l1, l2 = node_factory.get_nodes(2, opts=[opts, {}])
+
+    if backup is not None:
+        l1.daemon.opts['wallet'] = "sqlite3://{0}:{0}.bak".format(l1.db.path)
+        if backup == "async":
+            l1.daemon.opts['wallet-backup-async'] = None
+        l1.start()
+
+    node_factory.join_nodes([l1, l2])
+
+    def do_pay(src, dest):
+        invoice = dest.rpc.invoice(1000, 'invoice-{}'.format(random.random()), 'desc')['bolt11']
+        src.rpc.pay(invoice)
+
+    benchmark(do_pay, l1, l2)
+
+
+@pytest.mark.parametrize("num_invoices", [1000, 10000])
+def test_sql_invoices(node_factory, benchmark, num_invoices):
+    """Repeated sql queries over a large invoices table"""
+    l1 = node_factory.get_node()
+
+    for i in tqdm(range(num_invoices)):
+        l1.rpc.invoice(1000, 'invoice-{}'.format(i), 'desc')
+
+    def do_query():
+        # One new invoice each time, so there's always something to refresh.
+        l1.rpc.invoice(1000, 'invoice-{}'.format(random.random()), 'desc')
+        l1.rpc.sql("SELECT COUNT(*) FROM invoices WHERE status = 'unpaid'")
+
+    benchmark(do_query)
+
+
 def test_invoice(node_factory, benchmark):
     l1 = node_factory.get_node()
 
@@ -4490,3 +4490,26 @@ def test_reconnect_no_additional_transient_failure(node_factory, bitcoind):
 
     # We should not see a "Peer transient failure" after restart of l1
     assert not l1.daemon.is_in_log(f"{l2id}-chan#1: Peer transient failure in CHANNELD_NORMAL: Disconnected", start=offset1)
+
+
+@pytest.mark.developer("needs dev-peer-writes")
+def test_peer_writes_coalesced(node_factory, bitcoind):
+    """connectd should pack queued messages (e.g. gossip) into fewer writes"""
+    l1, l2, l3 = node_factory.line_graph(3, wait_for_announce=True)
+    l4 = node_factory.get_node()
+
+    # l4 asks for all gossip, so l2 streams it in one burst.
+    l4.rpc.connect(l2.info['id'], 'localhost', l2.port)
+    wait_for(lambda: len(l4.rpc.listchannels()['channels']) == 4)
+
+    counts = l2.rpc.call('dev-peer-writes', [l4.info['id']])
+    assert 0 < counts['writes'] < counts['messages']
+
+    # A lone message still gets written.
+    l2.rpc.ping(l4.info['id'])
+    assert l2.rpc.call('dev-peer-writes', [l4.info['id']])['writes'] > counts['writes']
+
+    l4.rpc.disconnect(l2.info['id'])
+    wait_for(lambda: not l2.rpc.listpeers(l4.info['id'])['peers'])
+    with pytest.raises(RpcError, match='Peer not connected'):
+        l2.rpc.call('dev-peer-writes', [l4.info['id']])
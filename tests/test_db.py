@@ -328,6 +328,21 @@ def test_optimistic_locking(node_factory, bitcoind):
     assert(l1.daemon.is_in_log(r'Optimistic lock on the database failed'))
 
 
+@unittest.skipIf(not DEVELOPER, "needs dev-dbstats")
+def test_db_stmt_cache(node_factory, bitcoind):
+    """Repeated queries should be served from the prepared statement cache"""
+    l1 = node_factory.get_node()
+
+    before = l1.rpc.dev_dbstats()
+    for _ in range(10):
+        l1.rpc.listfunds()
+    after = l1.rpc.dev_dbstats()
+
+    assert after['stmt_cache_hits'] > before['stmt_cache_hits']
+    # Nothing new to prepare: we've run these queries before.
+    assert after['stmt_cache_misses'] - before['stmt_cache_misses'] <= 1
+
+
 @unittest.skipIf(os.environ.get('TEST_DB_PROVIDER', None) != 'postgres', "Only applicable to postgres")
 def test_psql_key_value_dsn(node_factory, db_provider, monkeypatch):
     from pyln.testing.db import PostgresDb
@@ -440,6 +455,32 @@ def test_sqlite3_builtin_backup(bitcoind, node_factory):
     assert(len(l1.rpc.listfunds()['outputs']) == 1)
 
 
+@unittest.skipIf(os.getenv('TEST_DB_PROVIDER', 'sqlite3') != 'sqlite3', "Tests a feature unique to SQLITE3 backend")
+def test_sqlite3_builtin_backup_async(bitcoind, node_factory):
+    l1 = node_factory.get_node(start=False)
+
+    main_db_file = l1.db.path
+    backup_db_file = main_db_file + ".bak"
+
+    l1.daemon.opts['wallet'] = "sqlite3://" + main_db_file + ':' + backup_db_file
+    l1.daemon.opts['wallet-backup-async'] = None
+    l1.start()
+
+    addr = l1.rpc.newaddr()['bech32']
+    bitcoind.rpc.sendtoaddress(addr, 1)
+    bitcoind.generate_block(1)
+    wait_for(lambda: len(l1.rpc.listfunds()['outputs']) == 1)
+
+    # Clean shutdown writes out everything still queued.
+    l1.stop()
+    shutil.copyfile(backup_db_file, main_db_file)
+
+    del l1.daemon.opts['wallet']
+    del l1.daemon.opts['wallet-backup-async']
+    l1.start()
+    assert(len(l1.rpc.listfunds()['outputs']) == 1)
+
+
 @unittest.skipIf(os.getenv('TEST_DB_PROVIDER', 'sqlite3') != 'sqlite3', "Don't know how to swap dbs in Postgres")
 def test_db_sanity_checks(bitcoind, node_factory):
     l1, l2 = node_factory.get_nodes(2, opts=[{'allow_broken_log': True,
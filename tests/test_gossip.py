@@ -1484,6 +1484,23 @@ def test_getroute_exclude_duplicate(node_factory):
     assert route == route3
 
 
+def test_getroute_guided(node_factory):
+    """A guided search should find the same routes, and honor exclude"""
+    l1, l2, l3, l4 = node_factory.line_graph(4, wait_for_announce=True)
+
+    for dst in (l2, l3, l4):
+        route = l1.rpc.getroute(dst.info['id'], 1000, 1)['route']
+        assert l1.rpc.getroute(dst.info['id'], 1000, 1, guided=True)['route'] == route
+
+    # Also when searching from elsewhere.
+    route = l1.rpc.getroute(l1.info['id'], 1000, 1, fromid=l4.info['id'])['route']
+    assert l1.rpc.getroute(l1.info['id'], 1000, 1, fromid=l4.info['id'],
+                           guided=True)['route'] == route
+
+    with pytest.raises(RpcError):
+        l1.rpc.getroute(l4.info['id'], 1000, 1, exclude=[l3.info['id']], guided=True)
+
+
 @pytest.mark.developer("gossip propagation is slow without DEVELOPER=1")
 def test_getroute_exclude(node_factory, bitcoind):
     """Test getroute's exclude argument"""
@@ -2383,3 +2400,18 @@ def test_dump_own_gossip(node_factory):
 
     # We should get exactly what we expected.
     assert expect == []
+
+
+def test_gossmap_index(node_factory, bitcoind):
+    """gossipd leaves an index of the gossip_store for plugins to start from"""
+    l1, l2, l3 = node_factory.line_graph(3, wait_for_announce=True)
+    wait_for(lambda: len(l1.rpc.listchannels()['channels']) == 4)
+
+    l1.restart()
+    l1.daemon.wait_for_log('gossipd: Wrote gossmap index')
+    assert os.path.exists(os.path.join(l1.daemon.lightning_dir, TEST_NETWORK, 'gossip_store.idx'))
+
+    # Plugins loaded from it, and see the same thing.
+    assert len(l1.rpc.listchannels()['channels']) == 4
+    route = l1.rpc.getroute(l3.info['id'], 1000, 1)['route']
+    assert [r['id'] for r in route] == [l2.info['id'], l3.info['id']]
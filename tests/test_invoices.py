@@ -913,6 +913,20 @@ def test_listinvoices_index(node_factory, executor):
         assert only_one(l2.rpc.listinvoices(index='updated', start=i, limit=1)['invoices'])['label'] == str(70 + 1 - i)
 
 
+def test_listinvoices_chunked(node_factory):
+    """listinvoices writes 1000 at a time, then comes back for more"""
+    l1 = node_factory.get_node()
+
+    for i in range(1, 2501):
+        l1.rpc.invoice(i, str(i), "test_listinvoices_chunked")
+
+    labels = [str(i) for i in range(1, 2501)]
+    assert [inv['label'] for inv in l1.rpc.listinvoices()['invoices']] == labels
+    assert [inv['label'] for inv in l1.rpc.listinvoices(index='created', start=500)['invoices']] == labels[499:]
+    assert [inv['label'] for inv in l1.rpc.listinvoices(index='created', start=2, limit=1500)['invoices']] == labels[1:1501]
+    assert [inv['label'] for inv in l1.rpc.listinvoices(index='created', start=1, limit=1000)['invoices']] == labels[:1000]
+
+
 def test_expiry_startup_crash(node_factory, bitcoind):
     """We crash trying to expire invoice on startup"""
     l1 = node_factory.get_node()
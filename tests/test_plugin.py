@@ -14,6 +14,7 @@ from utils import (
 
 import ast
 import base64
+import flask
 import json
 import os
 import pytest
@@ -1822,6 +1823,78 @@ def test_bcli(node_factory, bitcoind, chainparams):
     assert not resp["success"] and "decode failed" in resp["errmsg"]
 
 
+def test_bcli_http(node_factory, bitcoind, chainparams):
+    """
+    Same as test_bcli, but with bcli talking JSON-RPC over HTTP itself
+    (to our test proxy), rather than running bitcoin-cli.
+    """
+    l1, l2 = node_factory.get_nodes(2, opts={'bitcoin-rpcclient': 'http'})
+    assert l1.daemon.is_in_log("bitcoin-cli initialized and connected to"
+                               " bitcoind")
+
+    estimates = l1.rpc.call("estimatefees")
+    assert 'feerate_floor' in estimates
+    assert [f['blocks'] for f in estimates['feerates']] == [2, 6, 12, 100]
+
+    resp = l1.rpc.call("getchaininfo", {"last_height": 0})
+    assert resp["chain"] == chainparams['name']
+
+    resp = l1.rpc.call("getrawblockbyheight", {"height": 500})
+    assert resp["blockhash"] is resp["block"] is None
+    resp = l1.rpc.call("getrawblockbyheight", {"height": 50})
+    assert resp["blockhash"] == bitcoind.rpc.getblockhash(50)
+    assert resp["block"] == bitcoind.rpc.getblock(resp["blockhash"], 0)
+
+    l1.fundwallet(10**5)
+    l1.connect(l2)
+    fc = l1.rpc.fundchannel(l2.info["id"], 10**4 * 3)
+    txo = l1.rpc.call("getutxout", {"txid": fc['txid'], "vout": fc['outnum']})
+    assert (Millisatoshi(txo["amount"]) == Millisatoshi(10**4 * 3 * 10**3)
+            and txo["script"].startswith("0020"))
+    l1.rpc.close(l2.info["id"])
+    wait_for(lambda: l1.rpc.call("getutxout", {
+        "txid": fc['txid'],
+        "vout": fc['outnum']
+    })['amount'] is None)
+
+    resp = l1.rpc.call("sendrawtransaction", {"tx": "dummy", "allowhighfees": False})
+    assert not resp["success"] and "decode failed" in resp["errmsg"]
+
+    # Errors from bitcoind are retried, just like bitcoin-cli failures.
+    l1.daemon.rpcproxy.mock_rpc('getblockhash', lambda r: {
+        "id": r['id'], "error": {"code": -1, "message": "oops"}, "result": None})
+    bitcoind.generate_block(1)
+    l1.daemon.wait_for_log(r'getblockhash.*exited with status 1')
+    l1.daemon.rpcproxy.mock_rpc('getblockhash', None)
+    sync_blockheight(bitcoind, [l1])
+
+
+def test_bcli_http_keepalive(node_factory, bitcoind):
+    """bcli's http client should keep reusing its connections to bitcoind"""
+    l1 = node_factory.get_node(options={'bitcoin-rpcclient': 'http'})
+    requests = []
+
+    def getblockhash(r):
+        # Each connection comes from its own port.
+        requests.append((flask.request.environ['REMOTE_PORT'],
+                         flask.request.headers['Host']))
+        return {"id": r['id'], "error": None,
+                "result": bitcoind.rpc.getblockhash(*r['params'])}
+
+    l1.daemon.rpcproxy.mock_rpc('getblockhash', getblockhash)
+    for height in range(1, 11):
+        resp = l1.rpc.call("getrawblockbyheight", {"height": height})
+        assert resp["blockhash"] == bitcoind.rpc.getblockhash(height)
+    l1.daemon.rpcproxy.mock_rpc('getblockhash', None)
+
+    # Background polling may borrow a connection or two, but we must not
+    # be connecting for every request.
+    assert len(requests) >= 10
+    assert len(set(port for port, _ in requests)) <= 3
+    assert (set(host for _, host in requests)
+            == set(['127.0.0.1:{}'.format(l1.daemon.rpcproxy.rpcport)]))
+
+
 def test_hook_crash(node_factory, executor, bitcoind):
     """Verify that we fail over if a plugin crashes while handling a hook.
 
@@ -3288,6 +3361,39 @@ def test_autoclean(node_factory):
     assert l2.rpc.getinfo()['fees_collected_msat'] == amt_before
 
 
+def test_autoclean_invoices_paged(node_factory):
+    """autoclean pages through invoices, and remembers where it got to"""
+    l1 = node_factory.get_node()
+
+    # More than one page (1000) of invoices.
+    for i in range(1100):
+        l1.rpc.invoice(amount_msat=1000, label='inv{}'.format(i),
+                       description='paged', expiry=1)
+    keep = l1.rpc.invoice(amount_msat=1000, label='keep', description='keep')
+    wait_for(lambda: only_one(l1.rpc.listinvoices('inv1099')['invoices'])['status'] == 'expired')
+
+    l1.rpc.setconfig('autoclean-expiredinvoices-age', 1)
+    l1.rpc.setconfig('autoclean-cycle', 5)
+    wait_for(lambda: [i['label'] for i in l1.rpc.listinvoices()['invoices']] == ['keep'])
+    assert l1.rpc.autoclean_status()['autoclean']['expiredinvoices']['cleaned'] == 1100
+
+    # It will start at the unpaid one next time.
+    wait_for(lambda: l1.rpc.listdatastore(['autoclean', 'invoices', 'start'])['datastore'] != [])
+    start = only_one(l1.rpc.listdatastore(['autoclean', 'invoices', 'start'])['datastore'])['string']
+    assert int(start) == keep['created_index']
+
+    # Bulk delete only touches the given range and status.
+    l1.rpc.setconfig('autoclean-expiredinvoices-age', 0)
+    l1.rpc.invoice(amount_msat=1000, label='exp1', description='exp1', expiry=1)
+    inv = l1.rpc.invoice(amount_msat=1000, label='exp2', description='exp2', expiry=1)
+    wait_for(lambda: only_one(l1.rpc.listinvoices('exp2')['invoices'])['status'] == 'expired')
+    with pytest.raises(RpcError, match='Can only delete paid or expired invoices'):
+        l1.rpc.delinvoicerange('unpaid', 0)
+    assert l1.rpc.delinvoicerange('paid', 2**32)['deleted'] == 0
+    assert l1.rpc.delinvoicerange('expired', 2**32, inv['created_index'], inv['created_index'])['deleted'] == 1
+    assert [i['label'] for i in l1.rpc.listinvoices()['invoices']] == ['keep', 'exp1']
+
+
 def test_autoclean_timer_crash(node_factory):
     """Running two autocleans at once crashed timer code"""
     node_factory.get_node(options={'autoclean-cycle': 1,
@@ -4172,6 +4278,44 @@ def test_sql(node_factory, bitcoind):
     wait_for(lambda: l3.rpc.sql("SELECT * FROM nodes WHERE alias = '{}'".format(alias))['rows'] != [])
 
 
+def test_sql_invoices_incremental(node_factory):
+    l1, l2 = node_factory.line_graph(2)
+
+    def sql_invoices():
+        return l2.rpc.sql("SELECT label, status FROM invoices ORDER BY created_index")['rows']
+
+    assert sql_invoices() == []
+
+    inv1 = l2.rpc.invoice(1000, 'inv1', 'desc')
+    l2.rpc.invoice(1000, 'inv2', 'desc')
+    assert sql_invoices() == [['inv1', 'unpaid'], ['inv2', 'unpaid']]
+
+    # Updates replace the old row.
+    l1.rpc.pay(inv1['bolt11'])
+    l2.rpc.invoice(1000, 'inv3', 'desc')
+    assert sql_invoices() == [['inv1', 'paid'], ['inv2', 'unpaid'], ['inv3', 'unpaid']]
+    # Each invoice only appears once.
+    assert l2.rpc.sql("SELECT COUNT(DISTINCT created_index) = COUNT(*) FROM invoices")['rows'] == [[1]]
+
+    # Deletion means we start again.
+    l2.rpc.delinvoice('inv2', 'unpaid')
+    assert sql_invoices() == [['inv1', 'paid'], ['inv3', 'unpaid']]
+    assert l2.rpc.sql("SELECT COUNT(*) FROM invoices")['rows'] == [[2]]
+
+
+def test_sql_large_result(node_factory, executor):
+    """Results bigger than a chunk get streamed, and other queries wait"""
+    l1 = node_factory.get_node()
+
+    num = 2500
+    for i in range(num):
+        l1.rpc.invoice(1000, 'inv{:05}'.format(i), 'desc')
+
+    fut = executor.submit(l1.rpc.sql, "SELECT label FROM invoices ORDER BY label")
+    assert l1.rpc.sql("SELECT COUNT(*) FROM invoices")['rows'] == [[num]]
+    assert fut.result(TIMEOUT)['rows'] == [['inv{:05}'.format(i)] for i in range(num)]
+
+
 def test_sql_deprecated(node_factory, bitcoind):
     # deprecated-apis breaks schemas...
     l1 = node_factory.get_node(start=False, options={'allow-deprecated-apis': True})
@@ -1,4 +1,5 @@
 from fixtures import *  # noqa: F401,F403
+from utils import only_one, first_scid
 import os
 import pytest
 import unittest
@@ -33,3 +34,44 @@ def test_splice(node_factory, bitcoind):
 
     inv = l2.rpc.invoice(10**2, '3', 'no_3')
     l1.rpc.pay(inv['bolt11'])
+
+
+@unittest.skipIf(os.environ.get("EXPERIMENTAL_SPLICING", '0') != '1', "Need experimental splicing turned on")
+@pytest.mark.openchannel('v2')
+def test_splice_forward(node_factory, bitcoind):
+    l1, l2, l3 = node_factory.line_graph(3, fundamount=1000000, wait_for_announce=True)
+
+    chan_id = l2.get_channel_id(l3)
+    old_scid = only_one(l2.rpc.listpeerchannels(l3.info['id'])['channels'])['short_channel_id']
+
+    # add extra sats to pay fee
+    funds_result = l2.rpc.fundpsbt("109000sat", "slow", 166, excess_as_change=True)
+
+    result = l2.rpc.splice_init(chan_id, 100000, funds_result['psbt'])
+    result = l2.rpc.splice_update(chan_id, result['psbt'])
+    result = l2.rpc.signpsbt(result['psbt'])
+    result = l2.rpc.splice_signed(chan_id, result['signed_psbt'])
+
+    bitcoind.generate_block(6, wait_for_mempool=1)
+
+    l2.daemon.wait_for_log(r'CHANNELD_AWAITING_SPLICE to CHANNELD_NORMAL')
+    l3.daemon.wait_for_log(r'CHANNELD_AWAITING_SPLICE to CHANNELD_NORMAL')
+
+    new_scid = only_one(l2.rpc.listpeerchannels(l3.info['id'])['channels'])['short_channel_id']
+    assert new_scid != old_scid
+
+    # l2 has to find the channel by its new scid to forward this.
+    amt = 100000
+    fee = amt * 10 // 1000000 + 1
+    route = [{'amount_msat': amt + fee,
+              'id': l2.info['id'],
+              'delay': 12,
+              'channel': first_scid(l1, l2)},
+             {'amount_msat': amt,
+              'id': l3.info['id'],
+              'delay': 6,
+              'channel': new_scid}]
+
+    inv = l3.rpc.invoice(amt, 'splice_forward', 'desc')
+    l1.rpc.sendpay(route, inv['payment_hash'], payment_secret=inv['payment_secret'])
+    l1.rpc.waitsendpay(inv['payment_hash'])
@@ -1012,6 +1012,9 @@ static bool db_migrate(struct lightningd *ld, struct db *db,
 
 	while (current < available) {
 		current++;
+		/* postgres won't re-plan a statement we cached before the
+		 * last step changed the schema under it. */
+		db_stmt_cache_flush(db);
 		if (dbmigrations[current].sql) {
 			stmt = db_prepare_v2(db, dbmigrations[current].sql);
 			db_exec_prepared_v2(stmt);
@@ -1055,7 +1058,8 @@ static void db_error(struct lightningd *ld, bool fatal, const char *fmt, va_list
 struct db *db_setup(const tal_t *ctx, struct lightningd *ld,
 		    const struct ext_key *bip32_base)
 {
-	struct db *db = db_open(ctx, ld->wallet_dsn, db_error, ld);
+	struct db *db = db_open(ctx, ld->wallet_dsn, ld->wallet_backup_async,
+				db_error, ld);
 	bool migrated;
 
 	db->report_changes_fn = plugin_hook_db_sync;
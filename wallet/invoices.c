@@ -467,6 +467,55 @@ void invoices_delete_expired(struct invoices *invoices,
 	}
 }
 
+u64 invoices_delete_range(struct invoices *invoices,
+			  enum invoice_status status,
+			  u64 max_time,
+			  u64 start, u64 end)
+{
+	struct db_stmt *stmt;
+	u64 *ids = tal_arr(tmpctx, u64, 0);
+	u64 num_deleted = 0;
+
+	/* "id" is the created_index, so this is a simple range scan. */
+	if (status == PAID) {
+		stmt = db_prepare_v2(invoices->wallet->db,
+				     SQL("SELECT id"
+					 "  FROM invoices"
+					 " WHERE id >= ? AND id <= ?"
+					 "   AND state = ?"
+					 "   AND paid_timestamp <= ?"
+					 " ORDER BY id;"));
+	} else {
+		assert(status == EXPIRED);
+		stmt = db_prepare_v2(invoices->wallet->db,
+				     SQL("SELECT id"
+					 "  FROM invoices"
+					 " WHERE id >= ? AND id <= ?"
+					 "   AND state = ?"
+					 "   AND expiry_time <= ?"
+					 " ORDER BY id;"));
+	}
+	db_bind_u64(stmt, start);
+	db_bind_u64(stmt, end);
+	db_bind_int(stmt, status);
+	db_bind_u64(stmt, max_time);
+	db_query_prepared(stmt);
+
+	while (db_step(stmt))
+		tal_arr_expand(&ids, db_col_u64(stmt, "id"));
+	tal_free(stmt);
+
+	for (size_t i = 0; i < tal_count(ids); i++) {
+		const struct invoice_details *details;
+
+		details = invoices_get_details(tmpctx, invoices, ids[i]);
+		if (invoices_delete(invoices, ids[i], details->state,
+				    details->label, details->invstring))
+			num_deleted++;
+	}
+	return num_deleted;
+}
+
 struct db_stmt *invoices_first(struct invoices *invoices,
 			       const enum wait_index *listindex,
 			       u64 liststart,
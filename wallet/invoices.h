@@ -142,6 +142,22 @@ bool invoices_delete_description(struct invoices *invoices,
 void invoices_delete_expired(struct invoices *invoices,
 			     u64 max_expiry_time);
 
+/**
+ * invoices_delete_range - Delete old paid or expired invoices by created_index
+ *
+ * @invoices - the invoice handler.
+ * @status - PAID or EXPIRED.
+ * @max_time - only delete if paid (PAID) or expired (EXPIRED) by this time.
+ * @start - the first created_index to consider.
+ * @end - the last created_index to consider.
+ *
+ * Returns the number of invoices deleted.
+ */
+u64 invoices_delete_range(struct invoices *invoices,
+			  enum invoice_status status,
+			  u64 max_time,
+			  u64 start, u64 end);
+
 /**
  * Iterate through all the invoices.
  * @invoices: the invoices
@@ -29,10 +29,14 @@ void bip32_pubkey(struct lightningd *ld UNNEEDED, struct pubkey *pubkey UNNEEDED
 const struct short_channel_id *channel_scid_or_local_alias(const struct channel *chan UNNEEDED)
 { fprintf(stderr, "channel_scid_or_local_alias called!\n"); abort(); }
 /* Generated stub for connect_htlc_in */
-void connect_htlc_in(struct htlc_in_map *map UNNEEDED, struct htlc_in *hin UNNEEDED)
+void connect_htlc_in(struct htlc_in_map *map UNNEEDED,
+		     struct htlc_expiries *expiries UNNEEDED,
+		     struct htlc_in *hin UNNEEDED)
 { fprintf(stderr, "connect_htlc_in called!\n"); abort(); }
 /* Generated stub for connect_htlc_out */
-void connect_htlc_out(struct htlc_out_map *map UNNEEDED, struct htlc_out *hout UNNEEDED)
+void connect_htlc_out(struct htlc_out_map *map UNNEEDED,
+		      struct htlc_expiries *expiries UNNEEDED,
+		      struct htlc_out *hout UNNEEDED)
 { fprintf(stderr, "connect_htlc_out called!\n"); abort(); }
 /* Generated stub for create_onionreply */
 struct onionreply *create_onionreply(const tal_t *ctx UNNEEDED,
@@ -285,7 +289,7 @@ static struct db *create_test_db(void)
 
 	dsn = tal_fmt(NULL, "sqlite3://%s", filename);
 	tal_free(filename);
-	db = db_open(NULL, dsn, db_error, (struct lightningd *)NULL);
+	db = db_open(NULL, dsn, false, db_error, (struct lightningd *)NULL);
 	db->data_version = 0;
 	db->report_changes_fn = NULL;
 
@@ -98,6 +98,11 @@ struct command_result *command_fail(struct command *cmd UNNEEDED, enum jsonrpc_e
 				    const char *fmt UNNEEDED, ...)
 
 { fprintf(stderr, "command_fail called!\n"); abort(); }
+/* Generated stub for command_next_chunk_ */
+struct command_result *command_next_chunk_(struct command *cmd UNNEEDED,
+					   void (*cb)(void *arg) UNNEEDED, void *arg UNNEEDED)
+
+{ fprintf(stderr, "command_next_chunk_ called!\n"); abort(); }
 /* Generated stub for command_param_failed */
 struct command_result *command_param_failed(void)
 
@@ -194,6 +199,9 @@ bool fromwire_hsmd_client_hsmfd_reply(const void *p UNNEEDED)
 /* Generated stub for fromwire_hsmd_derive_secret_reply */
 bool fromwire_hsmd_derive_secret_reply(const void *p UNNEEDED, struct secret *secret UNNEEDED)
 { fprintf(stderr, "fromwire_hsmd_derive_secret_reply called!\n"); abort(); }
+/* Generated stub for fromwire_hsmd_ecdh_batch_resp */
+bool fromwire_hsmd_ecdh_batch_resp(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, struct secret **ss UNNEEDED)
+{ fprintf(stderr, "fromwire_hsmd_ecdh_batch_resp called!\n"); abort(); }
 /* Generated stub for fromwire_hsmd_get_output_scriptpubkey_reply */
 bool fromwire_hsmd_get_output_scriptpubkey_reply(const tal_t *ctx UNNEEDED, const void *p UNNEEDED, u8 **script UNNEEDED)
 { fprintf(stderr, "fromwire_hsmd_get_output_scriptpubkey_reply called!\n"); abort(); }
@@ -664,16 +672,6 @@ bool plugin_hook_call_(struct lightningd *ld UNNEEDED,
 		       const char *cmd_id TAKES UNNEEDED,
 		       tal_t *cb_arg STEALS UNNEEDED)
 { fprintf(stderr, "plugin_hook_call_ called!\n"); abort(); }
-/* Generated stub for process_onionpacket */
-struct route_step *process_onionpacket(
-	const tal_t * ctx UNNEEDED,
-	const struct onionpacket *packet UNNEEDED,
-	const struct secret *shared_secret UNNEEDED,
-	const u8 *assocdata UNNEEDED,
-	const size_t assocdatalen UNNEEDED,
-	bool has_realm
-	)
-{ fprintf(stderr, "process_onionpacket called!\n"); abort(); }
 /* Generated stub for psbt_fixup */
 const u8 *psbt_fixup(const tal_t *ctx UNNEEDED, const u8 *psbtblob UNNEEDED)
 { fprintf(stderr, "psbt_fixup called!\n"); abort(); }
@@ -692,6 +690,11 @@ u8 *serialize_onionpacket(
 	const tal_t *ctx UNNEEDED,
 	const struct onionpacket *packet UNNEEDED)
 { fprintf(stderr, "serialize_onionpacket called!\n"); abort(); }
+/* Generated stub for sphinx_batch_process */
+void sphinx_batch_process(const tal_t *ctx UNNEEDED,
+			  struct sphinx_batch *batch UNNEEDED,
+			  struct sphinx_batch_onion *onions UNNEEDED)
+{ fprintf(stderr, "sphinx_batch_process called!\n"); abort(); }
 /* Generated stub for start_leak_request */
 void start_leak_request(const struct subd_req *req UNNEEDED,
 			struct leak_detect *leak_detect UNNEEDED)
@@ -799,6 +802,9 @@ u8 *towire_hsmd_client_hsmfd(const tal_t *ctx UNNEEDED, const struct node_id *id
 /* Generated stub for towire_hsmd_derive_secret */
 u8 *towire_hsmd_derive_secret(const tal_t *ctx UNNEEDED, const u8 *info UNNEEDED)
 { fprintf(stderr, "towire_hsmd_derive_secret called!\n"); abort(); }
+/* Generated stub for towire_hsmd_ecdh_batch_req */
+u8 *towire_hsmd_ecdh_batch_req(const tal_t *ctx UNNEEDED, const struct pubkey *points UNNEEDED)
+{ fprintf(stderr, "towire_hsmd_ecdh_batch_req called!\n"); abort(); }
 /* Generated stub for towire_hsmd_get_output_scriptpubkey */
 u8 *towire_hsmd_get_output_scriptpubkey(const tal_t *ctx UNNEEDED, u64 channel_id UNNEEDED, const struct node_id *peer_id UNNEEDED, const struct pubkey *commitment_point UNNEEDED)
 { fprintf(stderr, "towire_hsmd_get_output_scriptpubkey called!\n"); abort(); }
@@ -999,7 +1005,7 @@ static struct wallet *create_test_wallet(struct lightningd *ld, const tal_t *ctx
 	close(fd);
 
 	dsn = tal_fmt(NULL, "sqlite3://%s", filename);
-	w->db = db_open(w, dsn, test_error, ld);
+	w->db = db_open(w, dsn, false, test_error, ld);
 	w->db->report_changes_fn = NULL;
 	tal_free(dsn);
 	tal_add_destructor2(w, cleanup_test_wallet, filename);
@@ -1813,6 +1819,7 @@ static bool test_htlc_crud(struct lightningd *ld, const tal_t *ctx)
 	struct wallet *w = create_test_wallet(ld, ctx);
 	struct htlc_in_map *htlcs_in = tal(ctx, struct htlc_in_map), *rem;
 	struct htlc_out_map *htlcs_out = tal(ctx, struct htlc_out_map);
+	struct htlc_expiries *expiries = new_htlc_expiries(ctx);
 	struct onionreply *onionreply;
 
 	/* Make sure we have our references correct */
@@ -1884,12 +1891,13 @@ static bool test_htlc_crud(struct lightningd *ld, const tal_t *ctx)
 	db_begin_transaction(w->db);
 	CHECK(!wallet_err);
 
-	CHECK_MSG(wallet_htlcs_load_in_for_channel(w, chan, htlcs_in),
+	CHECK_MSG(wallet_htlcs_load_in_for_channel(w, chan, htlcs_in, expiries),
 		  "Failed loading in HTLCs");
 	/* Freed by htlcs_resubmit */
 	rem = tal(NULL, struct htlc_in_map);
 	htlc_in_map_copy(rem, htlcs_in);
-	CHECK_MSG(wallet_htlcs_load_out_for_channel(w, chan, htlcs_out, rem),
+	CHECK_MSG(wallet_htlcs_load_out_for_channel(w, chan, htlcs_out, expiries,
+						    rem),
 		  "Failed loading out HTLCs");
 	db_commit_transaction(w->db);
 
@@ -1988,6 +1996,14 @@ int main(int argc, const char *argv[])
 	peer_node_id_map_init(ld->peers);
 	ld->peers_by_dbid = tal(ld, struct peer_dbid_map);
 	peer_dbid_map_init(ld->peers_by_dbid);
+	ld->channels_by_scid = tal(ld, struct channel_scid_map);
+	channel_scid_map_init(ld->channels_by_scid);
+	ld->channels_by_alias = tal(ld, struct channel_alias_map);
+	channel_alias_map_init(ld->channels_by_alias);
+	ld->channels_by_dbid = tal(ld, struct channel_dbid_map);
+	channel_dbid_map_init(ld->channels_by_dbid);
+	ld->channels_by_cid = tal(ld, struct channel_cid_map);
+	channel_cid_map_init(ld->channels_by_cid);
 	ld->rr_counter = 0;
 	node_id_from_hexstr("02a1633cafcc01ebfb6d78e39f687a1f0995c62fc95f51ead10a02ee0be551b5dc", 66, &ld->id);
 	/* Accessed in peer destructor sanity check */
@@ -1995,6 +2011,7 @@ int main(int argc, const char *argv[])
 	htlc_in_map_init(ld->htlcs_in);
 	ld->htlcs_out = tal(ld, struct htlc_out_map);
 	htlc_out_map_init(ld->htlcs_out);
+	ld->htlc_expiries = new_htlc_expiries(ld);
 
 	/* We do a runtime test here, so we still check compile! */
 	if (HAVE_SQLITE3) {
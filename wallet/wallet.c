@@ -6,7 +6,9 @@
 #include <ccan/tal/str/str.h>
 #include <common/blockheight_states.h>
 #include <common/fee_states.h>
+#include <common/memleak.h>
 #include <common/onionreply.h>
+#include <common/timeout.h>
 #include <common/trace.h>
 #include <common/type_to_string.h>
 #include <db/bindings.h>
@@ -104,6 +106,19 @@ static void outpointfilters_init(struct wallet *w)
 	tal_free(stmt);
 }
 
+/* Once an hour, say how the prepared statement cache is doing. */
+#define STMT_CACHE_STATS_INTERVAL_SECS 3600
+
+static void log_stmt_cache_stats(struct wallet *w)
+{
+	log_info(w->log, "Prepared statement cache: %"PRIu64" hits,"
+		 " %"PRIu64" misses",
+		 w->db->stmt_cache_hits, w->db->stmt_cache_misses);
+	notleak(new_reltimer(w->ld->timers, w,
+			     time_from_sec(STMT_CACHE_STATS_INTERVAL_SECS),
+			     log_stmt_cache_stats, w));
+}
+
 struct wallet *wallet_new(struct lightningd *ld, struct timers *timers)
 {
 	struct wallet *wallet = tal(ld, struct wallet);
@@ -130,6 +145,10 @@ struct wallet *wallet_new(struct lightningd *ld, struct timers *timers)
 	trace_span_end(wallet);
 
 	db_commit_transaction(wallet->db);
+
+	notleak(new_reltimer(timers, wallet,
+			     time_from_sec(STMT_CACHE_STATS_INTERVAL_SECS),
+			     log_stmt_cache_stats, wallet));
 	return wallet;
 }
 
@@ -3009,7 +3028,8 @@ static void fixup_hin(struct wallet *wallet, struct htlc_in *hin)
 
 bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 				      struct channel *chan,
-				      struct htlc_in_map *htlcs_in)
+				      struct htlc_in_map *htlcs_in,
+				      struct htlc_expiries *expiries)
 {
 	struct db_stmt *stmt;
 	bool ok = true;
@@ -3049,7 +3069,7 @@ bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 	while (db_step(stmt)) {
 		struct htlc_in *in = tal(chan, struct htlc_in);
 		ok &= wallet_stmt2htlc_in(chan, stmt, in);
-		connect_htlc_in(htlcs_in, in);
+		connect_htlc_in(htlcs_in, expiries, in);
 		fixup_hin(wallet, in);
 		ok &= htlc_in_check(in, NULL) != NULL;
 		incount++;
@@ -3063,6 +3083,7 @@ bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
 				       struct channel *chan,
 				       struct htlc_out_map *htlcs_out,
+				       struct htlc_expiries *expiries,
 				       struct htlc_in_map *unconnected_htlcs_in)
 {
 	struct db_stmt *stmt;
@@ -3103,7 +3124,7 @@ bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
 		struct htlc_out *out = tal(chan, struct htlc_out);
 		ok &= wallet_stmt2htlc_out(wallet, chan, stmt, out,
 					   unconnected_htlcs_in);
-		connect_htlc_out(htlcs_out, out);
+		connect_htlc_out(htlcs_out, expiries, out);
 		/* Cannot htlc_out_check because we haven't wired the
 		 * dependencies in yet */
 		outcount++;
@@ -3698,7 +3719,9 @@ void wallet_payment_set_failinfo(struct wallet *wallet,
 const struct wallet_payment **
 wallet_payment_list(const tal_t *ctx,
 		    struct wallet *wallet,
-		    const struct sha256 *payment_hash)
+		    const struct sha256 *payment_hash,
+		    u64 start,
+		    const u32 *limit)
 {
 	const struct wallet_payment **payments;
 	struct db_stmt *stmt;
@@ -3732,7 +3755,9 @@ wallet_payment_list(const tal_t *ctx,
 						     " FROM payments"
 						     " WHERE"
 						     "  payment_hash = ?"
-						     " ORDER BY id;"));
+						     "  AND id >= ?"
+						     " ORDER BY id"
+						     " LIMIT ?;"));
 		db_bind_sha256(stmt, payment_hash);
 	} else {
 		stmt = db_prepare_v2(wallet->db, SQL("SELECT"
@@ -3757,8 +3782,15 @@ wallet_payment_list(const tal_t *ctx,
 						     ", groupid"
 						     ", completed_at"
 						     " FROM payments"
-						     " ORDER BY id;"));
+						     " WHERE id >= ?"
+						     " ORDER BY id"
+						     " LIMIT ?;"));
 	}
+	db_bind_u64(stmt, start);
+	if (limit)
+		db_bind_int(stmt, *limit);
+	else
+		db_bind_int(stmt, INT_MAX);
 	db_query_prepared(stmt);
 
 	for (i = 0; db_step(stmt); i++) {
@@ -3767,6 +3799,10 @@ wallet_payment_list(const tal_t *ctx,
 	}
 	tal_free(stmt);
 
+	/* There may be more in the db: they'll ask again. */
+	if (limit && i == *limit)
+		return payments;
+
 	/* Now attach payments not yet in db. */
 	list_for_each(&wallet->unstored_payments, p, list) {
 		if (payment_hash && !sha256_eq(&p->payment_hash, payment_hash))
@@ -4684,7 +4720,9 @@ const struct forwarding *wallet_forwarded_payments_get(struct wallet *w,
 						       const tal_t *ctx,
 						       enum forward_status status,
 						       const struct short_channel_id *chan_in,
-						       const struct short_channel_id *chan_out)
+						       const struct short_channel_id *chan_out,
+						       const struct forwarding *after,
+						       const u32 *limit)
 {
 	struct forwarding *results = tal_arr(ctx, struct forwarding, 0);
 	size_t count = 0;
@@ -4710,7 +4748,10 @@ const struct forwarding *wallet_forwarded_payments_get(struct wallet *w,
 		"FROM forwards "
 		"WHERE (1 = ? OR state = ?) AND "
 		"(1 = ? OR in_channel_scid = ?) AND "
-		"(1 = ? OR out_channel_scid = ?)"));
+		"(1 = ? OR out_channel_scid = ?) AND "
+		"(in_channel_scid, in_htlc_id) > (?, ?) "
+		"ORDER BY in_channel_scid, in_htlc_id "
+		"LIMIT ?"));
 
 	if (status == FORWARD_ANY) {
 		// any status
@@ -4742,6 +4783,22 @@ const struct forwarding *wallet_forwarded_payments_get(struct wallet *w,
 		db_bind_int(stmt, any);
 	}
 
+	/* The primary key orders these, so we can carry on from any of them
+	 * (migrated ones can have negative in_htlc_id, so start from the
+	 * very bottom). */
+	if (after) {
+		db_bind_short_channel_id(stmt, &after->channel_in);
+		db_bind_u64(stmt, after->htlc_id_in);
+	} else {
+		db_bind_s64(stmt, INT64_MIN);
+		db_bind_s64(stmt, INT64_MIN);
+	}
+
+	if (limit)
+		db_bind_int(stmt, *limit);
+	else
+		db_bind_int(stmt, INT_MAX);
+
 	db_query_prepared(stmt);
 
 	for (count=0; db_step(stmt); count++) {
@@ -4796,7 +4853,7 @@ const struct forwarding *wallet_forwarded_payments_get(struct wallet *w,
 		cur->received_time = db_col_timeabs(stmt, "received_time");
 
 		if (!db_col_is_null(stmt, "resolved_time")) {
-			cur->resolved_time = tal(ctx, struct timeabs);
+			cur->resolved_time = tal(results, struct timeabs);
 			*cur->resolved_time
 				= db_col_timeabs(stmt, "resolved_time");
 		} else {
@@ -5575,6 +5632,9 @@ struct wallet_htlc_iter {
 struct wallet_htlc_iter *wallet_htlcs_first(const tal_t *ctx,
 					    struct wallet *w,
 					    const struct channel *chan,
+					    u64 liststart,
+					    const u32 *listlimit,
+					    u64 *dbid,
 					    struct short_channel_id *scid,
 					    u64 *htlc_id,
 					    int *cltv_expiry,
@@ -5591,7 +5651,8 @@ struct wallet_htlc_iter *wallet_htlcs_first(const tal_t *ctx,
 		assert(chan->dbid != 0);
 
 		i->stmt = db_prepare_v2(w->db,
-					SQL("SELECT h.channel_htlc_id"
+					SQL("SELECT h.id"
+					    ", h.channel_htlc_id"
 					    ", h.cltv_expiry"
 					    ", h.direction"
 					    ", h.msatoshi"
@@ -5599,12 +5660,15 @@ struct wallet_htlc_iter *wallet_htlcs_first(const tal_t *ctx,
 					    ", h.hstate"
 					    " FROM channel_htlcs h"
 					    " WHERE channel_id = ?"
-					    " ORDER BY id ASC"));
+					    " AND id >= ?"
+					    " ORDER BY id ASC"
+					    " LIMIT ?"));
 		db_bind_u64(i->stmt, chan->dbid);
 	} else {
 		i->scid.u64 = 0;
 		i->stmt = db_prepare_v2(w->db,
-					SQL("SELECT channels.scid"
+					SQL("SELECT h.id"
+					    ", channels.scid"
 					    ", channels.alias_local"
 					    ", h.channel_htlc_id"
 					    ", h.cltv_expiry"
@@ -5614,19 +5678,27 @@ struct wallet_htlc_iter *wallet_htlcs_first(const tal_t *ctx,
 					    ", h.hstate"
 					    " FROM channel_htlcs h"
 					    " JOIN channels ON channels.id = h.channel_id"
-					    " ORDER BY h.id ASC"));
+					    " WHERE h.id >= ?"
+					    " ORDER BY h.id ASC"
+					    " LIMIT ?"));
 	}
+	db_bind_u64(i->stmt, liststart);
+	if (listlimit)
+		db_bind_int(i->stmt, *listlimit);
+	else
+		db_bind_int(i->stmt, INT_MAX);
 	/* FIXME: db_prepare should take ctx! */
 	tal_steal(i, i->stmt);
 	db_query_prepared(i->stmt);
 
-	return wallet_htlcs_next(w, i,
+	return wallet_htlcs_next(w, i, dbid,
 				 scid, htlc_id, cltv_expiry, owner, msat,
 				 payment_hash, hstate);
 }
 
 struct wallet_htlc_iter *wallet_htlcs_next(struct wallet *w,
 					   struct wallet_htlc_iter *iter,
+					   u64 *dbid,
 					   struct short_channel_id *scid,
 					   u64 *htlc_id,
 					   int *cltv_expiry,
@@ -5638,6 +5710,7 @@ struct wallet_htlc_iter *wallet_htlcs_next(struct wallet *w,
 	if (!db_step(iter->stmt))
 		return tal_free(iter);
 
+	*dbid = db_col_u64(iter->stmt, "h.id");
 	if (iter->scid.u64 != 0)
 		*scid = iter->scid;
 	else {
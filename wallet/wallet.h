@@ -17,6 +17,7 @@ struct amount_msat;
 struct invoices;
 struct channel;
 struct channel_inflight;
+struct htlc_expiries;
 struct json_escape;
 struct lightningd;
 struct node_id;
@@ -795,13 +796,15 @@ void wallet_htlc_update(struct wallet *wallet, const u64 htlc_dbid,
  * @wallet: wallet to load from
  * @chan: load HTLCs associated with this channel
  * @htlcs_in: htlc_in_map to store loaded htlc_in in
+ * @expiries: htlc_expiries to index them by cltv_expiry
  *
  * This function looks for incoming HTLCs that are associated with the given
  * channel and loads them into the provided map.
  */
 bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 				      struct channel *chan,
-				      struct htlc_in_map *htlcs_in);
+				      struct htlc_in_map *htlcs_in,
+				      struct htlc_expiries *expiries);
 
 /**
  * wallet_htlcs_load_out_for_channel - Load outgoing HTLCs associated with chan from DB.
@@ -809,6 +812,7 @@ bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
  * @wallet: wallet to load from
  * @chan: load HTLCs associated with this channel
  * @htlcs_out: htlc_out_map to store loaded htlc_out in.
+ * @expiries: htlc_expiries to index them by cltv_expiry
  * @remaining_htlcs_in: htlc_in_map with unconnected htlcs (removed as we progress)
  *
  * We populate htlc_out->in by looking up in remaining_htlcs_in.  It's
@@ -818,6 +822,7 @@ bool wallet_htlcs_load_in_for_channel(struct wallet *wallet,
 bool wallet_htlcs_load_out_for_channel(struct wallet *wallet,
 				       struct channel *chan,
 				       struct htlc_out_map *htlcs_out,
+				       struct htlc_expiries *expiries,
 				       struct htlc_in_map *remaining_htlcs_in);
 
 /**
@@ -992,10 +997,17 @@ void wallet_payment_set_failinfo(struct wallet *wallet,
  * wallet_payment_list - Retrieve a list of payments
  *
  * payment_hash: optional filter for only this payment hash.
+ * start: only return stored payments with id >= this.
+ * limit: optional maximum number of stored payments to return.
+ *
+ * Payments not yet stored (id 0) are appended once the stored ones run out,
+ * so if this returns @limit stored payments, ask again from the last id + 1.
  */
 const struct wallet_payment **wallet_payment_list(const tal_t *ctx,
 						  struct wallet *wallet,
-						  const struct sha256 *payment_hash)
+						  const struct sha256 *payment_hash,
+						  u64 start,
+						  const u32 *limit)
 	NON_NULL_ARGS(2);
 
 
@@ -1169,13 +1181,19 @@ void wallet_forwarded_payment_add(struct wallet *w, const struct htlc_in *in,
 struct amount_msat wallet_total_forward_fees(struct wallet *w);
 
 /**
- * Retrieve a list of all forwarded_payments
+ * Retrieve a list of forwarded_payments
+ *
+ * These are ordered by in_channel, then in_htlc_id.  If @after is
+ * non-NULL, we start after that one; if @limit is non-NULL, we return at
+ * most that many.  Hand the last one back as @after to get the next lot.
  */
 const struct forwarding *wallet_forwarded_payments_get(struct wallet *w,
 						       const tal_t *ctx,
 						       enum forward_status state,
 						       const struct short_channel_id *chan_in,
-						       const struct short_channel_id *chan_out);
+						       const struct short_channel_id *chan_out,
+						       const struct forwarding *after,
+						       const u32 *limit);
 
 /**
  * Delete a particular forward entry
@@ -1539,6 +1557,9 @@ bool datastore_key_eq(const char **k1, const char **k2);
  * Iterate through the htlcs table.
  * @w: the wallet
  * @chan: optional channel to filter by
+ * @liststart: first db id to return
+ * @listlimit: optional maximum number to return
+ * @dbid: set to the db id of each one (start from @dbid + 1 next time)
  *
  * Returns pointer to hand as @iter to wallet_htlcs_next(), or NULL.
  * If you choose not to call wallet_htlcs_next() you must free it!
@@ -1546,6 +1567,9 @@ bool datastore_key_eq(const char **k1, const char **k2);
 struct wallet_htlc_iter *wallet_htlcs_first(const tal_t *ctx,
 					    struct wallet *w,
 					    const struct channel *chan,
+					    u64 liststart,
+					    const u32 *listlimit,
+					    u64 *dbid,
 					    struct short_channel_id *scid,
 					    u64 *htlc_id,
 					    int *cltv_expiry,
@@ -1564,6 +1588,7 @@ struct wallet_htlc_iter *wallet_htlcs_first(const tal_t *ctx,
  */
 struct wallet_htlc_iter *wallet_htlcs_next(struct wallet *w,
 					   struct wallet_htlc_iter *iter,
+					   u64 *dbid,
 					   struct short_channel_id *scid,
 					   u64 *htlc_id,
 					   int *cltv_expiry,